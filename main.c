@@ -7,20 +7,358 @@
  * - Viewing all incidents
  * - Filtering incidents by area or type
  * - Persistent data storage using files
+ *
+ * Build: cc main.c -lm
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
 #include <time.h>
 
-#define MAX_INCIDENTS 100
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/mempolicy.h>
+#include <linux/perf_event.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+#define INITIAL_INCIDENT_CAPACITY 100
 #define MAX_STRING_LENGTH 100
 #define MAX_AREA_LENGTH 50
 #define MAX_TYPE_LENGTH 50
+#define MAX_INCIDENT_TYPES 65536 // Type ids are kept in an unsigned short
 #define MAX_TIME_LENGTH 20
+#define MAX_DESCRIPTION_LENGTH 256
+#define MAX_LINE_LENGTH (MAX_STRING_LENGTH * 3 + MAX_DESCRIPTION_LENGTH) // One line of an incidents file
 #define DATA_FILE "incidents.txt"
+#define SUBSCRIPTIONS_FILE "subscriptions.txt"
+#define MAX_SUBSCRIBER_LENGTH 50
+
+// Which incident field a watch list subscription looks at
+#define WATCH_ANY 0
+#define WATCH_AREA 1
+#define WATCH_TYPE 2
+
+#define MAX_QUERY_LENGTH 256
+#define MAX_QUERY_ITEMS 8
+#define MAX_QUERY_PREDICATES 8
+#define MAX_PLAN_OPERATORS (MAX_QUERY_PREDICATES + 4)
+#define QUERY_BATCH_SIZE 1024
+#define PREPARED_QUERY_SLOTS 16
+
+// Query columns; QCOL_COUNT is the count(*) aggregate
+#define QCOL_ID 0
+#define QCOL_AREA 1
+#define QCOL_TYPE 2
+#define QCOL_TIME 3
+#define QCOL_STATUS 4
+#define QCOL_PRIORITY 5
+#define QCOL_COUNT 6
+
+// Query predicate operators
+#define QOP_EQ 0
+#define QOP_NE 1
+#define QOP_LT 2
+#define QOP_LE 3
+#define QOP_GT 4
+#define QOP_GE 5
+#define QOP_CONTAINS 6
+#define QOP_BETWEEN 7
+
+// Query plan operators
+#define PLAN_SCAN 0
+#define PLAN_FILTER 1
+#define PLAN_AGGREGATE 2
+#define PLAN_SORT 3
+#define PLAN_LIMIT 4
+
+// Query token kinds
+#define TOKEN_END 0
+#define TOKEN_WORD 1
+#define TOKEN_STRING 2
+#define TOKEN_NUMBER 3
+#define TOKEN_SYMBOL 4
+#define TOKEN_ERROR 5
+
+// Adaptive indexes: built for columns filtered at least MIN_USES times, scanning on average at
+// least MIN_ROWS rows and keeping at most MAX_SELECTIVITY of them; dropped after IDLE_QUERIES
+// queries without use or when all indexes together exceed MEMORY_BUDGET bytes
+#define ADAPTIVE_INDEX_MIN_USES 3
+#define ADAPTIVE_INDEX_MIN_ROWS 1000
+#define ADAPTIVE_INDEX_MAX_SELECTIVITY 0.2
+#define ADAPTIVE_INDEX_IDLE_QUERIES 50
+#define ADAPTIVE_INDEX_MEMORY_BUDGET ((size_t)64 * 1024 * 1024)
+#define ADAPTIVE_INDEX_BUILD_CHUNK 262144
+#define ADAPTIVE_INDEX_MAX_FRACTION 2 // Use an index only when it leaves at most 1/2 of the rows
+
+// Column statistics for selectivity estimation
+#define MCV_SIZE 10
+#define HISTOGRAM_BUCKETS 32
+#define HISTOGRAM_REBUILD_SPACING 4 // A drifted histogram is rebuilt after 1/4 more rows than it was built from
+#define MAX_STATUS_VALUES 8
+#define STATISTICS_EXACT_AREAS 4096 // Estimate area substring filters exactly up to this many areas
+#define DEFAULT_SELECTIVITY 0.1
+
+// Rollup cube of counts by area, type and minute of the day
+#define ROLLUP_ALL -1                              // Area or type id of a marginal cell
+#define ROLLUP_FENWICK_THRESHOLD (MINUTES_PER_DAY * 2) // Cells larger than this switch to a Fenwick tree
+#define ROLLUP_MAX_CELLS 4096                      // Answer count(*) from the cube only up to this many cells
+
+// Cooperative cancellation of long scans
+#define SCAN_RUNNING 0
+#define SCAN_CANCELLED 1
+#define SCAN_TIMED_OUT 2
+#define SCAN_CHECK_BATCHES 8 // Poll the keyboard and clock once per this many batches
+
+// Approximate queries over a uniform reservoir sample of the store
+#define RESERVOIR_SIZE 65536
+#define CONFIDENCE_Z 1.96                      // 95% confidence intervals
+#define QUERY_MODE_ENV "INCIDENTS_QUERY_MODE"  // "exact" (default) or "approx"
+
+// Full-text search over incident descriptions
+#define MAX_TERM_LENGTH 32
+#define MAX_DESCRIPTION_TERMS (MAX_DESCRIPTION_LENGTH / 2 + 1)
+#define MAX_SEARCH_TERMS 16
+#define MAX_SEARCH_PHRASES 4
+#define SEARCH_RESULTS 20
+#define BM25_K1 1.2
+#define BM25_B 0.75
+
+#define RULES_FILE "rules.txt"
+#define MAX_RULE_NAME_LENGTH 50
+#define MAX_RULE_THRESHOLD 10000 // Sliding windows keep threshold + 1 timestamps per key
+#define MINUTES_PER_DAY 1440
+
+// Which incident fields group events into one window
+#define RULE_KEY_AREA 0
+#define RULE_KEY_TYPE 1
+#define RULE_KEY_AREA_TYPE 2
+
+// Incident status values kept in the hot record
+#define STATUS_OPEN 0
+#define STATUS_DISPATCHED 1
+
+// Incident priorities, from a faded crosswalk to a gas leak
+#define PRIORITY_LOW 1
+#define PRIORITY_NORMAL 3
+#define PRIORITY_CRITICAL 5
+
+// Dispatch queue of open incidents, with its change log next to the incidents file
+#define DISPATCH_FILE "dispatch.txt"
+#define DISPATCH_HEAP_ARITY 4
+#define DISPATCH_PREVIEW 10
+
+// Version history of incident changes, read by AS OF queries
+#define HISTORY_DAYS_ENV "INCIDENTS_HISTORY_DAYS" // Days superseded versions are kept (default 30)
+#define DEFAULT_HISTORY_DAYS 30
+#define HISTORY_GC_MIN_VERSIONS 4096               // Live versions before the first collection
+#define SECONDS_PER_DAY 86400L
+
+// Batch crew assignment
+#define CREWS_FILE "crews.txt"
+#define ASSIGNMENTS_FILE "assignments.txt"
+#define MAX_CREW_NAME_LENGTH 50
+#define CREW_JOB_MAX_SIZE 8         // Incidents of one area, type and priority handled in a single visit
+#define CREW_LOCAL_SEARCH_PASSES 8
+#define MAX_OPTIMIZER_THREADS 16
+
+// Columns at least this large are mapped directly so they can be backed by huge pages
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define HUGE_PAGES_ENV "INCIDENTS_HUGE_PAGES" // "off", "thp" (default) or "explicit"
+#define HUGE_PAGES_OFF 0
+#define HUGE_PAGES_TRANSPARENT 1
+#define HUGE_PAGES_EXPLICIT 2
+#define MAX_NUMA_NODES 64
+
+// Store shared by instances on one host through a mapped segment file
+#define SHARED_STORE_ENV "INCIDENTS_SHARED_STORE" // Segment path, e.g. /dev/shm/incidents; unset for a private store
+#define SHARED_STORE_MAGIC 0x49434453u
+#define SHARED_STORE_MIN_ROWS (1 << 20)
+#define SHARED_STORE_TYPES 65536                   // Every id an IncidentHot.typeId can hold
+#define SHARED_STORE_ALIGNMENT 4096
+
+// Server mode: one worker process pinned to each core, owning the incidents of the areas that hash to it and
+// accepting connections on a port shared through SO_REUSEPORT. A request for another worker's areas is passed to
+// it through a single-producer ring in shared memory; the only other shared state is the id sequence.
+#define SERVER_PORT_ENV "INCIDENTS_SERVER_PORT"       // Port to serve on; unset runs the interactive menu
+#define SERVER_WORKERS_ENV "INCIDENTS_SERVER_WORKERS" // Workers (default: one per online core)
+#define MAX_SERVER_WORKERS 64
+#define SERVER_RING_SLOTS 32
+#define SERVER_MESSAGE_BYTES 4096 // Longest request line, and longest reply passed between workers
+#define SERVER_LIST_LIMIT 20      // Most recent incidents a LIST reply carries
+#define SERVER_EVENTS 64
+#define SERVER_REQUEST 0
+#define SERVER_REPLY 1
+#define EXPORT_MIGRATION_IDLE 0    // No migrated copy of the incidents file for EXPORT exists or is being made
+#define EXPORT_MIGRATION_RUNNING 1 // A thread is migrating older rows into a temporary copy
+#define EXPORT_MIGRATION_DONE 2    // The copy is ready for the next EXPORT (or failed, if its descriptor is -1)
+
+// Stackless coroutines for server requests. A task's function is re-entered from the top and jumps to where it
+// last suspended, so anything it needs across a suspension lives in the task, not in locals.
+#define TASK_BEGIN(task) switch ((task)->resumePoint) { case 0:
+#define TASK_SUSPEND_UNTIL(task, condition) \
+    do { (task)->resumePoint = __LINE__; if (0) { case __LINE__:; } if (!(condition)) { return 0; } } while (0)
+#define TASK_END(task) } return 1;
+
+// Municipalities hosted in one process, one line each: name|directory|memory MB|query ms|optimizer threads.
+// Each keeps its own files in its directory; 0 (or a missing field) leaves that quota unlimited.
+#define TENANTS_FILE "tenants.txt"
+#define MAX_TENANTS 64
+
+// Globals that together make up one municipality's store, indexes and id sequence. They are saved and
+// restored as a whole when switching municipalities; configuration read at startup is shared by all.
+#define STORE_STATE(X) \
+    X(incidentHot) X(incidentCold) X(incidentCount) X(incidentCapacity) X(sharedStore) X(sharedHot) \
+    X(dispatchLogOffset) X(incidentFileOffset) X(incidentFileLayout) X(legacyIncidentRows) \
+    X(lastCompactionTime) X(deferredIndexFrom) \
+    X(incidentTypes) X(incidentTypeCount) X(incidentTypeCapacity) X(typeTable) X(typeTableSize) X(idTable) X(idTableSize) X(idTableValid) \
+    X(dispatchHeap) X(dispatchHeapCount) X(dispatchHeapCapacity) X(dispatchSlot) X(dispatchSlotCapacity) \
+    X(dispatchQueueReady) \
+    X(versions) X(versionCapacity) X(versionFree) X(liveVersions) X(nextVersionCollection) X(versionHead) \
+    X(versionHeadCapacity) X(historyHorizon) X(lastCommitTime) \
+    X(areaKeys) X(areaKeyCount) X(areaKeyCapacity) X(areaKeyTable) X(areaKeyTableSize) \
+    X(checkpointRows) X(checkpointLogOffset) X(lastCheckpointTime) X(restoredCheckpointRows) X(replayedIncidentRows) \
+    X(subscriptions) X(subscriptionCount) X(subscriptionCapacity) X(watchNodes) X(watchNodeCount) \
+    X(watchNodeCapacity) X(watchMatchNext) X(watchAlertStamp) X(watchCheckStamp) \
+    X(alertRules) X(alertRuleCount) X(windowStates) X(windowStateCount) X(windowStateCapacity) X(windowTable) \
+    X(windowTableSize) X(streamDay) X(lastStreamMinute) \
+    X(preparedQueries) X(preparedQueryClock) X(adaptiveIndexes) X(predicateStats) X(querySequence) \
+    X(columnStats) \
+    X(rollupCells) X(rollupCellCount) X(rollupCellCapacity) X(rollupTable) X(rollupTableSize) X(rollupCubeValid) \
+    X(reservoir) X(reservoirCount) X(reservoirOrdered) X(reservoirOrderedValid) X(sampleRandomState) \
+    X(descriptionText) X(descriptionTextLength) X(descriptionTextCapacity) X(termPostings) X(termCount) \
+    X(termCapacity) X(termTable) X(termTableSize) X(describedIncidents) X(totalDescriptionTerms) X(textIndexValid)
+#define STORE_STATE_BYTES(name) bytes += sizeof(name);
+#define SAVE_STORE_STATE(name) memcpy(state, &(name), sizeof(name)); state += sizeof(name);
+#define LOAD_STORE_STATE(name) memcpy(&(name), state, sizeof(name)); state += sizeof(name);
+
+// Versioned layout of incidents file lines. A "#schema <version>|<field>|..." line starts a segment whose lines
+// carry those fields in that order; lines before any such line use the original, unversioned layout. Fields a
+// segment lacks take their defaults and fields this program does not know are skipped, so old files are read as
+// they are and only rewritten in the current schema when the file is compacted.
+#define SCHEMA_PREFIX "#schema "
+#define INCIDENT_SCHEMA_VERSION 1
+#define FIELD_UNKNOWN -1
+#define FIELD_ID 0
+#define FIELD_AREA 1
+#define FIELD_TYPE 2
+#define FIELD_TIME 3
+#define FIELD_DESCRIPTION 4
+#define FIELD_PRIORITY 5
+#define FIELD_REPORTED 6
+#define INCIDENT_FIELDS 7
+#define REQUIRED_INCIDENT_FIELDS 4 // id, area, type and time; a line without them is not an incident
+#define MAX_SCHEMA_FIELDS 32
+#define COMPACTION_INTERVAL_SECONDS 300 // Running time before old segments are migrated
+
+// Checkpoint image of the in-memory state, so a restart only replays what was logged after it
+#define CHECKPOINT_ENV "INCIDENTS_CHECKPOINT"    // Image path (default below), or "off"
+#define CHECKPOINT_FILE "incidents.ckpt"
+#define CHECKPOINT_MAGIC 0x49434b50u
+#define CHECKPOINT_FORMAT 3
+#define CHECKPOINT_INTERVAL_SECONDS 300          // Between checkpoints while the program runs
+#define CHECKPOINT_HASH_CHUNK 1048576            // Bytes of the incidents file read at a time while fingerprinting
+#define CHECKPOINT_ALIGNMENT 64
+#define CKPT_HOT 0
+#define CKPT_COLD 1
+#define CKPT_TYPES 2
+#define CKPT_AREAS 3
+#define CKPT_AREA_TABLE 4
+#define CKPT_ID_TABLE 5
+#define CKPT_DESCRIPTIONS 6
+#define CKPT_TERMS 7
+#define CKPT_POSTINGS 8
+#define CKPT_TERM_TABLE 9
+#define CKPT_CELLS 10
+#define CKPT_CELL_DATA 11
+#define CKPT_CELL_TABLE 12
+#define CKPT_RESERVOIR 13
+#define CKPT_AREA_COUNTS 14
+#define CKPT_TYPE_COUNTS 15
+#define CKPT_VERSIONS 16
+#define CKPT_VERSION_HEADS 17
+#define CHECKPOINT_SECTIONS 18
+
+// Parquet export: row groups are encoded in parallel, one per thread at a time, and written out in order
+#define PARQUET_MAGIC "PAR1"
+#define PARQUET_ROW_GROUP_ROWS 131072
+#define PARQUET_COLUMNS 8
+#define PARQUET_INT32 1        // Physical types
+#define PARQUET_INT64 2
+#define PARQUET_BYTE_ARRAY 6
+#define PARQUET_PLAIN 0        // Encodings
+#define PARQUET_RLE 3
+#define PARQUET_RLE_DICTIONARY 8
+#define PARQUET_DATA_PAGE 0    // Page types
+#define PARQUET_DICTIONARY_PAGE 2
+#define PARQUET_REQUIRED 0
+#define PARQUET_UTF8 0         // Converted type of the text columns
+#define PCOL_ID 0
+#define PCOL_AREA 1
+#define PCOL_TYPE 2
+#define PCOL_TIME 3
+#define PCOL_DESCRIPTION 4
+#define PCOL_PRIORITY 5
+#define PCOL_STATUS 6
+#define PCOL_REPORTED 7
+// Thrift compact protocol, which Parquet page headers and the file footer are written in
+#define THRIFT_I32 5
+#define THRIFT_I64 6
+#define THRIFT_BINARY 8
+#define THRIFT_LIST 9
+#define THRIFT_STRUCT 12
+#define THRIFT_MAX_DEPTH 8
+
+// Arrow export: a columnar copy of the store handed over through the C Data Interface, and Arrow IPC files of it
+#define ARROW_SNAPSHOT_ENV "INCIDENTS_ARROW_SNAPSHOT" // Also write an Arrow IPC file here with every checkpoint
+#define ARROW_MAGIC "ARROW1"
+#define ARROW_COLUMNS 8
+#define ARROW_DICTIONARIES 3       // Area, type and status values
+#define ARROW_MAX_BUFFERS 32
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_STATUS_VALUES 2      // STATUS_OPEN and STATUS_DISPATCHED
+#define ARROW_METADATA_V5 4        // Flatbuffer enums of the IPC format (Schema.fbs, Message.fbs)
+#define ARROW_HEADER_SCHEMA 1
+#define ARROW_HEADER_DICTIONARY 2
+#define ARROW_HEADER_RECORD_BATCH 3
+#define ARROW_TYPE_INT 2
+#define ARROW_TYPE_UTF8 5
+#define ARROW_TYPE_TIME 9
+#define ARROW_TYPE_TIMESTAMP 10
+#define ARROW_UNIT_SECOND 0
+#define FLAT_MAX_FIELDS 8         // Most fields a flatbuffer table written here has
+
+// How many records ahead the selection loops prefetch
+#define PREFETCH_DISTANCE 16
+#if defined(__GNUC__) || defined(__clang__)
+#define PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PREFETCH(address) ((void)0)
+#endif
+#define BENCHMARK_ENV "INCIDENTS_BENCHMARK" // Filter text to time the scan loops with; the program exits afterwards
+#define BENCHMARK_PASSES 5                  // Full scans timed per loop
+#define BENCHMARK_LOOPS 9
 
 // ANSI color codes for terminal output
 #define ANSI_COLOR_RED     "\x1b[31m"
@@ -31,12 +369,582 @@
 #define ANSI_COLOR_CYAN    "\x1b[36m"
 #define ANSI_COLOR_RESET   "\x1b[0m"
 
-// Structure to represent an incident
+// Structure to represent an incident as it is entered and stored in the file
 struct Incident {
     char area[MAX_AREA_LENGTH];
     char type[MAX_TYPE_LENGTH];
     char time[MAX_TIME_LENGTH]; // Time when the incident occurred
     int id;
+    char description[MAX_DESCRIPTION_LENGTH]; // Free text from the caller, may be empty
+    int priority;                             // PRIORITY_LOW to PRIORITY_CRITICAL
+    long reported;                            // Commit time of the report (seconds since the epoch), 0 if unknown
+};
+
+// Fields touched by every filter scan, packed densely so a scan only pulls these through cache
+struct IncidentHot {
+    int id;
+    int areaId;                 // Index into the (case-insensitive) area dictionary
+    unsigned short typeId;      // Index into the incident type dictionary
+    unsigned short timeMinutes; // Minutes since midnight
+    unsigned char status;
+    unsigned char priority;
+};
+
+// Fields only needed when printing an incident, stored at the same position as its hot record
+struct IncidentCold {
+    char area[MAX_AREA_LENGTH];
+    long description;                // Offset into descriptionText, -1 when there is none
+    unsigned short descriptionTerms; // Tokens in the description, for BM25 length normalization
+    long reported;                   // Commit time of the report, 0 if unknown
+};
+
+// The incident record as it was before the hot/cold split (124 bytes), kept for the benchmark's layout comparison
+struct BenchmarkRecord {
+    char area[MAX_AREA_LENGTH];
+    char type[MAX_TYPE_LENGTH];
+    char time[MAX_TIME_LENGTH];
+    int id;
+};
+
+// A superseded state of an incident, chained newest first apart from the store so current reads skip it
+struct IncidentVersion {
+    long validUntil; // Commit time of the change that replaced this state
+    int older;       // Next older version of the same incident, -1 at the end; free list link when unused
+    unsigned char status;
+    unsigned char priority;
+};
+
+// A supervisor's standing watch for incidents whose text contains a pattern
+struct Subscription {
+    char subscriber[MAX_SUBSCRIBER_LENGTH];
+    char pattern[MAX_STRING_LENGTH];
+    int field; // WATCH_ANY, WATCH_AREA or WATCH_TYPE
+};
+
+// Node of the Aho-Corasick automaton built over all subscription patterns
+struct WatchNode {
+    int firstChild;
+    int nextSibling;
+    int fail;        // Longest proper suffix of this node that is also in the trie
+    int output;      // Nearest node on the fail chain where a pattern ends (-1 if none)
+    int firstMatch;  // First subscription whose pattern ends here, chained via watchMatchNext
+    unsigned char label;
+};
+
+// Threshold rule: alert when more than `threshold` matching incidents share a key within a window
+struct AlertRule {
+    char name[MAX_RULE_NAME_LENGTH];
+    char typePattern[MAX_TYPE_LENGTH]; // Only incidents whose type contains this count ("*" for all)
+    int key;                           // RULE_KEY_AREA, RULE_KEY_TYPE or RULE_KEY_AREA_TYPE
+    int threshold;
+    int windowMinutes;
+    int tumbling;                      // 1 for fixed consecutive windows, 0 for a sliding window
+};
+
+// Incremental window state of one rule for one key
+struct WindowState {
+    char key[MAX_AREA_LENGTH + MAX_TYPE_LENGTH];
+    unsigned int hash;
+    int rule;
+    long* ring;          // Sliding windows: timestamps of the last threshold + 1 events
+    int ringNext;
+    int ringCount;
+    long bucket;         // Tumbling windows: index of the current window
+    int count;           // Tumbling windows: events in the current window
+    int firing;          // Already alerted for the current burst
+    long lastTimestamp;
+};
+
+// One WHERE condition of a query
+struct QueryPredicate {
+    int column;
+    int op;
+    char text[MAX_STRING_LENGTH]; // Lowercased operand for area and type
+    long low;                     // Numeric operand, or BETWEEN lower bound
+    long high;                    // BETWEEN upper bound
+};
+
+// One step of a compiled query pipeline
+struct PlanOperator {
+    int kind;
+    int predicate; // PLAN_FILTER: index into QueryPlan.predicates
+};
+
+// A parsed query, compiled once into a pipeline of vectorized operators
+struct QueryPlan {
+    int items[MAX_QUERY_ITEMS]; // Selected columns in output order
+    int itemCount;
+    struct QueryPredicate predicates[MAX_QUERY_PREDICATES];
+    int predicateCount;
+    int aggregate; // count(*) is selected
+    int groupBy;   // Grouped column, -1 when not grouping
+    int orderBy;   // Sort column, -1 to keep store order
+    int orderDesc;
+    long limit;    // -1 for no limit
+    long timeoutMs; // TIMEOUT deadline in milliseconds, -1 for none
+    long asOf;      // AS OF snapshot time in seconds since the epoch, -1 for the current state
+    struct PlanOperator operators[MAX_PLAN_OPERATORS];
+    int operatorCount;
+};
+
+// A cached plan for a query text that was run before
+struct PreparedQuery {
+    char text[MAX_QUERY_LENGTH];
+    struct QueryPlan plan;
+    unsigned long lastUsed; // 0 marks an empty slot
+};
+
+// One query result row: a store position (-1 for a global count) and its group count
+struct QueryRow {
+    int position;
+    long count;
+};
+
+// Runtime figures of one plan operator, collected by EXPLAIN ANALYZE
+struct OperatorProfile {
+    long rowsIn;
+    long rowsOut;
+    double seconds;
+    long bytes;            // Bytes of store records (or dictionary entries) the operator read
+    int dictionaryMatches; // Type filters: dictionary entries that matched
+};
+
+// Runtime figures of every operator of a plan, indexed like QueryPlan.operators
+struct QueryProfile {
+    struct OperatorProfile operators[MAX_PLAN_OPERATORS];
+    int indexedPredicate; // Predicate answered by an adaptive index, -1 for a full scan
+    int filterOrder[MAX_QUERY_PREDICATES]; // Order the planner evaluated the predicates in
+    int rollupCells;      // Cells read when the rollup cube answered the query, -1 otherwise
+    int sampleRows;       // Reservoir rows scanned in approximate mode, 0 for an exact run
+};
+
+// Positions of the incidents sharing one indexed value, in store order
+struct PostingList {
+    int* positions;
+    int count;
+    int capacity;
+};
+
+// Secondary index on one column, created and dropped by the observed query workload
+struct AdaptiveIndex {
+    int active;
+    int column;                    // QCOL_AREA, QCOL_TYPE or QCOL_TIME
+    int builtCount;                // Positions indexed so far; usable once it reaches incidentCount
+    struct PostingList* lists;     // By lowercased area, type id or minute of the day
+    int listCount;
+    int listCapacity;
+    char (*keys)[MAX_AREA_LENGTH]; // Area index: the key of each list
+    int* keyTable;                 // Area index: open addressing table over keys
+    int keyTableSize;
+    size_t memoryBytes;
+    unsigned long lastUsed;        // querySequence of the last query that used or created it
+};
+
+// How often a column is filtered on and how selective those filters are
+struct PredicateStats {
+    long uses;
+    long rowsExamined;
+    long rowsMatched;
+};
+
+// Most common values of a column and their counts, most frequent first
+struct MostCommonValues {
+    int values[MCV_SIZE];
+    long counts[MCV_SIZE];
+    int count;
+};
+
+// Equi-depth histogram over minutes of the day
+struct TimeHistogram {
+    unsigned short upper[HISTOGRAM_BUCKETS]; // Last minute of each bucket
+    long counts[HISTOGRAM_BUCKETS];
+    int bucketCount;
+    long builtRows; // Rows when last rebuilt
+};
+
+// Per-column statistics, maintained on insert and rebuilt on load
+struct ColumnStatistics {
+    long rows;
+    int minId;
+    int maxId;
+    long* areaCounts;                  // By area dictionary id
+    int areaCapacity;
+    struct MostCommonValues areaMcv;
+    long* typeCounts;                  // By type dictionary id
+    int typeCapacity;
+    struct MostCommonValues typeMcv;
+    unsigned char timeSeen[MINUTES_PER_DAY / 8];
+    int timeDistinct;
+    struct TimeHistogram timeHistogram;
+    long statusCounts[MAX_STATUS_VALUES];
+};
+
+// Incidents of one (area, type) combination by minute of the day; ROLLUP_ALL in either makes a marginal
+struct RollupCell {
+    int area;
+    int type;
+    long total;
+    unsigned short* minutes; // Sorted minutes while the cell is small
+    int capacity;
+    int* fenwick;            // Fenwick tree over MINUTES_PER_DAY minutes once it outgrows the list
+};
+
+// Stop conditions of a running scan, checked between batches
+struct ScanControl {
+    double deadline;   // monotonicSeconds() when the scan times out, 0 for no deadline
+    int watchKeyboard; // A keypress cancels the scan (only when stdin is a terminal)
+    int state;         // SCAN_RUNNING, SCAN_CANCELLED or SCAN_TIMED_OUT
+    int checks;
+    int stream;        // executeQuery prints rows as they are found when their order is final
+    int streamedRows;
+    int sampled;       // Evaluate over the reservoir sample; cleared if the query was answered exactly anyway
+#ifdef __linux__
+    struct termios savedTerminal;
+#endif
+};
+
+// Compressed postings of one description term: per incident a varint position gap and term
+// frequency, followed by the varint gaps between the term's token offsets for phrase matching
+struct TermPostings {
+    char term[MAX_TERM_LENGTH];
+    unsigned char* bytes;
+    size_t length;
+    size_t capacity;
+    int documents;    // Incidents whose description contains the term
+    int lastPosition; // Store position of the last posting, -1 before the first
+};
+
+// Read position in one term's postings while merging them document at a time
+struct PostingCursor {
+    const struct TermPostings* postings;
+    size_t offset;          // Next posting to decode
+    size_t offsetsStart;    // Token offsets of the current posting
+    int position;           // Current store position, -1 once exhausted
+    int frequency;
+};
+
+// A parsed description search: distinct terms to rank by, and phrases that must appear
+struct SearchQuery {
+    char terms[MAX_SEARCH_TERMS][MAX_TERM_LENGTH];
+    int termCount;
+    int phrases[MAX_SEARCH_PHRASES][MAX_SEARCH_TERMS]; // Term indices in phrase order
+    int phraseLengths[MAX_SEARCH_PHRASES];
+    int phraseCount;
+};
+
+// A field crew and the work it can take on in one batch
+struct Crew {
+    char name[MAX_CREW_NAME_LENGTH];
+    char skills[MAX_STRING_LENGTH]; // Comma-separated incident type texts, "*" for any type
+    int capacity;                   // Incidents the crew can handle in one batch
+};
+
+// Open incidents of one area, type and priority, assigned to a crew as a unit
+struct CrewJob {
+    int first;      // Into the job position list
+    int count;
+    int typeId;
+    int priority;
+    long weight;    // Unfinished work if the job stays unassigned
+};
+
+// One optimizer run: a greedy assignment improved by local search, on its own copy of the state
+struct CrewPlan {
+    const struct CrewJob* jobs;
+    int jobCount;
+    const struct Crew* crews;
+    int crewCount;
+    const unsigned char* eligible; // crewCount entries per type id
+    unsigned long long random;     // Tie-break shuffle seed; 0 keeps the plain greedy order
+    int* jobCrew;                  // Crew of each job, -1 when unassigned
+    int* remaining;                // Capacity left per crew
+    int* bucketHead;               // Per crew and priority: first assigned job, -1 when empty
+    int* bucketNext;
+    int* bucketPrevious;
+    long assignedWeight;
+    int status;                    // 1 when the run finished, 0 if it ran out of memory
+};
+
+#ifdef __linux__
+// Start of the shared segment; regions are found by offset, so each process may map it anywhere
+struct SharedStoreHeader {
+    unsigned int magic;
+    unsigned int recordSizes;   // Hot and cold record sizes, so a differently built program does not attach
+    pthread_mutex_t lock;       // Robust and process-shared: writers and catching-up readers hold it
+    size_t bytes;
+    int rowCapacity;
+    int rows;                   // Published rows; a writer's rows beyond this are not visible yet
+    int typeCount;
+    int areaCount;
+    size_t descriptionLength;
+    size_t descriptionCapacity;
+    long dataBytes;             // Size of the incidents file the published rows were loaded from
+    size_t hotOffset;           // Hot records as reported; each instance replays the dispatch log on a copy
+    size_t coldOffset;
+    size_t typeOffset;
+    size_t areaOffset;
+    size_t descriptionOffset;
+};
+#endif
+
+#ifdef __linux__
+// A request or reply passed from one server worker to another
+struct ServerMessage {
+    int kind;                  // SERVER_REQUEST or SERVER_REPLY
+    int origin;                // Worker holding the client connection
+    int connection;            // Its connection slot there (the socket descriptor)
+    unsigned int generation;   // The slot's generation, so a reply for a closed connection is dropped
+    char text[SERVER_MESSAGE_BYTES];
+};
+
+// Single-producer single-consumer ring from one worker to another; both indexes only ever grow
+struct ServerRing {
+    _Atomic unsigned int head; // Next slot the consumer reads
+    char headPadding[60];      // The two indexes on separate cache lines, so neither side stalls the other
+    _Atomic unsigned int tail; // Next slot the producer writes
+    char tailPadding[60];
+    struct ServerMessage slots[SERVER_RING_SLOTS];
+};
+
+// Memory shared by the server workers
+struct ServerShared {
+    _Atomic int nextId;                 // Next incident id, over all partitions
+    _Atomic int loaded;                 // Workers done loading; none accepts a report before all are
+    _Atomic int failed;                 // Set when a worker could not start, so every process gives up
+    int workers;
+    int wakeFds[MAX_SERVER_WORKERS];    // eventfd each worker waits on along with its sockets
+    struct ServerRing rings[];          // rings[from * workers + to]
+};
+
+// A server request suspended in the middle of its handler
+struct ServerTask {
+    int (*run)(struct ServerTask* task); // Resumes the handler; returns 1 once it has finished
+    int resumePoint;
+    int origin;                // Worker holding the client connection, this one for a local request
+    int connection;
+    unsigned int generation;
+    struct Incident incident;
+    unsigned long commitSequence; // Group commit the request's log line joined
+    char reply[MAX_STRING_LENGTH];
+    struct ServerTask* next;   // In the suspended list, or the free list
+};
+
+// Log lines collected for one group commit
+struct CommitBatch {
+    char* bytes;
+    size_t length;
+    size_t capacity;
+    unsigned long sequence;
+};
+
+// A client connection of one worker, found by its socket descriptor
+struct ServerConnection {
+    unsigned int generation;
+    int open;
+    unsigned int events;       // Events it is registered for
+    char input[SERVER_MESSAGE_BYTES];
+    size_t inputLength;
+    char* output;
+    size_t outputLength;
+    size_t outputCapacity;
+    int waiting;               // Replies from other workers still due before its next request is read
+    long gatheredRows;         // Sums collected for a STATS request
+    long gatheredOpen;
+    int exportFd;              // File an EXPORT reply is being sent from, -1 if none
+    off_t exportOffset;
+    off_t exportLength;
+};
+#endif
+
+// A growable byte buffer that remembers whether any append ran out of memory
+struct ByteBuffer {
+    unsigned char* bytes;
+    size_t length;
+    size_t capacity;
+    int failed;
+};
+
+// Writes Thrift compact protocol structs, tracking the last field id of each open struct
+struct ThriftWriter {
+    struct ByteBuffer* out;
+    int lastField[THRIFT_MAX_DEPTH];
+    int depth;
+};
+
+// A column of the Parquet export
+struct ParquetColumn {
+    const char* name;
+    int type;       // PARQUET_INT32, PARQUET_INT64 or PARQUET_BYTE_ARRAY
+    int dictionary; // Written as a dictionary page plus codes rather than plain values
+};
+
+// Where one column chunk of a row group landed, relative to the row group until it is written
+struct ParquetChunk {
+    long dictionaryOffset; // -1 without a dictionary page
+    long dataOffset;
+    long bytes;
+};
+
+// One row group of a Parquet export, encoded in memory by one thread
+struct ParquetRowGroup {
+    int first;
+    int count;
+    struct ByteBuffer out;
+    struct ParquetChunk chunks[PARQUET_COLUMNS];
+};
+
+// Arrow C Data Interface: a column's type, and its data (layouts fixed by the Arrow specification)
+struct ArrowSchema {
+    const char* format;
+    const char* name;
+    const char* metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema** children;
+    struct ArrowSchema* dictionary;
+    void (*release)(struct ArrowSchema* schema);
+    void* private_data;
+};
+struct ArrowArray {
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void** buffers;
+    struct ArrowArray** children;
+    struct ArrowArray* dictionary;
+    void (*release)(struct ArrowArray* array);
+    void* private_data;
+};
+
+// What an exported ArrowSchema owns: the column types of the store, as one struct type
+struct ArrowSchemaExport {
+    struct ArrowSchema columns[ARROW_COLUMNS];
+    struct ArrowSchema* columnPointers[ARROW_COLUMNS];
+    struct ArrowSchema dictionaries[ARROW_DICTIONARIES];
+};
+
+// What an exported ArrowArray owns: every buffer of the copy of the store in Arrow's columnar layout
+struct ArrowArrayExport {
+    struct ArrowArray columns[ARROW_COLUMNS];
+    struct ArrowArray* columnPointers[ARROW_COLUMNS];
+    struct ArrowArray dictionaries[ARROW_DICTIONARIES];
+    const void* buffers[ARROW_COLUMNS + ARROW_DICTIONARIES + 1][3];
+    void* owned[ARROW_MAX_BUFFERS];
+    int ownedCount;
+};
+
+// A flatbuffer built back to front, so every object is written before the ones that refer to it
+struct FlatBuilder {
+    unsigned char* bytes; // Content is the last `size` bytes
+    size_t capacity;
+    size_t size;
+    int failed;
+};
+
+// One field of a flatbuffer table: a scalar of 1 to 8 bytes, or a reference to an object already built
+struct FlatField {
+    int size;         // 0 when the field is left out
+    long long value;
+    size_t reference; // Object position when non-zero
+};
+
+// A body buffer of an Arrow IPC message, written straight from the exported array
+struct ArrowIpcBuffer {
+    const void* data;
+    long length;
+};
+
+// A municipality hosted in this process, with its quotas and, while another one is active, its saved globals
+struct Tenant {
+    char name[MAX_STRING_LENGTH];
+    char* directory;          // Absolute path its files are in
+    size_t memoryQuota;       // Bytes its store and indexes may grow to, 0 for no limit
+    long queryMilliseconds;   // Longest one of its scans may run, -1 for no limit
+    int optimizerThreads;     // Threads of the shared pool its crew planning may use, 0 for all
+    unsigned char* state;     // STORE_STATE while inactive, NULL until first switched away from
+    int opened;               // Loaded from its files at least once
+    double cpuSeconds;        // Processor time spent while it was active
+    int rows;                 // Incidents and approximate memory when it was last active
+    size_t memoryBytes;
+    int overQuota;            // The last growth of its store was refused by the memory quota
+};
+
+// Fields of the lines in one segment of an incidents file, in order
+struct IncidentLayout {
+    int version;                     // 0 for lines written before schemas were versioned
+    int fieldCount;
+    int fields[MAX_SCHEMA_FIELDS];   // FIELD_* ids, FIELD_UNKNOWN for a field to skip
+};
+
+// One array of a checkpoint image, found by its offset from the start of the file
+struct CheckpointSection {
+    size_t offset;
+    size_t bytes;
+};
+
+// A description term as a checkpoint image holds it; its postings follow those of the previous term in a section
+struct CheckpointTerm {
+    char term[MAX_TERM_LENGTH];
+    size_t length;
+    int documents;
+    int lastPosition;
+};
+
+// A rollup cube cell as a checkpoint image holds it; its sorted minutes or Fenwick tree follow those of the
+// previous cell in a section
+struct CheckpointCell {
+    int area;
+    int type;
+    long total;
+    int isFenwick;
+};
+
+// Start of a checkpoint image: the log prefixes it covers, scalar state, and where each array is. The image holds
+// no pointers, only offsets and counts, so it means the same to every process that reads it
+struct CheckpointHeader {
+    unsigned int magic;
+    unsigned int format;
+    unsigned int recordSizes;
+    long dataBytes;           // Prefix of the incidents file held in the image
+    struct IncidentLayout dataLayout; // Schema of the segment that prefix ends in
+    int legacyIncidentRows;
+    unsigned long long dataHash; // Hash of that whole prefix, to notice a rewritten file
+    long dispatchLogOffset;   // Prefix of the dispatch log already applied
+    int incidentCount;
+    int incidentTypeCount;
+    int areaKeyCount;
+    int areaKeyTableSize;
+    int idTableSize;
+    int idTableValid;
+    int termCount;
+    int termTableSize;
+    int describedIncidents;
+    int textIndexValid;
+    long totalDescriptionTerms;
+    size_t descriptionTextLength;
+    int rollupCellCount;
+    int rollupTableSize;
+    int rollupCubeValid;
+    int reservoirCount;
+    unsigned long long sampleRandomState;
+    int versionCapacity;
+    int versionFree;
+    int liveVersions;
+    int nextVersionCollection;
+    int versionHeadCapacity;
+    long historyHorizon;
+    long lastCommitTime;
+    struct ColumnStatistics columnStats; // Its count arrays are sections of their own; the pointers are NULL
+    struct CheckpointSection sections[CHECKPOINT_SECTIONS];
+};
+
+// Tokenizer state while parsing a query
+struct QueryLexer {
+    const char* cursor;
+    char token[MAX_STRING_LENGTH];
+    int kind;
 };
 
 // Function declarations
@@ -48,25 +956,540 @@ void addIncident();
 void viewAllIncidents();
 void viewIncidentsByArea();
 void viewIncidentsByType();
-int readIncidentsFromFile(struct Incident incidents[]);
+int readIncidentsFromFile();
+int parseIncidentLine(char* line, const struct IncidentLayout* layout, struct Incident* incident);
+int parseIncidentField(int field, const char* text, size_t length, struct Incident* incident);
+int parseSchemaLine(const char* line, struct IncidentLayout* layout);
+size_t formatSchemaLine(char* buffer, size_t size, const struct IncidentLayout* layout);
+size_t formatIncidentLine(char* buffer, size_t size, const struct Incident* incident);
+void writeSchemaLine(FILE* file, const struct IncidentLayout* layout);
+void writeIncidentLine(FILE* file, const struct Incident* incident);
 void writeIncidentToFile(const struct Incident* incident);
+int compactIncidentFile();
+int layoutIsCurrent(const struct IncidentLayout* layout);
+FILE* openLockedIncidentFile(const char* mode);
+int migrateIncidentRows(FILE* from, long end, FILE* to);
+void exportIncidentsInFormat();
+void exportIncidents();
+void exportIncidentsParquet();
+void* encodeParquetRowGroup(void* argument);
+int parquetDictionaryCode(int* local, int id, const char* text, const char** entries, int* entryCount);
+void encodeParquetDictionaryChunk(struct ParquetRowGroup* group, int column, struct ByteBuffer* page, const int* codes,
+                                  const char** entries, int entryCount);
+void encodeParquetPlainChunk(struct ParquetRowGroup* group, int column, const struct ByteBuffer* page);
+void writeParquetPageHeader(struct ByteBuffer* out, int pageType, size_t size, int values, int encoding);
+void writeParquetFooter(struct ByteBuffer* out, const struct ParquetRowGroup* groups, int groupCount);
+void byteBufferAppend(struct ByteBuffer* buffer, const void* bytes, size_t length);
+void byteBufferByte(struct ByteBuffer* buffer, unsigned char byte);
+void byteBufferVarint(struct ByteBuffer* buffer, unsigned long long value);
+void byteBufferLittleEndian(struct ByteBuffer* buffer, unsigned long long value, int bytes);
+void thriftBegin(struct ThriftWriter* writer);
+void thriftEnd(struct ThriftWriter* writer);
+void thriftField(struct ThriftWriter* writer, int id, int type);
+void thriftInteger(struct ThriftWriter* writer, int id, int type, long long value);
+void thriftBinary(struct ThriftWriter* writer, int id, const char* text);
+void thriftList(struct ThriftWriter* writer, int id, int elementType, int size);
+void exportIncidentsArrow();
+int exportIncidentArrow(struct ArrowSchema* schema, struct ArrowArray* array);
+void releaseArrowSchema(struct ArrowSchema* schema);
+void releaseArrowArray(struct ArrowArray* array);
+void releaseArrowChild(struct ArrowSchema* schema);
+void releaseArrowChildArray(struct ArrowArray* array);
+void* ownArrowBuffer(struct ArrowArrayExport* export, size_t bytes);
+int arrowFormatBits(const char* format);
+int fillArrowStrings(struct ArrowArrayExport* export, struct ArrowArray* array, const void** buffers,
+                     const char** strings, int count);
+int writeArrowSnapshot(const char* path, long* bytes);
+int writeArrowMessage(FILE* file, long* offset, struct FlatBuilder* builder, int headerType, size_t header,
+                      const struct ArrowIpcBuffer* buffers, int bufferCount, long bodyLength, unsigned char* block);
+size_t buildArrowSchema(struct FlatBuilder* builder, const struct ArrowSchema* schema);
+size_t buildArrowRecordBatch(struct FlatBuilder* builder, const struct ArrowSchema** fields,
+                             const struct ArrowArray** columns, int count, long length,
+                             struct ArrowIpcBuffer* buffers, int* bufferCount, long* bodyLength);
+void flatReserve(struct FlatBuilder* builder, size_t bytes);
+void flatPrepend(struct FlatBuilder* builder, const void* bytes, size_t length);
+void flatPad(struct FlatBuilder* builder, size_t alignment, size_t following);
+void flatScalar(struct FlatBuilder* builder, long long value, int size);
+void flatReference(struct FlatBuilder* builder, size_t target);
+size_t flatString(struct FlatBuilder* builder, const char* text);
+size_t flatVector(struct FlatBuilder* builder, const void* elements, size_t length, size_t alignment, int count);
+size_t flatReferences(struct FlatBuilder* builder, const size_t* targets, int count);
+size_t flatTable(struct FlatBuilder* builder, const struct FlatField* fields, int count);
+void flatFinish(struct FlatBuilder* builder, size_t root);
+#ifdef __linux__
+int openIncidentExport(long end, long* length);
+long sealedIncidentBytes();
+#endif
+void maybeCompactIncidentFile(int force);
+int storeIncident(const struct Incident* incident);
+void loadIncident(int position, struct Incident* incident);
+const char* descriptionAt(int position);
+int storeDescription(int position, const char* description);
+int tokenizeDescription(const char* text, char (*terms)[MAX_TERM_LENGTH], int maxTerms);
+int findTermPostings(const char* term, int create);
+int appendPostingVarint(struct TermPostings* postings, unsigned int value);
+unsigned int readPostingVarint(const unsigned char* bytes, size_t* offset);
+int indexDescription(int position);
+void searchDescriptions();
+int parseSearchQuery(const char* text, struct SearchQuery* query, char* error, size_t errorSize);
+void advancePostingCursor(struct PostingCursor* cursor);
+int readTokenOffsets(const struct PostingCursor* cursor, int* offsets);
+int phraseMatches(const struct SearchQuery* query, int phrase, const struct PostingCursor* cursors);
+void printIncidentRow(int position);
+int findOrAddIncidentType(const char* type);
+int findOrAddArea(const char* area);
+int lookupArea(const char* key);
+int timeToMinutes(const char* time);
+int reserveIncidentCapacity(int capacity);
+void configureColumnAllocation();
+void* allocateColumn(size_t bytes);
+int attachSharedStore();
+#ifdef __linux__
+size_t layoutSharedStore(struct SharedStoreHeader* header, int rowCapacity);
+#endif
+void lockSharedStore();
+void unlockSharedStore();
+void syncSharedStore();
+void indexStoredIncident(int position);
+void removeFromDispatchQueue(int position);
+void buildDeferredIndexes();
+void configureCheckpoint();
+void restrictTenantConfiguration();
+void openStore();
+void closeStore();
+int readTenantsFromFile();
+size_t storeStateBytes();
+void saveStoreState(unsigned char* state);
+void loadStoreState(const unsigned char* state);
+int switchTenant(int tenant);
+void switchMunicipality();
+size_t storeMemoryBytes();
+size_t indexDataMemory();
+int memoryQuotaReached(size_t extra);
+int configureServer();
+int areaWorker(const char* area);
+int runServer(int port);
+int executeServerRequest(char* line, int origin, int connection, unsigned int generation, char* reply,
+                         size_t replySize);
+#ifdef __linux__
+void restoreTerminalOnInterrupt(int signalNumber);
+int runServerWorker(int port);
+int serverRingFull(int to);
+int sendServerMessage(int to, const struct ServerMessage* message);
+void drainServerRings();
+void acceptServerConnections(int listener);
+void readServerConnection(int fd);
+void processServerInput(int fd);
+void routeServerRequest(int fd, char* line);
+void queueServerOutput(int fd, const char* text);
+void flushServerOutput(int fd);
+void updateServerEvents(int fd);
+void closeServerConnection(int fd);
+int startServerTask(int (*run)(struct ServerTask* task), int origin, int connection, unsigned int generation,
+                    const struct Incident* incident);
+void resumeServerTasks();
+int runReportTask(struct ServerTask* task);
+int serverReplyRoom(int origin);
+void deliverServerReply(int origin, int connection, unsigned int generation, const char* text);
+int startCommitLog();
+unsigned long appendCommitLog(const struct Incident* incident);
+void startCommitBatch();
+void* runCommitThread(void* argument);
+void* runExportMigration(void* argument);
+#endif
+unsigned long long hashFilePrefix(const char* path, long end);
+int checkpointSectionsMatch(const struct CheckpointHeader* header, long imageBytes);
+int restoreCheckpoint();
+void* copyCheckpointSection(const char* image, const struct CheckpointHeader* header, int section, size_t minimum);
+void beginCheckpointSection(FILE* file, struct CheckpointHeader* header, int section);
+void writeCheckpointSection(FILE* file, struct CheckpointHeader* header, int section, const void* data, size_t bytes);
+int writeCheckpoint();
+void maybeWriteCheckpoint(int force);
+void freeColumn(void* column, size_t bytes);
 void validateStringInput(char* input, int maxLength, const char* prompt);
 void validateTimeInput(char* input, int maxLength);
 int getNextIncidentId();
 int isValidTimeFormat(const char* time);
 int strContains(const char* str, const char* substr);
+int strContainsLower(const char* str, const char* substr_lower);
+void toLowerCopy(char* destination, const char* source, size_t size);
+unsigned char* matchAreaDictionary(const char* search);
+int selectIncidentsByArea(const unsigned char* areaMatches, int start, int end, int* selection);
+int selectIncidentsByType(const unsigned char* typeMatches, int start, int end, int* selection);
+int runBenchmark(const char* search);
+int openCacheMissCounter();
+long long readCacheMisses(int counter);
+void printIncidentHeader();
+void printIncidentSelection(const int* selection, int count);
+void beginScanControl(struct ScanControl* control, long timeoutMs, int stream);
+int scanStopped(struct ScanControl* control);
+void endScanControl(struct ScanControl* control);
+void reportScanStop(const struct ScanControl* control, long scanned, long total);
+void manageWatchList();
+void addSubscription();
+void viewSubscriptions();
+void removeSubscription();
+int readSubscriptionsFromFile();
+int writeSubscriptionsToFile();
+int appendSubscription(const struct Subscription* subscription);
+int buildWatchAutomaton();
+int addWatchNode(unsigned char label);
+int findWatchChild(int node, unsigned char label);
+void checkWatchList(const struct Incident* incident);
+void matchWatchText(const char* text, int field, const struct Incident* incident);
+const char* watchFieldName(int field);
+int validateChoiceInput(const char* prompt, int min, int max);
+void runQuery();
+const struct QueryPlan* prepareQuery(const char* text, int* reused, char* error, size_t errorSize);
+void nextQueryToken(struct QueryLexer* lexer);
+int acceptQueryToken(struct QueryLexer* lexer, const char* expected);
+int parseQueryColumn(const char* name);
+int parseQueryItem(struct QueryLexer* lexer);
+int parseQueryValue(struct QueryLexer* lexer, int column, long* number, char* text);
+int parseQueryPredicate(struct QueryLexer* lexer, struct QueryPredicate* predicate, char* error, size_t errorSize);
+int parseQuery(const char* text, struct QueryPlan* plan, char* error, size_t errorSize);
+int executeQuery(const struct QueryPlan* plan, struct QueryRow** rowsOut, struct QueryProfile* profile,
+                 struct ScanControl* control);
+const char* skipQueryKeyword(const char* text, const char* keyword);
+void printQueryPlan(const struct QueryPlan* plan, const struct QueryProfile* profile, int reused);
+void describePlanOperator(const struct QueryPlan* plan, int index, const struct QueryProfile* profile,
+                          char* description, size_t size);
+double monotonicSeconds();
+double chargeOperatorTime(struct OperatorProfile* stats, double mark);
+void viewColumnStatistics();
+int refreshColumnStatistics();
+int updateColumnStatistics(int position);
+void bumpMostCommonValue(struct MostCommonValues* mcv, int value, long count);
+void rebuildTimeHistogram();
+double estimateSelectivity(const struct QueryPredicate* predicate);
+double estimateTimeRange(long low, long high);
+void planPredicateOrder(const struct QueryPlan* plan, int indexedPredicate, int* order);
+int chooseIndexPredicate(const struct QueryPlan* plan, long* estimate);
+int indexListMatches(const struct AdaptiveIndex* index, int list, const struct QueryPredicate* predicate);
+int collectIndexCandidates(const struct QueryPredicate* predicate, int** candidatesOut);
+int compareInts(const void* first, const void* second);
+void recordQueryWorkload(const struct QueryPlan* plan, const long* examined, const long* matched);
+void maintainAdaptiveIndexes();
+int addToAdaptiveIndex(struct AdaptiveIndex* index, int position);
+int findAreaIndexList(struct AdaptiveIndex* index, const char* key);
+void dropAdaptiveIndex(int column);
+size_t adaptiveIndexMemory();
+int filterSelection(const struct QueryPredicate* predicate, const unsigned char* dictionaryMask,
+                    int* selection, int selected);
+void numberPredicateRange(const struct QueryPredicate* predicate, long* low, long* high, int* invert);
+struct RollupCell* findRollupCell(int area, int type, int create);
+int addToRollupCell(struct RollupCell* cell, int minute);
+long countRollupCell(const struct RollupCell* cell, int low, int high);
+int updateRollupCube(int position);
+int rollupCubeLookup(const struct QueryPlan* plan, long* count);
+int matchTextPredicate(const struct QueryPredicate* predicate, const char* value);
+int matchNumberPredicate(const struct QueryPredicate* predicate, long value);
+long queryColumnValue(int column, int position);
+int aggregateSelection(const struct QueryPlan* plan, const int* selection, int selected,
+                       struct QueryRow** rows, int* rowCount, int* rowCapacity,
+                       int** groupTable, int* groupTableSize);
+unsigned int groupHash(int column, int position);
+int sameGroup(int column, int first, int second);
+int compareQueryRows(const void* first, const void* second);
+void printQueryHeader(const struct QueryPlan* plan);
+void printQueryRows(const struct QueryPlan* plan, const struct QueryRow* rows, int rowCount, int approximate);
+void configureQueryMode();
+void sampleIncident(int position);
+unsigned long long nextSampleRandom();
+long scaleSampleCount(long matches);
+long sampleMargin(long matches);
+const char* statusName(int status);
+int parseStatusName(const char* name);
+const char* priorityName(int priority);
+int addIncidentId(int position);
+int findIncidentPosition(int id);
+void setIncidentStatus(int position, int status);
+int dispatchBefore(int first, int second);
+void siftDispatchUp(int slot);
+void siftDispatchDown(int slot);
+int pushDispatchQueue(int position);
+int popDispatchQueue();
+void changeDispatchPriority(int position, int priority);
+int buildDispatchQueue();
+int readDispatchLog();
+void appendDispatchLog(const char* change, int id, int value, long committed);
+void manageDispatchQueue();
+void viewDispatchQueue();
+void dispatchNextIncident();
+void changeIncidentPriority();
+void configureHistoryRetention();
+long nextCommitTime();
+int recordIncidentVersion(int position, long committed);
+void loseHistoryBefore(long committed);
+int incidentStatusAsOf(int position, long snapshot);
+int incidentPriorityAsOf(int position, long snapshot);
+void collectIncidentVersions();
+int parseSnapshotTime(struct QueryLexer* lexer, long* snapshot);
+int readCrewsFromFile(struct Crew** crewsOut);
+long priorityWeight(int priority);
+int compareJobPositions(const void* first, const void* second);
+int compareCrewJobs(const void* first, const void* second);
+int crewHasSkill(const struct Crew* crew, const char* type);
+void assignCrewJob(struct CrewPlan* plan, int job, int crew);
+void unassignCrewJob(struct CrewPlan* plan, int job);
+void* runCrewOptimizer(void* argument);
+int optimizerThreadCount();
+void planCrewAssignments();
+void manageAlertRules();
+void viewAlertRules();
+void replayTrace();
+int readAlertRulesFromFile();
+void resetRuleWindows();
+void warmRuleWindows();
+void evaluateAlertRules(const struct Incident* incident, int report);
+struct WindowState* findWindowState(int rule, const char* key);
+unsigned int hashString(const char* text);
 
-// Global array to store incidents
-struct Incident incidents[MAX_INCIDENTS];
+// Global incident store, split into hot and cold columns indexed by position
+struct IncidentHot* incidentHot = NULL;
+struct IncidentCold* incidentCold = NULL;
 int incidentCount = 0;
+int incidentCapacity = 0;
+
+// The shared segment when INCIDENTS_SHARED_STORE is set; cold records and dictionaries then live in it
+struct SharedStoreHeader* sharedStore = NULL;
+struct IncidentHot* sharedHot = NULL;
+long dispatchLogOffset = 0; // Dispatch log bytes already applied
+long incidentFileOffset = 0; // Incidents file bytes already loaded or written
+
+// Columns of a Parquet export, by PCOL_* id
+const struct ParquetColumn parquetColumns[PARQUET_COLUMNS] = {
+    { "id", PARQUET_INT32, 0 },
+    { "area", PARQUET_BYTE_ARRAY, 1 },
+    { "type", PARQUET_BYTE_ARRAY, 1 },
+    { "time", PARQUET_BYTE_ARRAY, 1 },
+    { "description", PARQUET_BYTE_ARRAY, 0 },
+    { "priority", PARQUET_INT32, 0 },
+    { "status", PARQUET_BYTE_ARRAY, 1 },
+    { "reported", PARQUET_INT64, 0 }
+};
+
+// Field names used in schema lines, by FIELD_* id
+const char* incidentFieldNames[INCIDENT_FIELDS] = {
+    "id", "area", "type", "time", "description", "priority", "reported"
+};
+// Layout of lines without a schema line before them; rows written before the description, priority or report
+// time existed simply stop early
+const struct IncidentLayout legacyIncidentLayout = {
+    0, INCIDENT_FIELDS,
+    { FIELD_ID, FIELD_AREA, FIELD_TYPE, FIELD_TIME, FIELD_DESCRIPTION, FIELD_PRIORITY, FIELD_REPORTED }
+};
+// Layout new lines are written in; must match writeIncidentLine
+const struct IncidentLayout currentIncidentLayout = {
+    INCIDENT_SCHEMA_VERSION, INCIDENT_FIELDS,
+    { FIELD_ID, FIELD_AREA, FIELD_TYPE, FIELD_TIME, FIELD_DESCRIPTION, FIELD_PRIORITY, FIELD_REPORTED }
+};
+struct IncidentLayout incidentFileLayout = { 0 }; // Segment the incidents file ends in, as far as it was read
+int legacyIncidentRows = 0;                       // Rows in the file whose segment has an older schema
+time_t lastCompactionTime = 0;
+int deferredIndexFrom = -1; // First row an attaching instance left out of the rollup cube and text index, -1 if none
+
+// Dictionary of distinct incident types referenced by IncidentHot.typeId
+char (*incidentTypes)[MAX_TYPE_LENGTH] = NULL;
+int incidentTypeCount = 0;
+int incidentTypeCapacity = 0;
+int* typeTable = NULL; // Open addressing table over incidentTypes, -1 for an empty slot
+int typeTableSize = 0;
+
+// Store position of each incident id, found through open addressing
+int* idTable = NULL; // Positions, -1 for an empty slot
+int idTableSize = 0;
+int idTableValid = 1; // Cleared if the table ran out of memory; lookups then scan the store
+
+// Dispatch queue: an indexed 4-ary max-heap of the positions of open incidents
+int* dispatchHeap = NULL;
+int dispatchHeapCount = 0;
+int dispatchHeapCapacity = 0;
+int* dispatchSlot = NULL; // Heap slot of each store position, -1 when it is not queued
+int dispatchSlotCapacity = 0;
+int dispatchQueueReady = 0; // Built after loading; inserts keep it current from then on
+
+// Superseded incident versions; versionHead holds the newest per store position, -1 for none
+struct IncidentVersion* versions = NULL;
+int versionCapacity = 0;
+int versionFree = -1;      // Unused versions, linked through older
+int liveVersions = 0;
+int nextVersionCollection = HISTORY_GC_MIN_VERSIONS;
+int* versionHead = NULL;
+int versionHeadCapacity = 0;
+long historyRetentionDays = DEFAULT_HISTORY_DAYS;
+long historyHorizon = 0;   // Versions replaced before this time were collected, so AS OF cannot go back further
+long lastCommitTime = 0;
+long querySnapshot = -1;   // AS OF time of the query being executed, -1 for the current state
+
+// Dictionary of distinct lowercased areas referenced by IncidentHot.areaId
+char (*areaKeys)[MAX_AREA_LENGTH] = NULL;
+int areaKeyCount = 0;
+int areaKeyCapacity = 0;
+int* areaKeyTable = NULL; // Open addressing table over areaKeys, -1 for an empty slot
+int areaKeyTableSize = 0;
+
+// Partition this process serves (serverWorkerCount is 0 outside server mode)
+int serverWorker = 0;
+int serverWorkerCount = 0;
+int highestFileIncidentId = 0; // Over every line of the incidents file, including other partitions'
+#ifdef __linux__
+struct ServerShared* serverShared = NULL;
+struct ServerConnection* serverConnections = NULL;
+int serverConnectionCapacity = 0;
+int serverEpoll = -1;
+int serverBacklog = 0; // Requests left on a ring because the ring back to their origin was full
+struct ServerTask* suspendedTasks = NULL;
+struct ServerTask* freeTasks = NULL;
+
+// Group commit of reports to the incidents file: a commit thread writes and syncs one batch while the event loop
+// fills the other, and each finished batch resumes the tasks waiting for it
+struct CommitBatch commitBatches[2];
+int commitFilling = 0;                // Batch the event loop appends to
+int commitInFlight = 0;               // The other batch is with the commit thread
+int commitFd = -1;                    // Incidents file, opened for appending
+int commitRequestFd = -1;             // eventfd: a batch is ready for the commit thread
+int commitDoneFd = -1;                // eventfd: the commit thread finished a batch
+_Atomic unsigned long commitCompleted = 0; // Last batch written and synced, or failed
+_Atomic unsigned long commitFailed = 0;    // Last batch that could not be written
+
+// Migrating older rows for an EXPORT takes as long as reading the whole file, so a thread does it off the event loop
+_Atomic int exportMigrationState = EXPORT_MIGRATION_IDLE;
+int exportMigrationFd = -1;     // Migrated copy, valid once the state is done
+long exportMigrationLength = 0;
+long exportMigrationEnd = 0;    // Incidents file bytes the copy covers
+
+// Terminal settings a watched scan replaced, put back by the SIGINT handler if the scan is interrupted
+struct termios interruptedTerminal;
+volatile sig_atomic_t terminalIsRaw = 0;
+struct sigaction previousInterruptAction;
+#endif
+
+// Municipalities and which one the store globals currently belong to (-1 without a tenants file)
+struct Tenant* tenants = NULL;
+int tenantCount = 0;
+int activeTenant = -1;
+unsigned char* initialStoreState = NULL; // STORE_STATE before any store was loaded, the start of every new one
+clock_t tenantClockMark = 0;
+
+// Where and when the state was last checkpointed; an empty path disables checkpoints
+char checkpointPath[MAX_STRING_LENGTH] = CHECKPOINT_FILE;
+char arrowSnapshotPath[MAX_STRING_LENGTH] = ""; // Also written with every checkpoint when set
+int checkpointRows = -1;
+long checkpointLogOffset = -1;
+time_t lastCheckpointTime = 0;
+int restoredCheckpointRows = -1; // Rows the image held when the store was opened from one, -1 if it was not
+int replayedIncidentRows = 0;    // Rows read from the incidents file after that image
+
+// How large columns are backed, chosen once at startup
+int hugePageMode = HUGE_PAGES_TRANSPARENT;
+int numaNodeCount = 1;
+unsigned long numaNodeMask = 1; // Online NUMA nodes, bit n for node n
+int numaHighestNode = 0;
+
+// Watch list subscriptions and the automaton matching all of them in one pass
+struct Subscription* subscriptions = NULL;
+int subscriptionCount = 0;
+int subscriptionCapacity = 0;
+struct WatchNode* watchNodes = NULL;
+int watchNodeCount = 0;
+int watchNodeCapacity = 0;
+int* watchMatchNext = NULL;  // Next subscription ending at the same node (-1 ends the chain)
+int* watchAlertStamp = NULL; // Last incident check that alerted each subscription
+int watchCheckStamp = 0;
+
+// Alert rules and their window states, found through an open addressing hash table
+struct AlertRule* alertRules = NULL;
+int alertRuleCount = 0;
+struct WindowState* windowStates = NULL;
+int windowStateCount = 0;
+int windowStateCapacity = 0;
+int* windowTable = NULL; // Index into windowStates, -1 for an empty slot
+int windowTableSize = 0;
+long streamDay = 0;      // Days elapsed in the incident stream, since times carry no date
+int lastStreamMinute = 0;
+
+// Plans of recently run queries, reused when the same query text is run again
+struct PreparedQuery preparedQueries[PREPARED_QUERY_SLOTS];
+unsigned long preparedQueryClock = 0;
+const struct QueryPlan* sortingPlan = NULL; // Plan being sorted by compareQueryRows
+
+// Adaptive secondary indexes (one possible per query column) and the workload that drives them
+struct AdaptiveIndex adaptiveIndexes[QCOL_COUNT];
+struct PredicateStats predicateStats[QCOL_COUNT];
+unsigned long querySequence = 0;
+
+// Statistics the planner uses to estimate how selective predicates are
+struct ColumnStatistics columnStats;
+
+// Rollup cube maintained on insert, answering count(*) over area, type and time ranges without a scan
+struct RollupCell* rollupCells = NULL;
+int rollupCellCount = 0;
+int rollupCellCapacity = 0;
+int* rollupTable = NULL; // Open addressing table over rollupCells, -1 for an empty slot
+int rollupTableSize = 0;
+int rollupCubeValid = 1; // Cleared if an insert could not be folded in, so queries fall back to scanning
+
+// Uniform reservoir sample of store positions, maintained on insert for approximate queries
+int* reservoir = NULL;
+int reservoirCount = 0;
+int* reservoirOrdered = NULL; // The sample sorted into store order, rebuilt after it changes
+int reservoirOrderedValid = 0;
+unsigned long long sampleRandomState = 0x9E3779B97F4A7C15ULL;
+int approximateByDefault = 0; // INCIDENTS_QUERY_MODE=approx; EXACT in a query overrides it
+
+// Description text of all incidents, and the inverted index over its terms
+char* descriptionText = NULL;
+size_t descriptionTextLength = 0;
+size_t descriptionTextCapacity = 0;
+struct TermPostings* termPostings = NULL;
+int termCount = 0;
+int termCapacity = 0;
+int* termTable = NULL; // Open addressing table over termPostings, -1 for an empty slot
+int termTableSize = 0;
+int describedIncidents = 0;       // Incidents with a non-empty description
+long totalDescriptionTerms = 0;
+int textIndexValid = 1;           // Cleared if a description could not be indexed
 
 int main() {
     int choice;
 
     // Load incidents from file
-    incidentCount = readIncidentsFromFile(incidents);
+    configureColumnAllocation();
+    configureQueryMode();
+    configureHistoryRetention();
+    configureCheckpoint();
+    int serverPort = configureServer();
+    if (serverPort > 0) {
+        return runServer(serverPort);
+    }
+    tenantCount = readTenantsFromFile();
+    if (tenantCount > 0) {
+        restrictTenantConfiguration();
+        // Each municipality starts from the same empty state; the first one listed is opened
+        initialStoreState = malloc(storeStateBytes());
+        if (initialStoreState == NULL) {
+            printf(ANSI_COLOR_RED "Error: Not enough memory to host several municipalities.\n" ANSI_COLOR_RESET);
+            tenantCount = 0;
+        } else {
+            saveStoreState(initialStoreState);
+        }
+    }
+    if (tenantCount == 0 || !switchTenant(0)) {
+        openStore();
+    }
+    const char* benchmark = getenv(BENCHMARK_ENV);
+    if (benchmark != NULL && benchmark[0] != '\0') {
+        return runBenchmark(benchmark);
+    }
 
     while (1) {
+        // Take in what other instances sharing the store added, then build pending adaptive indexes
+        syncSharedStore();
+        maintainAdaptiveIndexes();
+        maybeCompactIncidentFile(0);
+        maybeWriteCheckpoint(0);
+
         clearScreen();
         displayHeader("INCIDENT REPORTING SYSTEM");
         displayMainMenu();
@@ -98,6 +1521,7 @@ int main() {
                 int viewMenuActive = 1;
 
                 while (viewMenuActive) {
+                    maintainAdaptiveIndexes();
                     clearScreen();
                     displayHeader("VIEW INCIDENTS");
                     displayViewMenu();
@@ -140,7 +1564,39 @@ int main() {
                             getchar();
                             break;
 
-                        case 4: // Back to main menu
+                        case 4: // Run a query
+                            clearScreen();
+                            displayHeader("RUN A QUERY");
+                            runQuery();
+                            printf("\nPress Enter to return to view menu...");
+                            getchar();
+                            break;
+
+                        case 5: // Column statistics
+                            clearScreen();
+                            displayHeader("COLUMN STATISTICS");
+                            viewColumnStatistics();
+                            printf("\nPress Enter to return to view menu...");
+                            getchar();
+                            break;
+
+                        case 6: // Search descriptions
+                            clearScreen();
+                            displayHeader("SEARCH DESCRIPTIONS");
+                            searchDescriptions();
+                            printf("\nPress Enter to return to view menu...");
+                            getchar();
+                            break;
+
+                        case 7: // Export incidents
+                            clearScreen();
+                            displayHeader("EXPORT INCIDENTS");
+                            exportIncidentsInFormat();
+                            printf("\nPress Enter to return to view menu...");
+                            getchar();
+                            break;
+
+                        case 8: // Back to main menu
                             viewMenuActive = 0; // Set flag to exit the view menu loop
                             break;
 
@@ -153,8 +1609,37 @@ int main() {
                 break;
             }
 
-            case 3: // Exit
+            case 3: // Manage watch list
+                manageWatchList();
+                break;
+
+            case 4: // Alert rules
+                manageAlertRules();
+                break;
+
+            case 5: // Dispatch queue
+                manageDispatchQueue();
+                break;
+
+            case 6: // Switch municipality
+                clearScreen();
+                displayHeader("SWITCH MUNICIPALITY");
+                switchMunicipality();
+                printf("\nPress Enter to continue...");
+                getchar();
+                break;
+
+            case 7: // Exit
                 clearScreen();
+                // Every municipality opened in this session gets its pending compaction and checkpoint
+                if (tenantCount == 0) {
+                    closeStore();
+                }
+                for (int t = 0; t < tenantCount; t++) {
+                    if (tenants[t].opened && switchTenant(t)) {
+                        closeStore();
+                    }
+                }
                 printf("Thank you for using the Incident Reporting System!\n");
                 return 0;
 
@@ -189,7 +1674,19 @@ void displayMainMenu() {
     printf("1. Report a new incident\n");
     printf("2. View incidents " ANSI_COLOR_GREEN "(%d incident%s reported so far)" ANSI_COLOR_RESET "\n",
            incidentCount, (incidentCount == 1) ? "" : "s");
-    printf("3. Exit\n\n");
+    printf("3. Manage watch list " ANSI_COLOR_GREEN "(%d subscription%s)" ANSI_COLOR_RESET "\n",
+           subscriptionCount, (subscriptionCount == 1) ? "" : "s");
+    printf("4. Alert rules " ANSI_COLOR_GREEN "(%d rule%s)" ANSI_COLOR_RESET "\n",
+           alertRuleCount, (alertRuleCount == 1) ? "" : "s");
+    printf("5. Dispatch queue " ANSI_COLOR_GREEN "(%d open incident%s)" ANSI_COLOR_RESET "\n",
+           dispatchHeapCount, (dispatchHeapCount == 1) ? "" : "s");
+    if (activeTenant >= 0) {
+        printf("6. Switch municipality " ANSI_COLOR_GREEN "(%s of %d)" ANSI_COLOR_RESET "\n",
+               tenants[activeTenant].name, tenantCount);
+    } else {
+        printf("6. Switch municipality\n");
+    }
+    printf("7. Exit\n\n");
 }
 
 // Display the view menu options
@@ -198,13 +1695,21 @@ void displayViewMenu() {
            incidentCount, (incidentCount == 1) ? "" : "s");
     printf("2. Filter incidents by area\n");
     printf("3. Filter incidents by incident type\n");
-    printf("4. Back to main menu\n\n");
+    printf("4. Run a query\n");
+    printf("5. Column statistics\n");
+    printf("6. Search descriptions\n");
+    printf("7. Export incidents\n");
+    printf("8. Back to main menu\n\n");
 }
 
 // Add a new incident to the system
 void addIncident() {
-    if (incidentCount >= MAX_INCIDENTS) {
-        printf(ANSI_COLOR_RED "Error: Maximum number of incidents reached.\n" ANSI_COLOR_RESET);
+    if (!reserveIncidentCapacity(incidentCount + 1)) {
+        if (activeTenant >= 0 && tenants[activeTenant].overQuota) {
+            printf(ANSI_COLOR_RED "Error: %s has reached its memory quota.\n" ANSI_COLOR_RESET, tenants[activeTenant].name);
+        } else {
+            printf(ANSI_COLOR_RED "Error: Not enough memory to store another incident.\n" ANSI_COLOR_RESET);
+        }
         return;
     }
 
@@ -219,17 +1724,56 @@ void addIncident() {
     // Get time when the incident occurred with validation
     validateTimeInput(newIncident.time, MAX_TIME_LENGTH);
 
-    // Assign ID
+    newIncident.priority = validateChoiceInput("Enter the priority (1 = low, 3 = normal, 5 = critical, e.g. a gas leak)",
+                                               PRIORITY_LOW, PRIORITY_CRITICAL);
+
+    // The description is optional, so an empty line is accepted here
+    printf("Enter a description of what the caller reported (optional, press Enter to skip): ");
+    if (fgets(newIncident.description, MAX_DESCRIPTION_LENGTH, stdin) == NULL) {
+        newIncident.description[0] = '\0';
+    }
+    size_t length = strlen(newIncident.description);
+    if (length > 0 && newIncident.description[length - 1] == '\n') {
+        newIncident.description[--length] = '\0';
+    } else if (length == MAX_DESCRIPTION_LENGTH - 1) {
+        // Drop the rest of an over-long line so it is not read as the next answer
+        int c;
+        while ((c = getchar()) != '\n' && c != EOF);
+    }
+    // '|' separates fields in the incidents file
+    for (size_t i = 0; i < length; i++) {
+        if (newIncident.description[i] == '|') {
+            newIncident.description[i] = '/';
+        }
+    }
+
+    // Assign ID; with a shared store, after taking in other instances' incidents so the ID is unique
+    lockSharedStore();
     newIncident.id = getNextIncidentId();
+    newIncident.reported = nextCommitTime();
 
-    // Add to array
-    incidents[incidentCount] = newIncident;
-    incidentCount++;
+    // Add to the store; a row the store refuses is not written either
+    if (!storeIncident(&newIncident)) {
+        unlockSharedStore();
+        if (activeTenant >= 0 && tenants[activeTenant].overQuota) {
+            printf(ANSI_COLOR_RED "\nError: %s has reached its memory quota; the incident was not reported.\n"
+                   ANSI_COLOR_RESET, tenants[activeTenant].name);
+        } else {
+            printf(ANSI_COLOR_RED "\nError: The incident could not be stored (out of memory, or %d incident types "
+                   "already exist); it was not reported.\n" ANSI_COLOR_RESET, MAX_INCIDENT_TYPES);
+        }
+        return;
+    }
 
     // Write to file
     writeIncidentToFile(&newIncident);
+    unlockSharedStore();
 
     printf(ANSI_COLOR_GREEN "\nIncident reported successfully with ID: %d\n" ANSI_COLOR_RESET, newIncident.id);
+
+    // Alert supervisors watching for this kind of incident
+    checkWatchList(&newIncident);
+    evaluateAlertRules(&newIncident, 1);
 }
 
 // View all incidents
@@ -239,38 +1783,38 @@ void viewAllIncidents() {
         return;
     }
 
-    printf("%-5s | %-30s | %-30s | %-20s\n", "ID", "Area", "Incident Type", "Time Occurred");
-    printf("---------------------------------------------------------------------------------\n");
+    printIncidentHeader();
 
     for (int i = 0; i < incidentCount; i++) {
-        printf("%-5d | " ANSI_COLOR_GREEN "%-30s" ANSI_COLOR_RESET " | "
-               ANSI_COLOR_RED "%-30s" ANSI_COLOR_RESET " | "
-               ANSI_COLOR_BLUE "%-20s" ANSI_COLOR_RESET "\n",
-               incidents[i].id, incidents[i].area, incidents[i].type, incidents[i].time);
+        printIncidentRow(i);
     }
 }
 
 // Helper function to check if a string contains a substring (case insensitive)
 int strContains(const char* str, const char* substr) {
-    char str_lower[MAX_STRING_LENGTH];
     char substr_lower[MAX_STRING_LENGTH];
+    toLowerCopy(substr_lower, substr, sizeof(substr_lower));
+    return strContainsLower(str, substr_lower);
+}
 
-    // Make lowercase copies
-    size_t i;
-    for (i = 0; i < strlen(str) && i < MAX_STRING_LENGTH - 1; i++) {
-        str_lower[i] = tolower(str[i]);
-    }
-    str_lower[i] = '\0';
-
-    for (i = 0; i < strlen(substr) && i < MAX_STRING_LENGTH - 1; i++) {
-        substr_lower[i] = tolower(substr[i]);
-    }
-    substr_lower[i] = '\0';
+// Check if a string contains an already lowercased substring (case insensitive)
+int strContainsLower(const char* str, const char* substr_lower) {
+    char str_lower[MAX_STRING_LENGTH];
+    toLowerCopy(str_lower, str, sizeof(str_lower));
 
     // Check if the lowercase substr appears in lowercase str
     return strstr(str_lower, substr_lower) != NULL;
 }
 
+// Copy a string in lowercase, truncating it to the destination size
+void toLowerCopy(char* destination, const char* source, size_t size) {
+    size_t i;
+    for (i = 0; source[i] != '\0' && i < size - 1; i++) {
+        destination[i] = (char)tolower((unsigned char)source[i]);
+    }
+    destination[i] = '\0';
+}
+
 // View incidents filtered by area
 void viewIncidentsByArea() {
     if (incidentCount == 0) {
@@ -281,23 +1825,33 @@ void viewIncidentsByArea() {
     char searchArea[MAX_AREA_LENGTH];
     validateStringInput(searchArea, MAX_AREA_LENGTH, "Enter area to filter by");
 
-    printf("\nIncidents in area containing: %s\n", searchArea);
-    printf("%-5s | %-30s | %-30s | %-20s\n", "ID", "Area", "Incident Type", "Time Occurred");
-    printf("---------------------------------------------------------------------------------\n");
+    // Match the area dictionary once, then scan only the hot records
+    unsigned char* areaMatches = matchAreaDictionary(searchArea);
+    if (areaMatches == NULL) {
+        printf(ANSI_COLOR_RED "Error: Not enough memory to run the filter.\n" ANSI_COLOR_RESET);
+        return;
+    }
 
-    int found = 0;
-    for (int i = 0; i < incidentCount; i++) {
-        // Use partial matching instead of exact match
-        if (strContains(incidents[i].area, searchArea)) {
-            printf("%-5d | " ANSI_COLOR_GREEN "%-30s" ANSI_COLOR_RESET " | "
-                   ANSI_COLOR_RED "%-30s" ANSI_COLOR_RESET " | "
-                   ANSI_COLOR_BLUE "%-20s" ANSI_COLOR_RESET "\n",
-                   incidents[i].id, incidents[i].area, incidents[i].type, incidents[i].time);
-            found = 1;
-        }
+    // Print each batch as soon as it is scanned, so the first page shows up immediately
+    printf("\nIncidents in area containing: %s\n", searchArea);
+    printIncidentHeader();
+    struct ScanControl control;
+    beginScanControl(&control, -1, 0);
+    int selection[QUERY_BATCH_SIZE];
+    long found = 0;
+    int start;
+    for (start = 0; start < incidentCount && !scanStopped(&control); start += QUERY_BATCH_SIZE) {
+        int end = start + QUERY_BATCH_SIZE < incidentCount ? start + QUERY_BATCH_SIZE : incidentCount;
+        int selected = selectIncidentsByArea(areaMatches, start, end, selection);
+        printIncidentSelection(selection, selected);
+        fflush(stdout);
+        found += selected;
     }
+    endScanControl(&control);
+    free(areaMatches);
 
-    if (!found) {
+    reportScanStop(&control, start < incidentCount ? start : incidentCount, incidentCount);
+    if (found == 0 && control.state == SCAN_RUNNING) {
         printf("No incidents found in this area.\n");
     }
 }
@@ -312,80 +1866,8404 @@ void viewIncidentsByType() {
     char searchType[MAX_TYPE_LENGTH];
     validateStringInput(searchType, MAX_TYPE_LENGTH, "Enter incident type to filter by");
 
-    printf("\nIncidents of type containing: %s\n", searchType);
-    printf("%-5s | %-30s | %-30s | %-20s\n", "ID", "Area", "Incident Type", "Time Occurred");
-    printf("---------------------------------------------------------------------------------\n");
-
-    int found = 0;
-    for (int i = 0; i < incidentCount; i++) {
+    // Match the type dictionary once, then scan only the hot records
+    unsigned char* typeMatches = malloc(incidentTypeCount > 0 ? incidentTypeCount : 1);
+    if (typeMatches == NULL) {
+        printf(ANSI_COLOR_RED "Error: Not enough memory to run the filter.\n" ANSI_COLOR_RESET);
+        return;
+    }
+    char needle[MAX_STRING_LENGTH];
+    toLowerCopy(needle, searchType, sizeof(needle));
+    for (int t = 0; t < incidentTypeCount; t++) {
         // Use partial matching instead of exact match
-        if (strContains(incidents[i].type, searchType)) {
-            printf("%-5d | " ANSI_COLOR_GREEN "%-30s" ANSI_COLOR_RESET " | "
-                   ANSI_COLOR_RED "%-30s" ANSI_COLOR_RESET " | "
-                   ANSI_COLOR_BLUE "%-20s" ANSI_COLOR_RESET "\n",
-                   incidents[i].id, incidents[i].area, incidents[i].type, incidents[i].time);
-            found = 1;
-        }
+        typeMatches[t] = (unsigned char)strContainsLower(incidentTypes[t], needle);
+    }
+
+    printf("\nIncidents of type containing: %s\n", searchType);
+    printIncidentHeader();
+    struct ScanControl control;
+    beginScanControl(&control, -1, 0);
+    int selection[QUERY_BATCH_SIZE];
+    long found = 0;
+    int start;
+    for (start = 0; start < incidentCount && !scanStopped(&control); start += QUERY_BATCH_SIZE) {
+        int end = start + QUERY_BATCH_SIZE < incidentCount ? start + QUERY_BATCH_SIZE : incidentCount;
+        int selected = selectIncidentsByType(typeMatches, start, end, selection);
+        printIncidentSelection(selection, selected);
+        fflush(stdout);
+        found += selected;
     }
+    endScanControl(&control);
+    free(typeMatches);
 
-    if (!found) {
+    reportScanStop(&control, start < incidentCount ? start : incidentCount, incidentCount);
+    if (found == 0 && control.state == SCAN_RUNNING) {
         printf("No incidents found of this type.\n");
     }
 }
 
-// Read incidents from file
-int readIncidentsFromFile(struct Incident incidents[]) {
+// Mark every area dictionary entry containing a search text (case insensitive); the caller frees the table
+unsigned char* matchAreaDictionary(const char* search) {
+    unsigned char* areaMatches = malloc(areaKeyCount > 0 ? areaKeyCount : 1);
+    if (areaMatches == NULL) {
+        return NULL;
+    }
+    char needle[MAX_STRING_LENGTH];
+    toLowerCopy(needle, search, sizeof(needle));
+    for (int area = 0; area < areaKeyCount; area++) {
+        // Area keys are already lowercased
+        areaMatches[area] = strstr(areaKeys[area], needle) != NULL;
+    }
+    return areaMatches;
+}
+
+// Collect the positions in [start, end) whose area is marked in a per-dictionary-entry match table
+int selectIncidentsByArea(const unsigned char* areaMatches, int start, int end, int* selection) {
+    int selected = 0;
+    // Split off the tail so the prefetching loop needs no bounds check
+    int prefetchEnd = end - PREFETCH_DISTANCE > start ? end - PREFETCH_DISTANCE : start;
+    int i;
+    for (i = start; i < prefetchEnd; i++) {
+        PREFETCH(&incidentHot[i + PREFETCH_DISTANCE]);
+        // Always write the position and only advance when it matched, so the loop has no data-dependent branch
+        selection[selected] = i;
+        selected += areaMatches[incidentHot[i].areaId];
+    }
+    for (; i < end; i++) {
+        selection[selected] = i;
+        selected += areaMatches[incidentHot[i].areaId];
+    }
+    return selected;
+}
+
+// Collect the positions in [start, end) whose type is marked in a per-dictionary-entry match table
+int selectIncidentsByType(const unsigned char* typeMatches, int start, int end, int* selection) {
+    int selected = 0;
+    int prefetchEnd = end - PREFETCH_DISTANCE > start ? end - PREFETCH_DISTANCE : start;
+    int i;
+    for (i = start; i < prefetchEnd; i++) {
+        PREFETCH(&incidentHot[i + PREFETCH_DISTANCE]);
+        selection[selected] = i;
+        selected += typeMatches[incidentHot[i].typeId];
+    }
+    for (; i < end; i++) {
+        selection[selected] = i;
+        selected += typeMatches[incidentHot[i].typeId];
+    }
+    return selected;
+}
+
+// Time the scan loops over the loaded store with a filter and print rows per second and cache misses per row
+int runBenchmark(const char* search) {
+    unsigned char* areaMatches = matchAreaDictionary(search);
+    unsigned char* typeMatches = malloc(incidentTypeCount > 0 ? incidentTypeCount : 1);
+    int* selection = malloc(QUERY_BATCH_SIZE * sizeof(int));
+    struct BenchmarkRecord* records = malloc((incidentCount > 0 ? (size_t)incidentCount : 1) * sizeof(struct BenchmarkRecord));
+    if (areaMatches == NULL || typeMatches == NULL || selection == NULL || records == NULL) {
+        printf(ANSI_COLOR_RED "Error: Not enough memory to run the benchmark.\n" ANSI_COLOR_RESET);
+        free(areaMatches);
+        free(typeMatches);
+        free(selection);
+        free(records);
+        return 1;
+    }
+    char needle[MAX_STRING_LENGTH];
+    toLowerCopy(needle, search, sizeof(needle));
+    for (int t = 0; t < incidentTypeCount; t++) {
+        typeMatches[t] = (unsigned char)strContainsLower(incidentTypes[t], needle);
+    }
+    // The same incidents in the pre-split layout, and an id bound both layouts filter on, so only the width differs
+    int idLimit = 0;
+    for (int i = 0; i < incidentCount; i++) {
+        struct Incident incident;
+        loadIncident(i, &incident);
+        strcpy(records[i].area, incident.area);
+        strcpy(records[i].type, incident.type);
+        strcpy(records[i].time, incident.time);
+        records[i].id = incident.id;
+        idLimit = incident.id > idLimit ? incident.id : idLimit;
+    }
+    idLimit /= 2;
+
+    int counter = openCacheMissCounter();
+    static const char* hugePageNames[3] = { "off", "thp", "explicit" };
+    printf("Benchmark: %d incidents, filter \"%s\", %d passes\n", incidentCount, search, BENCHMARK_PASSES);
+    printf("Columns: huge pages %s (%s), %d NUMA node%s%s\n", hugePageNames[hugePageMode], HUGE_PAGES_ENV,
+           numaNodeCount, numaNodeCount == 1 ? "" : "s", numaNodeCount > 1 ? ", pages interleaved" : "");
+    printf("%-34s | %-10s | %-12s | %-10s\n", "Loop", "Matches", "Rows/second", "Misses/row");
+    // Loops 0 and 1 render matches to /dev/null: the old loop printing as it matched, then selection and rendering
+    // as separate passes. Loops 2-6 only select: the old per-row string match, then the dictionary masks with and
+    // without prefetching and branch-free appends. Loops 7 and 8 scan the same predicate over 124-byte records and
+    // 16-byte hot records, which is the traffic the hot/cold split saves
+    const char* names[BENCHMARK_LOOPS] = { "area, match and print per row", "area, select then print",
+                                           "area, per-row match", "area, mask, branchy, no prefetch",
+                                           "area, mask, branch-free, prefetch", "type, mask, branchy, no prefetch",
+                                           "type, mask, branch-free, prefetch", "id filter, 124-byte records",
+                                           "id filter, hot records" };
+    for (int loop = 0; loop < BENCHMARK_LOOPS; loop++) {
+        long matches = 0;
+        int printing = loop <= 1;
+        int savedStdout = -1;
+#ifdef __linux__
+        // The rendering loops print through stdout as the viewing functions do, with stdout pointed at /dev/null
+        int discard = printing ? open("/dev/null", O_WRONLY) : -1;
+        if (discard >= 0) {
+            fflush(stdout);
+            savedStdout = dup(STDOUT_FILENO);
+            dup2(discard, STDOUT_FILENO);
+            close(discard);
+        }
+#endif
+        if (printing && savedStdout < 0) {
+            printf("%-34s | skipped, stdout cannot be discarded here\n", names[loop]);
+            continue;
+        }
+        long long missesBefore = readCacheMisses(counter);
+        double started = monotonicSeconds();
+        for (int pass = 0; pass < BENCHMARK_PASSES; pass++) {
+            for (int start = 0; start < incidentCount; start += QUERY_BATCH_SIZE) {
+                int end = start + QUERY_BATCH_SIZE < incidentCount ? start + QUERY_BATCH_SIZE : incidentCount;
+                int selected = 0;
+                if (loop == 0) {
+                    for (int i = start; i < end; i++) {
+                        if (strContains(incidentCold[i].area, search)) {
+                            printIncidentRow(i);
+                            selected++;
+                        }
+                    }
+                } else if (loop == 1) {
+                    selected = selectIncidentsByArea(areaMatches, start, end, selection);
+                    printIncidentSelection(selection, selected);
+                } else if (loop == 2) {
+                    for (int i = start; i < end; i++) {
+                        if (strContainsLower(incidentCold[i].area, needle)) {
+                            selection[selected++] = i;
+                        }
+                    }
+                } else if (loop == 3) {
+                    for (int i = start; i < end; i++) {
+                        if (areaMatches[incidentHot[i].areaId]) {
+                            selection[selected++] = i;
+                        }
+                    }
+                } else if (loop == 4) {
+                    selected = selectIncidentsByArea(areaMatches, start, end, selection);
+                } else if (loop == 5) {
+                    for (int i = start; i < end; i++) {
+                        if (typeMatches[incidentHot[i].typeId]) {
+                            selection[selected++] = i;
+                        }
+                    }
+                } else if (loop == 6) {
+                    selected = selectIncidentsByType(typeMatches, start, end, selection);
+                } else if (loop == 7) {
+                    for (int i = start; i < end; i++) {
+                        selection[selected] = i;
+                        selected += records[i].id <= idLimit;
+                    }
+                } else {
+                    for (int i = start; i < end; i++) {
+                        selection[selected] = i;
+                        selected += incidentHot[i].id <= idLimit;
+                    }
+                }
+                matches += selected;
+            }
+        }
+        double elapsed = monotonicSeconds() - started;
+        long long misses = readCacheMisses(counter) - missesBefore;
+#ifdef __linux__
+        if (savedStdout >= 0) {
+            fflush(stdout);
+            dup2(savedStdout, STDOUT_FILENO);
+            close(savedStdout);
+        }
+#endif
+        char missesPerRow[16] = "n/a";
+        if (counter >= 0 && incidentCount > 0) {
+            snprintf(missesPerRow, sizeof(missesPerRow), "%.3f", (double)misses / incidentCount / BENCHMARK_PASSES);
+        }
+        printf("%-34s | %-10ld | %-12.0f | %-10s\n", names[loop], matches / BENCHMARK_PASSES,
+               elapsed > 0 ? (double)incidentCount * BENCHMARK_PASSES / elapsed : 0.0, missesPerRow);
+    }
+    if (counter < 0) {
+        printf("Cache misses are not counted: this host does not expose the hardware counter.\n");
+    }
+#ifdef __linux__
+    if (counter >= 0) {
+        close(counter);
+    }
+#endif
+
+    free(areaMatches);
+    free(typeMatches);
+    free(selection);
+    free(records);
+    return 0;
+}
+
+// Open a counter of this process's cache misses for the benchmark, -1 if the host does not expose one
+int openCacheMissCounter() {
+#ifdef __linux__
+    struct perf_event_attr attributes;
+    memset(&attributes, 0, sizeof(attributes));
+    attributes.type = PERF_TYPE_HARDWARE;
+    attributes.size = sizeof(attributes);
+    attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+#else
+    return -1;
+#endif
+}
+
+// Cache misses counted so far, 0 without a counter
+long long readCacheMisses(int counter) {
+    long long misses = 0;
+#ifdef __linux__
+    if (counter >= 0 && read(counter, &misses, sizeof(misses)) != sizeof(misses)) {
+        misses = 0;
+    }
+#else
+    (void)counter;
+#endif
+    return misses;
+}
+
+// Print the column headings of an incident table
+void printIncidentHeader() {
+    printf("%-5s | %-30s | %-30s | %-20s | %-8s\n", "ID", "Area", "Incident Type", "Time Occurred", "Priority");
+    printf("--------------------------------------------------------------------------------------------\n");
+}
+
+// Print the incidents at the selected positions as table rows
+void printIncidentSelection(const int* selection, int count) {
+    for (int i = 0; i < count; i++) {
+        printIncidentRow(selection[i]);
+    }
+}
+
+// Start watching a scan for a keypress and an optional deadline (timeoutMs < 0 for none)
+void beginScanControl(struct ScanControl* control, long timeoutMs, int stream) {
+    // A municipality's query quota bounds every scan, whatever TIMEOUT the query asked for
+    long quota = activeTenant >= 0 ? tenants[activeTenant].queryMilliseconds : -1;
+    if (quota >= 0 && (timeoutMs < 0 || timeoutMs > quota)) {
+        timeoutMs = quota;
+    }
+    memset(control, 0, sizeof(*control));
+    control->state = SCAN_RUNNING;
+    control->stream = stream;
+    if (timeoutMs >= 0) {
+        control->deadline = monotonicSeconds() + (double)timeoutMs / 1000.0;
+    }
+
+#ifdef __linux__
+    // Piped input is the next menu answer, not a cancel request, so only a terminal is watched
+    if (isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &control->savedTerminal) == 0) {
+        struct termios raw = control->savedTerminal;
+        raw.c_lflag &= ~(tcflag_t)(ICANON | ECHO);
+        raw.c_cc[VMIN] = 0;
+        raw.c_cc[VTIME] = 0;
+        // Ctrl+C must not leave the shell without echo, so the handler is in place before the terminal changes
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = restoreTerminalOnInterrupt;
+        sigemptyset(&action.sa_mask);
+        interruptedTerminal = control->savedTerminal;
+        sigaction(SIGINT, &action, &previousInterruptAction);
+        terminalIsRaw = 1;
+        if (tcsetattr(STDIN_FILENO, TCSANOW, &raw) == 0) {
+            control->watchKeyboard = 1;
+            printf(ANSI_COLOR_CYAN "(press any key to cancel)\n" ANSI_COLOR_RESET);
+        } else {
+            terminalIsRaw = 0;
+            sigaction(SIGINT, &previousInterruptAction, NULL);
+        }
+    }
+#endif
+}
+
+// Check between batches whether the scan should stop; once stopped it stays stopped
+int scanStopped(struct ScanControl* control) {
+    if (control == NULL) {
+        return 0;
+    }
+    if (control->state != SCAN_RUNNING || control->checks++ % SCAN_CHECK_BATCHES != 0) {
+        return control->state != SCAN_RUNNING;
+    }
+    if (control->deadline > 0 && monotonicSeconds() >= control->deadline) {
+        control->state = SCAN_TIMED_OUT;
+    }
+#ifdef __linux__
+    struct pollfd input = { STDIN_FILENO, POLLIN, 0 };
+    if (control->watchKeyboard && poll(&input, 1, 0) > 0) {
+        char key;
+        if (read(STDIN_FILENO, &key, 1) == 1) {
+            control->state = SCAN_CANCELLED;
+        }
+    }
+#endif
+    return control->state != SCAN_RUNNING;
+}
+
+// Restore the terminal after a watched scan
+void endScanControl(struct ScanControl* control) {
+#ifdef __linux__
+    if (control->watchKeyboard) {
+        // Drop what is left of the key that cancelled (e.g. the rest of an arrow key's escape sequence), so it
+        // does not answer the next prompt
+        tcsetattr(STDIN_FILENO, TCSAFLUSH, &control->savedTerminal);
+        terminalIsRaw = 0;
+        sigaction(SIGINT, &previousInterruptAction, NULL);
+        control->watchKeyboard = 0;
+    }
+#else
+    (void)control;
+#endif
+}
+
+#ifdef __linux__
+// SIGINT during a watched scan: put the terminal back, then end the program as the interrupt would have
+void restoreTerminalOnInterrupt(int signalNumber) {
+    if (terminalIsRaw) {
+        tcsetattr(STDIN_FILENO, TCSAFLUSH, &interruptedTerminal);
+    }
+    signal(signalNumber, SIG_DFL);
+    raise(signalNumber);
+}
+#endif
+
+// Split text into lowercased alphanumeric terms, truncated to MAX_TERM_LENGTH - 1 characters
+int tokenizeDescription(const char* text, char (*terms)[MAX_TERM_LENGTH], int maxTerms) {
+    int count = 0;
+    const char* cursor = text;
+    while (*cursor != '\0' && count < maxTerms) {
+        while (*cursor != '\0' && !isalnum((unsigned char)*cursor)) {
+            cursor++;
+        }
+        int length = 0;
+        while (isalnum((unsigned char)*cursor)) {
+            if (length < MAX_TERM_LENGTH - 1) {
+                terms[count][length++] = (char)tolower((unsigned char)*cursor);
+            }
+            cursor++;
+        }
+        if (length > 0) {
+            terms[count++][length] = '\0';
+        }
+    }
+    return count;
+}
+
+// Find a term's postings, optionally adding empty ones (-1 if absent or out of memory)
+int findTermPostings(const char* term, int create) {
+    if (create && (termCount + 1) * 2 > termTableSize) {
+        int newSize = termTableSize == 0 ? 1024 : termTableSize * 2;
+        int* table = malloc((size_t)newSize * sizeof(int));
+        if (table == NULL) {
+            return -1;
+        }
+        for (int i = 0; i < newSize; i++) {
+            table[i] = -1;
+        }
+        for (int t = 0; t < termCount; t++) {
+            int slot = (int)(hashString(termPostings[t].term) & (unsigned int)(newSize - 1));
+            while (table[slot] >= 0) {
+                slot = (slot + 1) & (newSize - 1);
+            }
+            table[slot] = t;
+        }
+        free(termTable);
+        termTable = table;
+        termTableSize = newSize;
+    }
+    if (termTableSize == 0) {
+        return -1;
+    }
+
+    int slot = (int)(hashString(term) & (unsigned int)(termTableSize - 1));
+    while (termTable[slot] >= 0) {
+        if (strcmp(termPostings[termTable[slot]].term, term) == 0) {
+            return termTable[slot];
+        }
+        slot = (slot + 1) & (termTableSize - 1);
+    }
+    if (!create) {
+        return -1;
+    }
+
+    if (termCount == termCapacity) {
+        int newCapacity = termCapacity == 0 ? 256 : termCapacity * 2;
+        struct TermPostings* grown = realloc(termPostings, (size_t)newCapacity * sizeof(struct TermPostings));
+        if (grown == NULL) {
+            return -1;
+        }
+        termPostings = grown;
+        termCapacity = newCapacity;
+    }
+    struct TermPostings* postings = &termPostings[termCount];
+    memset(postings, 0, sizeof(*postings));
+    strcpy(postings->term, term);
+    postings->lastPosition = -1;
+    termTable[slot] = termCount;
+    return termCount++;
+}
+
+// Append a value to a posting list in 7-bit groups, low bits first; returns 0 if out of memory
+int appendPostingVarint(struct TermPostings* postings, unsigned int value) {
+    if (postings->length + 5 > postings->capacity) {
+        size_t newCapacity = postings->capacity == 0 ? 16 : postings->capacity * 2;
+        unsigned char* grown = realloc(postings->bytes, newCapacity);
+        if (grown == NULL) {
+            return 0;
+        }
+        postings->bytes = grown;
+        postings->capacity = newCapacity;
+    }
+    while (value >= 0x80) {
+        postings->bytes[postings->length++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    postings->bytes[postings->length++] = (unsigned char)value;
+    return 1;
+}
+
+// Decode one varint of a posting list and move past it
+unsigned int readPostingVarint(const unsigned char* bytes, size_t* offset) {
+    unsigned int value = 0;
+    int shift = 0;
+    unsigned char byte;
+    do {
+        byte = bytes[(*offset)++];
+        value |= (unsigned int)(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return value;
+}
+
+// Add the description of a newly stored incident to the inverted index; returns 0 if out of memory
+int indexDescription(int position) {
+    char terms[MAX_DESCRIPTION_TERMS][MAX_TERM_LENGTH];
+    int count = tokenizeDescription(descriptionAt(position), terms, MAX_DESCRIPTION_TERMS);
+    incidentCold[position].descriptionTerms = (unsigned short)count;
+    if (count == 0) {
+        return 1;
+    }
+    describedIncidents++;
+    totalDescriptionTerms += count;
+
+    for (int i = 0; i < count; i++) {
+        // Each distinct term gets one posting, written at its first occurrence
+        int seen = 0;
+        for (int j = 0; j < i && !seen; j++) {
+            seen = strcmp(terms[j], terms[i]) == 0;
+        }
+        if (seen) {
+            continue;
+        }
+        int frequency = 0;
+        for (int j = i; j < count; j++) {
+            frequency += strcmp(terms[j], terms[i]) == 0;
+        }
+
+        int term = findTermPostings(terms[i], 1);
+        if (term < 0) {
+            return 0;
+        }
+        struct TermPostings* postings = &termPostings[term];
+        if (!appendPostingVarint(postings, (unsigned int)(position - postings->lastPosition))
+            || !appendPostingVarint(postings, (unsigned int)frequency)) {
+            return 0;
+        }
+        int previous = 0;
+        for (int j = i; j < count; j++) {
+            if (strcmp(terms[j], terms[i]) == 0) {
+                if (!appendPostingVarint(postings, (unsigned int)(j - previous))) {
+                    return 0;
+                }
+                previous = j;
+            }
+        }
+        postings->lastPosition = position;
+        postings->documents++;
+    }
+    return 1;
+}
+
+// Parse search text into distinct terms and "quoted phrases"; returns 0 with a message if it cannot be searched
+int parseSearchQuery(const char* text, struct SearchQuery* query, char* error, size_t errorSize) {
+    memset(query, 0, sizeof(*query));
+    const char* cursor = text;
+    while (*cursor != '\0') {
+        // Split off the next quoted or unquoted stretch of text
+        int quoted = *cursor == '"';
+        const char* start = quoted ? cursor + 1 : cursor;
+        const char* end = start;
+        while (*end != '\0' && *end != '"') {
+            end++;
+        }
+        char chunk[MAX_DESCRIPTION_LENGTH];
+        size_t length = (size_t)(end - start) < sizeof(chunk) - 1 ? (size_t)(end - start) : sizeof(chunk) - 1;
+        memcpy(chunk, start, length);
+        chunk[length] = '\0';
+        cursor = (quoted && *end == '"') ? end + 1 : end;
+
+        char terms[MAX_DESCRIPTION_TERMS][MAX_TERM_LENGTH];
+        int count = tokenizeDescription(chunk, terms, MAX_DESCRIPTION_TERMS);
+        // Dropping words would silently change what a phrase means, so limits are reported instead
+        int phrase = -1;
+        if (quoted && count > 0) {
+            if (query->phraseCount == MAX_SEARCH_PHRASES) {
+                snprintf(error, errorSize, "a search can have at most %d quoted phrases", MAX_SEARCH_PHRASES);
+                return 0;
+            }
+            if (count > MAX_SEARCH_TERMS) {
+                snprintf(error, errorSize, "a quoted phrase can have at most %d words", MAX_SEARCH_TERMS);
+                return 0;
+            }
+            phrase = query->phraseCount++;
+        }
+        for (int i = 0; i < count; i++) {
+            int term = 0;
+            while (term < query->termCount && strcmp(query->terms[term], terms[i]) != 0) {
+                term++;
+            }
+            if (term == query->termCount) {
+                if (query->termCount == MAX_SEARCH_TERMS) {
+                    snprintf(error, errorSize, "a search can have at most %d different words", MAX_SEARCH_TERMS);
+                    return 0;
+                }
+                strcpy(query->terms[query->termCount++], terms[i]);
+            }
+            if (phrase >= 0) {
+                query->phrases[phrase][query->phraseLengths[phrase]++] = term;
+            }
+        }
+    }
+    if (query->termCount == 0) {
+        snprintf(error, errorSize, "the search has no words to look for");
+        return 0;
+    }
+    return 1;
+}
+
+// Move a cursor to its next posting, or mark it exhausted
+void advancePostingCursor(struct PostingCursor* cursor) {
+    const struct TermPostings* postings = cursor->postings;
+    if (postings == NULL || cursor->offset >= postings->length) {
+        cursor->position = -1;
+        return;
+    }
+    cursor->position += (int)readPostingVarint(postings->bytes, &cursor->offset);
+    cursor->frequency = (int)readPostingVarint(postings->bytes, &cursor->offset);
+    cursor->offsetsStart = cursor->offset;
+    for (int i = 0; i < cursor->frequency; i++) {
+        readPostingVarint(postings->bytes, &cursor->offset);
+    }
+}
+
+// Decode the token offsets of a cursor's current posting, in increasing order
+int readTokenOffsets(const struct PostingCursor* cursor, int* offsets) {
+    size_t offset = cursor->offsetsStart;
+    int previous = 0;
+    for (int i = 0; i < cursor->frequency; i++) {
+        previous += (int)readPostingVarint(cursor->postings->bytes, &offset);
+        offsets[i] = previous;
+    }
+    return cursor->frequency;
+}
+
+// Check that a phrase's terms occur at consecutive token offsets in the cursors' current incident
+int phraseMatches(const struct SearchQuery* query, int phrase, const struct PostingCursor* cursors) {
+    int length = query->phraseLengths[phrase];
+    int offsets[MAX_SEARCH_TERMS][MAX_DESCRIPTION_TERMS];
+    int counts[MAX_SEARCH_TERMS];
+    for (int i = 0; i < length; i++) {
+        const struct PostingCursor* cursor = &cursors[query->phrases[phrase][i]];
+        counts[i] = readTokenOffsets(cursor, offsets[i]);
+    }
+
+    for (int first = 0; first < counts[0]; first++) {
+        int matched = 1;
+        for (int i = 1; i < length && matched; i++) {
+            matched = 0;
+            for (int k = 0; k < counts[i] && !matched; k++) {
+                matched = offsets[i][k] == offsets[0][first] + i;
+            }
+        }
+        if (matched) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Rank incidents by BM25 over their descriptions, requiring any quoted phrases, and print the best
+void searchDescriptions() {
+    buildDeferredIndexes();
+    if (describedIncidents == 0) {
+        printf("No incident has a description yet.\n");
+        return;
+    }
+    if (!textIndexValid) {
+        printf(ANSI_COLOR_RED "Error: The description index ran out of memory; search is unavailable.\n" ANSI_COLOR_RESET);
+        return;
+    }
+
+    char text[MAX_DESCRIPTION_LENGTH];
+    printf("Terms are ranked by BM25; put words in \"double quotes\" to require them as a phrase.\n");
+    validateStringInput(text, MAX_DESCRIPTION_LENGTH, "Enter search terms (e.g., gas smell \"near school\")");
+    struct SearchQuery query;
+    char error[MAX_STRING_LENGTH];
+    if (!parseSearchQuery(text, &query, error, sizeof(error))) {
+        printf(ANSI_COLOR_RED "Error: %s.\n" ANSI_COLOR_RESET, error);
+        return;
+    }
+
+    double started = monotonicSeconds();
+    struct PostingCursor cursors[MAX_SEARCH_TERMS];
+    double weights[MAX_SEARCH_TERMS];
+    for (int t = 0; t < query.termCount; t++) {
+        int term = findTermPostings(query.terms[t], 0);
+        memset(&cursors[t], 0, sizeof(cursors[t]));
+        cursors[t].postings = term >= 0 ? &termPostings[term] : NULL;
+        cursors[t].position = -1;
+        int documents = term >= 0 ? termPostings[term].documents : 0;
+        weights[t] = log((describedIncidents - documents + 0.5) / (documents + 0.5) + 1.0);
+        advancePostingCursor(&cursors[t]);
+    }
+    double averageTerms = (double)totalDescriptionTerms / describedIncidents;
+
+    // Merge the posting lists document at a time, keeping the best scores in rank order
+    int results[SEARCH_RESULTS];
+    double scores[SEARCH_RESULTS];
+    int resultCount = 0;
+    long matches = 0;
+    struct ScanControl control;
+    beginScanControl(&control, -1, 0);
+    for (long visited = 0; ; visited++) {
+        int position = -1;
+        for (int t = 0; t < query.termCount; t++) {
+            if (cursors[t].position >= 0 && (position < 0 || cursors[t].position < position)) {
+                position = cursors[t].position;
+            }
+        }
+        if (position < 0 || (visited % QUERY_BATCH_SIZE == 0 && scanStopped(&control))) {
+            break;
+        }
+
+        int accepted = 1;
+        for (int p = 0; p < query.phraseCount && accepted; p++) {
+            for (int i = 0; i < query.phraseLengths[p] && accepted; i++) {
+                accepted = cursors[query.phrases[p][i]].position == position;
+            }
+            accepted = accepted && phraseMatches(&query, p, cursors);
+        }
+
+        double score = 0.0;
+        double lengthNorm = BM25_K1 * (1.0 - BM25_B + BM25_B * incidentCold[position].descriptionTerms / averageTerms);
+        for (int t = 0; t < query.termCount; t++) {
+            if (cursors[t].position == position) {
+                score += weights[t] * cursors[t].frequency * (BM25_K1 + 1.0) / (cursors[t].frequency + lengthNorm);
+                advancePostingCursor(&cursors[t]);
+            }
+        }
+        if (!accepted) {
+            continue;
+        }
+        matches++;
+
+        // Insert into the top results, dropping the lowest score when full
+        int slot = resultCount < SEARCH_RESULTS ? resultCount++ : SEARCH_RESULTS;
+        while (slot > 0 && scores[slot - 1] < score) {
+            if (slot < SEARCH_RESULTS) {
+                scores[slot] = scores[slot - 1];
+                results[slot] = results[slot - 1];
+            }
+            slot--;
+        }
+        if (slot < SEARCH_RESULTS) {
+            scores[slot] = score;
+            results[slot] = position;
+        }
+    }
+    endScanControl(&control);
+    double elapsed = monotonicSeconds() - started;
+
+    printf("\n%-6s | %-7s | %-5s | %-30s | %-30s | %-20s | %-8s\n", "Rank", "Score", "ID", "Area", "Incident Type",
+           "Time Occurred", "Priority");
+    printf("-------------------------------------------------------------------------------------------------------------\n");
+    for (int r = 0; r < resultCount; r++) {
+        printf("%-6d | " ANSI_COLOR_YELLOW "%-7.3f" ANSI_COLOR_RESET " | ", r + 1, scores[r]);
+        printIncidentRow(results[r]);
+        printf("                 " ANSI_COLOR_CYAN "%s" ANSI_COLOR_RESET "\n", descriptionAt(results[r]));
+    }
+    if (control.state != SCAN_RUNNING) {
+        printf(ANSI_COLOR_YELLOW "\nSearch %s; ranking covers the incidents merged so far.\n" ANSI_COLOR_RESET,
+               control.state == SCAN_CANCELLED ? "cancelled" : "reached its deadline");
+    }
+    printf("\n" ANSI_COLOR_GREEN "%ld" ANSI_COLOR_RESET " matching incident%s, best %d shown ("
+           ANSI_COLOR_YELLOW "%.3f ms" ANSI_COLOR_RESET ")\n",
+           matches, matches == 1 ? "" : "s", resultCount, elapsed * 1000.0);
+}
+
+// Read whether queries are approximate unless they say EXACT
+void configureQueryMode() {
+    const char* mode = getenv(QUERY_MODE_ENV);
+    approximateByDefault = mode != NULL && strcmp(mode, "approx") == 0;
+}
+
+// Next value of the xorshift64* generator behind reservoir sampling
+unsigned long long nextSampleRandom() {
+    sampleRandomState ^= sampleRandomState >> 12;
+    sampleRandomState ^= sampleRandomState << 25;
+    sampleRandomState ^= sampleRandomState >> 27;
+    return sampleRandomState * 2685821657736338717ULL;
+}
+
+// Offer a newly stored position to the reservoir (Algorithm R), keeping a uniform sample of the store
+void sampleIncident(int position) {
+    if (reservoir == NULL) {
+        reservoir = malloc(RESERVOIR_SIZE * sizeof(int));
+        if (reservoir == NULL) {
+            // Without a sample, approximate queries simply run exactly
+            return;
+        }
+    }
+    if (reservoirCount < RESERVOIR_SIZE) {
+        reservoir[reservoirCount++] = position;
+        reservoirOrderedValid = 0;
+        return;
+    }
+    unsigned long long slot = nextSampleRandom() % (unsigned long long)(position + 1);
+    if (slot < RESERVOIR_SIZE) {
+        reservoir[slot] = position;
+        reservoirOrderedValid = 0;
+    }
+}
+
+// Scale a count of matching sample rows up to the whole store
+long scaleSampleCount(long matches) {
+    if (reservoirCount == 0) {
+        return matches;
+    }
+    return (long)((double)matches * incidentCount / reservoirCount + 0.5);
+}
+
+// Half-width of the confidence interval of a scaled sample count, with the finite population correction
+long sampleMargin(long matches) {
+    if (reservoirCount == 0 || reservoirCount >= incidentCount) {
+        return 0;
+    }
+    double n = reservoirCount, total = incidentCount;
+    double share = matches / n;
+    double correction = (total - n) / (total - 1.0);
+    double margin = CONFIDENCE_Z * total * sqrt(share * (1.0 - share) / n * correction);
+    return (long)(margin + 0.5);
+}
+
+// Tell the user a scan ended early and how far it got
+void reportScanStop(const struct ScanControl* control, long scanned, long total) {
+    if (control->state == SCAN_RUNNING) {
+        return;
+    }
+    printf(ANSI_COLOR_YELLOW "\n%s after scanning %ld of %ld incidents; results are partial.\n" ANSI_COLOR_RESET,
+           control->state == SCAN_CANCELLED ? "Cancelled" : "Deadline reached", scanned, total);
+}
+
+// Let an analyst type a query and print its result
+void runQuery() {
+    if (incidentCount == 0) {
+        printf("No incidents have been reported yet.\n");
+        return;
+    }
+
+    char text[MAX_QUERY_LENGTH];
+    printf("Columns: id, area, type, time, status, priority. Operators: = != < <= > >= ~ (contains), BETWEEN.\n");
+    printf("Prefix with EXPLAIN to see the plan, or EXPLAIN ANALYZE to also profile it.\n");
+    printf("End with TIMEOUT <ms> to stop the query at a deadline.\n");
+    printf("Prefix with APPROX for a fast estimate from a sample, or EXACT to force a full evaluation.\n");
+    printf("Add AS OF 'YYYY-MM-DD HH:MM' after the column list to see the incidents as they were then.\n");
+    validateStringInput(text, MAX_QUERY_LENGTH,
+                        "Enter a query (e.g., SELECT area, count(*) WHERE type ~ 'pothole' GROUP BY area ORDER BY 2 DESC LIMIT 10)");
+
+    // EXPLAIN is not part of the plan, so explained and plain runs share the prepared plan
+    const char* body = text;
+    int explain = 0, analyze = 0;
+    const char* rest = skipQueryKeyword(body, "explain");
+    if (rest != NULL) {
+        explain = 1;
+        body = rest;
+        rest = skipQueryKeyword(body, "analyze");
+        if (rest != NULL) {
+            analyze = 1;
+            body = rest;
+        }
+    }
+    int approximate = approximateByDefault;
+    if ((rest = skipQueryKeyword(body, "approx")) != NULL) {
+        approximate = 1;
+        body = rest;
+    } else if ((rest = skipQueryKeyword(body, "exact")) != NULL) {
+        approximate = 0;
+        body = rest;
+    }
+    // A sample as large as the store is the store itself
+    approximate = approximate && reservoirCount < incidentCount;
+
+    char error[MAX_STRING_LENGTH];
+    int reused = 0;
+    const struct QueryPlan* plan = prepareQuery(body, &reused, error, sizeof(error));
+    if (plan == NULL) {
+        printf(ANSI_COLOR_RED "Query error: %s\n" ANSI_COLOR_RESET, error);
+        return;
+    }
+    if (plan->asOf >= 0 && plan->asOf < historyHorizon) {
+        time_t horizon = (time_t)historyHorizon;
+        char when[MAX_STRING_LENGTH];
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime(&horizon));
+        printf(ANSI_COLOR_RED "Query error: AS OF can go back to %s (history is kept for %ld day%s)\n" ANSI_COLOR_RESET,
+               when, historyRetentionDays, historyRetentionDays == 1 ? "" : "s");
+        return;
+    }
+    // Snapshots are read from the version history, which the sample does not cover
+    approximate = approximate && plan->asOf < 0;
+
+    if (explain && !analyze) {
+        printf("\n");
+        printQueryPlan(plan, NULL, reused);
+        if (approximate) {
+            printf("Approximate: evaluated over a reservoir sample of %d of %d rows\n", reservoirCount, incidentCount);
+        }
+        return;
+    }
+
+    // Rows that arrive in their final order are printed while the scan is still running
+    int stream = !analyze && plan->aggregate == 0 && plan->groupBy < 0 && plan->orderBy < 0;
+    printf("\n");
+    if (stream) {
+        printQueryHeader(plan);
+    }
+
+    struct QueryProfile profile;
+    struct QueryRow* rows = NULL;
+    struct ScanControl control;
+    beginScanControl(&control, plan->timeoutMs, stream);
+    control.sampled = approximate;
+    double started = monotonicSeconds();
+    int rowCount = executeQuery(plan, &rows, analyze ? &profile : NULL, &control);
+    double elapsed = monotonicSeconds() - started;
+    endScanControl(&control);
+    if (rowCount < 0) {
+        printf(ANSI_COLOR_RED "Error: Not enough memory to run the query.\n" ANSI_COLOR_RESET);
+        return;
+    }
+
+    if (analyze) {
+        printQueryPlan(plan, &profile, reused);
+        printf("Execution time: " ANSI_COLOR_YELLOW "%.3f ms" ANSI_COLOR_RESET ", " ANSI_COLOR_GREEN "%d"
+               ANSI_COLOR_RESET " row%s\n", elapsed * 1000.0, rowCount, (rowCount == 1) ? "" : "s");
+        reportScanStop(&control, profile.operators[0].rowsIn, incidentCount);
+        free(rows);
+        return;
+    }
+    if (control.state != SCAN_RUNNING && !stream) {
+        // A partial count or sort would be misleading, so only streamed rows survive a stop
+        printf(ANSI_COLOR_YELLOW "Query %s before it finished; no result.\n" ANSI_COLOR_RESET,
+               control.state == SCAN_CANCELLED ? "cancelled" : "reached its deadline");
+        free(rows);
+        return;
+    }
+    if (!stream) {
+        printQueryHeader(plan);
+        printQueryRows(plan, rows, rowCount, control.sampled);
+    }
+    if (control.sampled) {
+        printf(ANSI_COLOR_YELLOW "\nApproximate result from a uniform sample of %d of %d incidents "
+               "(95%% confidence intervals)" ANSI_COLOR_RESET, reservoirCount, incidentCount);
+        if (stream && plan->limit < 0 && control.state == SCAN_RUNNING) {
+            printf(ANSI_COLOR_YELLOW "; about %ld \xC2\xB1 %ld incidents match" ANSI_COLOR_RESET,
+                   scaleSampleCount(rowCount), sampleMargin(rowCount));
+        }
+        printf("\n");
+    }
+    if (control.state != SCAN_RUNNING) {
+        printf(ANSI_COLOR_YELLOW "\nQuery %s; showing the %d row%s found so far.\n" ANSI_COLOR_RESET,
+               control.state == SCAN_CANCELLED ? "cancelled" : "reached its deadline",
+               rowCount, (rowCount == 1) ? "" : "s");
+    } else {
+        printf("\n" ANSI_COLOR_GREEN "%d" ANSI_COLOR_RESET " row%s%s\n", rowCount, (rowCount == 1) ? "" : "s",
+               reused ? " (prepared plan reused)" : "");
+    }
+    free(rows);
+}
+
+// If text starts with a keyword (case insensitive), return what follows it, else NULL
+const char* skipQueryKeyword(const char* text, const char* keyword) {
+    while (isspace((unsigned char)*text)) {
+        text++;
+    }
+    size_t length = strlen(keyword);
+    for (size_t i = 0; i < length; i++) {
+        if (tolower((unsigned char)text[i]) != keyword[i]) {
+            return NULL;
+        }
+    }
+    if (text[length] != '\0' && !isspace((unsigned char)text[length])) {
+        return NULL;
+    }
+    return text + length;
+}
+
+// Print the operator tree of a plan, top operator first, with runtime figures when profiled
+void printQueryPlan(const struct QueryPlan* plan, const struct QueryProfile* profile, int reused) {
+    // Filters are shown in the order the planner evaluates them, which depends on current statistics
+    int order[MAX_QUERY_PREDICATES];
+    if (profile != NULL) {
+        memcpy(order, profile->filterOrder, sizeof(order));
+    } else {
+        planPredicateOrder(plan, chooseIndexPredicate(plan, NULL), order);
+    }
+
+    for (int position = plan->operatorCount - 1; position >= 0; position--) {
+        int depth = plan->operatorCount - 1 - position;
+        int o = plan->operators[position].kind == PLAN_FILTER ? 1 + order[position - 1] : position;
+        char description[MAX_STRING_LENGTH * 2];
+        describePlanOperator(plan, o, profile, description, sizeof(description));
+
+        printf("%*s%s" ANSI_COLOR_CYAN "%s" ANSI_COLOR_RESET "\n", depth * 2, "", depth > 0 ? "-> " : "", description);
+        if (profile != NULL) {
+            const struct OperatorProfile* stats = &profile->operators[o];
+            printf("%*s   rows in " ANSI_COLOR_GREEN "%ld" ANSI_COLOR_RESET ", rows out " ANSI_COLOR_GREEN "%ld"
+                   ANSI_COLOR_RESET ", time " ANSI_COLOR_YELLOW "%.3f ms" ANSI_COLOR_RESET ", scanned "
+                   ANSI_COLOR_BLUE "%.1f KiB" ANSI_COLOR_RESET "\n",
+                   depth * 2, "", stats->rowsIn, stats->rowsOut, stats->seconds * 1000.0, stats->bytes / 1024.0);
+        }
+    }
+    printf("Planning: %s\n", reused ? "prepared plan reused" : "parsed and compiled");
+}
+
+// Describe one plan operator in a line of EXPLAIN output
+void describePlanOperator(const struct QueryPlan* plan, int index, const struct QueryProfile* profile,
+                          char* description, size_t size) {
+    static const char* columns[] = { "id", "area", "type", "time", "status", "priority", "count(*)" };
+    static const char* symbols[] = { "=", "!=", "<", "<=", ">", ">=", "~" };
+    const struct PlanOperator* op = &plan->operators[index];
+
+    switch (op->kind) {
+        case PLAN_SCAN: {
+            long estimate;
+            int cells = profile != NULL ? profile->rollupCells : rollupCubeLookup(plan, &estimate);
+            int indexed = profile != NULL ? profile->indexedPredicate : chooseIndexPredicate(plan, &estimate);
+            if (cells >= 0) {
+                snprintf(description, size, "Rollup cube lookup (%d cell%s, no rows scanned)",
+                         cells, cells == 1 ? "" : "s");
+            } else if (profile != NULL && profile->sampleRows > 0) {
+                snprintf(description, size, "Sample scan (reservoir of %d of %d rows, batches of %d)",
+                         profile->sampleRows, incidentCount, QUERY_BATCH_SIZE);
+            } else if (indexed >= 0) {
+                snprintf(description, size, "Index scan using %s index (%s%ld candidate rows, batches of %d)",
+                         columns[plan->predicates[indexed].column], profile != NULL ? "" : "about ",
+                         profile != NULL ? profile->operators[index].rowsIn : estimate, QUERY_BATCH_SIZE);
+            } else {
+                snprintf(description, size, "Scan incidents (full scan of %d rows, batches of %d)",
+                         incidentCount, QUERY_BATCH_SIZE);
+            }
+            if (plan->asOf >= 0) {
+                time_t seconds = (time_t)plan->asOf;
+                size_t used = strlen(description);
+                used += strftime(description + used, size - used, " as of %Y-%m-%d %H:%M:%S", localtime(&seconds));
+                snprintf(description + used, size - used, " from version history");
+            }
+            break;
+        }
+
+        case PLAN_FILTER: {
+            const struct QueryPredicate* predicate = &plan->predicates[op->predicate];
+            char condition[MAX_STRING_LENGTH + 32];
+            if (predicate->column == QCOL_AREA || predicate->column == QCOL_TYPE) {
+                snprintf(condition, sizeof(condition), "%s %s '%s'", columns[predicate->column],
+                         symbols[predicate->op], predicate->text);
+            } else if (predicate->column == QCOL_TIME) {
+                if (predicate->op == QOP_BETWEEN) {
+                    snprintf(condition, sizeof(condition), "time BETWEEN %02ld:%02ld AND %02ld:%02ld",
+                             predicate->low / 60, predicate->low % 60, predicate->high / 60, predicate->high % 60);
+                } else {
+                    snprintf(condition, sizeof(condition), "time %s %02ld:%02ld", symbols[predicate->op],
+                             predicate->low / 60, predicate->low % 60);
+                }
+            } else if (predicate->op == QOP_BETWEEN) {
+                snprintf(condition, sizeof(condition), "%s BETWEEN %ld AND %ld", columns[predicate->column],
+                         predicate->low, predicate->high);
+            } else if (predicate->column == QCOL_STATUS) {
+                snprintf(condition, sizeof(condition), "status %s '%s'", symbols[predicate->op],
+                         statusName((int)predicate->low));
+            } else {
+                snprintf(condition, sizeof(condition), "%s %s %ld", columns[predicate->column],
+                         symbols[predicate->op], predicate->low);
+            }
+
+            long cubeCount;
+            int cells = profile != NULL ? profile->rollupCells : rollupCubeLookup(plan, &cubeCount);
+            int indexed = profile != NULL ? profile->indexedPredicate : chooseIndexPredicate(plan, NULL);
+            double estimate = estimateSelectivity(predicate) * 100.0;
+            if (cells >= 0) {
+                snprintf(description, size, "Filter (%s) folded into rollup cube lookup", condition);
+            } else if (indexed == op->predicate) {
+                snprintf(description, size, "Filter (%s) satisfied by %s index, est. %.1f%%",
+                         condition, columns[predicate->column], estimate);
+            } else if (predicate->column == QCOL_TYPE && profile != NULL) {
+                snprintf(description, size, "Filter (%s) using type dictionary, %d of %d types match, est. %.1f%%",
+                         condition, profile->operators[index].dictionaryMatches, incidentTypeCount, estimate);
+            } else if (predicate->column == QCOL_TYPE) {
+                snprintf(description, size, "Filter (%s) using type dictionary, est. %.1f%%", condition, estimate);
+            } else {
+                snprintf(description, size, "Filter (%s), est. %.1f%%", condition, estimate);
+            }
+            break;
+        }
+
+        case PLAN_AGGREGATE:
+            if (plan->groupBy >= 0) {
+                snprintf(description, size, "Hash aggregate count(*) group by %s", columns[plan->groupBy]);
+            } else {
+                snprintf(description, size, "Aggregate count(*)");
+            }
+            break;
+
+        case PLAN_SORT:
+            snprintf(description, size, "Sort by %s %s", columns[plan->orderBy], plan->orderDesc ? "DESC" : "ASC");
+            break;
+
+        default:
+            snprintf(description, size, "Limit %ld", plan->limit);
+            break;
+    }
+}
+
+// Seconds from a monotonic clock, for timing queries
+double monotonicSeconds() {
+#if defined(CLOCK_MONOTONIC) && !defined(_WIN32)
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+// Return the compiled plan for a query, parsing it only the first time it is seen (NULL on error)
+const struct QueryPlan* prepareQuery(const char* text, int* reused, char* error, size_t errorSize) {
+    preparedQueryClock++;
+
+    int victim = 0;
+    for (int i = 0; i < PREPARED_QUERY_SLOTS; i++) {
+        if (preparedQueries[i].lastUsed != 0 && strcmp(preparedQueries[i].text, text) == 0) {
+            preparedQueries[i].lastUsed = preparedQueryClock;
+            *reused = 1;
+            return &preparedQueries[i].plan;
+        }
+        if (preparedQueries[i].lastUsed < preparedQueries[victim].lastUsed) {
+            victim = i;
+        }
+    }
+
+    // Parse first, so a query with an error does not evict a cached plan
+    struct QueryPlan plan;
+    if (!parseQuery(text, &plan, error, errorSize)) {
+        return NULL;
+    }
+    struct PreparedQuery* slot = &preparedQueries[victim];
+    slot->plan = plan;
+    snprintf(slot->text, sizeof(slot->text), "%s", text);
+    slot->lastUsed = preparedQueryClock;
+    *reused = 0;
+    return &slot->plan;
+}
+
+// Read the next token of a query into the lexer
+void nextQueryToken(struct QueryLexer* lexer) {
+    const char* c = lexer->cursor;
+    while (isspace((unsigned char)*c)) {
+        c++;
+    }
+
+    size_t length = 0;
+    if (*c == '\0') {
+        lexer->kind = TOKEN_END;
+    } else if (*c == '\'') {
+        // Quoted string, up to the closing quote
+        lexer->kind = TOKEN_STRING;
+        c++;
+        while (*c != '\0' && *c != '\'') {
+            if (length < sizeof(lexer->token) - 1) {
+                lexer->token[length++] = *c;
+            }
+            c++;
+        }
+        if (*c == '\'') {
+            c++;
+        } else {
+            lexer->kind = TOKEN_ERROR;
+        }
+    } else if (isdigit((unsigned char)*c)) {
+        // Number or HH:MM time
+        lexer->kind = TOKEN_NUMBER;
+        while (isdigit((unsigned char)*c) || *c == ':') {
+            if (length < sizeof(lexer->token) - 1) {
+                lexer->token[length++] = *c;
+            }
+            c++;
+        }
+    } else if (isalpha((unsigned char)*c) || *c == '_') {
+        lexer->kind = TOKEN_WORD;
+        while (isalnum((unsigned char)*c) || *c == '_') {
+            if (length < sizeof(lexer->token) - 1) {
+                lexer->token[length++] = (char)tolower((unsigned char)*c);
+            }
+            c++;
+        }
+    } else {
+        // One or two character symbol
+        lexer->kind = TOKEN_SYMBOL;
+        lexer->token[length++] = *c++;
+        if ((lexer->token[0] == '<' || lexer->token[0] == '>' || lexer->token[0] == '!') && *c == '=') {
+            lexer->token[length++] = *c++;
+        }
+    }
+
+    lexer->token[length] = '\0';
+    lexer->cursor = c;
+}
+
+// Check whether the current token is the given keyword or symbol, consuming it if so
+int acceptQueryToken(struct QueryLexer* lexer, const char* expected) {
+    if ((lexer->kind == TOKEN_WORD || lexer->kind == TOKEN_SYMBOL) && strcmp(lexer->token, expected) == 0) {
+        nextQueryToken(lexer);
+        return 1;
+    }
+    return 0;
+}
+
+// Map a column name to its query column (-1 if unknown)
+int parseQueryColumn(const char* name) {
+    static const char* names[] = { "id", "area", "type", "time", "status", "priority" };
+    for (int column = 0; column < QCOL_COUNT; column++) {
+        if (strcmp(name, names[column]) == 0) {
+            return column;
+        }
+    }
+    return -1;
+}
+
+// Parse a column name or count(*) at the current token (-1 if neither)
+int parseQueryItem(struct QueryLexer* lexer) {
+    if (lexer->kind != TOKEN_WORD) {
+        return -1;
+    }
+    if (strcmp(lexer->token, "count") == 0) {
+        nextQueryToken(lexer);
+        if (!acceptQueryToken(lexer, "(") || !acceptQueryToken(lexer, "*") || !acceptQueryToken(lexer, ")")) {
+            return -1;
+        }
+        return QCOL_COUNT;
+    }
+    int column = parseQueryColumn(lexer->token);
+    if (column >= 0) {
+        nextQueryToken(lexer);
+    }
+    return column;
+}
+
+// Parse a literal compared against a column into a predicate operand
+int parseQueryValue(struct QueryLexer* lexer, int column, long* number, char* text) {
+    if (column == QCOL_AREA || column == QCOL_TYPE) {
+        if (lexer->kind != TOKEN_STRING) {
+            return 0;
+        }
+        toLowerCopy(text, lexer->token, MAX_STRING_LENGTH);
+    } else if (column == QCOL_TIME) {
+        if (!isValidTimeFormat(lexer->token) || (lexer->kind != TOKEN_NUMBER && lexer->kind != TOKEN_STRING)) {
+            return 0;
+        }
+        *number = timeToMinutes(lexer->token);
+    } else if (column == QCOL_STATUS) {
+        *number = parseStatusName(lexer->token);
+        if (*number < 0) {
+            return 0;
+        }
+    } else {
+        char extra;
+        if (lexer->kind != TOKEN_NUMBER || sscanf(lexer->token, "%ld%c", number, &extra) != 1) {
+            return 0;
+        }
+    }
+    nextQueryToken(lexer);
+    return 1;
+}
+
+// Parse one WHERE predicate
+int parseQueryPredicate(struct QueryLexer* lexer, struct QueryPredicate* predicate, char* error, size_t errorSize) {
+    predicate->column = lexer->kind == TOKEN_WORD ? parseQueryColumn(lexer->token) : -1;
+    if (predicate->column < 0) {
+        snprintf(error, errorSize, "unknown column '%s' in WHERE", lexer->token);
+        return 0;
+    }
+    nextQueryToken(lexer);
+    predicate->text[0] = '\0';
+    predicate->low = predicate->high = 0;
+
+    int textual = predicate->column == QCOL_AREA || predicate->column == QCOL_TYPE;
+    if (acceptQueryToken(lexer, "between")) {
+        predicate->op = QOP_BETWEEN;
+        if (textual || !parseQueryValue(lexer, predicate->column, &predicate->low, predicate->text)
+            || !acceptQueryToken(lexer, "and")
+            || !parseQueryValue(lexer, predicate->column, &predicate->high, predicate->text)) {
+            snprintf(error, errorSize, "expected BETWEEN <value> AND <value> on a numeric or time column");
+            return 0;
+        }
+        return 1;
+    }
+
+    static const char* symbols[] = { "=", "!=", "<", "<=", ">", ">=", "~" };
+    predicate->op = -1;
+    for (int op = QOP_EQ; op <= QOP_CONTAINS; op++) {
+        if (lexer->kind == TOKEN_SYMBOL && strcmp(lexer->token, symbols[op]) == 0) {
+            predicate->op = op;
+        }
+    }
+    if (predicate->op < 0) {
+        snprintf(error, errorSize, "expected a comparison operator, found '%s'", lexer->token);
+        return 0;
+    }
+    if (textual && predicate->op != QOP_EQ && predicate->op != QOP_NE && predicate->op != QOP_CONTAINS) {
+        snprintf(error, errorSize, "area and type only support =, != and ~");
+        return 0;
+    }
+    if (!textual && predicate->op == QOP_CONTAINS) {
+        snprintf(error, errorSize, "~ only applies to area and type");
+        return 0;
+    }
+    nextQueryToken(lexer);
+
+    if (!parseQueryValue(lexer, predicate->column, &predicate->low, predicate->text)) {
+        snprintf(error, errorSize, "invalid value '%s' (use 'text' for area/type, HH:MM for time)", lexer->token);
+        return 0;
+    }
+    return 1;
+}
+
+// Parse a query and compile it into a plan of operators; returns 0 and fills error on failure
+int parseQuery(const char* text, struct QueryPlan* plan, char* error, size_t errorSize) {
+    struct QueryLexer lexer;
+    lexer.cursor = text;
+    nextQueryToken(&lexer);
+
+    memset(plan, 0, sizeof(*plan));
+    plan->groupBy = -1;
+    plan->orderBy = -1;
+    plan->limit = -1;
+    plan->timeoutMs = -1;
+    plan->asOf = -1;
+
+    if (!acceptQueryToken(&lexer, "select")) {
+        snprintf(error, errorSize, "queries start with SELECT");
+        return 0;
+    }
+
+    // Select list
+    if (acceptQueryToken(&lexer, "*")) {
+        for (int column = 0; column < QCOL_COUNT; column++) {
+            plan->items[plan->itemCount++] = column;
+        }
+    } else {
+        do {
+            if (plan->itemCount == MAX_QUERY_ITEMS) {
+                snprintf(error, errorSize, "too many columns (max %d)", MAX_QUERY_ITEMS);
+                return 0;
+            }
+            int item = parseQueryItem(&lexer);
+            if (item < 0) {
+                snprintf(error, errorSize, "expected a column or count(*), found '%s'", lexer.token);
+                return 0;
+            }
+            plan->aggregate |= item == QCOL_COUNT;
+            plan->items[plan->itemCount++] = item;
+        } while (acceptQueryToken(&lexer, ","));
+    }
+
+    // The store holds a single table, so FROM is optional
+    if (acceptQueryToken(&lexer, "from") && !acceptQueryToken(&lexer, "incidents")) {
+        snprintf(error, errorSize, "the only table is 'incidents'");
+        return 0;
+    }
+
+    // AS OF reads the incidents as they were at a past moment
+    if (acceptQueryToken(&lexer, "as")) {
+        if (!acceptQueryToken(&lexer, "of") || !parseSnapshotTime(&lexer, &plan->asOf)) {
+            snprintf(error, errorSize, "expected AS OF 'YYYY-MM-DD [HH:MM[:SS]]' or AS OF <seconds since 1970>");
+            return 0;
+        }
+    }
+
+    if (acceptQueryToken(&lexer, "where")) {
+        do {
+            if (plan->predicateCount == MAX_QUERY_PREDICATES) {
+                snprintf(error, errorSize, "too many conditions (max %d)", MAX_QUERY_PREDICATES);
+                return 0;
+            }
+            if (!parseQueryPredicate(&lexer, &plan->predicates[plan->predicateCount], error, errorSize)) {
+                return 0;
+            }
+            plan->predicateCount++;
+        } while (acceptQueryToken(&lexer, "and"));
+    }
+
+    if (acceptQueryToken(&lexer, "group")) {
+        if (!acceptQueryToken(&lexer, "by") || (plan->groupBy = parseQueryItem(&lexer)) < 0
+            || plan->groupBy == QCOL_COUNT) {
+            snprintf(error, errorSize, "expected GROUP BY <column>");
+            return 0;
+        }
+    }
+
+    if (acceptQueryToken(&lexer, "order")) {
+        if (!acceptQueryToken(&lexer, "by")) {
+            snprintf(error, errorSize, "expected ORDER BY");
+            return 0;
+        }
+        int position;
+        char extra;
+        if (lexer.kind == TOKEN_NUMBER && sscanf(lexer.token, "%d%c", &position, &extra) == 1) {
+            // ORDER BY <n> refers to the n-th selected column
+            if (position < 1 || position > plan->itemCount) {
+                snprintf(error, errorSize, "ORDER BY position must be between 1 and %d", plan->itemCount);
+                return 0;
+            }
+            plan->orderBy = plan->items[position - 1];
+            nextQueryToken(&lexer);
+        } else if ((plan->orderBy = parseQueryItem(&lexer)) < 0) {
+            snprintf(error, errorSize, "expected ORDER BY <column or position>");
+            return 0;
+        }
+        if (acceptQueryToken(&lexer, "desc")) {
+            plan->orderDesc = 1;
+        } else {
+            acceptQueryToken(&lexer, "asc");
+        }
+    }
+
+    if (acceptQueryToken(&lexer, "limit")) {
+        char extra;
+        if (lexer.kind != TOKEN_NUMBER || sscanf(lexer.token, "%ld%c", &plan->limit, &extra) != 1) {
+            snprintf(error, errorSize, "expected LIMIT <number>");
+            return 0;
+        }
+        nextQueryToken(&lexer);
+    }
+
+    if (acceptQueryToken(&lexer, "timeout")) {
+        char extra;
+        if (lexer.kind != TOKEN_NUMBER || sscanf(lexer.token, "%ld%c", &plan->timeoutMs, &extra) != 1) {
+            snprintf(error, errorSize, "expected TIMEOUT <milliseconds>");
+            return 0;
+        }
+        nextQueryToken(&lexer);
+    }
+
+    if (lexer.kind != TOKEN_END) {
+        snprintf(error, errorSize, "unexpected '%s'", lexer.token);
+        return 0;
+    }
+
+    // Grouped queries can only return the group column and the count
+    if (plan->aggregate || plan->groupBy >= 0) {
+        for (int i = 0; i < plan->itemCount; i++) {
+            if (plan->items[i] != QCOL_COUNT && plan->items[i] != plan->groupBy) {
+                snprintf(error, errorSize, "with count(*) or GROUP BY, select only the grouped column and count(*)");
+                return 0;
+            }
+        }
+        if (plan->orderBy >= 0 && plan->orderBy != QCOL_COUNT && plan->orderBy != plan->groupBy) {
+            snprintf(error, errorSize, "grouped queries can only be ordered by the grouped column or count(*)");
+            return 0;
+        }
+    } else if (plan->orderBy == QCOL_COUNT) {
+        snprintf(error, errorSize, "ORDER BY count(*) needs count(*) in the select list");
+        return 0;
+    }
+
+    // Compile the operator pipeline: scan, filters, aggregate, sort, limit
+    plan->operators[plan->operatorCount++].kind = PLAN_SCAN;
+    for (int p = 0; p < plan->predicateCount; p++) {
+        plan->operators[plan->operatorCount].kind = PLAN_FILTER;
+        plan->operators[plan->operatorCount++].predicate = p;
+    }
+    if (plan->aggregate || plan->groupBy >= 0) {
+        plan->operators[plan->operatorCount++].kind = PLAN_AGGREGATE;
+    }
+    if (plan->orderBy >= 0) {
+        plan->operators[plan->operatorCount++].kind = PLAN_SORT;
+    }
+    if (plan->limit >= 0) {
+        plan->operators[plan->operatorCount++].kind = PLAN_LIMIT;
+    }
+    return 1;
+}
+
+// Read an AS OF time: a quoted local date and time, or seconds since the epoch; returns 0 if malformed
+int parseSnapshotTime(struct QueryLexer* lexer, long* snapshot) {
+    if (lexer->kind == TOKEN_NUMBER) {
+        char extra;
+        if (sscanf(lexer->token, "%ld%c", snapshot, &extra) != 1) {
+            return 0;
+        }
+        nextQueryToken(lexer);
+        return 1;
+    }
+    if (lexer->kind != TOKEN_STRING) {
+        return 0;
+    }
+
+    // Each accepted form must use up the whole string, so "2024-05-01x" or "10:30junk" are refused
+    struct tm when;
+    memset(&when, 0, sizeof(when));
+    int length = (int)strlen(lexer->token);
+    int used = -1;
+    sscanf(lexer->token, "%d-%d-%d%n", &when.tm_year, &when.tm_mon, &when.tm_mday, &used);
+    if (used != length) {
+        used = -1;
+        sscanf(lexer->token, "%d-%d-%d %d:%d%n", &when.tm_year, &when.tm_mon, &when.tm_mday,
+               &when.tm_hour, &when.tm_min, &used);
+    }
+    if (used != length) {
+        used = -1;
+        sscanf(lexer->token, "%d-%d-%d %d:%d:%d%n", &when.tm_year, &when.tm_mon, &when.tm_mday,
+               &when.tm_hour, &when.tm_min, &when.tm_sec, &used);
+    }
+    if (used != length) {
+        return 0;
+    }
+
+    // mktime would roll "2024-13-45" over into a later date, so out-of-range fields are refused first
+    int month = when.tm_mon, day = when.tm_mday;
+    if (month < 1 || month > 12 || day < 1 || day > 31 || when.tm_hour < 0 || when.tm_hour > 23
+        || when.tm_min < 0 || when.tm_min > 59 || when.tm_sec < 0 || when.tm_sec > 59) {
+        return 0;
+    }
+    when.tm_year -= 1900;
+    when.tm_mon -= 1;
+    when.tm_isdst = -1;
+    time_t seconds = mktime(&when);
+    // A day past the end of its month, such as February 30, comes back normalized into the next month
+    if (seconds == (time_t)-1 || when.tm_mon != month - 1 || when.tm_mday != day) {
+        return 0;
+    }
+    *snapshot = (long)seconds;
+    nextQueryToken(lexer);
+    return 1;
+}
+
+// Run a compiled plan over the store; returns the number of result rows (-1 if out of memory)
+int executeQuery(const struct QueryPlan* plan, struct QueryRow** rowsOut, struct QueryProfile* profile,
+                 struct ScanControl* control) {
+    int grouped = plan->aggregate || plan->groupBy >= 0;
+    int rowCount = 0;
+    int rowCapacity = 0;
+    struct QueryRow* rows = NULL;
+    int* groupTable = NULL;
+    int groupTableSize = 0;
+    unsigned char* dictionaryMasks[MAX_QUERY_PREDICATES] = { NULL };
+    int status = 0;
+
+    // Operator positions in the plan, for attributing profile figures
+    int filterOperator[MAX_QUERY_PREDICATES];
+    int aggregateOperator = -1, sortOperator = -1, limitOperator = -1;
+    for (int o = 0; o < plan->operatorCount; o++) {
+        switch (plan->operators[o].kind) {
+            case PLAN_FILTER: filterOperator[plan->operators[o].predicate] = o; break;
+            case PLAN_AGGREGATE: aggregateOperator = o; break;
+            case PLAN_SORT: sortOperator = o; break;
+            case PLAN_LIMIT: limitOperator = o; break;
+        }
+    }
+    if (profile != NULL) {
+        memset(profile, 0, sizeof(*profile));
+        profile->rollupCells = -1;
+    }
+    querySnapshot = plan->asOf;
+    double clockMark = profile != NULL ? monotonicSeconds() : 0.0;
+    long examined[MAX_QUERY_PREDICATES] = { 0 };
+    long matched[MAX_QUERY_PREDICATES] = { 0 };
+    int* candidates = NULL;
+    const int* positions = NULL; // Positions to scan, NULL for the whole store
+
+    // A global count(*) over area, type and time filters is read from the rollup cube without a scan
+    long cubeCount;
+    int cubeCells = rollupCubeLookup(plan, &cubeCount);
+    if (cubeCells >= 0) {
+        if (control != NULL) {
+            control->sampled = 0;
+        }
+        rows = malloc(sizeof(struct QueryRow));
+        if (rows == NULL) {
+            status = -1;
+            goto done;
+        }
+        rows[0].position = -1;
+        rows[0].count = cubeCount;
+        rowCount = plan->limit == 0 ? 0 : 1;
+        if (profile != NULL) {
+            profile->rollupCells = cubeCells;
+            profile->indexedPredicate = -1;
+            planPredicateOrder(plan, -1, profile->filterOrder);
+            profile->operators[0].bytes = (long)cubeCells * sizeof(struct RollupCell);
+            profile->operators[aggregateOperator].rowsOut = 1;
+            if (limitOperator >= 0) {
+                profile->operators[limitOperator].rowsIn = 1;
+                profile->operators[limitOperator].rowsOut = rowCount;
+            }
+            chargeOperatorTime(&profile->operators[0], clockMark);
+        }
+        goto done;
+    }
+
+    // Bind text predicates to their dictionary once, so the scan only looks up a mask
+    for (int p = 0; p < plan->predicateCount; p++) {
+        if (plan->predicates[p].column == QCOL_TYPE) {
+            dictionaryMasks[p] = malloc(incidentTypeCount > 0 ? incidentTypeCount : 1);
+            if (dictionaryMasks[p] == NULL) {
+                status = -1;
+                goto done;
+            }
+            int matches = 0;
+            for (int t = 0; t < incidentTypeCount; t++) {
+                dictionaryMasks[p][t] = (unsigned char)matchTextPredicate(&plan->predicates[p], incidentTypes[t]);
+                matches += dictionaryMasks[p][t];
+            }
+            if (profile != NULL) {
+                profile->operators[filterOperator[p]].dictionaryMatches = matches;
+                profile->operators[filterOperator[p]].bytes += (long)incidentTypeCount * MAX_TYPE_LENGTH;
+            }
+        } else if (plan->predicates[p].column == QCOL_AREA) {
+            dictionaryMasks[p] = malloc(areaKeyCount > 0 ? areaKeyCount : 1);
+            if (dictionaryMasks[p] == NULL) {
+                status = -1;
+                goto done;
+            }
+            int matches = 0;
+            for (int area = 0; area < areaKeyCount; area++) {
+                dictionaryMasks[p][area] = (unsigned char)matchTextPredicate(&plan->predicates[p], areaKeys[area]);
+                matches += dictionaryMasks[p][area];
+            }
+            if (profile != NULL) {
+                profile->operators[filterOperator[p]].dictionaryMatches = matches;
+                profile->operators[filterOperator[p]].bytes += (long)areaKeyCount * MAX_AREA_LENGTH;
+            }
+        }
+    }
+
+    // Access path: the reservoir sample in approximate mode, else an adaptive index can narrow the scan
+    int sampled = control != NULL && control->sampled;
+    int indexedPredicate = sampled ? -1 : chooseIndexPredicate(plan, NULL);
+    int scanCount = incidentCount;
+    if (sampled) {
+        // Scan the sample in store order so streamed rows and LIMIT behave as on the full store
+        if (!reservoirOrderedValid) {
+            if (reservoirOrdered == NULL) {
+                reservoirOrdered = malloc(RESERVOIR_SIZE * sizeof(int));
+                if (reservoirOrdered == NULL) {
+                    status = -1;
+                    goto done;
+                }
+            }
+            memcpy(reservoirOrdered, reservoir, (size_t)reservoirCount * sizeof(int));
+            qsort(reservoirOrdered, (size_t)reservoirCount, sizeof(int), compareInts);
+            reservoirOrderedValid = 1;
+        }
+        positions = reservoirOrdered;
+        scanCount = reservoirCount;
+        if (profile != NULL) {
+            profile->sampleRows = reservoirCount;
+        }
+    } else if (indexedPredicate >= 0) {
+        scanCount = collectIndexCandidates(&plan->predicates[indexedPredicate], &candidates);
+        if (scanCount < 0) {
+            indexedPredicate = -1;
+            scanCount = incidentCount;
+        } else {
+            positions = candidates;
+            adaptiveIndexes[plan->predicates[indexedPredicate].column].lastUsed = querySequence + 1;
+            examined[indexedPredicate] = matched[indexedPredicate] = scanCount;
+            if (profile != NULL) {
+                struct OperatorProfile* stats = &profile->operators[filterOperator[indexedPredicate]];
+                stats->rowsIn = stats->rowsOut = scanCount;
+                stats->bytes = (long)scanCount * sizeof(int);
+            }
+        }
+    }
+    int order[MAX_QUERY_PREDICATES];
+    planPredicateOrder(plan, indexedPredicate, order);
+    if (profile != NULL) {
+        profile->indexedPredicate = indexedPredicate;
+        memcpy(profile->filterOrder, order, sizeof(order));
+    }
+
+    int selection[QUERY_BATCH_SIZE];
+    for (int start = 0; start < scanCount && !scanStopped(control); start += QUERY_BATCH_SIZE) {
+        // Scan: the next batch of positions
+        int selected = scanCount - start < QUERY_BATCH_SIZE ? scanCount - start : QUERY_BATCH_SIZE;
+        for (int i = 0; i < selected; i++) {
+            selection[i] = positions != NULL ? positions[start + i] : start + i;
+        }
+        if (profile != NULL) {
+            profile->operators[0].rowsIn += selected;
+        }
+
+        // A snapshot only sees incidents reported by its time
+        if (plan->asOf >= 0) {
+            int visible = 0;
+            for (int i = 0; i < selected; i++) {
+                selection[visible] = selection[i];
+                visible += incidentCold[selection[i]].reported <= plan->asOf;
+            }
+            selected = visible;
+        }
+        if (profile != NULL) {
+            profile->operators[0].rowsOut += selected;
+            clockMark = chargeOperatorTime(&profile->operators[0], clockMark);
+        }
+
+        // Filters narrow the selection vector in place
+        for (int f = 0; f < plan->predicateCount && selected > 0; f++) {
+            int p = order[f];
+            if (p == indexedPredicate) {
+                continue;
+            }
+            int before = selected;
+            selected = filterSelection(&plan->predicates[p], dictionaryMasks[p], selection, selected);
+            examined[p] += before;
+            matched[p] += selected;
+            if (profile != NULL) {
+                struct OperatorProfile* stats = &profile->operators[filterOperator[p]];
+                stats->rowsIn += before;
+                stats->rowsOut += selected;
+                stats->bytes += (long)before * (long)sizeof(struct IncidentHot);
+                clockMark = chargeOperatorTime(stats, clockMark);
+            }
+        }
+
+        if (grouped) {
+            if (!aggregateSelection(plan, selection, selected, &rows, &rowCount, &rowCapacity,
+                                    &groupTable, &groupTableSize)) {
+                status = -1;
+                goto done;
+            }
+            if (profile != NULL) {
+                struct OperatorProfile* stats = &profile->operators[aggregateOperator];
+                stats->rowsIn += selected;
+                stats->bytes += plan->groupBy >= 0 ? (long)selected * (long)sizeof(struct IncidentHot) : 0;
+                clockMark = chargeOperatorTime(stats, clockMark);
+            }
+            continue;
+        }
+
+        if (rowCount + selected > rowCapacity) {
+            int newCapacity = rowCapacity == 0 ? QUERY_BATCH_SIZE : rowCapacity;
+            while (newCapacity < rowCount + selected) {
+                newCapacity *= 2;
+            }
+            struct QueryRow* grown = realloc(rows, (size_t)newCapacity * sizeof(struct QueryRow));
+            if (grown == NULL) {
+                status = -1;
+                goto done;
+            }
+            rows = grown;
+            rowCapacity = newCapacity;
+        }
+        for (int i = 0; i < selected; i++) {
+            rows[rowCount].position = selection[i];
+            rows[rowCount++].count = 1;
+        }
+        if (control != NULL && control->stream) {
+            int final = plan->limit >= 0 && rowCount > plan->limit ? (int)plan->limit : rowCount;
+            printQueryRows(plan, &rows[control->streamedRows], final - control->streamedRows, 0);
+            fflush(stdout);
+            control->streamedRows = final;
+        }
+        if (profile != NULL) {
+            // Collecting and streaming rows is no operator's work; keep it out of the next scan batch
+            clockMark = monotonicSeconds();
+        }
+
+        // Without sorting, rows arrive in their final order and the scan can stop at the limit
+        if (plan->orderBy < 0 && plan->limit >= 0 && rowCount >= plan->limit) {
+            break;
+        }
+    }
+
+    // count(*) without GROUP BY still returns one row when nothing matched
+    if (grouped && plan->groupBy < 0 && rowCount == 0) {
+        rows = malloc(sizeof(struct QueryRow));
+        if (rows == NULL) {
+            status = -1;
+            goto done;
+        }
+        rows[0].position = -1;
+        rows[0].count = 0;
+        rowCount = 1;
+    }
+    if (profile != NULL && aggregateOperator >= 0) {
+        profile->operators[aggregateOperator].rowsOut = rowCount;
+    }
+
+    if (plan->orderBy >= 0) {
+        sortingPlan = plan;
+        qsort(rows, (size_t)rowCount, sizeof(struct QueryRow), compareQueryRows);
+        if (profile != NULL) {
+            profile->operators[sortOperator].rowsIn = profile->operators[sortOperator].rowsOut = rowCount;
+            clockMark = chargeOperatorTime(&profile->operators[sortOperator], clockMark);
+        }
+    }
+    if (profile != NULL && limitOperator >= 0) {
+        profile->operators[limitOperator].rowsIn = rowCount;
+    }
+    if (plan->limit >= 0 && rowCount > plan->limit) {
+        rowCount = (int)plan->limit;
+    }
+    if (profile != NULL && limitOperator >= 0) {
+        profile->operators[limitOperator].rowsOut = rowCount;
+        chargeOperatorTime(&profile->operators[limitOperator], clockMark);
+    }
+
+done:
+    querySnapshot = -1;
+    for (int p = 0; p < plan->predicateCount; p++) {
+        free(dictionaryMasks[p]);
+    }
+    free(groupTable);
+    free(candidates);
+    if (status < 0) {
+        free(rows);
+        return -1;
+    }
+    if (control != NULL && control->sampled) {
+        // The workload statistics count store rows, so a sample's counts are scaled up like its results
+        for (int p = 0; p < plan->predicateCount; p++) {
+            examined[p] = scaleSampleCount(examined[p]);
+            matched[p] = scaleSampleCount(matched[p]);
+        }
+    }
+    recordQueryWorkload(plan, examined, matched);
+    *rowsOut = rows;
+    return rowCount;
+}
+
+// Add the time since the last mark to an operator and return the new mark
+double chargeOperatorTime(struct OperatorProfile* stats, double mark) {
+    double now = monotonicSeconds();
+    stats->seconds += now - mark;
+    return now;
+}
+
+// Print per-column statistics used by the query planner
+void viewColumnStatistics() {
+    buildDeferredIndexes();
+    if (incidentCount == 0) {
+        printf("No incidents have been reported yet.\n");
+        return;
+    }
+
+    printf("Rows: " ANSI_COLOR_GREEN "%ld" ANSI_COLOR_RESET "\n", columnStats.rows);
+    printf("History: " ANSI_COLOR_GREEN "%d" ANSI_COLOR_RESET " superseded version%s, kept for %ld day%s\n",
+           liveVersions, liveVersions == 1 ? "" : "s", historyRetentionDays, historyRetentionDays == 1 ? "" : "s");
+    printf("Schema: version " ANSI_COLOR_GREEN "%d" ANSI_COLOR_RESET ", " ANSI_COLOR_GREEN "%d" ANSI_COLOR_RESET
+           " row%s in older segments awaiting compaction\n\n",
+           INCIDENT_SCHEMA_VERSION, legacyIncidentRows, legacyIncidentRows == 1 ? "" : "s");
+    if (restoredCheckpointRows >= 0) {
+        printf("Opened from checkpoint %s: " ANSI_COLOR_GREEN "%d" ANSI_COLOR_RESET " row%s restored, "
+               ANSI_COLOR_GREEN "%d" ANSI_COLOR_RESET " read from %s after it\n\n", checkpointPath,
+               restoredCheckpointRows, restoredCheckpointRows == 1 ? "" : "s", replayedIncidentRows, DATA_FILE);
+    }
+    printf("%-8s | %-15s | %s\n", "Column", "Distinct values", "Range");
+    printf("----------------------------------------------\n");
+    printf("%-8s | %-15d | %d - %d\n", "id", incidentCount, columnStats.minId, columnStats.maxId);
+    printf("%-8s | %-15d |\n", "area", areaKeyCount);
+    printf("%-8s | %-15d |\n", "type", incidentTypeCount);
+    printf("%-8s | %-15d |\n", "time", columnStats.timeDistinct);
+
+    printf("\nMost common areas:\n");
+    for (int i = 0; i < columnStats.areaMcv.count; i++) {
+        printf("  " ANSI_COLOR_GREEN "%-30s" ANSI_COLOR_RESET " " ANSI_COLOR_YELLOW "%ld" ANSI_COLOR_RESET "\n",
+               areaKeys[columnStats.areaMcv.values[i]], columnStats.areaMcv.counts[i]);
+    }
+    printf("\nMost common incident types:\n");
+    for (int i = 0; i < columnStats.typeMcv.count; i++) {
+        printf("  " ANSI_COLOR_RED "%-30s" ANSI_COLOR_RESET " " ANSI_COLOR_YELLOW "%ld" ANSI_COLOR_RESET "\n",
+               incidentTypes[columnStats.typeMcv.values[i]], columnStats.typeMcv.counts[i]);
+    }
+
+    printf("\nTime histogram (equi-depth, %d buckets):\n", columnStats.timeHistogram.bucketCount);
+    int lower = 0;
+    for (int b = 0; b < columnStats.timeHistogram.bucketCount; b++) {
+        int upper = columnStats.timeHistogram.upper[b];
+        printf("  " ANSI_COLOR_BLUE "%02d:%02d - %02d:%02d" ANSI_COLOR_RESET " " ANSI_COLOR_YELLOW "%ld" ANSI_COLOR_RESET "\n",
+               lower / 60, lower % 60, upper / 60, upper % 60, columnStats.timeHistogram.counts[b]);
+        lower = upper + 1;
+    }
+
+    int fenwickCells = 0;
+    for (int c = 0; c < rollupCellCount; c++) {
+        fenwickCells += rollupCells[c].fenwick != NULL;
+    }
+    if (rollupCubeValid) {
+        printf("\nRollup cube: " ANSI_COLOR_GREEN "%d" ANSI_COLOR_RESET " cells (%d as Fenwick trees)\n",
+               rollupCellCount, fenwickCells);
+    } else {
+        printf("\nRollup cube: " ANSI_COLOR_RED "disabled (out of memory)" ANSI_COLOR_RESET "\n");
+    }
+}
+
+// Rebuild all column statistics from the store, e.g. after loading
+int refreshColumnStatistics() {
+    free(columnStats.areaCounts);
+    free(columnStats.typeCounts);
+    memset(&columnStats, 0, sizeof(columnStats));
+
+    for (int position = 0; position < incidentCount; position++) {
+        if (!updateColumnStatistics(position)) {
+            return 0;
+        }
+    }
+    rebuildTimeHistogram();
+    return 1;
+}
+
+// Fold one newly stored incident into the column statistics; returns 0 if out of memory
+int updateColumnStatistics(int position) {
+    const struct IncidentHot* hot = &incidentHot[position];
+    columnStats.rows++;
+
+    if (columnStats.rows == 1 || hot->id < columnStats.minId) {
+        columnStats.minId = hot->id;
+    }
+    if (columnStats.rows == 1 || hot->id > columnStats.maxId) {
+        columnStats.maxId = hot->id;
+    }
+    columnStats.statusCounts[hot->status]++;
+
+    // Area: exact counts per area dictionary entry, plus the most common ones
+    int area = hot->areaId;
+    if (area >= columnStats.areaCapacity) {
+        int newCapacity = columnStats.areaCapacity == 0 ? 64 : columnStats.areaCapacity;
+        while (newCapacity <= area) {
+            newCapacity *= 2;
+        }
+        long* grown = realloc(columnStats.areaCounts, (size_t)newCapacity * sizeof(long));
+        if (grown == NULL) {
+            return 0;
+        }
+        memset(&grown[columnStats.areaCapacity], 0, (size_t)(newCapacity - columnStats.areaCapacity) * sizeof(long));
+        columnStats.areaCounts = grown;
+        columnStats.areaCapacity = newCapacity;
+    }
+    columnStats.areaCounts[area]++;
+    bumpMostCommonValue(&columnStats.areaMcv, area, columnStats.areaCounts[area]);
+
+    // Type: exact counts per dictionary entry
+    if (hot->typeId >= columnStats.typeCapacity) {
+        int newCapacity = columnStats.typeCapacity == 0 ? 16 : columnStats.typeCapacity;
+        while (newCapacity <= hot->typeId) {
+            newCapacity *= 2;
+        }
+        long* grown = realloc(columnStats.typeCounts, (size_t)newCapacity * sizeof(long));
+        if (grown == NULL) {
+            return 0;
+        }
+        memset(&grown[columnStats.typeCapacity], 0, (size_t)(newCapacity - columnStats.typeCapacity) * sizeof(long));
+        columnStats.typeCounts = grown;
+        columnStats.typeCapacity = newCapacity;
+    }
+    columnStats.typeCounts[hot->typeId]++;
+    bumpMostCommonValue(&columnStats.typeMcv, hot->typeId, columnStats.typeCounts[hot->typeId]);
+
+    // Time: distinct minutes and the histogram bucket holding this one
+    int minute = hot->timeMinutes;
+    if (!(columnStats.timeSeen[minute / 8] & (1 << (minute % 8)))) {
+        columnStats.timeSeen[minute / 8] |= (unsigned char)(1 << (minute % 8));
+        columnStats.timeDistinct++;
+    }
+    struct TimeHistogram* histogram = &columnStats.timeHistogram;
+    if (histogram->bucketCount > 0) {
+        int bucket = 0;
+        while (histogram->upper[bucket] < minute) {
+            bucket++;
+        }
+        histogram->counts[bucket]++;
+
+        // Rebuild once the data has doubled, or when a bucket has drifted far from the target depth. A bucket of
+        // a single minute cannot be split, and drift rebuilds are spaced out so a hot minute stays linear to load
+        long depth = columnStats.rows / histogram->bucketCount + 1;
+        int lower = bucket == 0 ? 0 : histogram->upper[bucket - 1] + 1;
+        int drifted = histogram->counts[bucket] > 3 * depth && lower < histogram->upper[bucket]
+                      && columnStats.rows >= histogram->builtRows + histogram->builtRows / HISTOGRAM_REBUILD_SPACING;
+        if (columnStats.rows >= 2 * histogram->builtRows || drifted) {
+            rebuildTimeHistogram();
+        }
+    } else if (columnStats.rows >= 2 * histogram->builtRows) {
+        rebuildTimeHistogram();
+    }
+    return 1;
+}
+
+// Keep a value's new count in the most-common-values list if it ranks among the top entries
+void bumpMostCommonValue(struct MostCommonValues* mcv, int value, long count) {
+    int slot = -1;
+    for (int i = 0; i < mcv->count; i++) {
+        if (mcv->values[i] == value) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) {
+        if (mcv->count < MCV_SIZE) {
+            slot = mcv->count++;
+        } else if (count > mcv->counts[MCV_SIZE - 1]) {
+            slot = MCV_SIZE - 1;
+        } else {
+            return;
+        }
+    }
+    mcv->values[slot] = value;
+    mcv->counts[slot] = count;
+
+    // Counts only grow, so one pass of bubbling up keeps the list sorted
+    while (slot > 0 && mcv->counts[slot] > mcv->counts[slot - 1]) {
+        int swapValue = mcv->values[slot];
+        long swapCount = mcv->counts[slot];
+        mcv->values[slot] = mcv->values[slot - 1];
+        mcv->counts[slot] = mcv->counts[slot - 1];
+        mcv->values[slot - 1] = swapValue;
+        mcv->counts[slot - 1] = swapCount;
+        slot--;
+    }
+}
+
+// Recompute the equi-depth time histogram from the rows counted in the statistics so far
+void rebuildTimeHistogram() {
+    struct TimeHistogram* histogram = &columnStats.timeHistogram;
+    long minuteCounts[MINUTES_PER_DAY] = { 0 };
+    for (int position = 0; position < columnStats.rows; position++) {
+        minuteCounts[incidentHot[position].timeMinutes]++;
+    }
+
+    // Close a bucket each time it holds its share of the rows; the last bucket ends the day
+    long total = columnStats.rows;
+    long depth = total / HISTOGRAM_BUCKETS + 1;
+    long inBucket = 0;
+    histogram->bucketCount = 0;
+    for (int minute = 0; minute < MINUTES_PER_DAY; minute++) {
+        inBucket += minuteCounts[minute];
+        if ((inBucket >= depth && histogram->bucketCount < HISTOGRAM_BUCKETS - 1) || minute == MINUTES_PER_DAY - 1) {
+            histogram->upper[histogram->bucketCount] = (unsigned short)minute;
+            histogram->counts[histogram->bucketCount] = inBucket;
+            histogram->bucketCount++;
+            inBucket = 0;
+        }
+    }
+    histogram->builtRows = total > 0 ? total : 1;
+}
+
+// Estimate the fraction of rows a predicate keeps, from the column statistics
+double estimateSelectivity(const struct QueryPredicate* predicate) {
+    if (columnStats.rows == 0) {
+        return 1.0;
+    }
+    double rows = (double)columnStats.rows;
+
+    switch (predicate->column) {
+        case QCOL_AREA: {
+            if (predicate->op != QOP_CONTAINS) {
+                int area = lookupArea(predicate->text);
+                double equal = area >= 0 ? columnStats.areaCounts[area] / rows : 0.0;
+                return predicate->op == QOP_EQ ? equal : 1.0 - equal;
+            }
+            // Substring matches: exact over a small dictionary, else the most common values plus a default guess
+            if (areaKeyCount <= STATISTICS_EXACT_AREAS) {
+                long matched = 0;
+                for (int area = 0; area < areaKeyCount && area < columnStats.areaCapacity; area++) {
+                    if (strstr(areaKeys[area], predicate->text) != NULL) {
+                        matched += columnStats.areaCounts[area];
+                    }
+                }
+                return matched / rows;
+            }
+            long matched = 0, common = 0;
+            for (int i = 0; i < columnStats.areaMcv.count; i++) {
+                common += columnStats.areaMcv.counts[i];
+                if (strstr(areaKeys[columnStats.areaMcv.values[i]], predicate->text) != NULL) {
+                    matched += columnStats.areaMcv.counts[i];
+                }
+            }
+            return (matched + DEFAULT_SELECTIVITY * (columnStats.rows - common)) / rows;
+        }
+
+        case QCOL_TYPE: {
+            // The type dictionary is small, so count matches exactly
+            long matched = 0;
+            for (int t = 0; t < incidentTypeCount && t < columnStats.typeCapacity; t++) {
+                if (matchTextPredicate(predicate, incidentTypes[t])) {
+                    matched += columnStats.typeCounts[t];
+                }
+            }
+            return matched / rows;
+        }
+
+        case QCOL_TIME: {
+            long low = 0, high = MINUTES_PER_DAY - 1;
+            switch (predicate->op) {
+                case QOP_EQ: low = high = predicate->low; break;
+                case QOP_NE: return 1.0 - estimateTimeRange(predicate->low, predicate->low) / rows;
+                case QOP_LT: high = predicate->low - 1; break;
+                case QOP_LE: high = predicate->low; break;
+                case QOP_GT: low = predicate->low + 1; break;
+                case QOP_GE: low = predicate->low; break;
+                default: low = predicate->low; high = predicate->high; break;
+            }
+            return estimateTimeRange(low, high) / rows;
+        }
+
+        case QCOL_STATUS: {
+            long equal = predicate->low >= 0 && predicate->low < MAX_STATUS_VALUES
+                         ? columnStats.statusCounts[predicate->low] : 0;
+            if (predicate->op == QOP_EQ) {
+                return equal / rows;
+            }
+            return predicate->op == QOP_NE ? 1.0 - equal / rows : DEFAULT_SELECTIVITY;
+        }
+
+        case QCOL_PRIORITY: {
+            // No per-priority counts are kept; treat the priority levels as equally likely
+            double levels = PRIORITY_CRITICAL - PRIORITY_LOW + 1;
+            double low = PRIORITY_LOW, high = PRIORITY_CRITICAL;
+            switch (predicate->op) {
+                case QOP_EQ: return 1.0 / levels;
+                case QOP_NE: return 1.0 - 1.0 / levels;
+                case QOP_LT: high = predicate->low - 1; break;
+                case QOP_LE: high = predicate->low; break;
+                case QOP_GT: low = predicate->low + 1; break;
+                case QOP_GE: low = predicate->low; break;
+                default: low = predicate->low; high = predicate->high; break;
+            }
+            low = low > PRIORITY_LOW ? low : PRIORITY_LOW;
+            high = high < PRIORITY_CRITICAL ? high : PRIORITY_CRITICAL;
+            return high >= low ? (high - low + 1) / levels : 0.0;
+        }
+
+        default: {
+            // Ids are close to uniform between the smallest and largest
+            double span = (double)columnStats.maxId - columnStats.minId + 1;
+            double low = columnStats.minId, high = columnStats.maxId;
+            switch (predicate->op) {
+                case QOP_EQ: return 1.0 / rows;
+                case QOP_NE: return 1.0 - 1.0 / rows;
+                case QOP_LT: high = predicate->low - 1; break;
+                case QOP_LE: high = predicate->low; break;
+                case QOP_GT: low = predicate->low + 1; break;
+                case QOP_GE: low = predicate->low; break;
+                default: low = predicate->low; high = predicate->high; break;
+            }
+            if (low < columnStats.minId) {
+                low = columnStats.minId;
+            }
+            if (high > columnStats.maxId) {
+                high = columnStats.maxId;
+            }
+            return high < low ? 0.0 : (high - low + 1) / span;
+        }
+    }
+}
+
+// Estimated rows with a time between two minutes (inclusive), interpolating inside histogram buckets
+double estimateTimeRange(long low, long high) {
+    const struct TimeHistogram* histogram = &columnStats.timeHistogram;
+    double rows = 0.0;
+    long bucketLow = 0;
+    for (int b = 0; b < histogram->bucketCount; b++) {
+        long bucketHigh = histogram->upper[b];
+        long overlapLow = low > bucketLow ? low : bucketLow;
+        long overlapHigh = high < bucketHigh ? high : bucketHigh;
+        if (overlapLow <= overlapHigh) {
+            rows += (double)histogram->counts[b] * (overlapHigh - overlapLow + 1) / (bucketHigh - bucketLow + 1);
+        }
+        bucketLow = bucketHigh + 1;
+    }
+    return rows;
+}
+
+// Order predicates so cheap, selective filters run first; an index-satisfied predicate leads
+void planPredicateOrder(const struct QueryPlan* plan, int indexedPredicate, int* order) {
+    double rank[MAX_QUERY_PREDICATES];
+    for (int p = 0; p < plan->predicateCount; p++) {
+        // Expected cost per row removed: comparing area text costs more than reading a hot field
+        double cost = plan->predicates[p].column == QCOL_AREA ? 4.0 : 1.0;
+        double removed = 1.0 - estimateSelectivity(&plan->predicates[p]);
+        rank[p] = p == indexedPredicate ? -1.0 : cost / (removed > 1e-6 ? removed : 1e-6);
+        order[p] = p;
+    }
+
+    // Insertion sort, at most MAX_QUERY_PREDICATES entries
+    for (int i = 1; i < plan->predicateCount; i++) {
+        int predicate = order[i];
+        int j = i - 1;
+        while (j >= 0 && rank[order[j]] > rank[predicate]) {
+            order[j + 1] = order[j];
+            j--;
+        }
+        order[j + 1] = predicate;
+    }
+}
+
+// Pick the predicate whose adaptive index yields the fewest candidate rows (-1 for a full scan)
+int chooseIndexPredicate(const struct QueryPlan* plan, long* estimate) {
+    int best = -1;
+    long bestRows = 0;
+    // Indexes hold current values, so snapshots scan
+    if (plan->asOf >= 0) {
+        return -1;
+    }
+    for (int p = 0; p < plan->predicateCount; p++) {
+        const struct AdaptiveIndex* index = &adaptiveIndexes[plan->predicates[p].column];
+        if (!index->active || index->builtCount < incidentCount) {
+            continue;
+        }
+        long rows = 0;
+        for (int list = 0; list < index->listCount; list++) {
+            if (indexListMatches(index, list, &plan->predicates[p])) {
+                rows += index->lists[list].count;
+            }
+        }
+        if (best < 0 || rows < bestRows) {
+            best = p;
+            bestRows = rows;
+        }
+    }
+
+    // Gathering and sorting candidates only pays off when they are a small part of the store
+    if (best >= 0 && bestRows * ADAPTIVE_INDEX_MAX_FRACTION > incidentCount) {
+        best = -1;
+    }
+    if (estimate != NULL) {
+        *estimate = best >= 0 ? bestRows : incidentCount;
+    }
+    return best;
+}
+
+// Check whether the key of one posting list satisfies a predicate
+int indexListMatches(const struct AdaptiveIndex* index, int list, const struct QueryPredicate* predicate) {
+    switch (index->column) {
+        case QCOL_AREA: return matchTextPredicate(predicate, index->keys[list]);
+        case QCOL_TYPE: return matchTextPredicate(predicate, incidentTypes[list]);
+        default: return matchNumberPredicate(predicate, list);
+    }
+}
+
+// Gather the positions an index holds for a predicate, in store order (-1 if out of memory)
+int collectIndexCandidates(const struct QueryPredicate* predicate, int** candidatesOut) {
+    const struct AdaptiveIndex* index = &adaptiveIndexes[predicate->column];
+    long total = 0;
+    int matchingLists = 0;
+    for (int list = 0; list < index->listCount; list++) {
+        if (indexListMatches(index, list, predicate)) {
+            total += index->lists[list].count;
+            matchingLists++;
+        }
+    }
+
+    int* candidates = malloc((size_t)(total > 0 ? total : 1) * sizeof(int));
+    if (candidates == NULL) {
+        return -1;
+    }
+    int count = 0;
+    for (int list = 0; list < index->listCount; list++) {
+        if (indexListMatches(index, list, predicate)) {
+            memcpy(&candidates[count], index->lists[list].positions,
+                   (size_t)index->lists[list].count * sizeof(int));
+            count += index->lists[list].count;
+        }
+    }
+
+    // Each list is already in store order; several lists need merging back into it
+    if (matchingLists > 1) {
+        qsort(candidates, (size_t)count, sizeof(int), compareInts);
+    }
+    *candidatesOut = candidates;
+    return count;
+}
+
+// qsort comparator for ascending ints
+int compareInts(const void* first, const void* second) {
+    int a = *(const int*)first;
+    int b = *(const int*)second;
+    return (a > b) - (a < b);
+}
+
+// Record how a query's predicates behaved, then create or drop adaptive indexes accordingly
+void recordQueryWorkload(const struct QueryPlan* plan, const long* examined, const long* matched) {
+    querySequence++;
+    for (int p = 0; p < plan->predicateCount; p++) {
+        struct PredicateStats* stats = &predicateStats[plan->predicates[p].column];
+        stats->uses++;
+        stats->rowsExamined += examined[p];
+        stats->rowsMatched += matched[p];
+    }
+
+    // Drop indexes that the recent workload no longer uses
+    for (int column = 0; column < QCOL_COUNT; column++) {
+        if (adaptiveIndexes[column].active
+            && querySequence - adaptiveIndexes[column].lastUsed > ADAPTIVE_INDEX_IDLE_QUERIES) {
+            dropAdaptiveIndex(column);
+        }
+    }
+
+    // Index columns that are filtered often, scan many rows and keep few of them
+    for (int p = 0; p < plan->predicateCount; p++) {
+        int column = plan->predicates[p].column;
+        const struct PredicateStats* stats = &predicateStats[column];
+        if (adaptiveIndexes[column].active || (column != QCOL_AREA && column != QCOL_TYPE && column != QCOL_TIME)) {
+            continue;
+        }
+        if (stats->uses < ADAPTIVE_INDEX_MIN_USES || stats->rowsExamined == 0
+            || stats->rowsExamined / stats->uses < ADAPTIVE_INDEX_MIN_ROWS
+            || (double)stats->rowsMatched / (double)stats->rowsExamined > ADAPTIVE_INDEX_MAX_SELECTIVITY) {
+            continue;
+        }
+
+        // Make room within the memory budget by dropping the least recently used indexes
+        size_t needed = (size_t)incidentCount * sizeof(int);
+        while (adaptiveIndexMemory() + needed > ADAPTIVE_INDEX_MEMORY_BUDGET) {
+            int victim = -1;
+            for (int other = 0; other < QCOL_COUNT; other++) {
+                if (adaptiveIndexes[other].active
+                    && (victim < 0 || adaptiveIndexes[other].lastUsed < adaptiveIndexes[victim].lastUsed)) {
+                    victim = other;
+                }
+            }
+            if (victim < 0) {
+                break;
+            }
+            dropAdaptiveIndex(victim);
+        }
+        if (adaptiveIndexMemory() + needed > ADAPTIVE_INDEX_MEMORY_BUDGET) {
+            continue;
+        }
+
+        // The index is filled a chunk at a time by maintainAdaptiveIndexes
+        memset(&adaptiveIndexes[column], 0, sizeof(struct AdaptiveIndex));
+        adaptiveIndexes[column].active = 1;
+        adaptiveIndexes[column].column = column;
+        adaptiveIndexes[column].lastUsed = querySequence;
+    }
+}
+
+// Index a bounded chunk of rows for every index still being built; called between user actions
+void maintainAdaptiveIndexes() {
+    for (int column = 0; column < QCOL_COUNT; column++) {
+        struct AdaptiveIndex* index = &adaptiveIndexes[column];
+        if (!index->active) {
+            continue;
+        }
+        int end = index->builtCount + ADAPTIVE_INDEX_BUILD_CHUNK;
+        if (end > incidentCount) {
+            end = incidentCount;
+        }
+        while (index->builtCount < end) {
+            if (!addToAdaptiveIndex(index, index->builtCount)) {
+                dropAdaptiveIndex(column);
+                break;
+            }
+        }
+        if (index->active && adaptiveIndexMemory() > ADAPTIVE_INDEX_MEMORY_BUDGET) {
+            dropAdaptiveIndex(column);
+        }
+    }
+}
+
+// Add the incident at the next unindexed position to an index; returns 0 if out of memory
+int addToAdaptiveIndex(struct AdaptiveIndex* index, int position) {
+    int list;
+    if (index->column == QCOL_AREA) {
+        char key[MAX_AREA_LENGTH];
+        toLowerCopy(key, incidentCold[position].area, sizeof(key));
+        list = findAreaIndexList(index, key);
+    } else {
+        list = (int)queryColumnValue(index->column, position);
+    }
+    if (list < 0) {
+        return 0;
+    }
+
+    // Type and time lists are addressed directly by type id or minute
+    if (list >= index->listCount) {
+        if (list >= index->listCapacity) {
+            int newCapacity = index->listCapacity == 0 ? 64 : index->listCapacity;
+            while (newCapacity <= list) {
+                newCapacity *= 2;
+            }
+            struct PostingList* grown = realloc(index->lists, (size_t)newCapacity * sizeof(struct PostingList));
+            if (grown == NULL) {
+                return 0;
+            }
+            index->lists = grown;
+            index->memoryBytes += (size_t)(newCapacity - index->listCapacity) * sizeof(struct PostingList);
+            index->listCapacity = newCapacity;
+        }
+        memset(&index->lists[index->listCount], 0,
+               (size_t)(list + 1 - index->listCount) * sizeof(struct PostingList));
+        index->listCount = list + 1;
+    }
+
+    struct PostingList* postings = &index->lists[list];
+    if (postings->count == postings->capacity) {
+        int newCapacity = postings->capacity == 0 ? 8 : postings->capacity * 2;
+        int* grown = realloc(postings->positions, (size_t)newCapacity * sizeof(int));
+        if (grown == NULL) {
+            return 0;
+        }
+        postings->positions = grown;
+        index->memoryBytes += (size_t)(newCapacity - postings->capacity) * sizeof(int);
+        postings->capacity = newCapacity;
+    }
+    postings->positions[postings->count++] = position;
+    index->builtCount = position + 1;
+    return 1;
+}
+
+// Find the posting list of an area key, creating an empty one for a new key (-1 if out of memory)
+int findAreaIndexList(struct AdaptiveIndex* index, const char* key) {
+    if ((index->listCount + 1) * 2 > index->keyTableSize) {
+        int newSize = index->keyTableSize == 0 ? 256 : index->keyTableSize * 2;
+        int* table = malloc((size_t)newSize * sizeof(int));
+        if (table == NULL) {
+            return -1;
+        }
+        for (int i = 0; i < newSize; i++) {
+            table[i] = -1;
+        }
+        for (int list = 0; list < index->listCount; list++) {
+            int slot = (int)(hashString(index->keys[list]) & (unsigned int)(newSize - 1));
+            while (table[slot] >= 0) {
+                slot = (slot + 1) & (newSize - 1);
+            }
+            table[slot] = list;
+        }
+        free(index->keyTable);
+        index->memoryBytes += (size_t)(newSize - index->keyTableSize) * sizeof(int);
+        index->keyTable = table;
+        index->keyTableSize = newSize;
+    }
+
+    int slot = (int)(hashString(key) & (unsigned int)(index->keyTableSize - 1));
+    while (index->keyTable[slot] >= 0) {
+        if (strcmp(index->keys[index->keyTable[slot]], key) == 0) {
+            return index->keyTable[slot];
+        }
+        slot = (slot + 1) & (index->keyTableSize - 1);
+    }
+
+    // New key: grow the key array alongside the posting lists
+    int list = index->listCount;
+    if (list >= index->listCapacity) {
+        int newCapacity = index->listCapacity == 0 ? 64 : index->listCapacity * 2;
+        struct PostingList* lists = realloc(index->lists, (size_t)newCapacity * sizeof(struct PostingList));
+        if (lists == NULL) {
+            return -1;
+        }
+        index->lists = lists;
+        char (*keys)[MAX_AREA_LENGTH] = realloc(index->keys, (size_t)newCapacity * MAX_AREA_LENGTH);
+        if (keys == NULL) {
+            return -1;
+        }
+        index->keys = keys;
+        index->memoryBytes += (size_t)(newCapacity - index->listCapacity)
+                              * (sizeof(struct PostingList) + MAX_AREA_LENGTH);
+        index->listCapacity = newCapacity;
+    }
+    memset(&index->lists[list], 0, sizeof(struct PostingList));
+    strcpy(index->keys[list], key);
+    index->keyTable[slot] = list;
+    index->listCount++;
+    return list;
+}
+
+// Free an adaptive index and mark its column as unindexed
+void dropAdaptiveIndex(int column) {
+    struct AdaptiveIndex* index = &adaptiveIndexes[column];
+    for (int list = 0; list < index->listCount; list++) {
+        free(index->lists[list].positions);
+    }
+    free(index->lists);
+    free(index->keys);
+    free(index->keyTable);
+    memset(index, 0, sizeof(*index));
+}
+
+// Memory held by all adaptive indexes
+size_t adaptiveIndexMemory() {
+    size_t total = 0;
+    for (int column = 0; column < QCOL_COUNT; column++) {
+        total += adaptiveIndexes[column].memoryBytes;
+    }
+    return total;
+}
+
+// Keep only the selected positions that satisfy a predicate; returns the new selection size
+int filterSelection(const struct QueryPredicate* predicate, const unsigned char* dictionaryMask,
+                    int* selection, int selected) {
+    int kept = 0;
+    // Every loop writes the position and advances by the match, so no row takes a data-dependent branch
+    switch (predicate->column) {
+        case QCOL_TYPE:
+            for (int i = 0; i < selected; i++) {
+                int position = selection[i];
+                selection[kept] = position;
+                kept += dictionaryMask[incidentHot[position].typeId];
+            }
+            return kept;
+
+        case QCOL_AREA:
+            for (int i = 0; i < selected; i++) {
+                int position = selection[i];
+                selection[kept] = position;
+                kept += dictionaryMask[incidentHot[position].areaId];
+            }
+            return kept;
+    }
+
+    // Numeric operators become a closed range, inverted for "!="
+    long low, high;
+    int invert;
+    numberPredicateRange(predicate, &low, &high, &invert);
+    switch (predicate->column) {
+        case QCOL_ID:
+            for (int i = 0; i < selected; i++) {
+                int position = selection[i];
+                long value = incidentHot[position].id;
+                selection[kept] = position;
+                kept += ((value >= low) & (value <= high)) ^ invert;
+            }
+            break;
+
+        case QCOL_TIME:
+            for (int i = 0; i < selected; i++) {
+                int position = selection[i];
+                long value = incidentHot[position].timeMinutes;
+                selection[kept] = position;
+                kept += ((value >= low) & (value <= high)) ^ invert;
+            }
+            break;
+
+        default:
+            for (int i = 0; i < selected; i++) {
+                int position = selection[i];
+                long value = queryColumnValue(predicate->column, position);
+                selection[kept] = position;
+                kept += ((value >= low) & (value <= high)) ^ invert;
+            }
+            break;
+    }
+    return kept;
+}
+
+// Express a numeric predicate as a closed range, optionally inverted
+void numberPredicateRange(const struct QueryPredicate* predicate, long* low, long* high, int* invert) {
+    *low = LONG_MIN;
+    *high = LONG_MAX;
+    *invert = 0;
+    switch (predicate->op) {
+        case QOP_EQ: *low = *high = predicate->low; break;
+        case QOP_NE: *low = *high = predicate->low; *invert = 1; break;
+        case QOP_LT:
+            if (predicate->low == LONG_MIN) {
+                // Nothing is below the smallest value: an inverted full range
+                *invert = 1;
+            } else {
+                *high = predicate->low - 1;
+            }
+            break;
+        case QOP_LE: *high = predicate->low; break;
+        case QOP_GT:
+            if (predicate->low == LONG_MAX) {
+                *invert = 1;
+            } else {
+                *low = predicate->low + 1;
+            }
+            break;
+        case QOP_GE: *low = predicate->low; break;
+        default: *low = predicate->low; *high = predicate->high; break;
+    }
+}
+
+// Evaluate a text predicate (case insensitive) against one value
+int matchTextPredicate(const struct QueryPredicate* predicate, const char* value) {
+    char lowered[MAX_STRING_LENGTH];
+    toLowerCopy(lowered, value, sizeof(lowered));
+    switch (predicate->op) {
+        case QOP_EQ: return strcmp(lowered, predicate->text) == 0;
+        case QOP_NE: return strcmp(lowered, predicate->text) != 0;
+        default: return strstr(lowered, predicate->text) != NULL;
+    }
+}
+
+// Evaluate a numeric predicate against one value
+int matchNumberPredicate(const struct QueryPredicate* predicate, long value) {
+    switch (predicate->op) {
+        case QOP_EQ: return value == predicate->low;
+        case QOP_NE: return value != predicate->low;
+        case QOP_LT: return value < predicate->low;
+        case QOP_LE: return value <= predicate->low;
+        case QOP_GT: return value > predicate->low;
+        case QOP_GE: return value >= predicate->low;
+        default: return value >= predicate->low && value <= predicate->high;
+    }
+}
+
+// Numeric value of a hot column at a position
+long queryColumnValue(int column, int position) {
+    switch (column) {
+        case QCOL_ID: return incidentHot[position].id;
+        case QCOL_TIME: return incidentHot[position].timeMinutes;
+        case QCOL_STATUS: return querySnapshot < 0 ? incidentHot[position].status
+                                                   : incidentStatusAsOf(position, querySnapshot);
+        case QCOL_PRIORITY: return querySnapshot < 0 ? incidentHot[position].priority
+                                                     : incidentPriorityAsOf(position, querySnapshot);
+        default: return incidentHot[position].typeId;
+    }
+}
+
+// Count the selected rows into groups, keyed by the grouped column's value
+int aggregateSelection(const struct QueryPlan* plan, const int* selection, int selected,
+                       struct QueryRow** rows, int* rowCount, int* rowCapacity,
+                       int** groupTable, int* groupTableSize) {
+    // Without GROUP BY everything falls into a single group
+    if (plan->groupBy < 0) {
+        if (*rowCount == 0 && selected > 0) {
+            *rows = malloc(sizeof(struct QueryRow));
+            if (*rows == NULL) {
+                return 0;
+            }
+            (*rows)[0].position = -1;
+            (*rows)[0].count = 0;
+            *rowCount = *rowCapacity = 1;
+        }
+        if (selected > 0) {
+            (*rows)[0].count += selected;
+        }
+        return 1;
+    }
+
+    for (int i = 0; i < selected; i++) {
+        int position = selection[i];
+
+        // Keep the group table at most half full
+        if ((*rowCount + 1) * 2 > *groupTableSize) {
+            int newSize = *groupTableSize == 0 ? 256 : *groupTableSize * 2;
+            int* table = malloc((size_t)newSize * sizeof(int));
+            if (table == NULL) {
+                return 0;
+            }
+            for (int s = 0; s < newSize; s++) {
+                table[s] = -1;
+            }
+            for (int g = 0; g < *rowCount; g++) {
+                int slot = (int)(groupHash(plan->groupBy, (*rows)[g].position) & (unsigned int)(newSize - 1));
+                while (table[slot] >= 0) {
+                    slot = (slot + 1) & (newSize - 1);
+                }
+                table[slot] = g;
+            }
+            free(*groupTable);
+            *groupTable = table;
+            *groupTableSize = newSize;
+        }
+
+        int slot = (int)(groupHash(plan->groupBy, position) & (unsigned int)(*groupTableSize - 1));
+        while ((*groupTable)[slot] >= 0
+               && !sameGroup(plan->groupBy, (*rows)[(*groupTable)[slot]].position, position)) {
+            slot = (slot + 1) & (*groupTableSize - 1);
+        }
+
+        if ((*groupTable)[slot] >= 0) {
+            (*rows)[(*groupTable)[slot]].count++;
+            continue;
+        }
+
+        // First row of a new group becomes its representative
+        if (*rowCount == *rowCapacity) {
+            int newCapacity = *rowCapacity == 0 ? 64 : *rowCapacity * 2;
+            struct QueryRow* grown = realloc(*rows, (size_t)newCapacity * sizeof(struct QueryRow));
+            if (grown == NULL) {
+                return 0;
+            }
+            *rows = grown;
+            *rowCapacity = newCapacity;
+        }
+        (*rows)[*rowCount].position = position;
+        (*rows)[*rowCount].count = 1;
+        (*groupTable)[slot] = (*rowCount)++;
+    }
+    return 1;
+}
+
+// Hash of a column's value at a position, for grouping
+unsigned int groupHash(int column, int position) {
+    if (column == QCOL_AREA) {
+        // Areas group by their case-insensitive key, as area filters match
+        return (unsigned int)incidentHot[position].areaId * 2654435761u;
+    }
+    return (unsigned int)queryColumnValue(column, position) * 2654435761u;
+}
+
+// Check whether two positions fall into the same group
+int sameGroup(int column, int first, int second) {
+    if (column == QCOL_AREA) {
+        return incidentHot[first].areaId == incidentHot[second].areaId;
+    }
+    return queryColumnValue(column, first) == queryColumnValue(column, second);
+}
+
+// qsort comparator ordering result rows by the plan's ORDER BY column
+int compareQueryRows(const void* first, const void* second) {
+    const struct QueryRow* a = first;
+    const struct QueryRow* b = second;
+    int result;
+
+    if (sortingPlan->orderBy == QCOL_COUNT) {
+        result = (a->count > b->count) - (a->count < b->count);
+    } else if (sortingPlan->orderBy == QCOL_AREA) {
+        result = strcmp(areaKeys[incidentHot[a->position].areaId], areaKeys[incidentHot[b->position].areaId]);
+    } else if (sortingPlan->orderBy == QCOL_TYPE) {
+        result = strcmp(incidentTypes[incidentHot[a->position].typeId], incidentTypes[incidentHot[b->position].typeId]);
+    } else {
+        long x = queryColumnValue(sortingPlan->orderBy, a->position);
+        long y = queryColumnValue(sortingPlan->orderBy, b->position);
+        result = (x > y) - (x < y);
+    }
+
+    if (sortingPlan->orderDesc) {
+        result = -result;
+    }
+    // Fall back to store order so equal rows keep a stable order
+    return result != 0 ? result : (a->position > b->position) - (a->position < b->position);
+}
+
+// Print query results as a table with one column per selected item
+void printQueryHeader(const struct QueryPlan* plan) {
+    static const char* headers[] = { "ID", "Area", "Incident Type", "Time", "Status", "Priority", "Count" };
+    static const int widths[] = { 5, 30, 30, 8, 10, 8, 8 };
+
+    int lineLength = 0;
+    for (int i = 0; i < plan->itemCount; i++) {
+        printf("%s%-*s", i > 0 ? " | " : "", widths[plan->items[i]], headers[plan->items[i]]);
+        lineLength += widths[plan->items[i]] + (i > 0 ? 3 : 0);
+    }
+    printf("\n");
+    for (int i = 0; i < lineLength; i++) {
+        putchar('-');
+    }
+    printf("\n");
+}
+
+// Print query result rows in the columns of printQueryHeader; approximate counts get their interval
+void printQueryRows(const struct QueryPlan* plan, const struct QueryRow* rows, int rowCount, int approximate) {
+    static const int widths[] = { 5, 30, 30, 8, 10, 8, 8 };
+
+    for (int r = 0; r < rowCount; r++) {
+        struct Incident incident;
+        int position = rows[r].position;
+        if (position >= 0) {
+            loadIncident(position, &incident);
+        }
+        for (int i = 0; i < plan->itemCount; i++) {
+            int item = plan->items[i];
+            int width = widths[item];
+            printf("%s", i > 0 ? " | " : "");
+            switch (item) {
+                case QCOL_ID:
+                    printf("%-*d", width, incident.id);
+                    break;
+                case QCOL_AREA:
+                    printf(ANSI_COLOR_GREEN "%-*s" ANSI_COLOR_RESET, width, incident.area);
+                    break;
+                case QCOL_TYPE:
+                    printf(ANSI_COLOR_RED "%-*s" ANSI_COLOR_RESET, width, incident.type);
+                    break;
+                case QCOL_TIME:
+                    printf(ANSI_COLOR_BLUE "%-*s" ANSI_COLOR_RESET, width, incident.time);
+                    break;
+                case QCOL_STATUS:
+                    printf(ANSI_COLOR_MAGENTA "%-*s" ANSI_COLOR_RESET, width, statusName(incidentStatusAsOf(position, plan->asOf)));
+                    break;
+                case QCOL_PRIORITY:
+                    printf(ANSI_COLOR_YELLOW "%-*s" ANSI_COLOR_RESET, width,
+                           priorityName(incidentPriorityAsOf(position, plan->asOf)));
+                    break;
+                default:
+                    if (approximate) {
+                        printf(ANSI_COLOR_YELLOW "~%ld" ANSI_COLOR_RESET " \xC2\xB1 %ld",
+                               scaleSampleCount(rows[r].count), sampleMargin(rows[r].count));
+                    } else {
+                        printf(ANSI_COLOR_YELLOW "%-*ld" ANSI_COLOR_RESET, width, rows[r].count);
+                    }
+                    break;
+            }
+        }
+        printf("\n");
+    }
+}
+
+// Name of an incident status as shown to the user
+const char* statusName(int status) {
+    switch (status) {
+        case STATUS_OPEN: return "open";
+        case STATUS_DISPATCHED: return "dispatched";
+        default: return "unknown";
+    }
+}
+
+// Parse a status name (-1 if unknown)
+int parseStatusName(const char* name) {
+    char lowered[MAX_STRING_LENGTH];
+    toLowerCopy(lowered, name, sizeof(lowered));
+    if (strcmp(lowered, "open") == 0) {
+        return STATUS_OPEN;
+    }
+    if (strcmp(lowered, "dispatched") == 0) {
+        return STATUS_DISPATCHED;
+    }
+    return -1;
+}
+
+// Name of an incident priority as shown to the user
+const char* priorityName(int priority) {
+    static const char* names[] = { "low", "minor", "normal", "high", "critical" };
+    return priority >= PRIORITY_LOW && priority <= PRIORITY_CRITICAL ? names[priority - PRIORITY_LOW] : "unknown";
+}
+
+// Record a stored incident's id in the id table; returns 0 if out of memory
+int addIncidentId(int position) {
+    if ((incidentCount + 1) * 2 > idTableSize) {
+        int newSize = idTableSize == 0 ? 1024 : idTableSize;
+        while ((incidentCount + 1) * 2 > newSize) {
+            newSize *= 2;
+        }
+        int* table = malloc((size_t)newSize * sizeof(int));
+        if (table == NULL) {
+            return 0;
+        }
+        for (int i = 0; i < newSize; i++) {
+            table[i] = -1;
+        }
+        free(idTable);
+        idTable = table;
+        idTableSize = newSize;
+        // Re-add everything stored before this position; the new one is added below
+        for (int other = 0; other < position; other++) {
+            int slot = (int)((unsigned int)incidentHot[other].id * 2654435761u & (unsigned int)(newSize - 1));
+            while (idTable[slot] >= 0) {
+                slot = (slot + 1) & (newSize - 1);
+            }
+            idTable[slot] = other;
+        }
+    }
+    int slot = (int)((unsigned int)incidentHot[position].id * 2654435761u & (unsigned int)(idTableSize - 1));
+    while (idTable[slot] >= 0) {
+        slot = (slot + 1) & (idTableSize - 1);
+    }
+    idTable[slot] = position;
+    return 1;
+}
+
+// Store position of an incident id (-1 if there is none); the latest wins if an id repeats
+int findIncidentPosition(int id) {
+    int found = -1;
+    if (!idTableValid) {
+        for (int position = 0; position < incidentCount; position++) {
+            if (incidentHot[position].id == id) {
+                found = position;
+            }
+        }
+        return found;
+    }
+    int slot = (int)((unsigned int)id * 2654435761u & (unsigned int)(idTableSize - 1));
+    while (idTableSize > 0 && idTable[slot] >= 0) {
+        if (incidentHot[idTable[slot]].id == id && idTable[slot] > found) {
+            found = idTable[slot];
+        }
+        slot = (slot + 1) & (idTableSize - 1);
+    }
+    return found;
+}
+
+// Change an incident's status, keeping the planner's status counts in step
+void setIncidentStatus(int position, int status) {
+    struct IncidentHot* hot = &incidentHot[position];
+    if (columnStats.rows > position) {
+        columnStats.statusCounts[hot->status]--;
+        columnStats.statusCounts[status]++;
+    }
+    hot->status = (unsigned char)status;
+}
+
+// Whether the incident at one position should be dispatched before another: higher priority, then older
+int dispatchBefore(int first, int second) {
+    int firstPriority = incidentHot[first].priority, secondPriority = incidentHot[second].priority;
+    if (firstPriority != secondPriority) {
+        return firstPriority > secondPriority;
+    }
+    return first < second;
+}
+
+// Move the entry at a heap slot up until its parent goes first
+void siftDispatchUp(int slot) {
+    int position = dispatchHeap[slot];
+    while (slot > 0) {
+        int parent = (slot - 1) / DISPATCH_HEAP_ARITY;
+        if (!dispatchBefore(position, dispatchHeap[parent])) {
+            break;
+        }
+        dispatchHeap[slot] = dispatchHeap[parent];
+        dispatchSlot[dispatchHeap[slot]] = slot;
+        slot = parent;
+    }
+    dispatchHeap[slot] = position;
+    dispatchSlot[position] = slot;
+}
+
+// Move the entry at a heap slot down until it goes before all of its children
+void siftDispatchDown(int slot) {
+    int position = dispatchHeap[slot];
+    while (1) {
+        int first = slot * DISPATCH_HEAP_ARITY + 1;
+        if (first >= dispatchHeapCount) {
+            break;
+        }
+        int best = first;
+        int last = first + DISPATCH_HEAP_ARITY < dispatchHeapCount ? first + DISPATCH_HEAP_ARITY : dispatchHeapCount;
+        for (int child = first + 1; child < last; child++) {
+            if (dispatchBefore(dispatchHeap[child], dispatchHeap[best])) {
+                best = child;
+            }
+        }
+        if (!dispatchBefore(dispatchHeap[best], position)) {
+            break;
+        }
+        dispatchHeap[slot] = dispatchHeap[best];
+        dispatchSlot[dispatchHeap[slot]] = slot;
+        slot = best;
+    }
+    dispatchHeap[slot] = position;
+    dispatchSlot[position] = slot;
+}
+
+// Queue a newly stored incident if it is open; returns 0 if out of memory
+int pushDispatchQueue(int position) {
+    if (position >= dispatchSlotCapacity) {
+        int newCapacity = dispatchSlotCapacity == 0 ? INITIAL_INCIDENT_CAPACITY : dispatchSlotCapacity;
+        while (newCapacity <= position) {
+            newCapacity *= 2;
+        }
+        int* grown = realloc(dispatchSlot, (size_t)newCapacity * sizeof(int));
+        if (grown == NULL) {
+            return 0;
+        }
+        for (int i = dispatchSlotCapacity; i < newCapacity; i++) {
+            grown[i] = -1;
+        }
+        dispatchSlot = grown;
+        dispatchSlotCapacity = newCapacity;
+    }
+    if (incidentHot[position].status != STATUS_OPEN) {
+        return 1;
+    }
+
+    if (dispatchHeapCount == dispatchHeapCapacity) {
+        int newCapacity = dispatchHeapCapacity == 0 ? INITIAL_INCIDENT_CAPACITY : dispatchHeapCapacity * 2;
+        int* grown = realloc(dispatchHeap, (size_t)newCapacity * sizeof(int));
+        if (grown == NULL) {
+            return 0;
+        }
+        dispatchHeap = grown;
+        dispatchHeapCapacity = newCapacity;
+    }
+    dispatchHeap[dispatchHeapCount] = position;
+    siftDispatchUp(dispatchHeapCount++);
+    return 1;
+}
+
+// Remove and return the position of the next incident to dispatch (-1 if none is open)
+int popDispatchQueue() {
+    if (dispatchHeapCount == 0) {
+        return -1;
+    }
+    int position = dispatchHeap[0];
+    dispatchSlot[position] = -1;
+    if (--dispatchHeapCount > 0) {
+        dispatchHeap[0] = dispatchHeap[dispatchHeapCount];
+        siftDispatchDown(0);
+    }
+    return position;
+}
+
+// Take an incident off the dispatch queue wherever it is in the heap, e.g. after another instance dispatched it
+void removeFromDispatchQueue(int position) {
+    if (!dispatchQueueReady || position >= dispatchSlotCapacity || dispatchSlot[position] < 0) {
+        return;
+    }
+    int slot = dispatchSlot[position];
+    dispatchSlot[position] = -1;
+    if (--dispatchHeapCount > slot) {
+        int moved = dispatchHeap[dispatchHeapCount];
+        dispatchHeap[slot] = moved;
+        dispatchSlot[moved] = slot;
+        siftDispatchUp(slot);
+        siftDispatchDown(dispatchSlot[moved]);
+    }
+}
+
+// Set an incident's priority and restore the heap order around it in O(log n)
+void changeDispatchPriority(int position, int priority) {
+    int raised = priority > incidentHot[position].priority;
+    incidentHot[position].priority = (unsigned char)priority;
+    if (!dispatchQueueReady || dispatchSlot[position] < 0) {
+        return;
+    }
+    if (raised) {
+        siftDispatchUp(dispatchSlot[position]);
+    } else {
+        siftDispatchDown(dispatchSlot[position]);
+    }
+}
+
+// Heapify all open incidents in O(n), after loading the store and its dispatch log; returns 0 if out of memory
+int buildDispatchQueue() {
+    free(dispatchHeap);
+    free(dispatchSlot);
+    dispatchHeap = NULL;
+    dispatchSlot = NULL;
+    dispatchHeapCount = dispatchHeapCapacity = dispatchSlotCapacity = 0;
+    dispatchQueueReady = 0;
+
+    int capacity = incidentCount > INITIAL_INCIDENT_CAPACITY ? incidentCount : INITIAL_INCIDENT_CAPACITY;
+    dispatchHeap = malloc((size_t)capacity * sizeof(int));
+    dispatchSlot = malloc((size_t)capacity * sizeof(int));
+    if (dispatchHeap == NULL || dispatchSlot == NULL) {
+        return 0;
+    }
+    dispatchHeapCapacity = dispatchSlotCapacity = capacity;
+    for (int position = 0; position < capacity; position++) {
+        dispatchSlot[position] = -1;
+    }
+    for (int position = 0; position < incidentCount; position++) {
+        if (incidentHot[position].status == STATUS_OPEN) {
+            dispatchSlot[position] = dispatchHeapCount;
+            dispatchHeap[dispatchHeapCount++] = position;
+        }
+    }
+    for (int slot = (dispatchHeapCount - 2) / DISPATCH_HEAP_ARITY; slot >= 0 && dispatchHeapCount > 1; slot--) {
+        siftDispatchDown(slot);
+    }
+    dispatchQueueReady = 1;
+    return 1;
+}
+
+// Replay priority changes and dispatches recorded since the incidents were reported
+int readDispatchLog() {
+    FILE *file = fopen(DISPATCH_FILE, "r");
+    if (file == NULL) {
+        return 0;
+    }
+    // Only lines added since the last read, which with a shared store includes other instances' changes
+    if (fseek(file, dispatchLogOffset, SEEK_SET) != 0) {
+        fclose(file);
+        return 0;
+    }
+
+    int applied = 0;
+    char line[MAX_STRING_LENGTH];
+    char change[MAX_STRING_LENGTH];
+    int id, value;
+    long committed;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        // Older logs have no commit time; their changes count as made before any snapshot
+        int fields = sscanf(line, "%49[^|]|%d|%d|%ld", change, &id, &value, &committed);
+        int position = fields >= 2 ? findIncidentPosition(id) : -1;
+        if (position < 0) {
+            continue;
+        }
+        if (fields < 4 || committed < 0) {
+            committed = 0;
+        }
+        if (committed > lastCommitTime) {
+            lastCommitTime = committed;
+        }
+        if (strcmp(change, "priority") == 0 && fields >= 3 && value >= PRIORITY_LOW && value <= PRIORITY_CRITICAL) {
+            if (!recordIncidentVersion(position, committed)) {
+                loseHistoryBefore(committed);
+            }
+            changeDispatchPriority(position, value);
+            applied++;
+        } else if (strcmp(change, "dispatched") == 0) {
+            if (!recordIncidentVersion(position, committed)) {
+                loseHistoryBefore(committed);
+            }
+            setIncidentStatus(position, STATUS_DISPATCHED);
+            removeFromDispatchQueue(position);
+            applied++;
+        }
+    }
+    dispatchLogOffset = ftell(file);
+
+    fclose(file);
+    return applied;
+}
+
+// Append one change and its commit time to the dispatch log so it survives a restart
+void appendDispatchLog(const char* change, int id, int value, long committed) {
+    FILE *file = fopen(DISPATCH_FILE, "a");
+    if (file == NULL) {
+        printf(ANSI_COLOR_RED "Error: Could not open %s for writing.\n" ANSI_COLOR_RESET, DISPATCH_FILE);
+        return;
+    }
+    fprintf(file, "%s|%d|%d|%ld\n", change, id, value, committed);
+    // Writers hold the shared store lock and have read everything before, so the log is applied up to here
+    dispatchLogOffset = ftell(file);
+    fclose(file);
+}
+
+// Read how many days superseded versions are kept for AS OF queries
+void configureHistoryRetention() {
+    const char* days = getenv(HISTORY_DAYS_ENV);
+    long value;
+    char extra;
+    if (days != NULL && sscanf(days, "%ld%c", &value, &extra) == 1 && value >= 0) {
+        historyRetentionDays = value;
+    }
+}
+
+// Commit time for a change: the wall clock, but never before an earlier commit
+long nextCommitTime() {
+    long now = (long)time(NULL);
+    if (now < lastCommitTime) {
+        now = lastCommitTime;
+    }
+    lastCommitTime = now;
+    return now;
+}
+
+// Keep the current state of an incident as a version before a change committed at the given time
+int recordIncidentVersion(int position, long committed) {
+    if (position >= versionHeadCapacity) {
+        int newCapacity = versionHeadCapacity == 0 ? INITIAL_INCIDENT_CAPACITY : versionHeadCapacity;
+        while (newCapacity <= position || newCapacity < incidentCount) {
+            newCapacity *= 2;
+        }
+        int* grown = realloc(versionHead, (size_t)newCapacity * sizeof(int));
+        if (grown == NULL) {
+            return 0;
+        }
+        for (int i = versionHeadCapacity; i < newCapacity; i++) {
+            grown[i] = -1;
+        }
+        versionHead = grown;
+        versionHeadCapacity = newCapacity;
+    }
+
+    if (versionFree < 0) {
+        int newCapacity = versionCapacity == 0 ? HISTORY_GC_MIN_VERSIONS : versionCapacity * 2;
+        struct IncidentVersion* grown = realloc(versions, (size_t)newCapacity * sizeof(struct IncidentVersion));
+        if (grown == NULL) {
+            return 0;
+        }
+        for (int v = newCapacity - 1; v >= versionCapacity; v--) {
+            grown[v].older = versionFree;
+            versionFree = v;
+        }
+        versions = grown;
+        versionCapacity = newCapacity;
+    }
+
+    int version = versionFree;
+    versionFree = versions[version].older;
+    versions[version].validUntil = committed;
+    versions[version].status = incidentHot[position].status;
+    versions[version].priority = incidentHot[position].priority;
+    versions[version].older = versionHead[position];
+    versionHead[position] = version;
+
+    if (++liveVersions >= nextVersionCollection) {
+        collectIncidentVersions();
+    }
+    return 1;
+}
+
+// A change's previous state could not be kept, so snapshots before the change can no longer be answered
+void loseHistoryBefore(long committed) {
+    if (committed > historyHorizon) {
+        historyHorizon = committed;
+    }
+}
+
+// Status of an incident at a snapshot time (-1 for now): the oldest version replaced after it, else the current one
+int incidentStatusAsOf(int position, long snapshot) {
+    int status = incidentHot[position].status;
+    if (snapshot < 0 || position >= versionHeadCapacity) {
+        return status;
+    }
+    for (int v = versionHead[position]; v >= 0 && versions[v].validUntil > snapshot; v = versions[v].older) {
+        status = versions[v].status;
+    }
+    return status;
+}
+
+// Priority of an incident at a snapshot time (-1 for now), read from the same version chain as the status
+int incidentPriorityAsOf(int position, long snapshot) {
+    int priority = incidentHot[position].priority;
+    if (snapshot < 0 || position >= versionHeadCapacity) {
+        return priority;
+    }
+    for (int v = versionHead[position]; v >= 0 && versions[v].validUntil > snapshot; v = versions[v].older) {
+        priority = versions[v].priority;
+    }
+    return priority;
+}
+
+// Drop versions that were replaced before the retention period, cutting each chain at its first such version
+void collectIncidentVersions() {
+    long cutoff = nextCommitTime() - historyRetentionDays * SECONDS_PER_DAY;
+    if (cutoff > historyHorizon) {
+        historyHorizon = cutoff;
+    }
+    for (int position = 0; position < versionHeadCapacity; position++) {
+        int* link = &versionHead[position];
+        while (*link >= 0 && versions[*link].validUntil > historyHorizon) {
+            link = &versions[*link].older;
+        }
+        // Everything from here on only served snapshots before the horizon
+        int v = *link;
+        *link = -1;
+        while (v >= 0) {
+            int older = versions[v].older;
+            versions[v].older = versionFree;
+            versionFree = v;
+            liveVersions--;
+            v = older;
+        }
+    }
+    nextVersionCollection = liveVersions * 2 > HISTORY_GC_MIN_VERSIONS ? liveVersions * 2 : HISTORY_GC_MIN_VERSIONS;
+}
+
+// Show the dispatch queue menu until the user goes back
+void manageDispatchQueue() {
+    while (1) {
+        clearScreen();
+        displayHeader("DISPATCH QUEUE");
+        printf("1. View the next %d incidents " ANSI_COLOR_GREEN "(%d open)" ANSI_COLOR_RESET "\n",
+               DISPATCH_PREVIEW, dispatchHeapCount);
+        printf("2. Dispatch the next incident\n");
+        printf("3. Change an incident's priority\n");
+        printf("4. Plan crew assignments from %s\n", CREWS_FILE);
+        printf("5. Back to main menu\n\n");
+
+        int choice = validateChoiceInput("Enter your choice (1-5)", 1, 5);
+        if (choice == 5) {
+            return;
+        }
+
+        clearScreen();
+        if (!dispatchQueueReady && !buildDispatchQueue()) {
+            printf(ANSI_COLOR_RED "Error: Not enough memory for the dispatch queue.\n" ANSI_COLOR_RESET);
+        } else {
+            switch (choice) {
+                case 1:
+                    displayHeader("NEXT TO DISPATCH");
+                    viewDispatchQueue();
+                    break;
+                case 2:
+                    displayHeader("DISPATCH");
+                    dispatchNextIncident();
+                    break;
+                case 3:
+                    displayHeader("CHANGE PRIORITY");
+                    changeIncidentPriority();
+                    break;
+                case 4:
+                    displayHeader("CREW ASSIGNMENTS");
+                    planCrewAssignments();
+                    break;
+            }
+        }
+        printf("\nPress Enter to return to the dispatch menu...");
+        getchar();
+    }
+}
+
+// List the next incidents in dispatch order without removing them
+void viewDispatchQueue() {
+    if (dispatchHeapCount == 0) {
+        printf("No open incidents are waiting for dispatch.\n");
+        return;
+    }
+
+    // Best-first walk of the heap: the next entry is always the best child of one already listed
+    int frontier[DISPATCH_PREVIEW * DISPATCH_HEAP_ARITY + 1];
+    int frontierCount = 0;
+    frontier[frontierCount++] = 0;
+    printIncidentHeader();
+    for (int shown = 0; shown < DISPATCH_PREVIEW && frontierCount > 0; shown++) {
+        int best = 0;
+        for (int i = 1; i < frontierCount; i++) {
+            if (dispatchBefore(dispatchHeap[frontier[i]], dispatchHeap[frontier[best]])) {
+                best = i;
+            }
+        }
+        int slot = frontier[best];
+        frontier[best] = frontier[--frontierCount];
+        printIncidentRow(dispatchHeap[slot]);
+        for (int child = slot * DISPATCH_HEAP_ARITY + 1;
+             child <= slot * DISPATCH_HEAP_ARITY + DISPATCH_HEAP_ARITY && child < dispatchHeapCount; child++) {
+            frontier[frontierCount++] = child;
+        }
+    }
+}
+
+// Take the most urgent open incident off the queue and mark it dispatched
+void dispatchNextIncident() {
+    // Under the shared store lock, so two instances never dispatch the same incident
+    lockSharedStore();
+    int position = popDispatchQueue();
+    if (position < 0) {
+        unlockSharedStore();
+        printf("No open incidents are waiting for dispatch.\n");
+        return;
+    }
+    long committed = nextCommitTime();
+    int versioned = recordIncidentVersion(position, committed);
+    if (!versioned) {
+        loseHistoryBefore(committed);
+    }
+    setIncidentStatus(position, STATUS_DISPATCHED);
+    appendDispatchLog("dispatched", incidentHot[position].id, STATUS_DISPATCHED, committed);
+    unlockSharedStore();
+
+    printf("Dispatching:\n\n");
+    printIncidentHeader();
+    printIncidentRow(position);
+    const char* description = descriptionAt(position);
+    if (description[0] != '\0') {
+        printf("      " ANSI_COLOR_CYAN "%s" ANSI_COLOR_RESET "\n", description);
+    }
+    printf(ANSI_COLOR_GREEN "\n%d open incident%s left in the queue.\n" ANSI_COLOR_RESET,
+           dispatchHeapCount, (dispatchHeapCount == 1) ? "" : "s");
+    if (!versioned) {
+        printf(ANSI_COLOR_YELLOW "Warning: Not enough memory to keep the previous state; AS OF queries now start here.\n"
+               ANSI_COLOR_RESET);
+    }
+}
+
+// Re-prioritize an incident by id, moving it within the dispatch queue
+void changeIncidentPriority() {
+    char input[MAX_STRING_LENGTH];
+    int id;
+    char extra;
+    validateStringInput(input, MAX_STRING_LENGTH, "Enter the incident ID");
+    if (sscanf(input, "%d%c", &id, &extra) != 1) {
+        printf(ANSI_COLOR_RED "Error: The ID must be a whole number.\n" ANSI_COLOR_RESET);
+        return;
+    }
+    int position = findIncidentPosition(id);
+    if (position < 0) {
+        printf(ANSI_COLOR_RED "Error: No incident has ID %d.\n" ANSI_COLOR_RESET, id);
+        return;
+    }
+
+    printIncidentHeader();
+    printIncidentRow(position);
+    int priority = validateChoiceInput("\nEnter the new priority (1 = low, 3 = normal, 5 = critical)",
+                                       PRIORITY_LOW, PRIORITY_CRITICAL);
+    lockSharedStore();
+    long committed = nextCommitTime();
+    int versioned = recordIncidentVersion(position, committed);
+    if (!versioned) {
+        loseHistoryBefore(committed);
+    }
+    changeDispatchPriority(position, priority);
+    appendDispatchLog("priority", id, priority, committed);
+    unlockSharedStore();
+    printf(ANSI_COLOR_GREEN "Incident %d is now %s priority%s.\n" ANSI_COLOR_RESET, id, priorityName(priority),
+           incidentHot[position].status == STATUS_OPEN ? "" : " (already dispatched)");
+    if (!versioned) {
+        printf(ANSI_COLOR_YELLOW "Warning: Not enough memory to keep the previous state; AS OF queries now start here.\n"
+               ANSI_COLOR_RESET);
+    }
+}
+
+// Read the crews file (name|skills|capacity per line); returns the number of crews
+int readCrewsFromFile(struct Crew** crewsOut) {
+    *crewsOut = NULL;
+    FILE *file = fopen(CREWS_FILE, "r");
+    if (file == NULL) {
+        return 0;
+    }
+
+    int count = 0;
+    int capacity = 0;
+    char line[MAX_STRING_LENGTH * 3];
+    struct Crew crew;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (line[0] == '#') {
+            continue;
+        }
+        if (sscanf(line, "%49[^|]|%99[^|]|%d", crew.name, crew.skills, &crew.capacity) != 3 || crew.capacity <= 0) {
+            continue;
+        }
+        toLowerCopy(crew.skills, crew.skills, sizeof(crew.skills));
+
+        if (count == capacity) {
+            capacity = capacity == 0 ? 8 : capacity * 2;
+            struct Crew* grown = realloc(*crewsOut, (size_t)capacity * sizeof(struct Crew));
+            if (grown == NULL) {
+                break;
+            }
+            *crewsOut = grown;
+        }
+        (*crewsOut)[count++] = crew;
+    }
+
+    fclose(file);
+    return count;
+}
+
+// Weight of leaving one incident unfinished; each priority level outweighs four of the level below
+long priorityWeight(int priority) {
+    return 1L << (2 * (priority - PRIORITY_LOW));
+}
+
+// Order open incident positions by area, type, then priority (highest first)
+int compareJobPositions(const void* first, const void* second) {
+    const struct IncidentHot* a = &incidentHot[*(const int*)first];
+    const struct IncidentHot* b = &incidentHot[*(const int*)second];
+    if (a->areaId != b->areaId) {
+        return a->areaId < b->areaId ? -1 : 1;
+    }
+    if (a->typeId != b->typeId) {
+        return a->typeId < b->typeId ? -1 : 1;
+    }
+    if (a->priority != b->priority) {
+        return a->priority > b->priority ? -1 : 1;
+    }
+    return *(const int*)first - *(const int*)second;
+}
+
+// Order jobs for the greedy pass: most urgent first, then the smaller ones, which pack more easily
+int compareCrewJobs(const void* first, const void* second) {
+    const struct CrewJob* a = (const struct CrewJob*)first;
+    const struct CrewJob* b = (const struct CrewJob*)second;
+    if (a->priority != b->priority) {
+        return b->priority - a->priority;
+    }
+    if (a->count != b->count) {
+        return a->count - b->count;
+    }
+    return a->first - b->first;
+}
+
+// Whether a crew's skills cover an incident type (any listed text contained in the type)
+int crewHasSkill(const struct Crew* crew, const char* type) {
+    char lowered[MAX_TYPE_LENGTH];
+    toLowerCopy(lowered, type, sizeof(lowered));
+    const char* skill = crew->skills;
+    while (*skill != '\0') {
+        while (*skill == ',' || *skill == ' ') {
+            skill++;
+        }
+        size_t length = strcspn(skill, ",");
+        while (length > 0 && skill[length - 1] == ' ') {
+            length--;
+        }
+        char text[MAX_STRING_LENGTH];
+        memcpy(text, skill, length);
+        text[length] = '\0';
+        if (strcmp(text, "*") == 0 || (length > 0 && strstr(lowered, text) != NULL)) {
+            return 1;
+        }
+        skill += strcspn(skill, ",");
+    }
+    return 0;
+}
+
+// Give a job to a crew and file it under its priority for later eviction
+void assignCrewJob(struct CrewPlan* plan, int job, int crew) {
+    int bucket = crew * PRIORITY_CRITICAL + plan->jobs[job].priority - PRIORITY_LOW;
+    plan->jobCrew[job] = crew;
+    plan->remaining[crew] -= plan->jobs[job].count;
+    plan->assignedWeight += plan->jobs[job].weight;
+    plan->bucketPrevious[job] = -1;
+    plan->bucketNext[job] = plan->bucketHead[bucket];
+    if (plan->bucketHead[bucket] >= 0) {
+        plan->bucketPrevious[plan->bucketHead[bucket]] = job;
+    }
+    plan->bucketHead[bucket] = job;
+}
+
+// Take a job back from its crew
+void unassignCrewJob(struct CrewPlan* plan, int job) {
+    int crew = plan->jobCrew[job];
+    int bucket = crew * PRIORITY_CRITICAL + plan->jobs[job].priority - PRIORITY_LOW;
+    if (plan->bucketPrevious[job] >= 0) {
+        plan->bucketNext[plan->bucketPrevious[job]] = plan->bucketNext[job];
+    } else {
+        plan->bucketHead[bucket] = plan->bucketNext[job];
+    }
+    if (plan->bucketNext[job] >= 0) {
+        plan->bucketPrevious[plan->bucketNext[job]] = plan->bucketPrevious[job];
+    }
+    plan->jobCrew[job] = -1;
+    plan->remaining[crew] += plan->jobs[job].count;
+    plan->assignedWeight -= plan->jobs[job].weight;
+}
+
+// Assign jobs greedily by best fit, then improve by evicting less urgent work for unassigned jobs
+void* runCrewOptimizer(void* argument) {
+    struct CrewPlan* plan = (struct CrewPlan*)argument;
+    int jobCount = plan->jobCount, crewCount = plan->crewCount;
+    int* order = malloc((size_t)(jobCount > 0 ? jobCount : 1) * sizeof(int));
+    plan->jobCrew = malloc((size_t)(jobCount > 0 ? jobCount : 1) * sizeof(int));
+    plan->bucketNext = malloc((size_t)(jobCount > 0 ? jobCount : 1) * sizeof(int));
+    plan->bucketPrevious = malloc((size_t)(jobCount > 0 ? jobCount : 1) * sizeof(int));
+    plan->remaining = malloc((size_t)crewCount * sizeof(int));
+    plan->bucketHead = malloc((size_t)crewCount * PRIORITY_CRITICAL * sizeof(int));
+    plan->status = 0;
+    if (order == NULL || plan->jobCrew == NULL || plan->bucketNext == NULL || plan->bucketPrevious == NULL
+        || plan->remaining == NULL || plan->bucketHead == NULL) {
+        free(order);
+        return NULL;
+    }
+    for (int c = 0; c < crewCount; c++) {
+        plan->remaining[c] = plan->crews[c].capacity;
+    }
+    for (int b = 0; b < crewCount * PRIORITY_CRITICAL; b++) {
+        plan->bucketHead[b] = -1;
+    }
+    plan->assignedWeight = 0;
+
+    // Jobs arrive sorted by urgency; other runs shuffle within each priority to explore other packings
+    for (int j = 0; j < jobCount; j++) {
+        order[j] = j;
+        plan->jobCrew[j] = -1;
+    }
+    if (plan->random != 0) {
+        for (int start = 0; start < jobCount; ) {
+            int end = start;
+            while (end < jobCount && plan->jobs[end].priority == plan->jobs[start].priority) {
+                end++;
+            }
+            for (int j = end - 1; j > start; j--) {
+                plan->random ^= plan->random >> 12;
+                plan->random ^= plan->random << 25;
+                plan->random ^= plan->random >> 27;
+                int k = start + (int)(plan->random * 2685821657736338717ULL % (unsigned long long)(j - start + 1));
+                int swap = order[j];
+                order[j] = order[k];
+                order[k] = swap;
+            }
+            start = end;
+        }
+    }
+
+    // Greedy: each job goes to the eligible crew it fits most tightly
+    for (int i = 0; i < jobCount; i++) {
+        const struct CrewJob* job = &plan->jobs[order[i]];
+        const unsigned char* eligible = &plan->eligible[(size_t)job->typeId * crewCount];
+        int best = -1;
+        for (int c = 0; c < crewCount; c++) {
+            if (eligible[c] && plan->remaining[c] >= job->count
+                && (best < 0 || plan->remaining[c] < plan->remaining[best])) {
+                best = c;
+            }
+        }
+        if (best >= 0) {
+            assignCrewJob(plan, order[i], best);
+        }
+    }
+
+    // Local search: place each unassigned job where evicting lower-priority jobs loses the least weight
+    for (int pass = 0; pass < CREW_LOCAL_SEARCH_PASSES; pass++) {
+        int improved = 0;
+        for (int i = 0; i < jobCount; i++) {
+            int j = order[i];
+            if (plan->jobCrew[j] >= 0) {
+                continue;
+            }
+            const struct CrewJob* job = &plan->jobs[j];
+            const unsigned char* eligible = &plan->eligible[(size_t)job->typeId * crewCount];
+            int bestCrew = -1;
+            long bestLoss = job->weight;
+            for (int c = 0; c < crewCount; c++) {
+                if (!eligible[c]) {
+                    continue;
+                }
+                // Free enough room from the least urgent jobs first, stopping short of this job's priority
+                int freed = plan->remaining[c];
+                long loss = 0;
+                for (int p = PRIORITY_LOW; p < job->priority && freed < job->count && loss < bestLoss; p++) {
+                    for (int other = plan->bucketHead[c * PRIORITY_CRITICAL + p - PRIORITY_LOW];
+                         other >= 0 && freed < job->count && loss < bestLoss; other = plan->bucketNext[other]) {
+                        freed += plan->jobs[other].count;
+                        loss += plan->jobs[other].weight;
+                    }
+                }
+                if (freed >= job->count && loss < bestLoss) {
+                    bestCrew = c;
+                    bestLoss = loss;
+                }
+            }
+            if (bestCrew < 0) {
+                continue;
+            }
+
+            // Each eviction frees at least one slot, so a job never displaces more than its own size
+            int evicted[CREW_JOB_MAX_SIZE];
+            int evictedCount = 0;
+            for (int p = PRIORITY_LOW; p < job->priority && plan->remaining[bestCrew] < job->count; p++) {
+                int* head = &plan->bucketHead[bestCrew * PRIORITY_CRITICAL + p - PRIORITY_LOW];
+                while (*head >= 0 && plan->remaining[bestCrew] < job->count) {
+                    evicted[evictedCount++] = *head;
+                    unassignCrewJob(plan, *head);
+                }
+            }
+            assignCrewJob(plan, j, bestCrew);
+            improved = 1;
+
+            // Evicted jobs may still fit elsewhere as they are
+            for (int k = 0; k < evictedCount; k++) {
+                int other = evicted[k];
+                const unsigned char* otherEligible = &plan->eligible[(size_t)plan->jobs[other].typeId * crewCount];
+                for (int c = 0; c < crewCount; c++) {
+                    if (otherEligible[c] && plan->remaining[c] >= plan->jobs[other].count) {
+                        assignCrewJob(plan, other, c);
+                        break;
+                    }
+                }
+            }
+        }
+        if (!improved) {
+            break;
+        }
+    }
+
+    free(order);
+    plan->status = 1;
+    return NULL;
+}
+
+// Threads for the optimizer: one per online processor, within MAX_OPTIMIZER_THREADS
+int optimizerThreadCount() {
+#ifdef __linux__
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    if (processors > MAX_OPTIMIZER_THREADS) {
+        processors = MAX_OPTIMIZER_THREADS;
+    }
+    // The active municipality's share of the pool
+    if (activeTenant >= 0 && tenants[activeTenant].optimizerThreads > 0 && processors > tenants[activeTenant].optimizerThreads) {
+        processors = tenants[activeTenant].optimizerThreads;
+    }
+    return processors > 0 ? (int)processors : 1;
+#else
+    return 1;
+#endif
+}
+
+// Assign open incidents, grouped by area, type and priority, to the crews in the crews file
+void planCrewAssignments() {
+    struct Crew* crews;
+    int crewCount = readCrewsFromFile(&crews);
+    if (crewCount == 0) {
+        printf("No crews configured. Add lines to %s in the format:\n", CREWS_FILE);
+        printf("  crew name|skills (incident type texts separated by commas, or *)|incidents per batch\n");
+        printf("Example: Road crew 1|pothole,crosswalk|40\n");
+        return;
+    }
+
+    double started = monotonicSeconds();
+
+    // Group the open incidents into jobs of one area, type and priority
+    int openCount = 0;
+    for (int position = 0; position < incidentCount; position++) {
+        openCount += incidentHot[position].status == STATUS_OPEN;
+    }
+    int* positions = malloc((size_t)(openCount > 0 ? openCount : 1) * sizeof(int));
+    struct CrewJob* jobs = malloc((size_t)(openCount > 0 ? openCount : 1) * sizeof(struct CrewJob));
+    unsigned char* eligible = malloc((size_t)(incidentTypeCount > 0 ? incidentTypeCount : 1) * crewCount);
+    int threadCount = optimizerThreadCount();
+    struct CrewPlan plans[MAX_OPTIMIZER_THREADS];
+    memset(plans, 0, sizeof(plans));
+    if (positions == NULL || jobs == NULL || eligible == NULL) {
+        printf(ANSI_COLOR_RED "Error: Not enough memory to plan crew assignments.\n" ANSI_COLOR_RESET);
+        goto done;
+    }
+    openCount = 0;
+    for (int position = 0; position < incidentCount; position++) {
+        if (incidentHot[position].status == STATUS_OPEN) {
+            positions[openCount++] = position;
+        }
+    }
+    qsort(positions, (size_t)openCount, sizeof(int), compareJobPositions);
+
+    int jobCount = 0;
+    for (int start = 0; start < openCount; ) {
+        const struct IncidentHot* hot = &incidentHot[positions[start]];
+        int end = start + 1;
+        while (end < openCount && end - start < CREW_JOB_MAX_SIZE && incidentHot[positions[end]].areaId == hot->areaId
+               && incidentHot[positions[end]].typeId == hot->typeId
+               && incidentHot[positions[end]].priority == hot->priority) {
+            end++;
+        }
+        struct CrewJob* job = &jobs[jobCount++];
+        job->first = start;
+        job->count = end - start;
+        job->typeId = hot->typeId;
+        job->priority = hot->priority;
+        job->weight = job->count * priorityWeight(hot->priority);
+        start = end;
+    }
+    qsort(jobs, (size_t)jobCount, sizeof(struct CrewJob), compareCrewJobs);
+
+    for (int type = 0; type < incidentTypeCount; type++) {
+        for (int c = 0; c < crewCount; c++) {
+            eligible[(size_t)type * crewCount + c] = (unsigned char)crewHasSkill(&crews[c], incidentTypes[type]);
+        }
+    }
+
+    // Independent runs in parallel: the plain greedy order plus differently shuffled ones; the best wins
+    for (int t = 0; t < threadCount; t++) {
+        plans[t].jobs = jobs;
+        plans[t].jobCount = jobCount;
+        plans[t].crews = crews;
+        plans[t].crewCount = crewCount;
+        plans[t].eligible = eligible;
+        plans[t].random = t == 0 ? 0 : 0x9E3779B97F4A7C15ULL * (unsigned long long)t;
+    }
+#ifdef __linux__
+    pthread_t threads[MAX_OPTIMIZER_THREADS];
+    int threadStarted[MAX_OPTIMIZER_THREADS] = { 0 };
+    for (int t = 1; t < threadCount; t++) {
+        threadStarted[t] = pthread_create(&threads[t], NULL, runCrewOptimizer, &plans[t]) == 0;
+    }
+    runCrewOptimizer(&plans[0]);
+    for (int t = 1; t < threadCount; t++) {
+        if (threadStarted[t]) {
+            pthread_join(threads[t], NULL);
+        }
+    }
+#else
+    runCrewOptimizer(&plans[0]);
+#endif
+    int best = -1;
+    for (int t = 0; t < threadCount; t++) {
+        if (plans[t].status && (best < 0 || plans[t].assignedWeight > plans[best].assignedWeight)) {
+            best = t;
+        }
+    }
+    if (best < 0) {
+        printf(ANSI_COLOR_RED "Error: Not enough memory to plan crew assignments.\n" ANSI_COLOR_RESET);
+        goto done;
+    }
+    double elapsed = monotonicSeconds() - started;
+    const struct CrewPlan* plan = &plans[best];
+
+    // Summarize per crew and write the assignments for the crews to pick up
+    FILE *file = fopen(ASSIGNMENTS_FILE, "w");
+    if (file == NULL) {
+        printf(ANSI_COLOR_RED "Error: Could not open %s for writing.\n" ANSI_COLOR_RESET, ASSIGNMENTS_FILE);
+    }
+    long left[PRIORITY_CRITICAL + 1] = { 0 };
+    long totalWeight = 0;
+    printf("%-25s | %-8s | %-8s | %-8s | %-8s\n", "Crew", "Capacity", "Assigned", "Critical", "High");
+    printf("----------------------------------------------------------------------\n");
+    for (int c = 0; c < crewCount; c++) {
+        long assigned = 0, critical = 0, high = 0;
+        for (int j = 0; j < jobCount; j++) {
+            if (plan->jobCrew[j] != c) {
+                continue;
+            }
+            assigned += jobs[j].count;
+            critical += jobs[j].priority == PRIORITY_CRITICAL ? jobs[j].count : 0;
+            high += jobs[j].priority == PRIORITY_CRITICAL - 1 ? jobs[j].count : 0;
+            for (int i = 0; file != NULL && i < jobs[j].count; i++) {
+                int position = positions[jobs[j].first + i];
+                fprintf(file, "%s|%d\n", crews[c].name, incidentHot[position].id);
+            }
+        }
+        printf(ANSI_COLOR_GREEN "%-25s" ANSI_COLOR_RESET " | %-8d | " ANSI_COLOR_YELLOW "%-8ld" ANSI_COLOR_RESET
+               " | " ANSI_COLOR_RED "%-8ld" ANSI_COLOR_RESET " | %-8ld\n",
+               crews[c].name, crews[c].capacity, assigned, critical, high);
+    }
+    if (file != NULL) {
+        fclose(file);
+    }
+    for (int j = 0; j < jobCount; j++) {
+        totalWeight += jobs[j].weight;
+        if (plan->jobCrew[j] < 0) {
+            left[jobs[j].priority] += jobs[j].count;
+        }
+    }
+
+    printf("\nUnassigned:");
+    for (int p = PRIORITY_CRITICAL; p >= PRIORITY_LOW; p--) {
+        printf(" %s " ANSI_COLOR_YELLOW "%ld" ANSI_COLOR_RESET "%s", priorityName(p), left[p], p > PRIORITY_LOW ? "," : "\n");
+    }
+    printf("Covered " ANSI_COLOR_GREEN "%.1f%%" ANSI_COLOR_RESET " of the priority-weighted open work "
+           "(%d incidents in %d jobs, %d crews, %d run%s in " ANSI_COLOR_YELLOW "%.1f ms" ANSI_COLOR_RESET ")\n",
+           totalWeight > 0 ? 100.0 * plan->assignedWeight / totalWeight : 100.0, openCount, jobCount, crewCount,
+           threadCount, threadCount == 1 ? "" : "s", elapsed * 1000.0);
+    if (file != NULL) {
+        printf("Assignments written to %s.\n", ASSIGNMENTS_FILE);
+    }
+
+done:
+    for (int t = 0; t < threadCount; t++) {
+        free(plans[t].jobCrew);
+        free(plans[t].remaining);
+        free(plans[t].bucketHead);
+        free(plans[t].bucketNext);
+        free(plans[t].bucketPrevious);
+    }
+    free(positions);
+    free(jobs);
+    free(eligible);
+    free(crews);
+}
+
+// Read incidents from file into the store
+int readIncidentsFromFile() {
     FILE *file = fopen(DATA_FILE, "r");
     if (file == NULL) {
-        // File doesn't exist yet, which is fine for a new system
+        // File doesn't exist yet, which is fine for a new system
+        return 0;
+    }
+    // After a checkpoint was restored, only the lines written since it
+    if (fseek(file, incidentFileOffset, SEEK_SET) != 0) {
+        fclose(file);
+        return 0;
+    }
+    if (incidentFileOffset == 0) {
+        incidentFileLayout = legacyIncidentLayout;
+        legacyIncidentRows = 0;
+    }
+
+    int count = 0;
+    char line[MAX_LINE_LENGTH]; // Buffer to hold each line
+    struct Incident incident;
+
+    long unread = 0; // Bytes of a line that could not be stored, read again next time
+    while (fgets(line, sizeof(line), file) != NULL) {
+        size_t lineLength = strlen(line);
+        if (line[0] == '#') {
+            parseSchemaLine(line, &incidentFileLayout);
+        } else if (parseIncidentLine(line, &incidentFileLayout, &incident)) {
+            if (incident.id > highestFileIncidentId) {
+                highestFileIncidentId = incident.id;
+            }
+            // A server worker only keeps the areas of its own partition, but counts old rows of the whole file
+            int legacy = !layoutIsCurrent(&incidentFileLayout);
+            if (serverWorkerCount > 0 && areaWorker(incident.area) != serverWorker) {
+                legacyIncidentRows += legacy;
+                continue;
+            }
+            if (!storeIncident(&incident)) {
+                unread = (long)lineLength;
+                if (activeTenant >= 0 && tenants[activeTenant].overQuota) {
+                    printf(ANSI_COLOR_RED "Error: %s reached its memory quota after %d incidents.\n" ANSI_COLOR_RESET,
+                           tenants[activeTenant].name, incidentCount);
+                } else {
+                    printf(ANSI_COLOR_RED "Error: Not enough memory to load all incidents.\n" ANSI_COLOR_RESET);
+                }
+                break;
+            }
+            legacyIncidentRows += legacy;
+            count++;
+        }
+    }
+    incidentFileOffset = ftell(file) - unread;
+
+    fclose(file);
+    return count;
+}
+
+// Parse one line of an incidents file laid out as its segment's schema, returning 1 if it holds a complete incident
+int parseIncidentLine(char* line, const struct IncidentLayout* layout, struct Incident* incident) {
+    // Remove newline character if present
+    size_t len = strlen(line);
+    if (len > 0 && line[len-1] == '\n') {
+        line[len-1] = '\0';
+    }
+
+    // Fields the segment does not carry keep these defaults
+    incident->description[0] = '\0';
+    incident->priority = PRIORITY_NORMAL;
+    incident->reported = 0;
+    int required = 0;
+    const char* text = line;
+    for (int f = 0; f < layout->fieldCount && text != NULL; f++) {
+        const char* end = strchr(text, '|');
+        size_t length = end != NULL ? (size_t)(end - text) : strlen(text);
+        int field = layout->fields[f];
+        if (parseIncidentField(field, text, length, incident)) {
+            if (field >= 0 && field < REQUIRED_INCIDENT_FIELDS) {
+                required++;
+            }
+        } else if (field >= 0 && field < REQUIRED_INCIDENT_FIELDS) {
+            return 0;
+        }
+        text = end != NULL ? end + 1 : NULL;
+    }
+    return required == REQUIRED_INCIDENT_FIELDS;
+}
+
+// Set one field of an incident from its text in a line, returning 0 if the text is not a valid value
+int parseIncidentField(int field, const char* text, size_t length, struct Incident* incident) {
+    char value[MAX_DESCRIPTION_LENGTH];
+    size_t limit = field == FIELD_AREA ? MAX_AREA_LENGTH : field == FIELD_TYPE ? MAX_TYPE_LENGTH
+                 : field == FIELD_TIME ? MAX_TIME_LENGTH : MAX_DESCRIPTION_LENGTH;
+    if (length >= limit) {
+        // Only the free-text description is cut short; anything else that long is not a value
+        if (field != FIELD_DESCRIPTION) {
+            return 0;
+        }
+        length = limit - 1;
+    }
+    memcpy(value, text, length);
+    value[length] = '\0';
+
+    int number;
+    long reported;
+    switch (field) {
+        case FIELD_ID:
+            return sscanf(value, "%d", &incident->id) == 1;
+        case FIELD_AREA:
+            strcpy(incident->area, value);
+            return length > 0;
+        case FIELD_TYPE:
+            strcpy(incident->type, value);
+            return length > 0;
+        case FIELD_TIME:
+            strcpy(incident->time, value);
+            return length > 0;
+        case FIELD_DESCRIPTION:
+            strcpy(incident->description, value);
+            return 1;
+        case FIELD_PRIORITY:
+            if (sscanf(value, "%d", &number) != 1 || number < PRIORITY_LOW || number > PRIORITY_CRITICAL) {
+                return 0;
+            }
+            incident->priority = number;
+            return 1;
+        case FIELD_REPORTED:
+            if (sscanf(value, "%ld", &reported) != 1 || reported <= 0) {
+                return 0;
+            }
+            incident->reported = reported;
+            return 1;
+        default:
+            // A field from a newer schema this program does not know
+            return 1;
+    }
+}
+
+// Read a "#schema" line into the layout of the segment it starts; returns 0 for other comment lines
+int parseSchemaLine(const char* line, struct IncidentLayout* layout) {
+    size_t prefix = strlen(SCHEMA_PREFIX);
+    int version;
+    if (strncmp(line, SCHEMA_PREFIX, prefix) != 0 || sscanf(line + prefix, "%d", &version) != 1) {
+        return 0;
+    }
+
+    layout->version = version;
+    layout->fieldCount = 0;
+    const char* name = strchr(line + prefix, '|');
+    while (name != NULL && layout->fieldCount < MAX_SCHEMA_FIELDS) {
+        name++;
+        size_t length = strcspn(name, "|\r\n");
+        int field = FIELD_UNKNOWN;
+        for (int f = 0; f < INCIDENT_FIELDS; f++) {
+            if (strlen(incidentFieldNames[f]) == length && strncmp(incidentFieldNames[f], name, length) == 0) {
+                field = f;
+                break;
+            }
+        }
+        layout->fields[layout->fieldCount++] = field;
+        name = strchr(name, '|');
+    }
+    return 1;
+}
+
+// Write the schema line that starts a segment in the given layout
+void writeSchemaLine(FILE* file, const struct IncidentLayout* layout) {
+    char line[MAX_LINE_LENGTH];
+    formatSchemaLine(line, sizeof(line), layout);
+    fputs(line, file);
+}
+
+// Write one incident in the current schema
+void writeIncidentLine(FILE* file, const struct Incident* incident) {
+    char line[MAX_LINE_LENGTH];
+    formatIncidentLine(line, sizeof(line), incident);
+    fputs(line, file);
+}
+
+// Whether lines in a layout read the same as the current schema, so its rows need no migration. Files from before
+// schema lines had the same fields, so an unversioned file in them is as good as current
+int layoutIsCurrent(const struct IncidentLayout* layout) {
+    if (layout->fieldCount != currentIncidentLayout.fieldCount) {
+        return 0;
+    }
+    for (int f = 0; f < layout->fieldCount; f++) {
+        if (layout->fields[f] != currentIncidentLayout.fields[f]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Open the incidents file and lock it exclusively against compaction and other writers; the lock goes with fclose
+FILE* openLockedIncidentFile(const char* mode) {
+    FILE *file = fopen(DATA_FILE, mode);
+#ifdef __linux__
+    // A compaction may replace the file while this waits for the lock; the replacement is then opened instead
+    for (int attempt = 0; file != NULL && attempt < 8; attempt++) {
+        struct stat opened, current;
+        flock(fileno(file), LOCK_EX);
+        if (fstat(fileno(file), &opened) == 0 && stat(DATA_FILE, &current) == 0 && opened.st_ino == current.st_ino) {
+            return file;
+        }
+        fclose(file);
+        file = fopen(DATA_FILE, mode);
+    }
+    if (file != NULL) {
+        fclose(file);
+    }
+    return NULL;
+#else
+    return file;
+#endif
+}
+
+// Format the schema line that starts a segment in the given layout, returning its length
+size_t formatSchemaLine(char* buffer, size_t size, const struct IncidentLayout* layout) {
+    size_t length = (size_t)snprintf(buffer, size, SCHEMA_PREFIX "%d", layout->version);
+    for (int f = 0; f < layout->fieldCount && length < size; f++) {
+        length += (size_t)snprintf(buffer + length, size - length, "|%s",
+                                   layout->fields[f] >= 0 ? incidentFieldNames[layout->fields[f]] : "?");
+    }
+    if (length < size) {
+        length += (size_t)snprintf(buffer + length, size - length, "\n");
+    }
+    return length < size ? length : size - 1;
+}
+
+// Format one incident as a line in the current schema, returning its length
+size_t formatIncidentLine(char* buffer, size_t size, const struct Incident* incident) {
+    int length = snprintf(buffer, size, "%d|%s|%s|%s|%s|%d|%ld\n", incident->id, incident->area, incident->type,
+                          incident->time, incident->description, incident->priority, incident->reported);
+    return (size_t)length < size ? (size_t)length : size - 1;
+}
+
+// Write a new incident to file
+void writeIncidentToFile(const struct Incident* incident) {
+    FILE *file = openLockedIncidentFile("a");
+    if (file == NULL) {
+        printf(ANSI_COLOR_RED "Error: Could not open file for writing.\n" ANSI_COLOR_RESET);
+        return;
+    }
+
+    // A file that ends in an older segment gets a new one for the current schema
+    if (!layoutIsCurrent(&incidentFileLayout)) {
+        writeSchemaLine(file, &currentIncidentLayout);
+        incidentFileLayout = currentIncidentLayout;
+    }
+    writeIncidentLine(file, incident);
+    incidentFileOffset = ftell(file);
+    fclose(file);
+}
+
+// Rewrite the incidents file with every row in the current schema; rows keep their order, so the store is unchanged.
+// Returns 1 once compacted, 0 on an error, and -1 while the file holds rows that are not loaded
+int compactIncidentFile() {
+    // Held until the new file is in place, so no writer appends to the old one in between
+    FILE *file = openLockedIncidentFile("r");
+    if (file == NULL) {
+        return 0;
+    }
+    // Rows appended since this instance last read the file would be migrated without being loaded
+    fseek(file, 0, SEEK_END);
+    if (ftell(file) != incidentFileOffset) {
+        fclose(file);
+        return -1;
+    }
+    rewind(file);
+
+    char temporary[sizeof(DATA_FILE) + 8];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", DATA_FILE);
+    FILE *compacted = fopen(temporary, "w");
+    if (compacted == NULL) {
+        fclose(file);
+        return 0;
+    }
+
+    int rows = migrateIncidentRows(file, incidentFileOffset, compacted);
+
+    int written = rows == incidentCount && fflush(compacted) == 0 && !ferror(compacted);
+#ifdef __linux__
+    written = written && fsync(fileno(compacted)) == 0;
+#endif
+    long compactedBytes = ftell(compacted);
+    written = fclose(compacted) == 0 && written;
+    if (!written) {
+        fclose(file);
+        remove(temporary);
+        return 0;
+    }
+    // A checkpoint image describes the file it was taken from, so it goes first
+    if (checkpointPath[0] != '\0') {
+        remove(checkpointPath);
+    }
+    if (rename(temporary, DATA_FILE) != 0) {
+        fclose(file);
+        remove(temporary);
+        return 0;
+    }
+    fclose(file);
+    incidentFileOffset = compactedBytes;
+    incidentFileLayout = currentIncidentLayout;
+    legacyIncidentRows = 0;
+    checkpointRows = -1;
+    return 1;
+}
+
+// Migrate rows in older segments once the program has run a while, or when forced, never while starting up
+void maybeCompactIncidentFile(int force) {
+    // Other instances sharing the store track the file by its size
+    if (legacyIncidentRows == 0 || sharedStore != NULL) {
+        return;
+    }
+    time_t now = time(NULL);
+    if (!force && now - lastCompactionTime < COMPACTION_INTERVAL_SECONDS) {
+        return;
+    }
+    lastCompactionTime = now;
+    if (compactIncidentFile() == 0) {
+        printf(ANSI_COLOR_RED "Error: Could not compact %s.\n" ANSI_COLOR_RESET, DATA_FILE);
+    }
+}
+
+// Copy the rows in the first bytes of an incidents file to another one in the current schema, returning how many
+int migrateIncidentRows(FILE* from, long end, FILE* to) {
+    writeSchemaLine(to, &currentIncidentLayout);
+    struct IncidentLayout layout = legacyIncidentLayout;
+    char line[MAX_LINE_LENGTH];
+    struct Incident incident;
+    int rows = 0;
+    long position = 0;
+    while (position < end && fgets(line, sizeof(line), from) != NULL) {
+        position += (long)strlen(line);
+        if (line[0] == '#') {
+            parseSchemaLine(line, &layout);
+        } else if (parseIncidentLine(line, &layout, &incident)) {
+            writeIncidentLine(to, &incident);
+            rows++;
+        }
+    }
+    return rows;
+}
+
+// Ask which format to export the incidents in, then write them in it
+void exportIncidentsInFormat() {
+    printf("1. Incidents file (text)\n");
+    printf("2. Parquet\n");
+    printf("3. Arrow IPC (a columnar copy of the store)\n\n");
+    int format = validateChoiceInput("Enter the format (1-3)", 1, 3);
+    if (format == 1) {
+        exportIncidents();
+    } else if (format == 2) {
+        exportIncidentsParquet();
+    } else {
+        exportIncidentsArrow();
+    }
+}
+
+// Write every loaded incident to a file of the user's choice, in the incidents file format and current schema
+void exportIncidents() {
+    char path[MAX_STRING_LENGTH];
+    validateStringInput(path, MAX_STRING_LENGTH, "Enter the file to export to (e.g., backup.txt)");
+
+#ifdef __linux__
+    // Truncating the destination must not be able to empty the source
+    struct stat sourceStat, destinationStat;
+    if (stat(DATA_FILE, &sourceStat) == 0 && stat(path, &destinationStat) == 0
+        && sourceStat.st_dev == destinationStat.st_dev && sourceStat.st_ino == destinationStat.st_ino) {
+        printf(ANSI_COLOR_RED "Error: %s is the incidents file itself.\n" ANSI_COLOR_RESET, path);
+        return;
+    }
+    // The file's own length, since an instance attached to a shared store never read it and has no offset into it
+    long length;
+    long end = sealedIncidentBytes();
+    if (end == 0 && incidentCount > 0) {
+        printf(ANSI_COLOR_RED "Error: Could not read %s.\n" ANSI_COLOR_RESET, DATA_FILE);
+        return;
+    }
+    int source = openIncidentExport(end, &length);
+    if (source < 0) {
+        printf(ANSI_COLOR_RED "Error: Could not read %s.\n" ANSI_COLOR_RESET, DATA_FILE);
+        return;
+    }
+    int destination = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (destination < 0) {
+        close(source);
+        printf(ANSI_COLOR_RED "Error: Could not open %s for writing.\n" ANSI_COLOR_RESET, path);
+        return;
+    }
+    // The kernel copies from the page cache straight into the destination
+    off_t offset = 0;
+    while (offset < length && sendfile(destination, source, &offset, (size_t)(length - offset)) > 0) {
+    }
+    int exported = offset == length;
+    exported = close(destination) == 0 && exported;
+    close(source);
+    if (!exported) {
+        printf(ANSI_COLOR_RED "Error: Could not write all of %s.\n" ANSI_COLOR_RESET, path);
+        return;
+    }
+    printf(ANSI_COLOR_GREEN "Exported %d incident%s (%ld bytes%s) to %s.\n" ANSI_COLOR_RESET, incidentCount,
+           incidentCount == 1 ? "" : "s", length, legacyIncidentRows > 0 ? ", older rows migrated" : "", path);
+#else
+    if (strcmp(path, DATA_FILE) == 0) {
+        printf(ANSI_COLOR_RED "Error: %s is the incidents file itself.\n" ANSI_COLOR_RESET, path);
+        return;
+    }
+    FILE *source = fopen(DATA_FILE, "r");
+    FILE *destination = source != NULL ? fopen(path, "w") : NULL;
+    if (destination == NULL) {
+        if (source != NULL) {
+            fclose(source);
+        }
+        printf(ANSI_COLOR_RED "Error: Could not export to %s.\n" ANSI_COLOR_RESET, path);
+        return;
+    }
+    int rows = migrateIncidentRows(source, incidentFileOffset, destination);
+    fclose(source);
+    if (fclose(destination) != 0) {
+        printf(ANSI_COLOR_RED "Error: Could not write all of %s.\n" ANSI_COLOR_RESET, path);
+        return;
+    }
+    printf(ANSI_COLOR_GREEN "Exported %d incident%s to %s.\n" ANSI_COLOR_RESET, rows, rows == 1 ? "" : "s", path);
+#endif
+}
+
+// Write every loaded incident to a Parquet file with dictionary-encoded text columns, for columnar analytics tools
+void exportIncidentsParquet() {
+    char path[MAX_STRING_LENGTH];
+    validateStringInput(path, MAX_STRING_LENGTH, "Enter the Parquet file to export to (e.g., incidents.parquet)");
+    if (strcmp(path, DATA_FILE) == 0) {
+        printf(ANSI_COLOR_RED "Error: %s is the incidents file itself.\n" ANSI_COLOR_RESET, path);
+        return;
+    }
+    double started = monotonicSeconds();
+    int groupCount = (incidentCount + PARQUET_ROW_GROUP_ROWS - 1) / PARQUET_ROW_GROUP_ROWS;
+    struct ParquetRowGroup* groups = calloc((size_t)(groupCount > 0 ? groupCount : 1), sizeof(struct ParquetRowGroup));
+    FILE *file = groups != NULL ? fopen(path, "wb") : NULL;
+    if (file == NULL) {
+        free(groups);
+        printf(ANSI_COLOR_RED "Error: Could not open %s for writing.\n" ANSI_COLOR_RESET, path);
+        return;
+    }
+    for (int g = 0; g < groupCount; g++) {
+        groups[g].first = g * PARQUET_ROW_GROUP_ROWS;
+        groups[g].count = incidentCount - groups[g].first < PARQUET_ROW_GROUP_ROWS ? incidentCount - groups[g].first
+                                                                                     : PARQUET_ROW_GROUP_ROWS;
+    }
+
+    // Only as many row groups as threads are in memory at once; each is written out, then dropped
+    int threadCount = optimizerThreadCount();
+    long offset = (long)fwrite(PARQUET_MAGIC, 1, 4, file);
+    int written = offset == 4;
+    for (int wave = 0; wave < groupCount && written; wave += threadCount) {
+        int end = wave + threadCount < groupCount ? wave + threadCount : groupCount;
+#ifdef __linux__
+        pthread_t threads[MAX_OPTIMIZER_THREADS];
+        int threadStarted[MAX_OPTIMIZER_THREADS] = { 0 };
+        for (int g = wave + 1; g < end; g++) {
+            threadStarted[g - wave] = pthread_create(&threads[g - wave], NULL, encodeParquetRowGroup, &groups[g]) == 0;
+        }
+        encodeParquetRowGroup(&groups[wave]);
+        for (int g = wave + 1; g < end; g++) {
+            if (threadStarted[g - wave]) {
+                pthread_join(threads[g - wave], NULL);
+            } else {
+                encodeParquetRowGroup(&groups[g]);
+            }
+        }
+#else
+        for (int g = wave; g < end; g++) {
+            encodeParquetRowGroup(&groups[g]);
+        }
+#endif
+        for (int g = wave; g < end; g++) {
+            struct ParquetRowGroup* group = &groups[g];
+            written = written && !group->out.failed
+                      && fwrite(group->out.bytes, 1, group->out.length, file) == group->out.length;
+            for (int c = 0; c < PARQUET_COLUMNS; c++) {
+                if (group->chunks[c].dictionaryOffset >= 0) {
+                    group->chunks[c].dictionaryOffset += offset;
+                }
+                group->chunks[c].dataOffset += offset;
+            }
+            offset += (long)group->out.length;
+            free(group->out.bytes);
+            group->out.bytes = NULL;
+        }
+    }
+
+    struct ByteBuffer footer = { NULL, 0, 0, 0 };
+    writeParquetFooter(&footer, groups, groupCount);
+    byteBufferLittleEndian(&footer, footer.length, 4);
+    byteBufferAppend(&footer, PARQUET_MAGIC, 4);
+    written = written && !footer.failed && fwrite(footer.bytes, 1, footer.length, file) == footer.length;
+    offset += (long)footer.length;
+    written = fclose(file) == 0 && written;
+    for (int g = 0; g < groupCount; g++) {
+        free(groups[g].out.bytes);
+    }
+    free(footer.bytes);
+    free(groups);
+    if (!written) {
+        remove(path);
+        printf(ANSI_COLOR_RED "Error: Could not write %s.\n" ANSI_COLOR_RESET, path);
+        return;
+    }
+    printf(ANSI_COLOR_GREEN "Exported %d incident%s in %d row group%s (%ld bytes) to %s in %.2f s.\n" ANSI_COLOR_RESET,
+           incidentCount, incidentCount == 1 ? "" : "s", groupCount, groupCount == 1 ? "" : "s", offset, path,
+           monotonicSeconds() - started);
+}
+
+// Encode the column chunks of one row group into its buffer; a failure is left in the buffer's flag
+void* encodeParquetRowGroup(void* argument) {
+    struct ParquetRowGroup* group = argument;
+    int count = group->count;
+    struct ByteBuffer page = { NULL, 0, 0, 0 };
+    int* codes = malloc((size_t)count * sizeof(int));
+    const char** entries = malloc((size_t)count * sizeof(const char*));
+    int* variants = malloc((size_t)count * sizeof(int));
+    int localCount = areaKeyCount > incidentTypeCount ? areaKeyCount : incidentTypeCount;
+    localCount = localCount > 24 * 60 ? localCount : 24 * 60;
+    int* local = malloc((size_t)localCount * sizeof(int));
+    char (*times)[MAX_TIME_LENGTH] = malloc(24 * 60 * sizeof(*times));
+    if (codes == NULL || entries == NULL || variants == NULL || local == NULL || times == NULL) {
+        group->out.failed = 1;
+        goto done;
+    }
+
+    for (int column = 0; column < PARQUET_COLUMNS; column++) {
+        page.length = 0;
+        if (parquetColumns[column].dictionary) {
+            int entryCount = 0;
+            for (int i = 0; i < localCount; i++) {
+                local[i] = -1;
+            }
+            for (int i = 0; i < count; i++) {
+                int position = group->first + i;
+                const struct IncidentHot* hot = &incidentHot[position];
+                if (column == PCOL_AREA) {
+                    // The area dictionary ignores case, so spellings of one area are chained behind its first one
+                    const char* area = incidentCold[position].area;
+                    int added = local[hot->areaId] < 0;
+                    int code = parquetDictionaryCode(local, hot->areaId, area, entries, &entryCount);
+                    if (added) {
+                        variants[code] = -1;
+                    }
+                    while (strcmp(entries[code], area) != 0) {
+                        if (variants[code] < 0) {
+                            variants[code] = entryCount;
+                            variants[entryCount] = -1;
+                            entries[entryCount++] = area;
+                        }
+                        code = variants[code];
+                    }
+                    codes[i] = code;
+                } else if (column == PCOL_TYPE) {
+                    codes[i] = parquetDictionaryCode(local, hot->typeId, incidentTypes[hot->typeId], entries,
+                                                     &entryCount);
+                } else if (column == PCOL_TIME) {
+                    snprintf(times[hot->timeMinutes], MAX_TIME_LENGTH, "%02d:%02d", hot->timeMinutes / 60,
+                             hot->timeMinutes % 60);
+                    codes[i] = parquetDictionaryCode(local, hot->timeMinutes, times[hot->timeMinutes], entries,
+                                                     &entryCount);
+                } else {
+                    codes[i] = parquetDictionaryCode(local, hot->status, statusName(hot->status), entries,
+                                                     &entryCount);
+                }
+            }
+            encodeParquetDictionaryChunk(group, column, &page, codes, entries, entryCount);
+            continue;
+        }
+        for (int i = 0; i < count; i++) {
+            int position = group->first + i;
+            if (column == PCOL_ID) {
+                byteBufferLittleEndian(&page, (unsigned int)incidentHot[position].id, 4);
+            } else if (column == PCOL_PRIORITY) {
+                byteBufferLittleEndian(&page, incidentHot[position].priority, 4);
+            } else if (column == PCOL_REPORTED) {
+                byteBufferLittleEndian(&page, (unsigned long long)incidentCold[position].reported, 8);
+            } else {
+                const char* description = descriptionAt(position);
+                size_t length = strlen(description);
+                byteBufferLittleEndian(&page, length, 4);
+                byteBufferAppend(&page, description, length);
+            }
+        }
+        encodeParquetPlainChunk(group, column, &page);
+    }
+    group->out.failed = group->out.failed || page.failed;
+
+done:
+    free(page.bytes);
+    free(codes);
+    free(entries);
+    free(variants);
+    free(local);
+    free(times);
+    return NULL;
+}
+
+// Code of a value in a row group's dictionary, found through its store id and added on first sight
+int parquetDictionaryCode(int* local, int id, const char* text, const char** entries, int* entryCount) {
+    if (local[id] < 0) {
+        local[id] = *entryCount;
+        entries[(*entryCount)++] = text;
+    }
+    return local[id];
+}
+
+// Append a column chunk as a dictionary page of its distinct strings and a data page of bit-packed codes
+void encodeParquetDictionaryChunk(struct ParquetRowGroup* group, int column, struct ByteBuffer* page, const int* codes,
+                                  const char** entries, int entryCount) {
+    struct ParquetChunk* chunk = &group->chunks[column];
+    long start = (long)group->out.length;
+    page->length = 0;
+    for (int e = 0; e < entryCount; e++) {
+        size_t length = strlen(entries[e]);
+        byteBufferLittleEndian(page, length, 4);
+        byteBufferAppend(page, entries[e], length);
+    }
+    chunk->dictionaryOffset = start;
+    writeParquetPageHeader(&group->out, PARQUET_DICTIONARY_PAGE, page->length, entryCount, PARQUET_PLAIN);
+    byteBufferAppend(&group->out, page->bytes, page->length);
+
+    // One bit-packed run of the RLE/bit-packing hybrid, in groups of eight codes
+    int width = 1;
+    while (width < 32 && (1 << width) < entryCount) {
+        width++;
+    }
+    int runs = (group->count + 7) / 8;
+    page->length = 0;
+    byteBufferByte(page, (unsigned char)width);
+    byteBufferVarint(page, (unsigned long long)runs << 1 | 1);
+    unsigned long long bits = 0;
+    int bitCount = 0;
+    for (int i = 0; i < runs * 8; i++) {
+        bits |= (unsigned long long)(i < group->count ? codes[i] : 0) << bitCount;
+        bitCount += width;
+        while (bitCount >= 8) {
+            byteBufferByte(page, (unsigned char)(bits & 0xFF));
+            bits >>= 8;
+            bitCount -= 8;
+        }
+    }
+    chunk->dataOffset = (long)group->out.length;
+    writeParquetPageHeader(&group->out, PARQUET_DATA_PAGE, page->length, group->count, PARQUET_RLE_DICTIONARY);
+    byteBufferAppend(&group->out, page->bytes, page->length);
+    chunk->bytes = (long)group->out.length - start;
+}
+
+// Append a column chunk as one data page of plain values
+void encodeParquetPlainChunk(struct ParquetRowGroup* group, int column, const struct ByteBuffer* page) {
+    struct ParquetChunk* chunk = &group->chunks[column];
+    chunk->dictionaryOffset = -1;
+    chunk->dataOffset = (long)group->out.length;
+    writeParquetPageHeader(&group->out, PARQUET_DATA_PAGE, page->length, group->count, PARQUET_PLAIN);
+    byteBufferAppend(&group->out, page->bytes, page->length);
+    chunk->bytes = (long)group->out.length - chunk->dataOffset;
+}
+
+// Write the Thrift header of an uncompressed page; columns are required, so there are no level streams
+void writeParquetPageHeader(struct ByteBuffer* out, int pageType, size_t size, int values, int encoding) {
+    struct ThriftWriter writer = { out, { 0 }, -1 };
+    thriftBegin(&writer);
+    thriftInteger(&writer, 1, THRIFT_I32, pageType);
+    thriftInteger(&writer, 2, THRIFT_I32, (long long)size);
+    thriftInteger(&writer, 3, THRIFT_I32, (long long)size);
+    thriftField(&writer, pageType == PARQUET_DICTIONARY_PAGE ? 7 : 5, THRIFT_STRUCT);
+    thriftBegin(&writer);
+    thriftInteger(&writer, 1, THRIFT_I32, values);
+    thriftInteger(&writer, 2, THRIFT_I32, encoding);
+    if (pageType == PARQUET_DATA_PAGE) {
+        thriftInteger(&writer, 3, THRIFT_I32, PARQUET_RLE);
+        thriftInteger(&writer, 4, THRIFT_I32, PARQUET_RLE);
+    }
+    thriftEnd(&writer);
+    thriftEnd(&writer);
+}
+
+// Write the file metadata: the schema and where every column chunk of every row group is
+void writeParquetFooter(struct ByteBuffer* out, const struct ParquetRowGroup* groups, int groupCount) {
+    struct ThriftWriter writer = { out, { 0 }, -1 };
+    thriftBegin(&writer);
+    thriftInteger(&writer, 1, THRIFT_I32, 1);
+    thriftList(&writer, 2, THRIFT_STRUCT, PARQUET_COLUMNS + 1);
+    thriftBegin(&writer);
+    thriftBinary(&writer, 4, "incident");
+    thriftInteger(&writer, 5, THRIFT_I32, PARQUET_COLUMNS);
+    thriftEnd(&writer);
+    for (int c = 0; c < PARQUET_COLUMNS; c++) {
+        thriftBegin(&writer);
+        thriftInteger(&writer, 1, THRIFT_I32, parquetColumns[c].type);
+        thriftInteger(&writer, 3, THRIFT_I32, PARQUET_REQUIRED);
+        thriftBinary(&writer, 4, parquetColumns[c].name);
+        if (parquetColumns[c].type == PARQUET_BYTE_ARRAY) {
+            thriftInteger(&writer, 6, THRIFT_I32, PARQUET_UTF8);
+        }
+        thriftEnd(&writer);
+    }
+    thriftInteger(&writer, 3, THRIFT_I64, incidentCount);
+
+    thriftList(&writer, 4, THRIFT_STRUCT, groupCount);
+    for (int g = 0; g < groupCount; g++) {
+        const struct ParquetRowGroup* group = &groups[g];
+        long groupBytes = 0;
+        thriftBegin(&writer);
+        thriftList(&writer, 1, THRIFT_STRUCT, PARQUET_COLUMNS);
+        for (int c = 0; c < PARQUET_COLUMNS; c++) {
+            const struct ParquetChunk* chunk = &group->chunks[c];
+            long start = chunk->dictionaryOffset >= 0 ? chunk->dictionaryOffset : chunk->dataOffset;
+            groupBytes += chunk->bytes;
+            thriftBegin(&writer);
+            thriftInteger(&writer, 2, THRIFT_I64, start);
+            thriftField(&writer, 3, THRIFT_STRUCT);
+            thriftBegin(&writer);
+            thriftInteger(&writer, 1, THRIFT_I32, parquetColumns[c].type);
+            int dictionary = chunk->dictionaryOffset >= 0;
+            thriftList(&writer, 2, THRIFT_I32, dictionary ? 3 : 2);
+            byteBufferVarint(out, PARQUET_PLAIN << 1);
+            byteBufferVarint(out, PARQUET_RLE << 1);
+            if (dictionary) {
+                byteBufferVarint(out, PARQUET_RLE_DICTIONARY << 1);
+            }
+            thriftList(&writer, 3, THRIFT_BINARY, 1);
+            byteBufferVarint(out, strlen(parquetColumns[c].name));
+            byteBufferAppend(out, parquetColumns[c].name, strlen(parquetColumns[c].name));
+            thriftInteger(&writer, 4, THRIFT_I32, 0); // Uncompressed
+            thriftInteger(&writer, 5, THRIFT_I64, group->count);
+            thriftInteger(&writer, 6, THRIFT_I64, chunk->bytes);
+            thriftInteger(&writer, 7, THRIFT_I64, chunk->bytes);
+            thriftInteger(&writer, 9, THRIFT_I64, chunk->dataOffset);
+            if (dictionary) {
+                thriftInteger(&writer, 11, THRIFT_I64, chunk->dictionaryOffset);
+            }
+            thriftEnd(&writer);
+            thriftEnd(&writer);
+        }
+        thriftInteger(&writer, 2, THRIFT_I64, groupBytes);
+        thriftInteger(&writer, 3, THRIFT_I64, group->count);
+        thriftEnd(&writer);
+    }
+    thriftBinary(&writer, 6, "incident reporting system");
+    thriftEnd(&writer);
+}
+
+// Append bytes to a buffer, doubling its capacity as needed
+void byteBufferAppend(struct ByteBuffer* buffer, const void* bytes, size_t length) {
+    if (buffer->length + length > buffer->capacity) {
+        size_t newCapacity = buffer->capacity == 0 ? 4096 : buffer->capacity;
+        while (newCapacity < buffer->length + length) {
+            newCapacity *= 2;
+        }
+        unsigned char* grown = buffer->failed ? NULL : realloc(buffer->bytes, newCapacity);
+        if (grown == NULL) {
+            buffer->failed = 1;
+            return;
+        }
+        buffer->bytes = grown;
+        buffer->capacity = newCapacity;
+    }
+    memcpy(buffer->bytes + buffer->length, bytes, length);
+    buffer->length += length;
+}
+
+// Append one byte to a buffer
+void byteBufferByte(struct ByteBuffer* buffer, unsigned char byte) {
+    byteBufferAppend(buffer, &byte, 1);
+}
+
+// Append an unsigned LEB128 varint
+void byteBufferVarint(struct ByteBuffer* buffer, unsigned long long value) {
+    while (value >= 0x80) {
+        byteBufferByte(buffer, (unsigned char)(value | 0x80));
+        value >>= 7;
+    }
+    byteBufferByte(buffer, (unsigned char)value);
+}
+
+// Append the low bytes of a value, least significant first
+void byteBufferLittleEndian(struct ByteBuffer* buffer, unsigned long long value, int bytes) {
+    unsigned char encoded[8];
+    for (int b = 0; b < bytes; b++) {
+        encoded[b] = (unsigned char)(value >> (8 * b));
+    }
+    byteBufferAppend(buffer, encoded, (size_t)bytes);
+}
+
+// Open a struct: the top-level one, a list element, or the value of a field just written
+void thriftBegin(struct ThriftWriter* writer) {
+    writer->lastField[++writer->depth] = 0;
+}
+
+// Close the innermost open struct
+void thriftEnd(struct ThriftWriter* writer) {
+    byteBufferByte(writer->out, 0);
+    writer->depth--;
+}
+
+// Write a field header, as a delta from the previous field id when it fits
+void thriftField(struct ThriftWriter* writer, int id, int type) {
+    int delta = id - writer->lastField[writer->depth];
+    if (delta > 0 && delta <= 15) {
+        byteBufferByte(writer->out, (unsigned char)(delta << 4 | type));
+    } else {
+        byteBufferByte(writer->out, (unsigned char)type);
+        byteBufferVarint(writer->out, (unsigned long long)((id << 1) ^ (id >> 31)));
+    }
+    writer->lastField[writer->depth] = id;
+}
+
+// Write an i32 or i64 field, zigzag encoded
+void thriftInteger(struct ThriftWriter* writer, int id, int type, long long value) {
+    thriftField(writer, id, type);
+    byteBufferVarint(writer->out, (unsigned long long)value << 1 ^ (unsigned long long)(value >> 63));
+}
+
+// Write a string field
+void thriftBinary(struct ThriftWriter* writer, int id, const char* text) {
+    size_t length = strlen(text);
+    thriftField(writer, id, THRIFT_BINARY);
+    byteBufferVarint(writer->out, length);
+    byteBufferAppend(writer->out, text, length);
+}
+
+// Write a list field's header; its elements follow
+void thriftList(struct ThriftWriter* writer, int id, int elementType, int size) {
+    thriftField(writer, id, THRIFT_LIST);
+    if (size < 15) {
+        byteBufferByte(writer->out, (unsigned char)(size << 4 | elementType));
+    } else {
+        byteBufferByte(writer->out, (unsigned char)(0xF0 | elementType));
+        byteBufferVarint(writer->out, (unsigned long long)size);
+    }
+}
+
+// Write the store to an Arrow IPC file of the user's choice, for tools that read Arrow
+void exportIncidentsArrow() {
+    char path[MAX_STRING_LENGTH];
+    validateStringInput(path, MAX_STRING_LENGTH, "Enter the Arrow file to write (e.g., incidents.arrow)");
+    if (strcmp(path, DATA_FILE) == 0) {
+        printf(ANSI_COLOR_RED "Error: %s is the incidents file itself.\n" ANSI_COLOR_RESET, path);
+        return;
+    }
+    double started = monotonicSeconds();
+    long bytes;
+    if (!writeArrowSnapshot(path, &bytes)) {
+        printf(ANSI_COLOR_RED "Error: Could not write %s.\n" ANSI_COLOR_RESET, path);
+        return;
+    }
+    printf(ANSI_COLOR_GREEN "Copied %d incident%s into Arrow's layout and wrote them (%ld bytes) to %s in %.2f s.\n"
+           ANSI_COLOR_RESET, incidentCount, incidentCount == 1 ? "" : "s", bytes, path, monotonicSeconds() - started);
+}
+
+// Copy the store into Arrow's columnar layout and hand it over through the C Data Interface, as a struct array with
+// the Parquet export's columns. Every call converts all rows, since the store itself keeps its hot/cold records (which
+// the shared store, checkpoints and scans depend on); the copy stays valid while reports arrive, until the consumer
+// calls both release callbacks
+int exportIncidentArrow(struct ArrowSchema* schema, struct ArrowArray* array) {
+    static const char* formats[ARROW_COLUMNS] = { "i", "i", "i", "tts", "u", "c", "c", "tss:UTC" };
+    static const int dictionaryOf[ARROW_COLUMNS] = { -1, 0, 1, -1, -1, -1, 2, -1 };
+    struct ArrowSchemaExport* types = calloc(1, sizeof(struct ArrowSchemaExport));
+    struct ArrowArrayExport* data = calloc(1, sizeof(struct ArrowArrayExport));
+    if (types == NULL || data == NULL) {
+        free(types);
+        free(data);
+        return 0;
+    }
+    for (int c = 0; c < ARROW_COLUMNS; c++) {
+        struct ArrowSchema* column = &types->columns[c];
+        column->format = formats[c];
+        column->name = parquetColumns[c].name;
+        column->flags = c == PCOL_DESCRIPTION || c == PCOL_REPORTED ? ARROW_FLAG_NULLABLE : 0;
+        column->release = releaseArrowChild;
+        if (dictionaryOf[c] >= 0) {
+            struct ArrowSchema* values = &types->dictionaries[dictionaryOf[c]];
+            values->format = "u";
+            values->name = "";
+            values->release = releaseArrowChild;
+            column->dictionary = values;
+        }
+        types->columnPointers[c] = column;
+    }
+    *schema = (struct ArrowSchema){ "+s", "", NULL, 0, ARROW_COLUMNS, types->columnPointers, NULL,
+                                    releaseArrowSchema, types };
+
+    int rows = incidentCount;
+    size_t bitmapBytes = ((size_t)rows + 7) / 8;
+    int32_t* ids = ownArrowBuffer(data, (size_t)rows * sizeof(int32_t));
+    int32_t* areaCodes = ownArrowBuffer(data, (size_t)rows * sizeof(int32_t));
+    int32_t* typeCodes = ownArrowBuffer(data, (size_t)rows * sizeof(int32_t));
+    int32_t* seconds = ownArrowBuffer(data, (size_t)rows * sizeof(int32_t));
+    unsigned char* describedBits = ownArrowBuffer(data, bitmapBytes);
+    int32_t* descriptionOffsets = ownArrowBuffer(data, ((size_t)rows + 1) * sizeof(int32_t));
+    int8_t* priorities = ownArrowBuffer(data, (size_t)rows);
+    int8_t* statuses = ownArrowBuffer(data, (size_t)rows);
+    unsigned char* reportedBits = ownArrowBuffer(data, bitmapBytes);
+    int64_t* reported = ownArrowBuffer(data, (size_t)rows * sizeof(int64_t));
+    const char** areas = malloc(((size_t)rows + 1) * sizeof(const char*));
+    int* variants = malloc(((size_t)rows + 1) * sizeof(int));
+    int* local = malloc(((size_t)areaKeyCount + 1) * sizeof(int));
+    const char** typeNames = malloc(((size_t)incidentTypeCount + 1) * sizeof(const char*));
+
+    // Descriptions are copied next to each other, which Arrow's 32-bit offsets limit to 2 GB
+    size_t descriptionBytes = 0;
+    for (int i = 0; i < rows; i++) {
+        descriptionBytes += strlen(descriptionAt(i));
+    }
+    char* descriptions = descriptionBytes <= INT32_MAX ? ownArrowBuffer(data, descriptionBytes) : NULL;
+    int ready = ids != NULL && areaCodes != NULL && typeCodes != NULL && seconds != NULL && describedBits != NULL
+                && descriptionOffsets != NULL && priorities != NULL && statuses != NULL && reportedBits != NULL
+                && reported != NULL && areas != NULL && variants != NULL && local != NULL && typeNames != NULL
+                && descriptions != NULL;
+
+    int areaCount = 0;
+    long missingDescriptions = 0, missingReports = 0;
+    for (int i = 0; ready && i < areaKeyCount; i++) {
+        local[i] = -1;
+    }
+    for (int t = 0; ready && t < incidentTypeCount; t++) {
+        typeNames[t] = incidentTypes[t];
+    }
+    if (ready) {
+        descriptionOffsets[0] = 0;
+    }
+    for (int i = 0; ready && i < rows; i++) {
+        const struct IncidentHot* hot = &incidentHot[i];
+        ids[i] = hot->id;
+        typeCodes[i] = hot->typeId;
+        seconds[i] = hot->timeMinutes * 60;
+        priorities[i] = (int8_t)hot->priority;
+        statuses[i] = (int8_t)hot->status;
+
+        // As in the Parquet export, each spelling of a case-insensitive area gets its own dictionary value
+        const char* area = incidentCold[i].area;
+        int added = local[hot->areaId] < 0;
+        int code = parquetDictionaryCode(local, hot->areaId, area, areas, &areaCount);
+        if (added) {
+            variants[code] = -1;
+        }
+        while (strcmp(areas[code], area) != 0) {
+            if (variants[code] < 0) {
+                variants[code] = areaCount;
+                variants[areaCount] = -1;
+                areas[areaCount++] = area;
+            }
+            code = variants[code];
+        }
+        areaCodes[i] = code;
+
+        // An incident without a description or a report time has a null there
+        const char* description = descriptionAt(i);
+        size_t length = strlen(description);
+        descriptionOffsets[i + 1] = descriptionOffsets[i] + (int32_t)length;
+        memcpy(descriptions + descriptionOffsets[i], description, length);
+        if (i % 8 == 0) {
+            describedBits[i / 8] = 0;
+            reportedBits[i / 8] = 0;
+        }
+        if (incidentCold[i].description >= 0) {
+            describedBits[i / 8] |= (unsigned char)(1 << (i % 8));
+        } else {
+            missingDescriptions++;
+        }
+        reported[i] = incidentCold[i].reported;
+        if (reported[i] != 0) {
+            reportedBits[i / 8] |= (unsigned char)(1 << (i % 8));
+        } else {
+            missingReports++;
+        }
+    }
+    const char* statusNames[ARROW_STATUS_VALUES];
+    for (int s = 0; s < ARROW_STATUS_VALUES; s++) {
+        statusNames[s] = statusName(s);
+    }
+    ready = ready
+            && fillArrowStrings(data, &data->dictionaries[0], data->buffers[ARROW_COLUMNS], areas, areaCount)
+            && fillArrowStrings(data, &data->dictionaries[1], data->buffers[ARROW_COLUMNS + 1],
+                                typeNames, incidentTypeCount)
+            && fillArrowStrings(data, &data->dictionaries[2], data->buffers[ARROW_COLUMNS + 2], statusNames,
+                                ARROW_STATUS_VALUES);
+    free(areas);
+    free(variants);
+    free(local);
+    free(typeNames);
+    if (!ready) {
+        schema->release(schema);
+        for (int b = 0; b < data->ownedCount; b++) {
+            free(data->owned[b]);
+        }
+        free(data);
+        return 0;
+    }
+
+    const void* values[ARROW_COLUMNS] = { ids, areaCodes, typeCodes, seconds, descriptionOffsets, priorities,
+                                          statuses, reported };
+    for (int c = 0; c < ARROW_COLUMNS; c++) {
+        struct ArrowArray* column = &data->columns[c];
+        const void** buffers = data->buffers[c];
+        buffers[0] = c == PCOL_DESCRIPTION ? describedBits : c == PCOL_REPORTED ? reportedBits : NULL;
+        buffers[1] = values[c];
+        buffers[2] = descriptions;
+        *column = (struct ArrowArray){ rows, 0, 0, c == PCOL_DESCRIPTION ? 3 : 2, 0, buffers, NULL, NULL,
+                                       releaseArrowChildArray, NULL };
+        column->null_count = c == PCOL_DESCRIPTION ? missingDescriptions : c == PCOL_REPORTED ? missingReports : 0;
+        column->dictionary = dictionaryOf[c] >= 0 ? &data->dictionaries[dictionaryOf[c]] : NULL;
+        data->columnPointers[c] = column;
+    }
+    *array = (struct ArrowArray){ rows, 0, 0, 1, ARROW_COLUMNS, data->buffers[ARROW_COLUMNS + ARROW_DICTIONARIES],
+                                  data->columnPointers, NULL, releaseArrowArray, data };
+    return 1;
+}
+
+// Release an exported schema with its children
+void releaseArrowSchema(struct ArrowSchema* schema) {
+    struct ArrowSchemaExport* types = schema->private_data;
+    for (int c = 0; c < ARROW_COLUMNS; c++) {
+        if (types->columns[c].release != NULL) {
+            types->columns[c].release(&types->columns[c]);
+        }
+    }
+    free(types);
+    schema->release = NULL;
+}
+
+// Release an exported array with its children and every buffer they point at
+void releaseArrowArray(struct ArrowArray* array) {
+    struct ArrowArrayExport* data = array->private_data;
+    for (int c = 0; c < ARROW_COLUMNS; c++) {
+        if (data->columns[c].release != NULL) {
+            data->columns[c].release(&data->columns[c]);
+        }
+    }
+    for (int b = 0; b < data->ownedCount; b++) {
+        free(data->owned[b]);
+    }
+    free(data);
+    array->release = NULL;
+}
+
+// Mark a child schema released; its memory belongs to the parent
+void releaseArrowChild(struct ArrowSchema* schema) {
+    if (schema->dictionary != NULL && schema->dictionary->release != NULL) {
+        schema->dictionary->release(schema->dictionary);
+    }
+    schema->release = NULL;
+}
+
+// Mark a child array released; its buffers belong to the parent
+void releaseArrowChildArray(struct ArrowArray* array) {
+    if (array->dictionary != NULL && array->dictionary->release != NULL) {
+        array->dictionary->release(array->dictionary);
+    }
+    array->release = NULL;
+}
+
+// Allocate a buffer freed with an exported array, NULL if out of memory
+void* ownArrowBuffer(struct ArrowArrayExport* export, size_t bytes) {
+    if (export->ownedCount == ARROW_MAX_BUFFERS) {
+        return NULL;
+    }
+    void* buffer = malloc(bytes > 0 ? bytes : 1);
+    if (buffer != NULL) {
+        export->owned[export->ownedCount++] = buffer;
+    }
+    return buffer;
+}
+
+// Lay out strings as an Arrow utf8 array without nulls; returns 0 if out of memory
+int fillArrowStrings(struct ArrowArrayExport* export, struct ArrowArray* array, const void** buffers,
+                     const char** strings, int count) {
+    size_t bytes = 0;
+    for (int i = 0; i < count; i++) {
+        bytes += strlen(strings[i]);
+    }
+    int32_t* offsets = ownArrowBuffer(export, ((size_t)count + 1) * sizeof(int32_t));
+    char* text = ownArrowBuffer(export, bytes);
+    if (offsets == NULL || text == NULL || bytes > INT32_MAX) {
+        return 0;
+    }
+    offsets[0] = 0;
+    for (int i = 0; i < count; i++) {
+        size_t length = strlen(strings[i]);
+        memcpy(text + offsets[i], strings[i], length);
+        offsets[i + 1] = offsets[i] + (int32_t)length;
+    }
+    buffers[0] = NULL;
+    buffers[1] = offsets;
+    buffers[2] = text;
+    *array = (struct ArrowArray){ count, 0, 0, 3, 0, buffers, NULL, NULL, releaseArrowChildArray, NULL };
+    return 1;
+}
+
+// Bits of one value of a fixed-width Arrow format: c, s, i, l, time32 (tt.) or timestamp (ts.)
+int arrowFormatBits(const char* format) {
+    switch (format[0]) {
+        case 'c': return 8;
+        case 's': return 16;
+        case 'i': return 32;
+        case 't': return format[1] == 't' ? 32 : 64;
+        default: return 64;
+    }
+}
+
+// Write the store as an Arrow IPC file: the schema, a dictionary batch per dictionary column and one record batch,
+// all from the copy the C Data Interface export makes, so a reader gets exactly what a consumer in this process would.
+// The file is written beside the old snapshot and renamed over it, so a failure leaves the last good one in place
+int writeArrowSnapshot(const char* path, long* bytes) {
+    struct ArrowSchema schema;
+    struct ArrowArray array;
+    if (!exportIncidentArrow(&schema, &array)) {
+        return 0;
+    }
+    char temporary[MAX_STRING_LENGTH + 8];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+    FILE *file = fopen(temporary, "wb");
+    struct FlatBuilder builder = { NULL, 0, 0, 0 };
+    struct ByteBuffer dictionaryBlocks = { NULL, 0, 0, 0 };
+    unsigned char block[24];
+    unsigned char recordBlock[24];
+    struct ArrowIpcBuffer buffers[ARROW_MAX_BUFFERS];
+    int bufferCount;
+    long bodyLength;
+
+    // The magic is padded to eight bytes, then the stream begins with the schema
+    long offset = 0;
+    int written = file != NULL && fwrite(ARROW_MAGIC "\0\0", 1, 8, file) == 8;
+    offset = 8;
+    size_t header = buildArrowSchema(&builder, &schema);
+    written = written && writeArrowMessage(file, &offset, &builder, ARROW_HEADER_SCHEMA, header, NULL, 0, 0, block);
+
+    // Dictionary ids follow the columns' order, as buildArrowSchema numbers them
+    int dictionaryId = 0;
+    for (int c = 0; c < schema.n_children && written; c++) {
+        if (schema.children[c]->dictionary == NULL) {
+            continue;
+        }
+        const struct ArrowSchema* valueType = schema.children[c]->dictionary;
+        const struct ArrowArray* values = array.children[c]->dictionary;
+        builder.size = 0;
+        size_t data = buildArrowRecordBatch(&builder, &valueType, &values, 1, values->length, buffers, &bufferCount,
+                                            &bodyLength);
+        struct FlatField batch[2] = { { 8, dictionaryId++, 0 }, { 4, 0, data } };
+        header = flatTable(&builder, batch, 2);
+        written = writeArrowMessage(file, &offset, &builder, ARROW_HEADER_DICTIONARY, header, buffers, bufferCount,
+                                    bodyLength, block);
+        byteBufferAppend(&dictionaryBlocks, block, sizeof(block));
+    }
+    if (written) {
+        builder.size = 0;
+        header = buildArrowRecordBatch(&builder, (const struct ArrowSchema**)schema.children,
+                                       (const struct ArrowArray**)array.children, (int)schema.n_children,
+                                       array.length, buffers, &bufferCount, &bodyLength);
+        written = writeArrowMessage(file, &offset, &builder, ARROW_HEADER_RECORD_BATCH, header, buffers, bufferCount,
+                                    bodyLength, recordBlock);
+    }
+
+    // The footer repeats the schema and says where each batch starts, so readers can map the file
+    builder.size = 0;
+    size_t footerSchema = buildArrowSchema(&builder, &schema);
+    size_t dictionaries = flatVector(&builder, dictionaryBlocks.bytes, dictionaryBlocks.length, 8,
+                                     (int)(dictionaryBlocks.length / sizeof(block)));
+    size_t records = flatVector(&builder, recordBlock, sizeof(recordBlock), 8, 1);
+    struct FlatField footer[4] = { { 2, ARROW_METADATA_V5, 0 }, { 4, 0, footerSchema }, { 4, 0, dictionaries },
+                                   { 4, 0, records } };
+    flatFinish(&builder, flatTable(&builder, footer, 4));
+    struct ByteBuffer trailer = { NULL, 0, 0, 0 };
+    byteBufferLittleEndian(&trailer, builder.size, 4);
+    byteBufferAppend(&trailer, ARROW_MAGIC, 6);
+    written = written && !builder.failed && !dictionaryBlocks.failed && !trailer.failed
+              && fwrite(builder.bytes + builder.capacity - builder.size, 1, builder.size, file) == builder.size
+              && fwrite(trailer.bytes, 1, trailer.length, file) == trailer.length;
+    *bytes = offset + (long)builder.size + (long)trailer.length;
+    if (file != NULL) {
+        written = fflush(file) == 0 && !ferror(file) && written;
+#ifdef __linux__
+        written = written && fsync(fileno(file)) == 0;
+#endif
+        written = fclose(file) == 0 && written;
+        if (!written || rename(temporary, path) != 0) {
+            remove(temporary);
+            written = 0;
+        }
+    }
+    free(builder.bytes);
+    free(dictionaryBlocks.bytes);
+    free(trailer.bytes);
+    array.release(&array);
+    schema.release(&schema);
+    return written;
+}
+
+// Write one encapsulated IPC message, its flatbuffer header then its body buffers, and fill in its footer block
+int writeArrowMessage(FILE* file, long* offset, struct FlatBuilder* builder, int headerType, size_t header,
+                      const struct ArrowIpcBuffer* buffers, int bufferCount, long bodyLength, unsigned char* block) {
+    struct FlatField message[4] = { { 2, ARROW_METADATA_V5, 0 }, { 1, headerType, 0 }, { 4, 0, header },
+                                    { 8, bodyLength, 0 } };
+    flatFinish(builder, flatTable(builder, message, 4));
+    if (builder->failed) {
+        return 0;
+    }
+    // A continuation marker and the metadata length; the finished flatbuffer is already a multiple of eight bytes
+    struct ByteBuffer prefix = { NULL, 0, 0, 0 };
+    byteBufferLittleEndian(&prefix, 0xFFFFFFFFu, 4);
+    byteBufferLittleEndian(&prefix, builder->size, 4);
+    struct ByteBuffer entry = { NULL, 0, 0, 0 };
+    byteBufferLittleEndian(&entry, (unsigned long long)*offset, 8);
+    byteBufferLittleEndian(&entry, 8 + builder->size, 8);
+    byteBufferLittleEndian(&entry, (unsigned long long)bodyLength, 8);
+    int written = !prefix.failed && !entry.failed && fwrite(prefix.bytes, 1, prefix.length, file) == prefix.length
+                  && fwrite(builder->bytes + builder->capacity - builder->size, 1, builder->size, file) == builder->size;
+    if (written) {
+        memcpy(block, entry.bytes, entry.length);
+    }
+    free(prefix.bytes);
+    free(entry.bytes);
+
+    static const unsigned char padding[8] = { 0 };
+    for (int b = 0; b < bufferCount && written; b++) {
+        size_t length = (size_t)buffers[b].length;
+        size_t padded = (length + 7) & ~(size_t)7;
+        written = (length == 0 || fwrite(buffers[b].data, 1, length, file) == length)
+                  && fwrite(padding, 1, padded - length, file) == padded - length;
+    }
+    *offset += 8 + (long)builder->size + bodyLength;
+    return written;
+}
+
+// Build an IPC Schema table from an exported struct schema; dictionary columns are numbered in order from 0
+size_t buildArrowSchema(struct FlatBuilder* builder, const struct ArrowSchema* schema) {
+    size_t fields[ARROW_COLUMNS];
+    int dictionaryId = 0;
+    int count = schema->n_children < ARROW_COLUMNS ? (int)schema->n_children : ARROW_COLUMNS;
+    for (int c = 0; c < count; c++) {
+        const struct ArrowSchema* column = schema->children[c];
+        const char* format = column->dictionary != NULL ? column->dictionary->format : column->format;
+        size_t name = flatString(builder, column->name);
+        size_t children = flatReferences(builder, NULL, 0);
+        int typeType;
+        size_t type;
+        if (strcmp(format, "u") == 0) {
+            typeType = ARROW_TYPE_UTF8;
+            type = flatTable(builder, NULL, 0);
+        } else if (format[0] == 't' && format[1] == 't') {
+            struct FlatField time[2] = { { 2, ARROW_UNIT_SECOND, 0 }, { 4, 32, 0 } };
+            typeType = ARROW_TYPE_TIME;
+            type = flatTable(builder, time, 2);
+        } else if (format[0] == 't') {
+            struct FlatField timestamp[2] = { { 2, ARROW_UNIT_SECOND, 0 }, { 4, 0, flatString(builder, format + 4) } };
+            typeType = ARROW_TYPE_TIMESTAMP;
+            type = flatTable(builder, timestamp, 2);
+        } else {
+            struct FlatField integer[2] = { { 4, arrowFormatBits(format), 0 }, { 1, 1, 0 } };
+            typeType = ARROW_TYPE_INT;
+            type = flatTable(builder, integer, 2);
+        }
+        size_t dictionary = 0;
+        if (column->dictionary != NULL) {
+            struct FlatField index[2] = { { 4, arrowFormatBits(column->format), 0 }, { 1, 1, 0 } };
+            struct FlatField encoding[2] = { { 8, dictionaryId++, 0 }, { 4, 0, flatTable(builder, index, 2) } };
+            dictionary = flatTable(builder, encoding, 2);
+        }
+        struct FlatField field[6] = {
+            { 4, 0, name },
+            { 1, (column->flags & ARROW_FLAG_NULLABLE) != 0, 0 },
+            { 1, typeType, 0 },
+            { 4, 0, type },
+            { dictionary != 0 ? 4 : 0, 0, dictionary },
+            { 4, 0, children }
+        };
+        fields[c] = flatTable(builder, field, 6);
+    }
+    struct FlatField table[2] = { { 2, 0, 0 }, { 4, 0, flatReferences(builder, fields, count) } }; // Little-endian
+    return flatTable(builder, table, 2);
+}
+
+// Build an IPC RecordBatch table over exported arrays, listing the body buffers it describes
+size_t buildArrowRecordBatch(struct FlatBuilder* builder, const struct ArrowSchema** fields,
+                             const struct ArrowArray** columns, int count, long length,
+                             struct ArrowIpcBuffer* buffers, int* bufferCount, long* bodyLength) {
+    struct ByteBuffer nodes = { NULL, 0, 0, 0 };
+    struct ByteBuffer layout = { NULL, 0, 0, 0 };
+    *bufferCount = 0;
+    *bodyLength = 0;
+    for (int c = 0; c < count && *bufferCount + 3 <= ARROW_MAX_BUFFERS; c++) {
+        const struct ArrowArray* column = columns[c];
+        byteBufferLittleEndian(&nodes, (unsigned long long)column->length, 8);
+        byteBufferLittleEndian(&nodes, (unsigned long long)column->null_count, 8);
+
+        // Validity, then values, or offsets and characters for strings; a column without nulls has no bitmap
+        long sizes[3];
+        int parts = 0;
+        sizes[parts++] = column->null_count > 0 && column->buffers[0] != NULL ? (column->length + 7) / 8 : 0;
+        if (strcmp(fields[c]->format, "u") == 0) {
+            sizes[parts++] = (column->length + 1) * (long)sizeof(int32_t);
+            sizes[parts++] = ((const int32_t*)column->buffers[1])[column->length];
+        } else {
+            sizes[parts++] = column->length * arrowFormatBits(fields[c]->format) / 8;
+        }
+        for (int p = 0; p < parts; p++) {
+            buffers[*bufferCount].data = column->buffers[p];
+            buffers[*bufferCount].length = sizes[p];
+            (*bufferCount)++;
+            byteBufferLittleEndian(&layout, (unsigned long long)*bodyLength, 8);
+            byteBufferLittleEndian(&layout, (unsigned long long)sizes[p], 8);
+            *bodyLength += (sizes[p] + 7) & ~7L;
+        }
+    }
+    builder->failed = builder->failed || nodes.failed || layout.failed;
+    size_t nodeVector = flatVector(builder, nodes.bytes, nodes.length, 8, count);
+    size_t bufferVector = flatVector(builder, layout.bytes, layout.length, 8, *bufferCount);
+    free(nodes.bytes);
+    free(layout.bytes);
+    struct FlatField batch[3] = { { 8, length, 0 }, { 4, 0, nodeVector }, { 4, 0, bufferVector } };
+    return flatTable(builder, batch, 3);
+}
+
+// Make room for more bytes in front of a flatbuffer's content
+void flatReserve(struct FlatBuilder* builder, size_t bytes) {
+    if (builder->failed || builder->size + bytes <= builder->capacity) {
+        return;
+    }
+    size_t newCapacity = builder->capacity == 0 ? 1024 : builder->capacity;
+    while (newCapacity < builder->size + bytes) {
+        newCapacity *= 2;
+    }
+    unsigned char* grown = malloc(newCapacity);
+    if (grown == NULL) {
+        builder->failed = 1;
+        return;
+    }
+    if (builder->size > 0) {
+        memcpy(grown + newCapacity - builder->size, builder->bytes + builder->capacity - builder->size, builder->size);
+    }
+    free(builder->bytes);
+    builder->bytes = grown;
+    builder->capacity = newCapacity;
+}
+
+// Put bytes in front of a flatbuffer's content
+void flatPrepend(struct FlatBuilder* builder, const void* bytes, size_t length) {
+    flatReserve(builder, length);
+    if (builder->failed) {
+        return;
+    }
+    builder->size += length;
+    memcpy(builder->bytes + builder->capacity - builder->size, bytes, length);
+}
+
+// Pad with zeros so that the next `following` bytes end up aligned
+void flatPad(struct FlatBuilder* builder, size_t alignment, size_t following) {
+    static const unsigned char zeros[8] = { 0 };
+    size_t padding = (alignment - (builder->size + following) % alignment) % alignment;
+    flatPrepend(builder, zeros, padding);
+}
+
+// Put an aligned little-endian scalar in front
+void flatScalar(struct FlatBuilder* builder, long long value, int size) {
+    unsigned char bytes[8];
+    for (int b = 0; b < size; b++) {
+        bytes[b] = (unsigned char)((unsigned long long)value >> (8 * b));
+    }
+    flatPad(builder, (size_t)size, 0);
+    flatPrepend(builder, bytes, (size_t)size);
+}
+
+// Put a reference to an object built earlier in front; it points forward from where it is stored
+void flatReference(struct FlatBuilder* builder, size_t target) {
+    flatPad(builder, 4, 0);
+    flatScalar(builder, (long long)(builder->size + 4 - target), 4);
+}
+
+// Build a string, returning its position
+size_t flatString(struct FlatBuilder* builder, const char* text) {
+    size_t length = strlen(text);
+    flatPad(builder, 4, length + 1);
+    flatPrepend(builder, "", 1);
+    flatPrepend(builder, text, length);
+    flatScalar(builder, (long long)length, 4);
+    return builder->size;
+}
+
+// Build a vector of scalars or structs already laid out in order, returning its position
+size_t flatVector(struct FlatBuilder* builder, const void* elements, size_t length, size_t alignment, int count) {
+    flatPad(builder, alignment > 4 ? alignment : 4, length);
+    if (length > 0) {
+        flatPrepend(builder, elements, length);
+    }
+    flatScalar(builder, count, 4);
+    return builder->size;
+}
+
+// Build a vector of references to objects built earlier, returning its position
+size_t flatReferences(struct FlatBuilder* builder, const size_t* targets, int count) {
+    for (int i = count - 1; i >= 0; i--) {
+        flatReference(builder, targets[i]);
+    }
+    flatScalar(builder, count, 4);
+    return builder->size;
+}
+
+// Build a table from its fields in id order, with its vtable right before it, returning its position
+size_t flatTable(struct FlatBuilder* builder, const struct FlatField* fields, int count) {
+    size_t end = builder->size;
+    size_t positions[FLAT_MAX_FIELDS] = { 0 };
+    for (int f = count - 1; f >= 0; f--) {
+        if (fields[f].size == 0) {
+            continue;
+        }
+        if (fields[f].reference != 0) {
+            flatReference(builder, fields[f].reference);
+        } else {
+            flatScalar(builder, fields[f].value, fields[f].size);
+        }
+        positions[f] = builder->size;
+    }
+    flatScalar(builder, 0, 4);
+    size_t table = builder->size;
+    for (int f = count - 1; f >= 0; f--) {
+        flatScalar(builder, positions[f] != 0 ? (long long)(table - positions[f]) : 0, 2);
+    }
+    flatScalar(builder, (long long)(table - end), 2);
+    flatScalar(builder, 4 + 2 * count, 2);
+
+    // The table starts with the distance back to its vtable, which is the vtable's size
+    if (!builder->failed) {
+        unsigned char* start = builder->bytes + builder->capacity - table;
+        for (int b = 0; b < 4; b++) {
+            start[b] = (unsigned char)((4 + 2 * count) >> (8 * b));
+        }
+    }
+    return table;
+}
+
+// Put the reference to the root table in front, leaving the buffer a multiple of eight bytes
+void flatFinish(struct FlatBuilder* builder, size_t root) {
+    flatPad(builder, 8, 4);
+    flatReference(builder, root);
+}
+
+#ifdef __linux__
+// Open what an export of the first bytes of the incidents file consists of, setting its length. Once every row is in
+// the current schema that is the file itself, sent as stored; otherwise the rows are migrated to a temporary file
+int openIncidentExport(long end, long* length) {
+    int source = open(DATA_FILE, O_RDONLY);
+    if (source < 0 || legacyIncidentRows == 0) {
+        *length = end;
+        return source;
+    }
+    FILE *file = fdopen(source, "r");
+    FILE *migrated = file != NULL ? tmpfile() : NULL;
+    if (migrated == NULL) {
+        if (file != NULL) {
+            fclose(file);
+        } else {
+            close(source);
+        }
+        return -1;
+    }
+    migrateIncidentRows(file, end, migrated);
+    fclose(file);
+    *length = ftell(migrated);
+    // The temporary file is already unlinked; a duplicate descriptor keeps it until the export is done
+    int copy = fflush(migrated) == 0 && !ferror(migrated) ? dup(fileno(migrated)) : -1;
+    fclose(migrated);
+    return copy;
+}
+
+// Bytes at the start of the incidents file that no group commit is still writing
+long sealedIncidentBytes() {
+    int fd = open(DATA_FILE, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    struct stat fileStat;
+    flock(fd, LOCK_SH);
+    long bytes = fstat(fd, &fileStat) == 0 ? (long)fileStat.st_size : 0;
+    close(fd);
+    return bytes;
+}
+#endif
+
+// Split an incident into its hot and cold records at the end of the store
+int storeIncident(const struct Incident* incident) {
+    if (!reserveIncidentCapacity(incidentCount + 1)) {
+        return 0;
+    }
+    int typeId = findOrAddIncidentType(incident->type);
+    int areaId = findOrAddArea(incident->area);
+    if (typeId < 0 || areaId < 0) {
+        return 0;
+    }
+
+    struct IncidentHot* hot = &incidentHot[incidentCount];
+    hot->id = incident->id;
+    hot->areaId = areaId;
+    hot->typeId = (unsigned short)typeId;
+    hot->timeMinutes = (unsigned short)timeToMinutes(incident->time);
+    hot->status = STATUS_OPEN;
+    hot->priority = (unsigned char)(incident->priority >= PRIORITY_LOW && incident->priority <= PRIORITY_CRITICAL
+                                    ? incident->priority : PRIORITY_NORMAL);
+
+    strcpy(incidentCold[incidentCount].area, incident->area);
+    incidentCold[incidentCount].reported = incident->reported;
+    if (!storeDescription(incidentCount, incident->description)) {
+        return 0;
+    }
+    if (sharedStore != NULL) {
+        sharedHot[incidentCount] = *hot;
+    }
+    incidentCount++;
+    indexStoredIncident(incidentCount - 1);
+    return 1;
+}
+
+// Fold the incident just added at the end of the store into the statistics, indexes and queues
+void indexStoredIncident(int position) {
+    if (incidentCold[position].reported > lastCommitTime) {
+        lastCommitTime = incidentCold[position].reported;
+    }
+    if (!updateColumnStatistics(position)) {
+        // Statistics only guide planning; rebuild them later rather than fail the insert
+        refreshColumnStatistics();
+    }
+    if (deferredIndexFrom < 0 && rollupCubeValid && !updateRollupCube(position)) {
+        rollupCubeValid = 0;
+    }
+    sampleIncident(position);
+    if (deferredIndexFrom < 0 && textIndexValid && !indexDescription(position)) {
+        textIndexValid = 0;
+    }
+    if (idTableValid && !addIncidentId(position)) {
+        idTableValid = 0;
+    }
+    if (dispatchQueueReady && !pushDispatchQueue(position)) {
+        // The queue can be rebuilt from the store, so losing it does not lose the incident
+        dispatchQueueReady = 0;
+    }
+
+    // Fully built adaptive indexes stay current; partial ones catch up in maintainAdaptiveIndexes
+    for (int column = 0; column < QCOL_COUNT; column++) {
+        struct AdaptiveIndex* index = &adaptiveIndexes[column];
+        if (index->active && index->builtCount == position && !addToAdaptiveIndex(index, position)) {
+            dropAdaptiveIndex(column);
+        }
+    }
+}
+
+// Fold the rows an attaching instance left out into the rollup cube and text index, on their first use
+void buildDeferredIndexes() {
+    if (deferredIndexFrom < 0) {
+        return;
+    }
+    for (int position = deferredIndexFrom; position < incidentCount; position++) {
+        if (rollupCubeValid && !updateRollupCube(position)) {
+            rollupCubeValid = 0;
+        }
+        if (textIndexValid && !indexDescription(position)) {
+            textIndexValid = 0;
+        }
+    }
+    deferredIndexFrom = -1;
+}
+
+// Reassemble the incident stored at a position from its hot and cold records
+void loadIncident(int position, struct Incident* incident) {
+    const struct IncidentHot* hot = &incidentHot[position];
+    incident->id = hot->id;
+    strcpy(incident->area, incidentCold[position].area);
+    strcpy(incident->type, incidentTypes[hot->typeId]);
+    snprintf(incident->time, MAX_TIME_LENGTH, "%02d:%02d", hot->timeMinutes / 60, hot->timeMinutes % 60);
+    strcpy(incident->description, descriptionAt(position));
+    incident->priority = hot->priority;
+    incident->reported = incidentCold[position].reported;
+}
+
+// Description of the incident stored at a position ("" when it has none)
+const char* descriptionAt(int position) {
+    long offset = incidentCold[position].description;
+    return offset < 0 ? "" : &descriptionText[offset];
+}
+
+// Append a description to the text heap and point the cold record at it; returns 0 if out of memory
+int storeDescription(int position, const char* description) {
+    struct IncidentCold* cold = &incidentCold[position];
+    cold->description = -1;
+    cold->descriptionTerms = 0;
+    size_t length = strlen(description);
+    if (length == 0) {
+        return 1;
+    }
+
+    if (descriptionTextLength + length + 1 > descriptionTextCapacity) {
+        // A shared segment's regions are sized when it is created and cannot move
+        if (sharedStore != NULL) {
+            return 0;
+        }
+        size_t newCapacity = descriptionTextCapacity == 0 ? 65536 : descriptionTextCapacity;
+        while (newCapacity < descriptionTextLength + length + 1) {
+            newCapacity *= 2;
+        }
+        if (memoryQuotaReached(newCapacity - descriptionTextCapacity)) {
+            return 0;
+        }
+        char* grown = realloc(descriptionText, newCapacity);
+        if (grown == NULL) {
+            return 0;
+        }
+        descriptionText = grown;
+        descriptionTextCapacity = newCapacity;
+    }
+    memcpy(&descriptionText[descriptionTextLength], description, length + 1);
+    cold->description = (long)descriptionTextLength;
+    descriptionTextLength += length + 1;
+    return 1;
+}
+
+// Print one table row for the incident stored at a position
+void printIncidentRow(int position) {
+    struct Incident incident;
+    loadIncident(position, &incident);
+    printf("%-5d | " ANSI_COLOR_GREEN "%-30s" ANSI_COLOR_RESET " | "
+           ANSI_COLOR_RED "%-30s" ANSI_COLOR_RESET " | "
+           ANSI_COLOR_BLUE "%-20s" ANSI_COLOR_RESET " | "
+           "%s%-8s" ANSI_COLOR_RESET "\n",
+           incident.id, incident.area, incident.type, incident.time,
+           incident.priority >= 4 ? ANSI_COLOR_RED : (incident.priority == PRIORITY_NORMAL ? ANSI_COLOR_YELLOW : ""),
+           priorityName(incident.priority));
+}
+
+// Look up an incident type in the dictionary, adding it if it is new (-1 if out of memory or the dictionary is full)
+int findOrAddIncidentType(const char* type) {
+    // A restored store brings its types but no table, so the first lookup builds one over all of them
+    if ((incidentTypeCount + 1) * 2 > typeTableSize) {
+        int newSize = typeTableSize == 0 ? 64 : typeTableSize * 2;
+        while ((incidentTypeCount + 1) * 2 > newSize) {
+            newSize *= 2;
+        }
+        int* table = malloc((size_t)newSize * sizeof(int));
+        if (table == NULL) {
+            return -1;
+        }
+        for (int i = 0; i < newSize; i++) {
+            table[i] = -1;
+        }
+        for (int id = 0; id < incidentTypeCount; id++) {
+            int slot = (int)(hashString(incidentTypes[id]) & (unsigned int)(newSize - 1));
+            while (table[slot] >= 0) {
+                slot = (slot + 1) & (newSize - 1);
+            }
+            table[slot] = id;
+        }
+        free(typeTable);
+        typeTable = table;
+        typeTableSize = newSize;
+    }
+
+    int slot = (int)(hashString(type) & (unsigned int)(typeTableSize - 1));
+    while (typeTable[slot] >= 0) {
+        if (strcmp(incidentTypes[typeTable[slot]], type) == 0) {
+            return typeTable[slot];
+        }
+        slot = (slot + 1) & (typeTableSize - 1);
+    }
+
+    if (incidentTypeCount == MAX_INCIDENT_TYPES) {
+        return -1;
+    }
+    if (incidentTypeCount == incidentTypeCapacity) {
+        if (sharedStore != NULL) {
+            return -1;
+        }
+        int newCapacity = incidentTypeCapacity == 0 ? 16 : incidentTypeCapacity * 2;
+        void* grown = realloc(incidentTypes, (size_t)newCapacity * MAX_TYPE_LENGTH);
+        if (grown == NULL) {
+            return -1;
+        }
+        incidentTypes = grown;
+        incidentTypeCapacity = newCapacity;
+    }
+    strcpy(incidentTypes[incidentTypeCount], type);
+    typeTable[slot] = incidentTypeCount;
+    return incidentTypeCount++;
+}
+
+// Look up an area (case insensitive) in the area dictionary, adding it if new (-1 if out of memory)
+int findOrAddArea(const char* area) {
+    char key[MAX_AREA_LENGTH];
+    toLowerCopy(key, area, sizeof(key));
+
+    if ((areaKeyCount + 1) * 2 > areaKeyTableSize) {
+        int newSize = areaKeyTableSize == 0 ? 256 : areaKeyTableSize * 2;
+        int* table = malloc((size_t)newSize * sizeof(int));
+        if (table == NULL) {
+            return -1;
+        }
+        for (int i = 0; i < newSize; i++) {
+            table[i] = -1;
+        }
+        for (int id = 0; id < areaKeyCount; id++) {
+            int slot = (int)(hashString(areaKeys[id]) & (unsigned int)(newSize - 1));
+            while (table[slot] >= 0) {
+                slot = (slot + 1) & (newSize - 1);
+            }
+            table[slot] = id;
+        }
+        free(areaKeyTable);
+        areaKeyTable = table;
+        areaKeyTableSize = newSize;
+    }
+
+    int slot = (int)(hashString(key) & (unsigned int)(areaKeyTableSize - 1));
+    while (areaKeyTable[slot] >= 0) {
+        if (strcmp(areaKeys[areaKeyTable[slot]], key) == 0) {
+            return areaKeyTable[slot];
+        }
+        slot = (slot + 1) & (areaKeyTableSize - 1);
+    }
+
+    if (areaKeyCount == areaKeyCapacity) {
+        if (sharedStore != NULL) {
+            return -1;
+        }
+        int newCapacity = areaKeyCapacity == 0 ? 64 : areaKeyCapacity * 2;
+        char (*keys)[MAX_AREA_LENGTH] = realloc(areaKeys, (size_t)newCapacity * MAX_AREA_LENGTH);
+        if (keys == NULL) {
+            return -1;
+        }
+        areaKeys = keys;
+        areaKeyCapacity = newCapacity;
+    }
+    strcpy(areaKeys[areaKeyCount], key);
+    areaKeyTable[slot] = areaKeyCount;
+    return areaKeyCount++;
+}
+
+// Find the dictionary id of a lowercased area (-1 if it never occurs)
+int lookupArea(const char* key) {
+    if (areaKeyTableSize == 0) {
+        return -1;
+    }
+    int slot = (int)(hashString(key) & (unsigned int)(areaKeyTableSize - 1));
+    while (areaKeyTable[slot] >= 0) {
+        if (strcmp(areaKeys[areaKeyTable[slot]], key) == 0) {
+            return areaKeyTable[slot];
+        }
+        slot = (slot + 1) & (areaKeyTableSize - 1);
+    }
+    return -1;
+}
+
+// Find the rollup cell of an (area, type) pair, optionally adding an empty one (NULL if absent or out of memory)
+struct RollupCell* findRollupCell(int area, int type, int create) {
+    if (create && (rollupCellCount + 1) * 2 > rollupTableSize) {
+        int newSize = rollupTableSize == 0 ? 1024 : rollupTableSize * 2;
+        int* table = malloc((size_t)newSize * sizeof(int));
+        if (table == NULL) {
+            return NULL;
+        }
+        for (int i = 0; i < newSize; i++) {
+            table[i] = -1;
+        }
+        for (int c = 0; c < rollupCellCount; c++) {
+            unsigned int hash = (unsigned int)(rollupCells[c].area + 1) * 2654435761u
+                                ^ (unsigned int)(rollupCells[c].type + 1) * 40503u;
+            int slot = (int)(hash & (unsigned int)(newSize - 1));
+            while (table[slot] >= 0) {
+                slot = (slot + 1) & (newSize - 1);
+            }
+            table[slot] = c;
+        }
+        free(rollupTable);
+        rollupTable = table;
+        rollupTableSize = newSize;
+    }
+    if (rollupTableSize == 0) {
+        return NULL;
+    }
+
+    unsigned int hash = (unsigned int)(area + 1) * 2654435761u ^ (unsigned int)(type + 1) * 40503u;
+    int slot = (int)(hash & (unsigned int)(rollupTableSize - 1));
+    while (rollupTable[slot] >= 0) {
+        struct RollupCell* cell = &rollupCells[rollupTable[slot]];
+        if (cell->area == area && cell->type == type) {
+            return cell;
+        }
+        slot = (slot + 1) & (rollupTableSize - 1);
+    }
+    if (!create) {
+        return NULL;
+    }
+
+    if (rollupCellCount == rollupCellCapacity) {
+        int newCapacity = rollupCellCapacity == 0 ? 256 : rollupCellCapacity * 2;
+        struct RollupCell* grown = realloc(rollupCells, (size_t)newCapacity * sizeof(struct RollupCell));
+        if (grown == NULL) {
+            return NULL;
+        }
+        rollupCells = grown;
+        rollupCellCapacity = newCapacity;
+    }
+    struct RollupCell* cell = &rollupCells[rollupCellCount];
+    memset(cell, 0, sizeof(*cell));
+    cell->area = area;
+    cell->type = type;
+    rollupTable[slot] = rollupCellCount++;
+    return cell;
+}
+
+// Count one incident at a minute into a cell; returns 0 if out of memory
+int addToRollupCell(struct RollupCell* cell, int minute) {
+    if (cell->fenwick == NULL && cell->total >= ROLLUP_FENWICK_THRESHOLD) {
+        // Large cells trade the sorted list for a fixed-size tree with O(log n) updates
+        int* tree = calloc(MINUTES_PER_DAY + 1, sizeof(int));
+        if (tree == NULL) {
+            return 0;
+        }
+        for (long i = 0; i < cell->total; i++) {
+            for (int node = cell->minutes[i] + 1; node <= MINUTES_PER_DAY; node += node & -node) {
+                tree[node]++;
+            }
+        }
+        free(cell->minutes);
+        cell->minutes = NULL;
+        cell->capacity = 0;
+        cell->fenwick = tree;
+    }
+
+    if (cell->fenwick != NULL) {
+        for (int node = minute + 1; node <= MINUTES_PER_DAY; node += node & -node) {
+            cell->fenwick[node]++;
+        }
+        cell->total++;
+        return 1;
+    }
+
+    if (cell->total == cell->capacity) {
+        int newCapacity = cell->capacity == 0 ? 4 : cell->capacity * 2;
+        unsigned short* grown = realloc(cell->minutes, (size_t)newCapacity * sizeof(unsigned short));
+        if (grown == NULL) {
+            return 0;
+        }
+        cell->minutes = grown;
+        cell->capacity = newCapacity;
+    }
+    int low = 0, high = (int)cell->total;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (cell->minutes[middle] <= minute) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    memmove(&cell->minutes[low + 1], &cell->minutes[low], (size_t)(cell->total - low) * sizeof(unsigned short));
+    cell->minutes[low] = (unsigned short)minute;
+    cell->total++;
+    return 1;
+}
+
+// Incidents in a cell between two minutes of the day, inclusive
+long countRollupCell(const struct RollupCell* cell, int low, int high) {
+    if (low <= 0 && high >= MINUTES_PER_DAY - 1) {
+        return cell->total;
+    }
+    if (cell->fenwick != NULL) {
+        long count = 0;
+        for (int node = high + 1; node > 0; node -= node & -node) {
+            count += cell->fenwick[node];
+        }
+        for (int node = low; node > 0; node -= node & -node) {
+            count -= cell->fenwick[node];
+        }
+        return count;
+    }
+
+    // Sorted list: first position past high minus first position at or past low
+    int bounds[2];
+    for (int b = 0; b < 2; b++) {
+        int first = 0, last = (int)cell->total;
+        while (first < last) {
+            int middle = (first + last) / 2;
+            if (b == 0 ? cell->minutes[middle] < low : cell->minutes[middle] <= high) {
+                first = middle + 1;
+            } else {
+                last = middle;
+            }
+        }
+        bounds[b] = first;
+    }
+    return bounds[1] - bounds[0];
+}
+
+// Fold a stored incident into its cell and the three marginals above it; returns 0 if out of memory
+int updateRollupCube(int position) {
+    const struct IncidentHot* hot = &incidentHot[position];
+    int areas[4] = { hot->areaId, hot->areaId, ROLLUP_ALL, ROLLUP_ALL };
+    int types[4] = { hot->typeId, ROLLUP_ALL, hot->typeId, ROLLUP_ALL };
+    for (int c = 0; c < 4; c++) {
+        struct RollupCell* cell = findRollupCell(areas[c], types[c], 1);
+        if (cell == NULL || !addToRollupCell(cell, hot->timeMinutes)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Answer a global count(*) from the rollup cube: returns the cells read, or -1 if the plan needs a scan
+int rollupCubeLookup(const struct QueryPlan* plan, long* count) {
+    buildDeferredIndexes();
+    // The cube only counts the current store
+    if (!rollupCubeValid || !plan->aggregate || plan->groupBy >= 0 || plan->asOf >= 0) {
+        return -1;
+    }
+
+    // Only one = or ~ filter on area and on type, and any number of time ranges, map onto cells
+    const struct QueryPredicate* areaPredicate = NULL;
+    const struct QueryPredicate* typePredicate = NULL;
+    long low = 0, high = MINUTES_PER_DAY - 1;
+    for (int p = 0; p < plan->predicateCount; p++) {
+        const struct QueryPredicate* predicate = &plan->predicates[p];
+        int textual = predicate->op == QOP_EQ || predicate->op == QOP_CONTAINS;
+        if (predicate->column == QCOL_AREA && areaPredicate == NULL && textual) {
+            areaPredicate = predicate;
+        } else if (predicate->column == QCOL_TYPE && typePredicate == NULL && textual) {
+            typePredicate = predicate;
+        } else if (predicate->column == QCOL_TIME && predicate->op != QOP_NE) {
+            long from = 0, to = MINUTES_PER_DAY - 1;
+            switch (predicate->op) {
+                case QOP_EQ: from = to = predicate->low; break;
+                case QOP_LT: to = predicate->low - 1; break;
+                case QOP_LE: to = predicate->low; break;
+                case QOP_GT: from = predicate->low + 1; break;
+                case QOP_GE: from = predicate->low; break;
+                default: from = predicate->low; to = predicate->high; break;
+            }
+            low = from > low ? from : low;
+            high = to < high ? to : high;
+        } else {
+            return -1;
+        }
+    }
+
+    // Dictionary ids each filter keeps; an unfiltered column reads its marginal
+    static int areas[ROLLUP_MAX_CELLS];
+    static int types[ROLLUP_MAX_CELLS];
+    int areaMatches = 0, typeMatches = 0;
+    if (areaPredicate == NULL) {
+        areas[areaMatches++] = ROLLUP_ALL;
+    } else if (areaPredicate->op == QOP_EQ) {
+        int area = lookupArea(areaPredicate->text);
+        if (area >= 0) {
+            areas[areaMatches++] = area;
+        }
+    } else {
+        for (int area = 0; area < areaKeyCount; area++) {
+            if (strstr(areaKeys[area], areaPredicate->text) != NULL) {
+                if (areaMatches == ROLLUP_MAX_CELLS) {
+                    return -1;
+                }
+                areas[areaMatches++] = area;
+            }
+        }
+    }
+    if (typePredicate == NULL) {
+        types[typeMatches++] = ROLLUP_ALL;
+    } else {
+        for (int type = 0; type < incidentTypeCount; type++) {
+            if (matchTextPredicate(typePredicate, incidentTypes[type])) {
+                if (typeMatches == ROLLUP_MAX_CELLS) {
+                    return -1;
+                }
+                types[typeMatches++] = type;
+            }
+        }
+    }
+    if ((long)areaMatches * typeMatches > ROLLUP_MAX_CELLS) {
+        return -1;
+    }
+
+    *count = 0;
+    int cells = 0;
+    for (int a = 0; a < areaMatches; a++) {
+        for (int t = 0; t < typeMatches; t++) {
+            const struct RollupCell* cell = findRollupCell(areas[a], types[t], 0);
+            cells++;
+            if (cell != NULL && low <= high) {
+                *count += countRollupCell(cell, (int)low, (int)high);
+            }
+        }
+    }
+    return cells;
+}
+
+// Convert a validated HH:MM time to minutes since midnight
+int timeToMinutes(const char* time) {
+    int hour = 0, minute = 0;
+    sscanf(time, "%d:%d", &hour, &minute);
+    return hour * 60 + minute;
+}
+
+// Make sure the store columns can hold at least the given number of incidents
+int reserveIncidentCapacity(int capacity) {
+    if (capacity <= incidentCapacity) {
+        return 1;
+    }
+    if (sharedStore != NULL) {
+        // Columns of a shared store were allocated for the segment's full row capacity
+        return 0;
+    }
+
+    int newCapacity = incidentCapacity == 0 ? INITIAL_INCIDENT_CAPACITY : incidentCapacity;
+    while (newCapacity < capacity) {
+        newCapacity *= 2;
+    }
+    size_t recordBytes = sizeof(struct IncidentHot) + sizeof(struct IncidentCold);
+    if (memoryQuotaReached((size_t)(newCapacity - incidentCapacity) * recordBytes)) {
+        return 0;
+    }
+
+    size_t oldHotBytes = (size_t)incidentCapacity * sizeof(struct IncidentHot);
+    size_t oldColdBytes = (size_t)incidentCapacity * sizeof(struct IncidentCold);
+    size_t newHotBytes = (size_t)newCapacity * sizeof(struct IncidentHot);
+    size_t newColdBytes = (size_t)newCapacity * sizeof(struct IncidentCold);
+
+    struct IncidentHot* hot = allocateColumn(newHotBytes);
+    struct IncidentCold* cold = allocateColumn(newColdBytes);
+    if (hot == NULL || cold == NULL) {
+        freeColumn(hot, newHotBytes);
+        freeColumn(cold, newColdBytes);
+        return 0;
+    }
+
+    if (incidentCount > 0) {
+        memcpy(hot, incidentHot, (size_t)incidentCount * sizeof(struct IncidentHot));
+        memcpy(cold, incidentCold, (size_t)incidentCount * sizeof(struct IncidentCold));
+    }
+    freeColumn(incidentHot, oldHotBytes);
+    freeColumn(incidentCold, oldColdBytes);
+
+    incidentHot = hot;
+    incidentCold = cold;
+    incidentCapacity = newCapacity;
+    return 1;
+}
+
+// Read the huge page setting and count the NUMA nodes of this host
+void configureColumnAllocation() {
+    const char* mode = getenv(HUGE_PAGES_ENV);
+    if (mode != NULL) {
+        if (strcmp(mode, "off") == 0) {
+            hugePageMode = HUGE_PAGES_OFF;
+        } else if (strcmp(mode, "explicit") == 0) {
+            hugePageMode = HUGE_PAGES_EXPLICIT;
+        } else {
+            hugePageMode = HUGE_PAGES_TRANSPARENT;
+        }
+    }
+
+#ifdef __linux__
+    // Node numbers need not be contiguous, so the kernel's list of online nodes ("0-1,4") is read as ranges
+    FILE *online = fopen("/sys/devices/system/node/online", "r");
+    char list[256];
+    if (online != NULL && fgets(list, sizeof(list), online) != NULL) {
+        unsigned long mask = 0;
+        int highest = 0, count = 0;
+        char* range = list;
+        while (*range != '\0' && *range != '\n') {
+            char* next;
+            long first = strtol(range, &next, 10);
+            long last = *next == '-' ? strtol(next + 1, &next, 10) : first;
+            if (next == range || first < 0 || last < first) {
+                break;
+            }
+            for (long node = first; node <= last && node < MAX_NUMA_NODES; node++) {
+                mask |= 1UL << node;
+                highest = (int)node;
+                count++;
+            }
+            range = *next == ',' ? next + 1 : next;
+        }
+        if (mask != 0) {
+            numaNodeMask = mask;
+            numaHighestNode = highest;
+            numaNodeCount = count;
+        }
+    }
+    if (online != NULL) {
+        fclose(online);
+    }
+#endif
+}
+
+// Allocate a store column; large columns are mapped with huge pages and interleaved across NUMA nodes
+void* allocateColumn(size_t bytes) {
+#ifdef __linux__
+    if (hugePageMode != HUGE_PAGES_OFF && bytes >= HUGE_PAGE_SIZE) {
+        size_t length = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        void* column = MAP_FAILED;
+
+        if (hugePageMode == HUGE_PAGES_EXPLICIT) {
+            column = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        }
+        if (column == MAP_FAILED) {
+            // No reserved huge pages (or THP mode): fall back to transparent huge pages
+            column = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (column == MAP_FAILED) {
+                return NULL;
+            }
+#ifdef MADV_HUGEPAGE
+            madvise(column, length, MADV_HUGEPAGE);
+#endif
+        }
+
+#ifdef SYS_mbind
+        if (numaNodeCount > 1) {
+            // Spread pages over all online nodes so no socket's memory becomes the bottleneck
+            unsigned long nodeMask = numaNodeMask;
+            syscall(SYS_mbind, column, length, MPOL_INTERLEAVE, &nodeMask, (unsigned long)numaHighestNode + 2, 0);
+        }
+#endif
+        return column;
+    }
+#endif
+    return malloc(bytes > 0 ? bytes : 1);
+}
+
+// Release a column obtained from allocateColumn with the same size
+void freeColumn(void* column, size_t bytes) {
+    if (column == NULL) {
+        return;
+    }
+#ifdef __linux__
+    if (hugePageMode != HUGE_PAGES_OFF && bytes >= HUGE_PAGE_SIZE) {
+        munmap(column, (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE);
+        return;
+    }
+#endif
+    (void)bytes;
+    free(column);
+}
+
+// Map the store from the shared segment named by INCIDENTS_SHARED_STORE, loading the incidents file into it
+// first if the segment is new or the file changed since; returns 0 to load a private store instead
+int attachSharedStore() {
+#ifdef __linux__
+    const char* path = getenv(SHARED_STORE_ENV);
+    // A server worker's partition is private to it, and so is each municipality's store
+    if (path == NULL || path[0] == '\0' || serverWorkerCount > 0 || tenantCount > 0) {
+        return 0;
+    }
+    int fd = open(path, O_RDWR | O_CREAT, 0600);
+    if (fd < 0) {
+        printf(ANSI_COLOR_RED "Error: Could not open the shared store %s; loading a private copy.\n" ANSI_COLOR_RESET,
+               path);
+        return 0;
+    }
+
+    // Every attached instance holds a shared lock on the segment for as long as it runs. Only an instance that gets
+    // the lock exclusively, i.e. finds no one else attached, may create or reload the segment; the others must map it
+    // as it is, since rewriting regions someone reads unlocked (or truncating them away) is not safe
+    int alone = flock(fd, LOCK_EX | LOCK_NB) == 0;
+    if (!alone) {
+        flock(fd, LOCK_SH);
+    }
+    struct stat segmentStat, dataStat;
+    long dataBytes = stat(DATA_FILE, &dataStat) == 0 ? (long)dataStat.st_size : 0;
+    unsigned int recordSizes = (unsigned int)(sizeof(struct IncidentHot) << 16 | sizeof(struct IncidentCold));
+    struct SharedStoreHeader existing;
+    int valid = fstat(fd, &segmentStat) == 0 && (size_t)segmentStat.st_size >= sizeof(existing)
+                && pread(fd, &existing, sizeof(existing), 0) == (ssize_t)sizeof(existing)
+                && existing.magic == SHARED_STORE_MAGIC && existing.recordSizes == recordSizes
+                && existing.bytes == (size_t)segmentStat.st_size;
+    if (!alone && (!valid || existing.dataBytes != dataBytes)) {
+        close(fd);
+        printf(ANSI_COLOR_RED "Error: The shared store %s %s, and other instances are using it; loading a private copy.\n"
+               ANSI_COLOR_RESET, path, valid ? "was loaded from a different incidents file" : "was made by another build");
+        return 0;
+    }
+
+    size_t bytes = valid ? existing.bytes : 0;
+    if (!valid) {
+        // Rows are at least 8 bytes in the file; the segment is sparse, so unused capacity costs no memory
+        int rowCapacity = SHARED_STORE_MIN_ROWS;
+        while (rowCapacity < dataBytes / 8 + INITIAL_INCIDENT_CAPACITY) {
+            rowCapacity *= 2;
+        }
+        memset(&existing, 0, sizeof(existing));
+        bytes = layoutSharedStore(&existing, rowCapacity);
+        // No one else has it mapped, so the old contents can be cut away
+        if (ftruncate(fd, 0) != 0 || ftruncate(fd, (off_t)bytes) != 0) {
+            bytes = 0;
+        }
+    }
+    void* segment = bytes > 0 ? mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    struct IncidentHot* hot = segment != MAP_FAILED
+                              ? allocateColumn((size_t)existing.rowCapacity * sizeof(struct IncidentHot)) : NULL;
+    if (hot == NULL) {
+        if (segment != MAP_FAILED) {
+            munmap(segment, bytes);
+        }
+        close(fd);
+        printf(ANSI_COLOR_RED "Error: Could not map the shared store %s; loading a private copy.\n" ANSI_COLOR_RESET,
+               path);
+        return 0;
+    }
+
+    struct SharedStoreHeader* header = segment;
+    if (!valid) {
+        *header = existing;
+        pthread_mutexattr_t attributes;
+        pthread_mutexattr_init(&attributes);
+        pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+        pthread_mutex_init(&header->lock, &attributes);
+        pthread_mutexattr_destroy(&attributes);
+        header->recordSizes = recordSizes;
+    }
+
+    char* base = segment;
+    sharedStore = header;
+    sharedHot = (struct IncidentHot*)(base + header->hotOffset);
+    incidentHot = hot;
+    incidentCold = (struct IncidentCold*)(base + header->coldOffset);
+    incidentCapacity = header->rowCapacity;
+    incidentTypes = (char (*)[MAX_TYPE_LENGTH])(base + header->typeOffset);
+    incidentTypeCapacity = SHARED_STORE_TYPES;
+    areaKeys = (char (*)[MAX_AREA_LENGTH])(base + header->areaOffset);
+    areaKeyCapacity = header->rowCapacity;
+    descriptionText = base + header->descriptionOffset;
+    descriptionTextCapacity = header->descriptionCapacity;
+
+    if (!valid || header->dataBytes != dataBytes) {
+        // Only reached alone: the segment is (re)loaded from the incidents file before anyone else can attach
+        if (pthread_mutex_lock(&header->lock) == EOWNERDEAD) {
+            pthread_mutex_consistent(&header->lock);
+        }
+        incidentCount = incidentTypeCount = areaKeyCount = 0;
+        descriptionTextLength = 0;
+        incidentFileOffset = 0;
+        readIncidentsFromFile();
+        header->magic = SHARED_STORE_MAGIC;
+        unlockSharedStore();
+    } else {
+        // Attaching only copies the hot records; the larger derived indexes are built when first needed
+        deferredIndexFrom = 0;
+        syncSharedStore();
+    }
+    // Keep the descriptor, and with it a shared lock that tells later instances this one is attached
+    if (alone) {
+        flock(fd, LOCK_SH);
+    }
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+#ifdef __linux__
+// Place the regions of a segment for a row capacity; returns the segment size
+size_t layoutSharedStore(struct SharedStoreHeader* header, int rowCapacity) {
+    size_t offset = sizeof(struct SharedStoreHeader);
+    size_t* regions[] = { &header->hotOffset, &header->coldOffset, &header->typeOffset, &header->areaOffset,
+                          &header->descriptionOffset };
+    size_t sizes[] = { (size_t)rowCapacity * sizeof(struct IncidentHot), (size_t)rowCapacity * sizeof(struct IncidentCold),
+                       (size_t)SHARED_STORE_TYPES * MAX_TYPE_LENGTH, (size_t)rowCapacity * MAX_AREA_LENGTH,
+                       (size_t)rowCapacity * MAX_DESCRIPTION_LENGTH / 2 };
+    for (int r = 0; r < 5; r++) {
+        offset = (offset + SHARED_STORE_ALIGNMENT - 1) / SHARED_STORE_ALIGNMENT * SHARED_STORE_ALIGNMENT;
+        *regions[r] = offset;
+        offset += sizes[r];
+    }
+    header->rowCapacity = rowCapacity;
+    header->descriptionCapacity = sizes[4];
+    header->bytes = offset;
+    return offset;
+}
+#endif
+
+// Take the shared store lock and catch up with rows and changes published by other instances
+void lockSharedStore() {
+#ifdef __linux__
+    if (sharedStore == NULL) {
+        return;
+    }
+    if (pthread_mutex_lock(&sharedStore->lock) == EOWNERDEAD) {
+        // A writer died holding the lock; anything it had not published is simply not part of the store
+        pthread_mutex_consistent(&sharedStore->lock);
+    }
+
+    // Dictionaries first, since new rows refer to them; an entry re-added in place just joins the lookup table
+    while (incidentTypeCount < sharedStore->typeCount) {
+        char type[MAX_TYPE_LENGTH];
+        strcpy(type, incidentTypes[incidentTypeCount]);
+        if (findOrAddIncidentType(type) < 0) {
+            break;
+        }
+    }
+    while (areaKeyCount < sharedStore->areaCount) {
+        char key[MAX_AREA_LENGTH];
+        strcpy(key, areaKeys[areaKeyCount]);
+        if (findOrAddArea(key) < 0) {
+            break;
+        }
+    }
+    descriptionTextLength = sharedStore->descriptionLength;
+    while (incidentCount < sharedStore->rows) {
+        incidentHot[incidentCount] = sharedHot[incidentCount];
+        incidentCount++;
+        indexStoredIncident(incidentCount - 1);
+    }
+    readDispatchLog();
+#endif
+}
+
+// Publish what this instance added and release the shared store lock
+void unlockSharedStore() {
+#ifdef __linux__
+    if (sharedStore == NULL) {
+        return;
+    }
+    struct stat dataStat;
+    sharedStore->rows = incidentCount;
+    sharedStore->typeCount = incidentTypeCount;
+    sharedStore->areaCount = areaKeyCount;
+    sharedStore->descriptionLength = descriptionTextLength;
+    sharedStore->dataBytes = stat(DATA_FILE, &dataStat) == 0 ? (long)dataStat.st_size : 0;
+    pthread_mutex_unlock(&sharedStore->lock);
+#endif
+}
+
+// Take in other instances' incidents and dispatch changes without changing anything
+void syncSharedStore() {
+    lockSharedStore();
+    unlockSharedStore();
+}
+
+// Load the active store from the files in the current directory and build what is derived from them
+void openStore() {
+    if (!attachSharedStore()) {
+        // A checkpoint holds everything up to some point of both files; only their tails are replayed
+        restoredCheckpointRows = restoreCheckpoint() ? incidentCount : -1;
+        replayedIncidentRows = readIncidentsFromFile();
+    }
+    readDispatchLog();
+    collectIncidentVersions();
+    // Loading kept the statistics up to date row by row; only the histogram is redrawn over the final rows
+    rebuildTimeHistogram();
+    lastCompactionTime = time(NULL);
+    subscriptionCount = readSubscriptionsFromFile();
+    buildWatchAutomaton();
+    alertRuleCount = readAlertRulesFromFile();
+    warmRuleWindows();
+    if (!buildDispatchQueue()) {
+        printf(ANSI_COLOR_RED "Error: Not enough memory for the dispatch queue.\n" ANSI_COLOR_RESET);
+    }
+}
+
+// Finish the active store's pending compaction and checkpoint before the program exits
+void closeStore() {
+    maybeCompactIncidentFile(1);
+    maybeWriteCheckpoint(1);
+}
+
+// Read the municipalities hosted by this process; without a tenants file the current directory is the only store
+int readTenantsFromFile() {
+    FILE *file = fopen(TENANTS_FILE, "r");
+    if (file == NULL) {
+        return 0;
+    }
+
+    int count = 0;
+    char line[MAX_STRING_LENGTH * 3];
+    char directory[MAX_STRING_LENGTH * 2];
+    struct Tenant tenant;
+    while (fgets(line, sizeof(line), file) != NULL && count < MAX_TENANTS) {
+        if (line[0] == '#') {
+            continue;
+        }
+        memset(&tenant, 0, sizeof(tenant));
+        long memoryMegabytes = 0;
+        if (sscanf(line, "%99[^|]|%199[^|\r\n]|%ld|%ld|%d", tenant.name, directory, &memoryMegabytes,
+                   &tenant.queryMilliseconds, &tenant.optimizerThreads) < 2) {
+            continue;
+        }
+        tenant.memoryQuota = memoryMegabytes > 0 ? (size_t)memoryMegabytes * 1024 * 1024 : 0;
+        if (tenant.queryMilliseconds <= 0) {
+            tenant.queryMilliseconds = -1;
+        }
+
+        // Switching changes into the directory, so it is resolved now relative to where the program started
+#ifdef __linux__
+        tenant.directory = realpath(directory, NULL);
+#else
+        tenant.directory = strcmp(directory, ".") == 0 ? strdup(".") : NULL;
+#endif
+        if (tenant.directory == NULL) {
+            printf(ANSI_COLOR_RED "Error: The directory of %s (%s) cannot be used; skipping it.\n" ANSI_COLOR_RESET,
+                   tenant.name, directory);
+            continue;
+        }
+
+        struct Tenant* grown = realloc(tenants, (size_t)(count + 1) * sizeof(struct Tenant));
+        if (grown == NULL) {
+            free(tenant.directory);
+            break;
+        }
+        tenants = grown;
+        tenants[count++] = tenant;
+    }
+
+    fclose(file);
+    return count;
+}
+
+// Size of the globals listed in STORE_STATE
+size_t storeStateBytes() {
+    size_t bytes = 0;
+    STORE_STATE(STORE_STATE_BYTES)
+    return bytes;
+}
+
+// Copy the active store's globals out
+void saveStoreState(unsigned char* state) {
+    STORE_STATE(SAVE_STORE_STATE)
+}
+
+// Make a saved store the active one
+void loadStoreState(const unsigned char* state) {
+    STORE_STATE(LOAD_STORE_STATE)
+}
+
+// Make a municipality's store active, loading it on first use; returns 0 if its directory cannot be entered
+int switchTenant(int tenant) {
+    if (tenant == activeTenant) {
+        return 1;
+    }
+#ifdef __linux__
+    if (chdir(tenants[tenant].directory) != 0) {
+        return 0;
+    }
+#endif
+
+    clock_t now = clock();
+    if (activeTenant >= 0) {
+        struct Tenant* previous = &tenants[activeTenant];
+        previous->cpuSeconds += (double)(now - tenantClockMark) / CLOCKS_PER_SEC;
+        if (previous->state == NULL) {
+            previous->state = malloc(storeStateBytes());
+        }
+        if (previous->state == NULL) {
+            printf(ANSI_COLOR_RED "Error: Not enough memory to switch municipalities.\n" ANSI_COLOR_RESET);
+#ifdef __linux__
+            if (chdir(previous->directory) != 0) {
+                printf(ANSI_COLOR_RED "Error: Could not return to %s.\n" ANSI_COLOR_RESET, previous->directory);
+            }
+#endif
+            return 0;
+        }
+        previous->rows = incidentCount;
+        previous->memoryBytes = storeMemoryBytes();
+        saveStoreState(previous->state);
+    }
+    tenantClockMark = now;
+    activeTenant = tenant;
+
+    if (tenants[tenant].opened) {
+        loadStoreState(tenants[tenant].state);
+    } else {
+        loadStoreState(initialStoreState);
+        tenants[tenant].opened = 1;
+        openStore();
+    }
+    return 1;
+}
+
+// List the municipalities with their usage against quotas and switch to the chosen one
+void switchMunicipality() {
+    if (tenantCount == 0) {
+        printf("Only one municipality is hosted. Add lines to %s in the format:\n", TENANTS_FILE);
+        printf("  name|directory|memory quota in MB|query quota in ms|optimizer threads\n");
+        printf("Example: Cluj-Napoca|cluj|2048|500|4\n");
+        return;
+    }
+
+    // Time spent so far in the active one counts towards it
+    clock_t now = clock();
+    tenants[activeTenant].cpuSeconds += (double)(now - tenantClockMark) / CLOCKS_PER_SEC;
+    tenantClockMark = now;
+
+    printf("%-3s | %-30s | %-10s | %-17s | %-9s | %s\n", "#", "Municipality", "Incidents", "Memory (MB)",
+           "CPU (s)", "Query quota");
+    printf("------------------------------------------------------------------------------------------------\n");
+    for (int t = 0; t < tenantCount; t++) {
+        struct Tenant* tenant = &tenants[t];
+        if (t == activeTenant) {
+            tenant->rows = incidentCount;
+            tenant->memoryBytes = storeMemoryBytes();
+        }
+        char rows[MAX_STRING_LENGTH];
+        char memory[MAX_STRING_LENGTH];
+        char quota[MAX_STRING_LENGTH];
+        if (tenant->opened) {
+            snprintf(rows, sizeof(rows), "%d", tenant->rows);
+        } else {
+            snprintf(rows, sizeof(rows), "not open");
+        }
+        if (tenant->memoryQuota > 0) {
+            snprintf(memory, sizeof(memory), "%.1f / %zu", (double)tenant->memoryBytes / (1024.0 * 1024.0),
+                     tenant->memoryQuota / (1024 * 1024));
+        } else {
+            snprintf(memory, sizeof(memory), "%.1f", (double)tenant->memoryBytes / (1024.0 * 1024.0));
+        }
+        if (tenant->queryMilliseconds >= 0) {
+            snprintf(quota, sizeof(quota), "%ld ms", tenant->queryMilliseconds);
+        } else {
+            snprintf(quota, sizeof(quota), "none");
+        }
+        printf("%-3d | " ANSI_COLOR_GREEN "%-30s" ANSI_COLOR_RESET " | %-10s | %-17s | %-9.2f | %s%s\n",
+               t + 1, tenant->name, rows, memory, tenant->cpuSeconds, quota,
+               t == activeTenant ? ANSI_COLOR_YELLOW "  (current)" ANSI_COLOR_RESET : "");
+    }
+
+    int choice = validateChoiceInput("\nSwitch to municipality (0 to stay)", 0, tenantCount);
+    if (choice == 0 || choice - 1 == activeTenant) {
+        return;
+    }
+    if (!switchTenant(choice - 1)) {
+        printf(ANSI_COLOR_RED "Error: Could not switch to %s.\n" ANSI_COLOR_RESET, tenants[choice - 1].name);
+        return;
+    }
+    printf(ANSI_COLOR_GREEN "\nNow working in %s (%d incident%s).\n" ANSI_COLOR_RESET,
+           tenants[activeTenant].name, incidentCount, incidentCount == 1 ? "" : "s");
+}
+
+// Approximate bytes held by the active store's columns, dictionaries and indexes
+size_t storeMemoryBytes() {
+    return (size_t)incidentCapacity * (sizeof(struct IncidentHot) + sizeof(struct IncidentCold))
+           + descriptionTextCapacity
+           + (size_t)incidentTypeCapacity * MAX_TYPE_LENGTH + (size_t)typeTableSize * sizeof(int)
+           + (size_t)areaKeyCapacity * MAX_AREA_LENGTH + (size_t)areaKeyTableSize * sizeof(int)
+           + (size_t)idTableSize * sizeof(int)
+           + (size_t)(dispatchHeapCapacity + dispatchSlotCapacity + versionHeadCapacity) * sizeof(int)
+           + (size_t)versionCapacity * sizeof(struct IncidentVersion)
+           + (size_t)termCapacity * sizeof(struct TermPostings) + (size_t)termTableSize * sizeof(int)
+           + (size_t)rollupCellCapacity * sizeof(struct RollupCell) + (size_t)rollupTableSize * sizeof(int)
+           + (reservoir != NULL ? RESERVOIR_SIZE * sizeof(int) : 0)
+           + (reservoirOrdered != NULL ? RESERVOIR_SIZE * sizeof(int) : 0)
+           + (size_t)(columnStats.areaCapacity + columnStats.typeCapacity) * sizeof(long)
+           + adaptiveIndexMemory() + indexDataMemory();
+}
+
+// Bytes held inside term postings and rollup cells, beyond their tables
+size_t indexDataMemory() {
+    size_t bytes = 0;
+    for (int term = 0; term < termCount; term++) {
+        bytes += termPostings[term].capacity;
+    }
+    for (int cell = 0; cell < rollupCellCount; cell++) {
+        bytes += rollupCells[cell].fenwick != NULL ? (MINUTES_PER_DAY + 1) * sizeof(int)
+                 : (size_t)rollupCells[cell].capacity * sizeof(unsigned short);
+    }
+    return bytes;
+}
+
+// Whether growing the active store by some bytes would take its municipality past its memory quota
+int memoryQuotaReached(size_t extra) {
+    if (activeTenant < 0 || tenants[activeTenant].memoryQuota == 0) {
+        return 0;
+    }
+    tenants[activeTenant].overQuota = storeMemoryBytes() + extra > tenants[activeTenant].memoryQuota;
+    return tenants[activeTenant].overQuota;
+}
+
+// Read the port to serve on, 0 to run the interactive menu
+int configureServer() {
+    const char* port = getenv(SERVER_PORT_ENV);
+    if (port == NULL) {
+        return 0;
+    }
+    int number = atoi(port);
+    return number > 0 && number <= 65535 ? number : 0;
+}
+
+// Server worker owning an area; high hash bits, since the area table already slots keys by the low ones
+int areaWorker(const char* area) {
+    char key[MAX_AREA_LENGTH];
+    toLowerCopy(key, area, sizeof(key));
+    return (int)((hashString(key) >> 16) % (unsigned int)serverWorkerCount);
+}
+
+// Answer one request line against this worker's partition; returns 0 if a task was started that replies later
+int executeServerRequest(char* line, int origin, int connection, unsigned int generation, char* reply,
+                         size_t replySize) {
+    // REPORT area|type|HH:MM|priority|description, parsed like a file line with the id still to be assigned
+    static const struct IncidentLayout reportLayout = {
+        0, 6, { FIELD_ID, FIELD_AREA, FIELD_TYPE, FIELD_TIME, FIELD_PRIORITY, FIELD_DESCRIPTION }
+    };
+    if (strncmp(line, "REPORT ", 7) == 0) {
+        char fields[SERVER_MESSAGE_BYTES + 2];
+        snprintf(fields, sizeof(fields), "0|%s", line + 7);
+        struct Incident incident;
+        if (!parseIncidentLine(fields, &reportLayout, &incident) || !isValidTimeFormat(incident.time)) {
+            snprintf(reply, replySize, "ERR expected REPORT area|type|HH:MM|priority|description\n");
+            return 1;
+        }
+        if (!reserveIncidentCapacity(incidentCount + 1)) {
+            snprintf(reply, replySize, "ERR not enough memory\n");
+            return 1;
+        }
+        incident.id = getNextIncidentId();
+        incident.reported = nextCommitTime();
+#ifdef __linux__
+        if (startServerTask(runReportTask, origin, connection, generation, &incident)) {
+            return 0;
+        }
+#else
+        (void)origin;
+        (void)connection;
+        (void)generation;
+#endif
+        snprintf(reply, replySize, "ERR not enough memory\n");
+    } else if (strncmp(line, "COUNT ", 6) == 0) {
+        char key[MAX_AREA_LENGTH];
+        toLowerCopy(key, line + 6, sizeof(key));
+        int area = lookupArea(key);
+        long count = area >= 0 && area < columnStats.areaCapacity ? columnStats.areaCounts[area] : 0;
+        snprintf(reply, replySize, "OK %ld\n", count);
+    } else if (strncmp(line, "LIST ", 5) == 0) {
+        // The area's most recent incidents, newest first
+        char key[MAX_AREA_LENGTH];
+        toLowerCopy(key, line + 5, sizeof(key));
+        int area = lookupArea(key);
+        int positions[SERVER_LIST_LIMIT];
+        int found = 0;
+        for (int i = incidentCount - 1; i >= 0 && area >= 0 && found < SERVER_LIST_LIMIT; i--) {
+            if (incidentHot[i].areaId == area) {
+                positions[found++] = i;
+            }
+        }
+        size_t length = (size_t)snprintf(reply, replySize, "OK %d\n", found);
+        for (int i = 0; i < found && length < replySize; i++) {
+            const struct IncidentHot* hot = &incidentHot[positions[i]];
+            length += (size_t)snprintf(reply + length, replySize - length, "%d|%s|%s|%02d:%02d|%s|%s\n", hot->id,
+                                       incidentCold[positions[i]].area, incidentTypes[hot->typeId],
+                                       hot->timeMinutes / 60, hot->timeMinutes % 60, statusName(hot->status),
+                                       priorityName(hot->priority));
+        }
+    } else if (strcmp(line, "ROWS") == 0) {
+        // One worker's share of a STATS request
+        snprintf(reply, replySize, "ROWS %d %d\n", incidentCount, dispatchHeapCount);
+    } else {
+        snprintf(reply, replySize, "ERR commands are REPORT, COUNT <area>, LIST <area>, STATS, EXPORT and QUIT\n");
+    }
+    return 1;
+}
+
+// Start a worker per core and wait for them; returns the exit status for main, 1 once any worker has stopped
+int runServer(int port) {
+#ifdef __linux__
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    const char* configured = getenv(SERVER_WORKERS_ENV);
+    int workers = configured != NULL ? atoi(configured) : (int)processors;
+    if (workers < 1) {
+        workers = 1;
+    }
+    if (workers > MAX_SERVER_WORKERS) {
+        workers = MAX_SERVER_WORKERS;
+    }
+    // A client that disconnects mid-reply makes the write fail with EPIPE, which closes just that connection
+    signal(SIGPIPE, SIG_IGN);
+
+    // Rings are mapped before forking so every worker sees the same ones; untouched slots cost no memory
+    size_t bytes = sizeof(struct ServerShared) + (size_t)workers * (size_t)workers * sizeof(struct ServerRing);
+    void* mapped = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED) {
+        printf(ANSI_COLOR_RED "Error: Could not map the server's shared memory.\n" ANSI_COLOR_RESET);
+        return 1;
+    }
+    serverShared = mapped;
+    serverShared->workers = workers;
+    atomic_init(&serverShared->nextId, 1);
+    atomic_init(&serverShared->loaded, 0);
+    atomic_init(&serverShared->failed, 0);
+    for (int w = 0; w < workers; w++) {
+        serverShared->wakeFds[w] = eventfd(0, EFD_NONBLOCK);
+        if (serverShared->wakeFds[w] < 0) {
+            printf(ANSI_COLOR_RED "Error: Could not create the server's wakeup descriptors.\n" ANSI_COLOR_RESET);
+            return 1;
+        }
+    }
+
+    // A checkpoint image would only hold one partition, so workers always load from the files
+    checkpointPath[0] = '\0';
+    serverWorkerCount = workers;
+    printf("Serving incidents on port %d with %d worker%s...\n", port, workers, workers == 1 ? "" : "s");
+    fflush(stdout);
+    pid_t children[MAX_SERVER_WORKERS];
+    int started = 0;
+    while (started < workers) {
+        pid_t child = fork();
+        if (child == 0) {
+            serverWorker = started;
+            exit(runServerWorker(port));
+        }
+        if (child < 0) {
+            printf(ANSI_COLOR_RED "Error: Could not start server worker %d.\n" ANSI_COLOR_RESET, started);
+            break;
+        }
+        children[started++] = child;
+    }
+
+    // Workers serve until stopped, so any of them exiting means the rest would forward into a dead ring
+    if (started == workers) {
+        int status;
+        pid_t exited = waitpid(-1, &status, 0);
+        for (int w = 0; w < started && exited > 0; w++) {
+            if (children[w] == exited) {
+                children[w] = 0;
+                printf(ANSI_COLOR_RED "Error: Server worker %d stopped; stopping the others.\n" ANSI_COLOR_RESET, w);
+            }
+        }
+    }
+    atomic_store(&serverShared->failed, 1);
+    for (int w = 0; w < started; w++) {
+        if (children[w] > 0) {
+            kill(children[w], SIGTERM);
+        }
+    }
+    while (wait(NULL) > 0);
+    return 1;
+#else
+    (void)port;
+    printf(ANSI_COLOR_RED "Error: Server mode needs Linux.\n" ANSI_COLOR_RESET);
+    return 1;
+#endif
+}
+
+#ifdef __linux__
+// Pin to a core, load this worker's partition, then serve it until the process is stopped; returns the exit status
+int runServerWorker(int port) {
+    unsigned long cpuMask[MAX_SERVER_WORKERS / (8 * sizeof(unsigned long)) + 1] = { 0 };
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    int core = processors > 0 ? serverWorker % (int)processors : 0;
+    cpuMask[core / (8 * sizeof(unsigned long))] |= 1UL << (core % (8 * sizeof(unsigned long)));
+    syscall(SYS_sched_setaffinity, 0, sizeof(cpuMask), cpuMask);
+
+    // Everything that can fail happens before this worker counts as loaded; a failure stops every worker
+    openStore();
+    if (!startCommitLog()) {
+        printf(ANSI_COLOR_RED "Error: Worker %d could not open %s for group commit.\n" ANSI_COLOR_RESET,
+               serverWorker, DATA_FILE);
+        atomic_store(&serverShared->failed, 1);
+        return 1;
+    }
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int enable = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable));
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons((unsigned short)port);
+    serverEpoll = epoll_create1(0);
+    if (listener < 0 || bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0
+        || listen(listener, SOMAXCONN) != 0 || serverEpoll < 0) {
+        printf(ANSI_COLOR_RED "Error: Worker %d could not listen on port %d.\n" ANSI_COLOR_RESET, serverWorker, port);
+        atomic_store(&serverShared->failed, 1);
+        return 1;
+    }
+
+    int nextId = highestFileIncidentId + 1;
+    int shared = atomic_load(&serverShared->nextId);
+    while (shared < nextId && !atomic_compare_exchange_weak(&serverShared->nextId, &shared, nextId));
+    atomic_fetch_add(&serverShared->loaded, 1);
+    printf("Worker %d on core %d: %d incident%s in its partition\n", serverWorker, core, incidentCount,
+           incidentCount == 1 ? "" : "s");
+    fflush(stdout);
+    struct timespec pause = { 0, 1000000 };
+    while (atomic_load(&serverShared->loaded) < serverShared->workers) {
+        if (atomic_load(&serverShared->failed)) {
+            return 1;
+        }
+        nanosleep(&pause, NULL);
+    }
+
+    fcntl(listener, F_SETFL, O_NONBLOCK);
+    struct epoll_event event = { EPOLLIN, { .fd = listener } };
+    epoll_ctl(serverEpoll, EPOLL_CTL_ADD, listener, &event);
+    int wakeFd = serverShared->wakeFds[serverWorker];
+    event.data.fd = wakeFd;
+    epoll_ctl(serverEpoll, EPOLL_CTL_ADD, wakeFd, &event);
+    event.data.fd = commitDoneFd;
+    epoll_ctl(serverEpoll, EPOLL_CTL_ADD, commitDoneFd, &event);
+
+    struct epoll_event events[SERVER_EVENTS];
+    while (1) {
+        // Left-over requests are retried shortly; their origins keep draining, so the rings free up
+        int ready = epoll_wait(serverEpoll, events, SERVER_EVENTS, serverBacklog ? 1 : -1);
+        int retry = serverBacklog;
+        int committed = 0;
+        if (retry) {
+            drainServerRings();
+        }
+        for (int e = 0; e < ready; e++) {
+            int fd = events[e].data.fd;
+            uint64_t count;
+            if (fd == listener) {
+                acceptServerConnections(listener);
+            } else if (fd == commitDoneFd) {
+                if (read(commitDoneFd, &count, sizeof(count)) == sizeof(count)) {
+                    commitInFlight = 0;
+                    committed = 1;
+                }
+            } else if (fd == wakeFd) {
+                // Reset the counter before draining, so a message published meanwhile wakes the loop again
+                if (read(wakeFd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+                    break;
+                }
+                drainServerRings();
+            } else {
+                if (events[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    readServerConnection(fd);
+                }
+                if (fd < serverConnectionCapacity && serverConnections[fd].open && (events[e].events & EPOLLOUT)) {
+                    // Requests held back behind a finished export run now
+                    int exporting = serverConnections[fd].exportFd >= 0;
+                    flushServerOutput(fd);
+                    if (exporting && serverConnections[fd].open && serverConnections[fd].exportFd < 0) {
+                        processServerInput(fd);
+                    }
+                }
+            }
+        }
+        // Tasks wait for a group commit or for room on a ring; everything that joined meanwhile is the next batch
+        if ((committed || retry) && suspendedTasks != NULL) {
+            resumeServerTasks();
+        }
+        startCommitBatch();
+    }
+    return 1;
+}
+
+// Run a request handler as a task; returns 0 if there was no memory for one
+int startServerTask(int (*run)(struct ServerTask* task), int origin, int connection, unsigned int generation,
+                    const struct Incident* incident) {
+    struct ServerTask* task = freeTasks;
+    if (task != NULL) {
+        freeTasks = task->next;
+    } else {
+        task = malloc(sizeof(struct ServerTask));
+        if (task == NULL) {
+            return 0;
+        }
+    }
+    task->run = run;
+    task->resumePoint = 0;
+    task->origin = origin;
+    task->connection = connection;
+    task->generation = generation;
+    task->incident = *incident;
+    if (task->run(task)) {
+        task->next = freeTasks;
+        freeTasks = task;
+    } else {
+        task->next = suspendedTasks;
+        suspendedTasks = task;
+    }
+    return 1;
+}
+
+// Give every suspended task a chance to continue, keeping those that suspend again
+void resumeServerTasks() {
+    // A reply can start the connection's next request, which adds a task while the list is walked
+    struct ServerTask* task = suspendedTasks;
+    suspendedTasks = NULL;
+    while (task != NULL) {
+        struct ServerTask* next = task->next;
+        if (task->run(task)) {
+            task->next = freeTasks;
+            freeTasks = task;
+        } else {
+            task->next = suspendedTasks;
+            suspendedTasks = task;
+        }
+        task = next;
+    }
+}
+
+// REPORT: log the incident in a group commit, suspend until it is on disk, then make it visible and reply
+int runReportTask(struct ServerTask* task) {
+    TASK_BEGIN(task);
+    task->commitSequence = appendCommitLog(&task->incident);
+    TASK_SUSPEND_UNTIL(task, task->commitSequence == 0 || atomic_load(&commitCompleted) >= task->commitSequence);
+
+    // The store only ever holds rows that are durable
+    if (task->commitSequence == 0) {
+        snprintf(task->reply, sizeof(task->reply), "ERR not enough memory\n");
+    } else if (atomic_load(&commitFailed) == task->commitSequence) {
+        snprintf(task->reply, sizeof(task->reply), "ERR could not write %s\n", DATA_FILE);
+    } else if (!storeIncident(&task->incident)) {
+        // The row is already durable, so a retry would only duplicate it
+        snprintf(task->reply, sizeof(task->reply), "OK %d (warning: not indexed until restart, not enough memory)\n",
+                 task->incident.id);
+    } else {
+        checkWatchList(&task->incident);
+        evaluateAlertRules(&task->incident, 1);
+        snprintf(task->reply, sizeof(task->reply), "OK %d\n", task->incident.id);
+    }
+
+    // A reply for another worker's client waits for room on the ring back to it
+    TASK_SUSPEND_UNTIL(task, serverReplyRoom(task->origin));
+    deliverServerReply(task->origin, task->connection, task->generation, task->reply);
+    TASK_END(task);
+}
+
+// Whether a reply can go to the worker holding the connection now; if not, the loop retries shortly
+int serverReplyRoom(int origin) {
+    if (origin == serverWorker || !serverRingFull(origin)) {
+        return 1;
+    }
+    serverBacklog = 1;
+    return 0;
+}
+
+// Hand a finished request's reply to its client, directly or through the worker holding the connection
+void deliverServerReply(int origin, int connection, unsigned int generation, const char* text) {
+    if (origin != serverWorker) {
+        struct ServerMessage message;
+        message.kind = SERVER_REPLY;
+        message.origin = origin;
+        message.connection = connection;
+        message.generation = generation;
+        snprintf(message.text, sizeof(message.text), "%s", text);
+        sendServerMessage(origin, &message);
+        return;
+    }
+    if (connection >= serverConnectionCapacity || !serverConnections[connection].open
+        || serverConnections[connection].generation != generation) {
+        return;
+    }
+    serverConnections[connection].waiting = 0;
+    queueServerOutput(connection, text);
+    processServerInput(connection);
+}
+
+// Open the incidents file for group commits and start this worker's commit thread
+int startCommitLog() {
+    commitFd = open(DATA_FILE, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    commitRequestFd = eventfd(0, 0);
+    commitDoneFd = eventfd(0, EFD_NONBLOCK);
+    commitBatches[0].sequence = 1;
+    pthread_t thread;
+    if (commitFd < 0 || commitRequestFd < 0 || commitDoneFd < 0
+        || pthread_create(&thread, NULL, runCommitThread, NULL) != 0) {
+        return 0;
+    }
+    pthread_detach(thread);
+    return 1;
+}
+
+// Add an incident's line to the batch being filled, returning that batch's sequence (0 if out of memory)
+unsigned long appendCommitLog(const struct Incident* incident) {
+    struct CommitBatch* batch = &commitBatches[commitFilling];
+    if (batch->length + MAX_LINE_LENGTH * 2 > batch->capacity) {
+        size_t newCapacity = batch->capacity == 0 ? 65536 : batch->capacity * 2;
+        char* grown = realloc(batch->bytes, newCapacity);
+        if (grown == NULL) {
+            return 0;
+        }
+        batch->bytes = grown;
+        batch->capacity = newCapacity;
+    }
+    // Workers share the file, so each one starts its first batch with the current schema
+    if (!layoutIsCurrent(&incidentFileLayout)) {
+        batch->length += formatSchemaLine(batch->bytes + batch->length, batch->capacity - batch->length,
+                                          &currentIncidentLayout);
+        incidentFileLayout = currentIncidentLayout;
+    }
+    batch->length += formatIncidentLine(batch->bytes + batch->length, batch->capacity - batch->length, incident);
+    return batch->sequence;
+}
+
+// Give the filled batch to the commit thread if it is idle, and start filling the other one
+void startCommitBatch() {
+    if (commitInFlight || commitBatches[commitFilling].length == 0) {
+        return;
+    }
+    struct CommitBatch* next = &commitBatches[1 - commitFilling];
+    next->length = 0;
+    next->sequence = commitBatches[commitFilling].sequence + 1;
+    commitFilling = 1 - commitFilling;
+    commitInFlight = 1;
+    uint64_t one = 1;
+    if (write(commitRequestFd, &one, sizeof(one)) != sizeof(one)) {
+        commitInFlight = 0;
+    }
+}
+
+// Write and sync each batch handed over by the event loop, one at a time
+void* runCommitThread(void* argument) {
+    (void)argument;
+    uint64_t count;
+    while (read(commitRequestFd, &count, sizeof(count)) == sizeof(count)) {
+        // The batch being flushed is the one the event loop is not filling; it stays untouched until done
+        struct CommitBatch* batch = &commitBatches[1 - commitFilling];
+        // Exports stop at the end of the file, so they must not see a batch half written
+        flock(commitFd, LOCK_EX);
+        // A compaction may have replaced the file meanwhile; batches go to the file that now has the name
+        struct stat opened, current;
+        while (fstat(commitFd, &opened) == 0 && stat(DATA_FILE, &current) == 0 && opened.st_ino != current.st_ino) {
+            int reopened = open(DATA_FILE, O_WRONLY | O_APPEND | O_CREAT, 0644);
+            if (reopened < 0) {
+                break;
+            }
+            flock(reopened, LOCK_EX);
+            close(commitFd);
+            commitFd = reopened;
+        }
+        // A failed batch is cut back off so no client is told ERR about a row that stays in the file
+        off_t committed = lseek(commitFd, 0, SEEK_END);
+        ssize_t written = write(commitFd, batch->bytes, batch->length);
+        if (written != (ssize_t)batch->length || fdatasync(commitFd) != 0) {
+            if (committed >= 0 && ftruncate(commitFd, committed) == 0) {
+                fdatasync(commitFd);
+            }
+            atomic_store(&commitFailed, batch->sequence);
+        }
+        flock(commitFd, LOCK_UN);
+        atomic_store(&commitCompleted, batch->sequence);
+        uint64_t one = 1;
+        if (write(commitDoneFd, &one, sizeof(one)) != sizeof(one)) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+// Make the migrated copy of the incidents file the next EXPORT sends
+void* runExportMigration(void* argument) {
+    (void)argument;
+    exportMigrationFd = openIncidentExport(exportMigrationEnd, &exportMigrationLength);
+    atomic_store(&exportMigrationState, EXPORT_MIGRATION_DONE);
+    return NULL;
+}
+
+// Whether the ring from this worker to another has no free slot
+int serverRingFull(int to) {
+    struct ServerRing* ring = &serverShared->rings[serverWorker * serverShared->workers + to];
+    return atomic_load_explicit(&ring->tail, memory_order_relaxed)
+           - atomic_load_explicit(&ring->head, memory_order_acquire) == SERVER_RING_SLOTS;
+}
+
+// Publish a message on the ring to another worker and wake it; returns 0 if the ring is full
+int sendServerMessage(int to, const struct ServerMessage* message) {
+    if (serverRingFull(to)) {
+        return 0;
+    }
+    struct ServerRing* ring = &serverShared->rings[serverWorker * serverShared->workers + to];
+    unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    struct ServerMessage* slot = &ring->slots[tail % SERVER_RING_SLOTS];
+    slot->kind = message->kind;
+    slot->origin = message->origin;
+    slot->connection = message->connection;
+    slot->generation = message->generation;
+    snprintf(slot->text, sizeof(slot->text), "%s", message->text);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+
+    uint64_t one = 1;
+    if (write(serverShared->wakeFds[to], &one, sizeof(one)) < 0) {
+        // The counter is already non-zero, so the worker will look at its rings anyway
+    }
+    return 1;
+}
+
+// Handle the messages other workers have published for this one, leaving requests whose reply has no room yet
+void drainServerRings() {
+    struct ServerMessage message;
+    serverBacklog = 0;
+    for (int from = 0; from < serverShared->workers; from++) {
+        struct ServerRing* ring = &serverShared->rings[from * serverShared->workers + serverWorker];
+        unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        while (head != atomic_load_explicit(&ring->tail, memory_order_acquire)) {
+            const struct ServerMessage* slot = &ring->slots[head % SERVER_RING_SLOTS];
+            // Waiting here for room could deadlock two workers replying to each other, so the request stays
+            if (slot->kind == SERVER_REQUEST && serverRingFull(slot->origin)) {
+                serverBacklog = 1;
+                break;
+            }
+            memcpy(&message, slot, sizeof(message));
+            atomic_store_explicit(&ring->head, ++head, memory_order_release);
+
+            if (message.kind == SERVER_REQUEST) {
+                // Answered for the worker holding the connection; the check above left room on the ring back
+                struct ServerMessage reply = message;
+                reply.kind = SERVER_REPLY;
+                if (executeServerRequest(message.text, message.origin, message.connection, message.generation,
+                                         reply.text, sizeof(reply.text))) {
+                    sendServerMessage(message.origin, &reply);
+                }
+                continue;
+            }
+
+            int fd = message.connection;
+            if (fd >= serverConnectionCapacity || !serverConnections[fd].open
+                || serverConnections[fd].generation != message.generation) {
+                continue;
+            }
+            struct ServerConnection* connection = &serverConnections[fd];
+            long rows, open;
+            if (sscanf(message.text, "ROWS %ld %ld", &rows, &open) == 2) {
+                connection->gatheredRows += rows;
+                connection->gatheredOpen += open;
+                if (--connection->waiting == 0) {
+                    char reply[MAX_STRING_LENGTH];
+                    snprintf(reply, sizeof(reply), "OK %ld incidents, %ld open, %d workers\n",
+                             connection->gatheredRows, connection->gatheredOpen, serverShared->workers);
+                    queueServerOutput(fd, reply);
+                }
+            } else {
+                connection->waiting = 0;
+                queueServerOutput(fd, message.text);
+            }
+            if (connection->waiting == 0) {
+                processServerInput(fd);
+            }
+        }
+    }
+}
+
+// Take every pending connection off the listening socket
+void acceptServerConnections(int listener) {
+    int fd;
+    while ((fd = accept(listener, NULL, NULL)) >= 0) {
+        if (fd >= serverConnectionCapacity) {
+            int newCapacity = serverConnectionCapacity == 0 ? 64 : serverConnectionCapacity;
+            while (newCapacity <= fd) {
+                newCapacity *= 2;
+            }
+            struct ServerConnection* grown = realloc(serverConnections,
+                                                     (size_t)newCapacity * sizeof(struct ServerConnection));
+            if (grown == NULL) {
+                close(fd);
+                continue;
+            }
+            memset(grown + serverConnectionCapacity, 0,
+                   (size_t)(newCapacity - serverConnectionCapacity) * sizeof(struct ServerConnection));
+            serverConnections = grown;
+            serverConnectionCapacity = newCapacity;
+        }
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        struct ServerConnection* connection = &serverConnections[fd];
+        connection->generation++;
+        connection->open = 1;
+        connection->events = EPOLLIN;
+        connection->inputLength = 0;
+        connection->outputLength = 0;
+        connection->waiting = 0;
+        connection->exportFd = -1;
+        struct epoll_event event = { EPOLLIN, { .fd = fd } };
+        epoll_ctl(serverEpoll, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+// Read what a client sent and run its complete request lines
+void readServerConnection(int fd) {
+    struct ServerConnection* connection = &serverConnections[fd];
+    ssize_t received = read(fd, connection->input + connection->inputLength,
+                            sizeof(connection->input) - connection->inputLength);
+    if (received == 0 || (received < 0 && errno != EAGAIN)) {
+        closeServerConnection(fd);
+        return;
+    }
+    if (received > 0) {
+        connection->inputLength += (size_t)received;
+    }
+    processServerInput(fd);
+}
+
+// Run buffered request lines one at a time, stopping while one waits for other workers
+void processServerInput(int fd) {
+    struct ServerConnection* connection = &serverConnections[fd];
+    while (connection->open && connection->waiting == 0) {
+        char* end = memchr(connection->input, '\n', connection->inputLength);
+        if (end == NULL) {
+            if (connection->inputLength == sizeof(connection->input)) {
+                queueServerOutput(fd, "ERR request too long\n");
+                closeServerConnection(fd);
+            }
+            break;
+        }
+        char line[SERVER_MESSAGE_BYTES];
+        size_t length = (size_t)(end - connection->input);
+        memcpy(line, connection->input, length);
+        line[length] = '\0';
+        if (length > 0 && line[length - 1] == '\r') {
+            line[length - 1] = '\0';
+        }
+        connection->inputLength -= length + 1;
+        memmove(connection->input, end + 1, connection->inputLength);
+        routeServerRequest(fd, line);
+    }
+    if (connection->open) {
+        updateServerEvents(fd);
+    }
+}
+
+// Answer a request here if this worker owns its area, or pass it to the worker that does
+void routeServerRequest(int fd, char* line) {
+    struct ServerConnection* connection = &serverConnections[fd];
+    if (strcmp(line, "QUIT") == 0) {
+        flushServerOutput(fd);
+        closeServerConnection(fd);
+        return;
+    }
+    // The incidents file is shared, so any worker sends all of it; later requests wait until it is out
+    if (strcmp(line, "EXPORT") == 0) {
+        long length;
+        int source;
+        if (legacyIncidentRows == 0) {
+            source = openIncidentExport(sealedIncidentBytes(), &length);
+        } else if (atomic_load(&exportMigrationState) == EXPORT_MIGRATION_DONE) {
+            // Each migrated copy serves one EXPORT, so a later one picks up the rows reported since
+            source = exportMigrationFd;
+            length = exportMigrationLength;
+            atomic_store(&exportMigrationState, EXPORT_MIGRATION_IDLE);
+        } else {
+            pthread_t thread;
+            if (atomic_load(&exportMigrationState) == EXPORT_MIGRATION_IDLE) {
+                exportMigrationEnd = sealedIncidentBytes();
+                atomic_store(&exportMigrationState, EXPORT_MIGRATION_RUNNING);
+                if (pthread_create(&thread, NULL, runExportMigration, NULL) == 0) {
+                    pthread_detach(thread);
+                } else {
+                    atomic_store(&exportMigrationState, EXPORT_MIGRATION_IDLE);
+                }
+            }
+            queueServerOutput(fd, "ERR busy, migrating older rows for the export; try again\n");
+            return;
+        }
+        if (source < 0) {
+            queueServerOutput(fd, "ERR could not read " DATA_FILE "\n");
+            return;
+        }
+        char header[MAX_STRING_LENGTH];
+        snprintf(header, sizeof(header), "OK %ld bytes\n", length);
+        connection->exportFd = source;
+        connection->exportOffset = 0;
+        connection->exportLength = length;
+        connection->waiting = 1;
+        queueServerOutput(fd, header);
+        return;
+    }
+
+    // STATS is gathered from every worker; requests about an area go to its owner; the rest are answered here
+    int owner = serverWorker;
+    char area[MAX_AREA_LENGTH] = "";
+    if (strncmp(line, "REPORT ", 7) == 0) {
+        size_t length = strcspn(line + 7, "|");
+        if (length < sizeof(area)) {
+            memcpy(area, line + 7, length);
+            area[length] = '\0';
+        }
+    } else if (strncmp(line, "COUNT ", 6) == 0 || strncmp(line, "LIST ", 5) == 0) {
+        snprintf(area, sizeof(area), "%s", strchr(line, ' ') + 1);
+    }
+    if (area[0] != '\0') {
+        owner = areaWorker(area);
+    }
+
+    struct ServerMessage message;
+    message.kind = SERVER_REQUEST;
+    message.origin = serverWorker;
+    message.connection = fd;
+    message.generation = connection->generation;
+    if (strcmp(line, "STATS") == 0) {
+        // The totals need every worker, so a full ring makes the whole request wait for a retry. Only this
+        // worker adds to its rings, so room found here is still there when the requests go out
+        for (int w = 0; w < serverShared->workers; w++) {
+            if (w != serverWorker && serverRingFull(w)) {
+                queueServerOutput(fd, "ERR busy, try again\n");
+                return;
+            }
+        }
+        snprintf(message.text, sizeof(message.text), "ROWS");
+        connection->gatheredRows = incidentCount;
+        connection->gatheredOpen = dispatchHeapCount;
+        connection->waiting = 1; // Held until every request is out, so early replies cannot finish it
+        for (int w = 0; w < serverShared->workers; w++) {
+            if (w != serverWorker && sendServerMessage(w, &message)) {
+                connection->waiting++;
+            }
+        }
+        if (--connection->waiting == 0) {
+            char reply[MAX_STRING_LENGTH];
+            snprintf(reply, sizeof(reply), "OK %ld incidents, %ld open, %d workers\n", connection->gatheredRows,
+                     connection->gatheredOpen, serverShared->workers);
+            queueServerOutput(fd, reply);
+        }
+        return;
+    }
+    if (owner != serverWorker) {
+        snprintf(message.text, sizeof(message.text), "%s", line);
+        if (sendServerMessage(owner, &message)) {
+            connection->waiting = 1;
+        } else {
+            queueServerOutput(fd, "ERR busy, try again\n");
+        }
+        return;
+    }
+
+    // A request that suspends holds the connection's later requests back until it has replied
+    char reply[SERVER_MESSAGE_BYTES];
+    if (executeServerRequest(line, serverWorker, fd, connection->generation, reply, sizeof(reply))) {
+        queueServerOutput(fd, reply);
+    } else {
+        connection->waiting = 1;
+    }
+}
+
+// Append a reply to a connection's output and send as much of it as the socket takes
+void queueServerOutput(int fd, const char* text) {
+    struct ServerConnection* connection = &serverConnections[fd];
+    size_t length = strlen(text);
+    if (connection->outputLength + length > connection->outputCapacity) {
+        size_t newCapacity = connection->outputCapacity == 0 ? SERVER_MESSAGE_BYTES : connection->outputCapacity;
+        while (newCapacity < connection->outputLength + length) {
+            newCapacity *= 2;
+        }
+        char* grown = realloc(connection->output, newCapacity);
+        if (grown == NULL) {
+            closeServerConnection(fd);
+            return;
+        }
+        connection->output = grown;
+        connection->outputCapacity = newCapacity;
+    }
+    memcpy(connection->output + connection->outputLength, text, length);
+    connection->outputLength += length;
+    flushServerOutput(fd);
+}
+
+// Send pending output; what the socket does not take now waits for it to become writable
+void flushServerOutput(int fd) {
+    struct ServerConnection* connection = &serverConnections[fd];
+    while (connection->outputLength > 0) {
+        ssize_t sent = write(fd, connection->output, connection->outputLength);
+        if (sent <= 0) {
+            if (sent < 0 && errno != EAGAIN) {
+                closeServerConnection(fd);
+                return;
+            }
+            break;
+        }
+        connection->outputLength -= (size_t)sent;
+        memmove(connection->output, connection->output + sent, connection->outputLength);
+    }
+    // An export follows its header straight from the page cache
+    while (connection->outputLength == 0 && connection->exportFd >= 0) {
+        ssize_t sent = 1;
+        if (connection->exportOffset < connection->exportLength) {
+            sent = sendfile(fd, connection->exportFd, &connection->exportOffset,
+                            (size_t)(connection->exportLength - connection->exportOffset));
+        }
+        if (sent < 0 && errno == EAGAIN) {
+            break;
+        }
+        if (sent <= 0) {
+            closeServerConnection(fd);
+            return;
+        }
+        if (connection->exportOffset >= connection->exportLength) {
+            close(connection->exportFd);
+            connection->exportFd = -1;
+            connection->waiting = 0;
+        }
+    }
+    updateServerEvents(fd);
+}
+
+// Listen for input only while there is room for it, and for writability only while output is pending
+void updateServerEvents(int fd) {
+    struct ServerConnection* connection = &serverConnections[fd];
+    if (!connection->open) {
+        return;
+    }
+    unsigned int events = (connection->inputLength < sizeof(connection->input) ? EPOLLIN : 0)
+                          | (connection->outputLength > 0 || connection->exportFd >= 0 ? EPOLLOUT : 0);
+    if (events != connection->events) {
+        struct epoll_event event = { events, { .fd = fd } };
+        epoll_ctl(serverEpoll, EPOLL_CTL_MOD, fd, &event);
+        connection->events = events;
+    }
+}
+
+// Close a client connection; replies still on their way for it are dropped by generation
+void closeServerConnection(int fd) {
+    struct ServerConnection* connection = &serverConnections[fd];
+    if (!connection->open) {
+        return;
+    }
+    epoll_ctl(serverEpoll, EPOLL_CTL_DEL, fd, NULL);
+    close(fd);
+    connection->open = 0;
+    connection->generation++;
+    if (connection->exportFd >= 0) {
+        close(connection->exportFd);
+        connection->exportFd = -1;
+    }
+    free(connection->output);
+    connection->output = NULL;
+    connection->outputLength = connection->outputCapacity = 0;
+}
+#endif
+
+// Read where checkpoints are written, or that they are off
+void configureCheckpoint() {
+    const char* arrowPath = getenv(ARROW_SNAPSHOT_ENV);
+    if (arrowPath != NULL) {
+        snprintf(arrowSnapshotPath, sizeof(arrowSnapshotPath), "%s", arrowPath);
+    }
+    const char* path = getenv(CHECKPOINT_ENV);
+    if (path == NULL) {
+        return;
+    }
+    if (strcmp(path, "off") == 0) {
+        checkpointPath[0] = '\0';
+    } else {
+        snprintf(checkpointPath, sizeof(checkpointPath), "%s", path);
+    }
+}
+
+// With several municipalities, turn off settings that would make them share one file or segment. Relative paths
+// are fine: each municipality resolves them in its own directory
+void restrictTenantConfiguration() {
+    const char* sharedPath = getenv(SHARED_STORE_ENV);
+    if (sharedPath != NULL && sharedPath[0] != '\0') {
+        printf(ANSI_COLOR_RED "Error: %s cannot be used with %s; each municipality loads a private store.\n"
+               ANSI_COLOR_RESET, SHARED_STORE_ENV, TENANTS_FILE);
+    }
+    if (checkpointPath[0] == '/') {
+        printf(ANSI_COLOR_RED "Error: %s must be a relative path with %s; checkpoints are off.\n" ANSI_COLOR_RESET,
+               CHECKPOINT_ENV, TENANTS_FILE);
+        checkpointPath[0] = '\0';
+    }
+    if (arrowSnapshotPath[0] == '/') {
+        printf(ANSI_COLOR_RED "Error: %s must be a relative path with %s; Arrow snapshots are off.\n" ANSI_COLOR_RESET,
+               ARROW_SNAPSHOT_ENV, TENANTS_FILE);
+        arrowSnapshotPath[0] = '\0';
+    }
+}
+
+// 64-bit FNV-1a hash of the first bytes of a file, 0 if they cannot be read. It goes a word at a time, so
+// fingerprinting a large incidents file costs about as much as reading it
+unsigned long long hashFilePrefix(const char* path, long end) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return 0;
+    }
+    unsigned char* bytes = malloc(CHECKPOINT_HASH_CHUNK);
+    if (bytes == NULL) {
+        fclose(file);
+        return 0;
+    }
+    unsigned long long hash = 14695981039346656037ULL;
+    long remaining = end;
+    while (remaining > 0) {
+        size_t wanted = remaining < CHECKPOINT_HASH_CHUNK ? (size_t)remaining : CHECKPOINT_HASH_CHUNK;
+        if (fread(bytes, 1, wanted, file) != wanted) {
+            hash = 0;
+            break;
+        }
+        // Chunks are a whole number of words, so only the last one has a partial word left over
+        size_t i = 0;
+        for (; i + sizeof(unsigned long long) <= wanted; i += sizeof(unsigned long long)) {
+            unsigned long long word;
+            memcpy(&word, bytes + i, sizeof(word));
+            hash = (hash ^ word) * 1099511628211ULL;
+        }
+        for (; i < wanted; i++) {
+            hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        }
+        remaining -= (long)wanted;
+    }
+    free(bytes);
+    fclose(file);
+    return hash;
+}
+
+// Check that every section of an image lies inside it and is exactly as long as its count in the header says
+int checkpointSectionsMatch(const struct CheckpointHeader* header, long imageBytes) {
+    const struct ColumnStatistics* stats = &header->columnStats;
+    if (header->incidentCount < 0 || header->incidentTypeCount < 0 || header->areaKeyCount < 0
+        || header->areaKeyTableSize < 0 || header->idTableSize < 0 || header->termCount < 0
+        || header->termTableSize < 0 || header->rollupCellCount < 0 || header->rollupTableSize < 0
+        || header->reservoirCount < 0 || header->reservoirCount > RESERVOIR_SIZE || header->versionCapacity < 0
+        || header->versionHeadCapacity < 0 || stats->areaCapacity < 0 || stats->typeCapacity < 0) {
+        return 0;
+    }
+
+    // Postings and cell data vary per entry, so restoreCheckpoint checks them against their sections as it walks
+    size_t expected[CHECKPOINT_SECTIONS];
+    expected[CKPT_HOT] = (size_t)header->incidentCount * sizeof(struct IncidentHot);
+    expected[CKPT_COLD] = (size_t)header->incidentCount * sizeof(struct IncidentCold);
+    expected[CKPT_TYPES] = (size_t)header->incidentTypeCount * MAX_TYPE_LENGTH;
+    expected[CKPT_AREAS] = (size_t)header->areaKeyCount * MAX_AREA_LENGTH;
+    expected[CKPT_AREA_TABLE] = (size_t)header->areaKeyTableSize * sizeof(int);
+    expected[CKPT_ID_TABLE] = (size_t)header->idTableSize * sizeof(int);
+    expected[CKPT_DESCRIPTIONS] = header->descriptionTextLength;
+    expected[CKPT_TERMS] = (size_t)header->termCount * sizeof(struct CheckpointTerm);
+    expected[CKPT_POSTINGS] = header->sections[CKPT_POSTINGS].bytes;
+    expected[CKPT_TERM_TABLE] = (size_t)header->termTableSize * sizeof(int);
+    expected[CKPT_CELLS] = (size_t)header->rollupCellCount * sizeof(struct CheckpointCell);
+    expected[CKPT_CELL_DATA] = header->sections[CKPT_CELL_DATA].bytes;
+    expected[CKPT_CELL_TABLE] = (size_t)header->rollupTableSize * sizeof(int);
+    expected[CKPT_RESERVOIR] = (size_t)header->reservoirCount * sizeof(int);
+    expected[CKPT_AREA_COUNTS] = (size_t)stats->areaCapacity * sizeof(long);
+    expected[CKPT_TYPE_COUNTS] = (size_t)stats->typeCapacity * sizeof(long);
+    expected[CKPT_VERSIONS] = (size_t)header->versionCapacity * sizeof(struct IncidentVersion);
+    expected[CKPT_VERSION_HEADS] = (size_t)header->versionHeadCapacity * sizeof(int);
+    for (int section = 0; section < CHECKPOINT_SECTIONS; section++) {
+        const struct CheckpointSection* entry = &header->sections[section];
+        if (entry->bytes != expected[section] || entry->offset > (size_t)imageBytes
+            || entry->bytes > (size_t)imageBytes - entry->offset) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Load the checkpoint image if it matches the incidents file and dispatch log; returns 1 if restored
+int restoreCheckpoint() {
+    if (checkpointPath[0] == '\0') {
+        return 0;
+    }
+    FILE *file = fopen(checkpointPath, "rb");
+    if (file == NULL) {
+        return 0;
+    }
+    struct CheckpointHeader header;
+    fseek(file, 0, SEEK_END);
+    long imageBytes = ftell(file);
+    rewind(file);
+    int usable = imageBytes >= (long)sizeof(header) && fread(&header, sizeof(header), 1, file) == 1
+                 && header.magic == CHECKPOINT_MAGIC && header.format == CHECKPOINT_FORMAT
+                 && header.recordSizes == (unsigned int)(sizeof(struct IncidentHot) << 16 | sizeof(struct IncidentCold))
+                 && checkpointSectionsMatch(&header, imageBytes);
+
+    // The image is only valid while both files still start with what it was built from
+    FILE *data = usable ? fopen(DATA_FILE, "rb") : NULL;
+    long dataBytes = -1;
+    if (data != NULL) {
+        fseek(data, 0, SEEK_END);
+        dataBytes = ftell(data);
+        fclose(data);
+    }
+    FILE *log = usable ? fopen(DISPATCH_FILE, "rb") : NULL;
+    long logBytes = 0;
+    if (log != NULL) {
+        fseek(log, 0, SEEK_END);
+        logBytes = ftell(log);
+        fclose(log);
+    }
+    usable = usable && dataBytes >= header.dataBytes && logBytes >= header.dispatchLogOffset
+             && hashFilePrefix(DATA_FILE, header.dataBytes) == header.dataHash;
+    if (!usable) {
+        fclose(file);
+        return 0;
+    }
+
+    // Map the image and copy each array out in one piece; nothing is parsed, hashed or sorted again
+    char* image = NULL;
+#ifdef __linux__
+    void* mapped = mmap(NULL, (size_t)imageBytes, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+    image = mapped == MAP_FAILED ? NULL : mapped;
+#else
+    image = malloc((size_t)imageBytes);
+    if (image != NULL && (fseek(file, 0, SEEK_SET) != 0 || fread(image, 1, (size_t)imageBytes, file) != (size_t)imageBytes)) {
+        free(image);
+        image = NULL;
+    }
+#endif
+    fclose(file);
+    if (image == NULL || !reserveIncidentCapacity(header.incidentCount)) {
+        goto failed;
+    }
+
+    memcpy(incidentHot, image + header.sections[CKPT_HOT].offset, header.sections[CKPT_HOT].bytes);
+    memcpy(incidentCold, image + header.sections[CKPT_COLD].offset, header.sections[CKPT_COLD].bytes);
+    incidentTypes = copyCheckpointSection(image, &header, CKPT_TYPES, 0);
+    areaKeys = copyCheckpointSection(image, &header, CKPT_AREAS, 0);
+    areaKeyTable = copyCheckpointSection(image, &header, CKPT_AREA_TABLE, 0);
+    idTable = copyCheckpointSection(image, &header, CKPT_ID_TABLE, 0);
+    descriptionText = copyCheckpointSection(image, &header, CKPT_DESCRIPTIONS, 0);
+    termPostings = calloc((size_t)(header.termCount > 0 ? header.termCount : 1), sizeof(struct TermPostings));
+    termTable = copyCheckpointSection(image, &header, CKPT_TERM_TABLE, 0);
+    rollupCells = calloc((size_t)(header.rollupCellCount > 0 ? header.rollupCellCount : 1), sizeof(struct RollupCell));
+    rollupTable = copyCheckpointSection(image, &header, CKPT_CELL_TABLE, 0);
+    reservoir = copyCheckpointSection(image, &header, CKPT_RESERVOIR, RESERVOIR_SIZE * sizeof(int));
+    versions = copyCheckpointSection(image, &header, CKPT_VERSIONS, 0);
+    versionHead = copyCheckpointSection(image, &header, CKPT_VERSION_HEADS, 0);
+    columnStats = header.columnStats;
+    columnStats.areaCounts = copyCheckpointSection(image, &header, CKPT_AREA_COUNTS, 0);
+    columnStats.typeCounts = copyCheckpointSection(image, &header, CKPT_TYPE_COUNTS, 0);
+    if (incidentTypes == NULL || areaKeys == NULL || areaKeyTable == NULL || idTable == NULL || descriptionText == NULL
+        || termPostings == NULL || termTable == NULL || rollupCells == NULL || rollupTable == NULL || reservoir == NULL
+        || versions == NULL || versionHead == NULL || columnStats.areaCounts == NULL || columnStats.typeCounts == NULL) {
+        goto failed;
+    }
+
+    // Postings and cube cells own their buffers, which follow one another in a section each and must use it up
+    // exactly; termCount and rollupCellCount follow the loops so a failure frees what was taken so far
+    const struct CheckpointTerm* savedTerms =
+        (const struct CheckpointTerm*)(const void*)(image + header.sections[CKPT_TERMS].offset);
+    const unsigned char* postings = (const unsigned char*)image + header.sections[CKPT_POSTINGS].offset;
+    size_t postingsLeft = header.sections[CKPT_POSTINGS].bytes;
+    for (int t = 0; t < header.termCount; t++) {
+        struct TermPostings* term = &termPostings[t];
+        if (savedTerms[t].length > postingsLeft) {
+            goto failed;
+        }
+        memcpy(term->term, savedTerms[t].term, sizeof(term->term));
+        term->term[MAX_TERM_LENGTH - 1] = '\0';
+        term->length = savedTerms[t].length;
+        term->documents = savedTerms[t].documents;
+        term->lastPosition = savedTerms[t].lastPosition;
+        term->capacity = term->length > 16 ? term->length : 16;
+        term->bytes = malloc(term->capacity);
+        if (term->bytes == NULL) {
+            goto failed;
+        }
+        termCount = t + 1;
+        memcpy(term->bytes, postings, term->length);
+        postings += term->length;
+        postingsLeft -= term->length;
+    }
+    termCount = termCapacity = header.termCount;
+    const struct CheckpointCell* savedCells =
+        (const struct CheckpointCell*)(const void*)(image + header.sections[CKPT_CELLS].offset);
+    const char* cellData = image + header.sections[CKPT_CELL_DATA].offset;
+    size_t cellDataLeft = header.sections[CKPT_CELL_DATA].bytes;
+    for (int c = 0; c < header.rollupCellCount; c++) {
+        struct RollupCell* cell = &rollupCells[c];
+        const struct CheckpointCell* saved = &savedCells[c];
+        if (saved->total < 0 || (!saved->isFenwick && saved->total > ROLLUP_FENWICK_THRESHOLD)) {
+            goto failed;
+        }
+        size_t bytes = saved->isFenwick ? (MINUTES_PER_DAY + 1) * sizeof(int)
+                                        : (size_t)saved->total * sizeof(unsigned short);
+        if (bytes > cellDataLeft) {
+            goto failed;
+        }
+        void* buffer = bytes > 0 ? malloc(bytes) : NULL;
+        if (bytes > 0 && buffer == NULL) {
+            goto failed;
+        }
+        if (bytes > 0) {
+            memcpy(buffer, cellData, bytes);
+        }
+        cellData += bytes;
+        cellDataLeft -= bytes;
+        cell->area = saved->area;
+        cell->type = saved->type;
+        cell->total = saved->total;
+        if (saved->isFenwick) {
+            cell->fenwick = buffer;
+        } else {
+            cell->minutes = buffer;
+            cell->capacity = (int)saved->total;
+        }
+        rollupCellCount = c + 1;
+    }
+    rollupCellCount = rollupCellCapacity = header.rollupCellCount;
+    if (postingsLeft != 0 || cellDataLeft != 0) {
+        goto failed;
+    }
+
+    incidentCount = header.incidentCount;
+    incidentTypeCount = incidentTypeCapacity = header.incidentTypeCount;
+    areaKeyCount = areaKeyCapacity = header.areaKeyCount;
+    areaKeyTableSize = header.areaKeyTableSize;
+    idTableSize = header.idTableSize;
+    idTableValid = header.idTableValid;
+    descriptionTextLength = descriptionTextCapacity = header.descriptionTextLength;
+    termTableSize = header.termTableSize;
+    describedIncidents = header.describedIncidents;
+    totalDescriptionTerms = header.totalDescriptionTerms;
+    textIndexValid = header.textIndexValid;
+    rollupTableSize = header.rollupTableSize;
+    rollupCubeValid = header.rollupCubeValid;
+    reservoirCount = header.reservoirCount;
+    sampleRandomState = header.sampleRandomState;
+    versionCapacity = header.versionCapacity;
+    versionFree = header.versionFree;
+    liveVersions = header.liveVersions;
+    nextVersionCollection = header.nextVersionCollection;
+    versionHeadCapacity = header.versionHeadCapacity;
+    historyHorizon = header.historyHorizon;
+    lastCommitTime = header.lastCommitTime;
+    incidentFileOffset = header.dataBytes;
+    incidentFileLayout = header.dataLayout;
+    legacyIncidentRows = header.legacyIncidentRows;
+    dispatchLogOffset = checkpointLogOffset = header.dispatchLogOffset;
+    checkpointRows = incidentCount;
+    lastCheckpointTime = time(NULL);
+#ifdef __linux__
+    munmap(image, (size_t)imageBytes);
+#else
+    free(image);
+#endif
+    return 1;
+
+failed:
+    // Start over from the files, as if there had been no image
+    printf(ANSI_COLOR_RED "Error: Could not restore the checkpoint %s; loading from %s.\n" ANSI_COLOR_RESET,
+           checkpointPath, DATA_FILE);
+    for (int t = 0; t < termCount; t++) {
+        free(termPostings[t].bytes);
+    }
+    for (int c = 0; c < rollupCellCount; c++) {
+        free(rollupCells[c].minutes);
+        free(rollupCells[c].fenwick);
+    }
+    free(incidentTypes);
+    free(areaKeys);
+    free(areaKeyTable);
+    free(idTable);
+    free(descriptionText);
+    free(termPostings);
+    free(termTable);
+    free(rollupCells);
+    free(rollupTable);
+    free(reservoir);
+    free(versions);
+    free(versionHead);
+    free(columnStats.areaCounts);
+    free(columnStats.typeCounts);
+    incidentTypes = NULL;
+    areaKeys = NULL;
+    areaKeyTable = idTable = termTable = rollupTable = reservoir = versionHead = NULL;
+    descriptionText = NULL;
+    termPostings = NULL;
+    rollupCells = NULL;
+    versions = NULL;
+    memset(&columnStats, 0, sizeof(columnStats));
+    termCount = rollupCellCount = 0;
+#ifdef __linux__
+    if (image != NULL) {
+        munmap(image, (size_t)imageBytes);
+    }
+#else
+    free(image);
+#endif
+    return 0;
+}
+
+// Copy one section of a checkpoint image into a new buffer of at least a minimum size (NULL if out of memory)
+void* copyCheckpointSection(const char* image, const struct CheckpointHeader* header, int section, size_t minimum) {
+    size_t bytes = header->sections[section].bytes;
+    void* copy = malloc(bytes > minimum ? bytes : (minimum > 0 ? minimum : 1));
+    if (copy != NULL) {
+        memcpy(copy, image + header->sections[section].offset, bytes);
+    }
+    return copy;
+}
+
+// Pad the image to an aligned offset and start a section there
+void beginCheckpointSection(FILE* file, struct CheckpointHeader* header, int section) {
+    static const char padding[CHECKPOINT_ALIGNMENT] = { 0 };
+    long offset = ftell(file);
+    long aligned = (offset + CHECKPOINT_ALIGNMENT - 1) / CHECKPOINT_ALIGNMENT * CHECKPOINT_ALIGNMENT;
+    fwrite(padding, 1, (size_t)(aligned - offset), file);
+    header->sections[section].offset = (size_t)aligned;
+}
+
+// Write one array as a section of the image
+void writeCheckpointSection(FILE* file, struct CheckpointHeader* header, int section, const void* data, size_t bytes) {
+    beginCheckpointSection(file, header, section);
+    if (bytes > 0) {
+        fwrite(data, 1, bytes, file);
+    }
+    header->sections[section].bytes = bytes;
+}
+
+// Dump the store, dictionaries, indexes and aggregates into a new image, replacing the old one atomically
+int writeCheckpoint() {
+    char temporary[MAX_STRING_LENGTH + 8];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", checkpointPath);
+    FILE *file = fopen(temporary, "wb");
+    if (file == NULL) {
+        return 0;
+    }
+
+    // Adaptive indexes follow the workload and the dispatch queue heapifies in O(n), so both are rebuilt instead
+    buildDeferredIndexes();
+    struct CheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = CHECKPOINT_MAGIC;
+    header.format = CHECKPOINT_FORMAT;
+    header.recordSizes = (unsigned int)(sizeof(struct IncidentHot) << 16 | sizeof(struct IncidentCold));
+    header.dataBytes = incidentFileOffset;
+    header.dataHash = hashFilePrefix(DATA_FILE, incidentFileOffset);
+    header.dataLayout = incidentFileLayout;
+    header.legacyIncidentRows = legacyIncidentRows;
+    header.dispatchLogOffset = dispatchLogOffset;
+    header.incidentCount = incidentCount;
+    header.incidentTypeCount = incidentTypeCount;
+    header.areaKeyCount = areaKeyCount;
+    header.areaKeyTableSize = areaKeyTableSize;
+    header.idTableSize = idTableSize;
+    header.idTableValid = idTableValid;
+    header.termCount = termCount;
+    header.termTableSize = termTableSize;
+    header.describedIncidents = describedIncidents;
+    header.textIndexValid = textIndexValid;
+    header.totalDescriptionTerms = totalDescriptionTerms;
+    header.descriptionTextLength = descriptionTextLength;
+    header.rollupCellCount = rollupCellCount;
+    header.rollupTableSize = rollupTableSize;
+    header.rollupCubeValid = rollupCubeValid;
+    header.reservoirCount = reservoirCount;
+    header.sampleRandomState = sampleRandomState;
+    header.versionCapacity = versionCapacity;
+    header.versionFree = versionFree;
+    header.liveVersions = liveVersions;
+    header.nextVersionCollection = nextVersionCollection;
+    header.versionHeadCapacity = versionHeadCapacity;
+    header.historyHorizon = historyHorizon;
+    header.lastCommitTime = lastCommitTime;
+    header.columnStats = columnStats;
+    header.columnStats.areaCounts = NULL;
+    header.columnStats.typeCounts = NULL;
+    fwrite(&header, sizeof(header), 1, file);
+
+    writeCheckpointSection(file, &header, CKPT_HOT, incidentHot, (size_t)incidentCount * sizeof(struct IncidentHot));
+    writeCheckpointSection(file, &header, CKPT_COLD, incidentCold, (size_t)incidentCount * sizeof(struct IncidentCold));
+    writeCheckpointSection(file, &header, CKPT_TYPES, incidentTypes, (size_t)incidentTypeCount * MAX_TYPE_LENGTH);
+    writeCheckpointSection(file, &header, CKPT_AREAS, areaKeys, (size_t)areaKeyCount * MAX_AREA_LENGTH);
+    writeCheckpointSection(file, &header, CKPT_AREA_TABLE, areaKeyTable, (size_t)areaKeyTableSize * sizeof(int));
+    writeCheckpointSection(file, &header, CKPT_ID_TABLE, idTable, (size_t)idTableSize * sizeof(int));
+    writeCheckpointSection(file, &header, CKPT_DESCRIPTIONS, descriptionText, descriptionTextLength);
+    beginCheckpointSection(file, &header, CKPT_TERMS);
+    for (int t = 0; t < termCount; t++) {
+        struct CheckpointTerm saved;
+        memset(&saved, 0, sizeof(saved));
+        memcpy(saved.term, termPostings[t].term, sizeof(saved.term));
+        saved.length = termPostings[t].length;
+        saved.documents = termPostings[t].documents;
+        saved.lastPosition = termPostings[t].lastPosition;
+        fwrite(&saved, sizeof(saved), 1, file);
+    }
+    header.sections[CKPT_TERMS].bytes = (size_t)termCount * sizeof(struct CheckpointTerm);
+    beginCheckpointSection(file, &header, CKPT_POSTINGS);
+    for (int t = 0; t < termCount; t++) {
+        fwrite(termPostings[t].bytes, 1, termPostings[t].length, file);
+    }
+    header.sections[CKPT_POSTINGS].bytes = (size_t)ftell(file) - header.sections[CKPT_POSTINGS].offset;
+    writeCheckpointSection(file, &header, CKPT_TERM_TABLE, termTable, (size_t)termTableSize * sizeof(int));
+    beginCheckpointSection(file, &header, CKPT_CELLS);
+    for (int c = 0; c < rollupCellCount; c++) {
+        struct CheckpointCell saved;
+        memset(&saved, 0, sizeof(saved));
+        saved.area = rollupCells[c].area;
+        saved.type = rollupCells[c].type;
+        saved.total = rollupCells[c].total;
+        saved.isFenwick = rollupCells[c].fenwick != NULL;
+        fwrite(&saved, sizeof(saved), 1, file);
+    }
+    header.sections[CKPT_CELLS].bytes = (size_t)rollupCellCount * sizeof(struct CheckpointCell);
+    beginCheckpointSection(file, &header, CKPT_CELL_DATA);
+    for (int c = 0; c < rollupCellCount; c++) {
+        if (rollupCells[c].fenwick != NULL) {
+            fwrite(rollupCells[c].fenwick, sizeof(int), MINUTES_PER_DAY + 1, file);
+        } else if (rollupCells[c].total > 0) {
+            fwrite(rollupCells[c].minutes, sizeof(unsigned short), (size_t)rollupCells[c].total, file);
+        }
+    }
+    header.sections[CKPT_CELL_DATA].bytes = (size_t)ftell(file) - header.sections[CKPT_CELL_DATA].offset;
+    writeCheckpointSection(file, &header, CKPT_CELL_TABLE, rollupTable, (size_t)rollupTableSize * sizeof(int));
+    writeCheckpointSection(file, &header, CKPT_RESERVOIR, reservoir, (size_t)reservoirCount * sizeof(int));
+    writeCheckpointSection(file, &header, CKPT_AREA_COUNTS, columnStats.areaCounts,
+                           (size_t)columnStats.areaCapacity * sizeof(long));
+    writeCheckpointSection(file, &header, CKPT_TYPE_COUNTS, columnStats.typeCounts,
+                           (size_t)columnStats.typeCapacity * sizeof(long));
+    writeCheckpointSection(file, &header, CKPT_VERSIONS, versions, (size_t)versionCapacity * sizeof(struct IncidentVersion));
+    writeCheckpointSection(file, &header, CKPT_VERSION_HEADS, versionHead, (size_t)versionHeadCapacity * sizeof(int));
+
+    // The header goes in last, with the section table filled in
+    int written = fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    written = fflush(file) == 0 && !ferror(file) && written;
+#ifdef __linux__
+    written = written && fsync(fileno(file)) == 0;
+#endif
+    written = fclose(file) == 0 && written;
+    if (!written || rename(temporary, checkpointPath) != 0) {
+        remove(temporary);
+        return 0;
+    }
+    checkpointRows = incidentCount;
+    checkpointLogOffset = dispatchLogOffset;
+    return 1;
+}
+
+// Checkpoint when the store or dispatch log moved on since the last image, at most every few minutes unless forced
+void maybeWriteCheckpoint(int force) {
+    // A shared store is kept in its own segment
+    if (checkpointPath[0] == '\0' || sharedStore != NULL) {
+        return;
+    }
+    if (incidentCount == checkpointRows && dispatchLogOffset == checkpointLogOffset) {
+        return;
+    }
+    time_t now = time(NULL);
+    if (!force && now - lastCheckpointTime < CHECKPOINT_INTERVAL_SECONDS) {
+        return;
+    }
+    lastCheckpointTime = now;
+    if (!writeCheckpoint()) {
+        printf(ANSI_COLOR_RED "Error: Could not write the checkpoint %s.\n" ANSI_COLOR_RESET, checkpointPath);
+        return;
+    }
+    // Tools that read Arrow get the same state, without knowing the checkpoint format
+    long bytes;
+    if (arrowSnapshotPath[0] != '\0' && !writeArrowSnapshot(arrowSnapshotPath, &bytes)) {
+        printf(ANSI_COLOR_RED "Error: Could not write the Arrow snapshot %s.\n" ANSI_COLOR_RESET, arrowSnapshotPath);
+    }
+}
+
+// Generate next incident ID
+int getNextIncidentId() {
+#ifdef __linux__
+    // Server workers each hold a partition, so ids come from the sequence they share
+    if (serverShared != NULL) {
+        return atomic_fetch_add(&serverShared->nextId, 1);
+    }
+#endif
+    int maxId = 0;
+    for (int i = 0; i < incidentCount; i++) {
+        if (incidentHot[i].id > maxId) {
+            maxId = incidentHot[i].id;
+        }
+    }
+    return maxId + 1;
+}
+
+// Show the watch list menu until the user goes back
+void manageWatchList() {
+    while (1) {
+        clearScreen();
+        displayHeader("MANAGE WATCH LIST");
+        printf("1. Add a subscription\n");
+        printf("2. View subscriptions " ANSI_COLOR_GREEN "(%d subscription%s)" ANSI_COLOR_RESET "\n",
+               subscriptionCount, (subscriptionCount == 1) ? "" : "s");
+        printf("3. Remove a subscription\n");
+        printf("4. Back to main menu\n\n");
+
+        int choice = validateChoiceInput("Enter your choice (1-4)", 1, 4);
+        if (choice == 4) {
+            return;
+        }
+
+        clearScreen();
+        switch (choice) {
+            case 1:
+                displayHeader("ADD SUBSCRIPTION");
+                addSubscription();
+                break;
+            case 2:
+                displayHeader("WATCH LIST");
+                viewSubscriptions();
+                break;
+            case 3:
+                displayHeader("REMOVE SUBSCRIPTION");
+                removeSubscription();
+                break;
+        }
+        printf("\nPress Enter to return to the watch list menu...");
+        getchar();
+    }
+}
+
+// Add a new subscription to the watch list
+void addSubscription() {
+    struct Subscription subscription;
+
+    validateStringInput(subscription.subscriber, MAX_SUBSCRIBER_LENGTH, "Enter the supervisor's name");
+    // '|' separates fields in the subscriptions file; the pattern is the last field, so only the name needs this
+    for (char* c = subscription.subscriber; *c != '\0'; c++) {
+        if (*c == '|') {
+            *c = '/';
+        }
+    }
+    validateStringInput(subscription.pattern, sizeof(subscription.pattern),
+                        "Enter the text to watch for (e.g., gas leak, Calea Dorobantilor)");
+
+    printf("Where should the text appear?\n");
+    printf("  1. Anywhere (area or incident type)\n");
+    printf("  2. Area only\n");
+    printf("  3. Incident type only\n");
+    subscription.field = validateChoiceInput("Enter your choice (1-3)", 1, 3) - 1;
+
+    if (!appendSubscription(&subscription)) {
+        printf(ANSI_COLOR_RED "Error: Not enough memory to add the subscription.\n" ANSI_COLOR_RESET);
+        return;
+    }
+    if (!buildWatchAutomaton()) {
+        // Only subscriptions that are also in the file stay on the watch list
+        subscriptionCount--;
+        buildWatchAutomaton();
+        printf(ANSI_COLOR_RED "Error: Not enough memory to add the subscription.\n" ANSI_COLOR_RESET);
+        return;
+    }
+
+    FILE *file = fopen(SUBSCRIPTIONS_FILE, "a");
+    if (file == NULL) {
+        printf(ANSI_COLOR_RED "Error: Could not open file for writing.\n" ANSI_COLOR_RESET);
+        return;
+    }
+    fprintf(file, "%s|%s|%s\n", subscription.subscriber, watchFieldName(subscription.field), subscription.pattern);
+    fclose(file);
+
+    printf(ANSI_COLOR_GREEN "\nSubscription added for %s.\n" ANSI_COLOR_RESET, subscription.subscriber);
+}
+
+// List all subscriptions on the watch list
+void viewSubscriptions() {
+    if (subscriptionCount == 0) {
+        printf("The watch list is empty.\n");
+        return;
+    }
+
+    printf("%-5s | %-30s | %-10s | %-30s\n", "No.", "Supervisor", "Field", "Watching for");
+    printf("---------------------------------------------------------------------------------\n");
+    for (int i = 0; i < subscriptionCount; i++) {
+        printf("%-5d | " ANSI_COLOR_GREEN "%-30s" ANSI_COLOR_RESET " | %-10s | "
+               ANSI_COLOR_MAGENTA "%-30s" ANSI_COLOR_RESET "\n",
+               i + 1, subscriptions[i].subscriber, watchFieldName(subscriptions[i].field), subscriptions[i].pattern);
+    }
+}
+
+// Remove a subscription chosen by its number in the list
+void removeSubscription() {
+    if (subscriptionCount == 0) {
+        printf("The watch list is empty.\n");
+        return;
+    }
+
+    viewSubscriptions();
+    printf("\n");
+    char prompt[MAX_STRING_LENGTH];
+    snprintf(prompt, sizeof(prompt), "Enter the number of the subscription to remove (1-%d)", subscriptionCount);
+    int number = validateChoiceInput(prompt, 1, subscriptionCount);
+
+    memmove(&subscriptions[number - 1], &subscriptions[number],
+            (size_t)(subscriptionCount - number) * sizeof(struct Subscription));
+    subscriptionCount--;
+    buildWatchAutomaton();
+
+    if (!writeSubscriptionsToFile()) {
+        printf(ANSI_COLOR_RED "Error: Could not open file for writing.\n" ANSI_COLOR_RESET);
+        return;
+    }
+    printf(ANSI_COLOR_GREEN "\nSubscription removed.\n" ANSI_COLOR_RESET);
+}
+
+// Read watch list subscriptions from file
+int readSubscriptionsFromFile() {
+    FILE *file = fopen(SUBSCRIPTIONS_FILE, "r");
+    if (file == NULL) {
         return 0;
     }
 
-    int count = 0;
-    char line[MAX_STRING_LENGTH * 3]; // Buffer to hold each line
+    char line[MAX_STRING_LENGTH * 3];
+    char field[MAX_STRING_LENGTH];
+    struct Subscription subscription;
 
-    while (count < MAX_INCIDENTS && fgets(line, sizeof(line), file) != NULL) {
-        // Remove newline character if present
+    while (fgets(line, sizeof(line), file) != NULL) {
         size_t len = strlen(line);
         if (len > 0 && line[len-1] == '\n') {
             line[len-1] = '\0';
         }
 
-        // Parse the line using sscanf
-        if (sscanf(line, "%d|%[^|]|%[^|]|%[^\n]",
-                   &incidents[count].id,
-                   incidents[count].area,
-                   incidents[count].type,
-                   incidents[count].time) == 4) {
-            count++;
+        if (sscanf(line, "%49[^|]|%99[^|]|%99[^\n]", subscription.subscriber, field, subscription.pattern) == 3) {
+            subscription.field = strcmp(field, "area") == 0 ? WATCH_AREA
+                               : strcmp(field, "type") == 0 ? WATCH_TYPE : WATCH_ANY;
+            if (!appendSubscription(&subscription)) {
+                break;
+            }
         }
     }
 
     fclose(file);
-    return count;
+    return subscriptionCount;
 }
 
-// Write a new incident to file
-void writeIncidentToFile(const struct Incident* incident) {
-    FILE *file = fopen(DATA_FILE, "a");
+// Rewrite the subscriptions file from the in-memory watch list
+int writeSubscriptionsToFile() {
+    FILE *file = fopen(SUBSCRIPTIONS_FILE, "w");
     if (file == NULL) {
-        printf(ANSI_COLOR_RED "Error: Could not open file for writing.\n" ANSI_COLOR_RESET);
+        return 0;
+    }
+    for (int i = 0; i < subscriptionCount; i++) {
+        fprintf(file, "%s|%s|%s\n", subscriptions[i].subscriber,
+                watchFieldName(subscriptions[i].field), subscriptions[i].pattern);
+    }
+    fclose(file);
+    return 1;
+}
+
+// Append a subscription to the in-memory watch list
+int appendSubscription(const struct Subscription* subscription) {
+    if (subscriptionCount == subscriptionCapacity) {
+        int newCapacity = subscriptionCapacity == 0 ? 16 : subscriptionCapacity * 2;
+        struct Subscription* grown = realloc(subscriptions, (size_t)newCapacity * sizeof(struct Subscription));
+        if (grown == NULL) {
+            return 0;
+        }
+        subscriptions = grown;
+        subscriptionCapacity = newCapacity;
+    }
+    subscriptions[subscriptionCount++] = *subscription;
+    return 1;
+}
+
+// Compile every subscription pattern into one Aho-Corasick automaton over lowercased text
+int buildWatchAutomaton() {
+    watchNodeCount = 0;
+    free(watchMatchNext);
+    free(watchAlertStamp);
+    watchMatchNext = malloc((size_t)(subscriptionCount > 0 ? subscriptionCount : 1) * sizeof(int));
+    watchAlertStamp = calloc((size_t)(subscriptionCount > 0 ? subscriptionCount : 1), sizeof(int));
+    if (watchMatchNext == NULL || watchAlertStamp == NULL || addWatchNode(0) < 0) {
+        return 0;
+    }
+
+    // Insert every pattern into the trie
+    for (int s = 0; s < subscriptionCount; s++) {
+        char pattern[MAX_STRING_LENGTH];
+        toLowerCopy(pattern, subscriptions[s].pattern, sizeof(pattern));
+
+        int node = 0;
+        for (const unsigned char* c = (const unsigned char*)pattern; *c != '\0'; c++) {
+            int child = findWatchChild(node, *c);
+            if (child < 0) {
+                child = addWatchNode(*c);
+                if (child < 0) {
+                    return 0;
+                }
+                watchNodes[child].nextSibling = watchNodes[node].firstChild;
+                watchNodes[node].firstChild = child;
+            }
+            node = child;
+        }
+        watchMatchNext[s] = watchNodes[node].firstMatch;
+        watchNodes[node].firstMatch = s;
+    }
+
+    // Breadth-first pass computing fail and output links, shallow nodes first
+    int* queue = malloc((size_t)watchNodeCount * sizeof(int));
+    if (queue == NULL) {
+        return 0;
+    }
+    int head = 0, tail = 0;
+    for (int child = watchNodes[0].firstChild; child >= 0; child = watchNodes[child].nextSibling) {
+        watchNodes[child].fail = 0;
+        watchNodes[child].output = -1;
+        queue[tail++] = child;
+    }
+    while (head < tail) {
+        int node = queue[head++];
+        for (int child = watchNodes[node].firstChild; child >= 0; child = watchNodes[child].nextSibling) {
+            int fail = watchNodes[node].fail;
+            int target;
+            while ((target = findWatchChild(fail, watchNodes[child].label)) < 0 && fail != 0) {
+                fail = watchNodes[fail].fail;
+            }
+            watchNodes[child].fail = target >= 0 ? target : 0;
+
+            int failNode = watchNodes[child].fail;
+            watchNodes[child].output = watchNodes[failNode].firstMatch >= 0 ? failNode : watchNodes[failNode].output;
+            queue[tail++] = child;
+        }
+    }
+    free(queue);
+    return 1;
+}
+
+// Append an empty automaton node and return its index (-1 if out of memory)
+int addWatchNode(unsigned char label) {
+    if (watchNodeCount == watchNodeCapacity) {
+        int newCapacity = watchNodeCapacity == 0 ? 64 : watchNodeCapacity * 2;
+        struct WatchNode* grown = realloc(watchNodes, (size_t)newCapacity * sizeof(struct WatchNode));
+        if (grown == NULL) {
+            return -1;
+        }
+        watchNodes = grown;
+        watchNodeCapacity = newCapacity;
+    }
+
+    struct WatchNode* node = &watchNodes[watchNodeCount];
+    node->firstChild = -1;
+    node->nextSibling = -1;
+    node->fail = 0;
+    node->output = -1;
+    node->firstMatch = -1;
+    node->label = label;
+    return watchNodeCount++;
+}
+
+// Find the child of a node reached by a character (-1 if there is none)
+int findWatchChild(int node, unsigned char label) {
+    for (int child = watchNodes[node].firstChild; child >= 0; child = watchNodes[child].nextSibling) {
+        if (watchNodes[child].label == label) {
+            return child;
+        }
+    }
+    return -1;
+}
+
+// Alert every supervisor whose subscription matches a newly reported incident
+void checkWatchList(const struct Incident* incident) {
+    if (subscriptionCount == 0 || watchNodeCount == 0) {
+        return;
+    }
+
+    // A new stamp makes each subscription alert at most once for this incident
+    watchCheckStamp++;
+    matchWatchText(incident->area, WATCH_AREA, incident);
+    matchWatchText(incident->type, WATCH_TYPE, incident);
+}
+
+// Run one field's text through the automaton and report matching subscriptions
+void matchWatchText(const char* text, int field, const struct Incident* incident) {
+    char normalized[MAX_STRING_LENGTH];
+    toLowerCopy(normalized, text, sizeof(normalized));
+
+    int node = 0;
+    for (const unsigned char* c = (const unsigned char*)normalized; *c != '\0'; c++) {
+        int next;
+        while ((next = findWatchChild(node, *c)) < 0 && node != 0) {
+            node = watchNodes[node].fail;
+        }
+        node = next >= 0 ? next : 0;
+
+        // Walk this node and every shorter pattern ending at the same position
+        int hit = watchNodes[node].firstMatch >= 0 ? node : watchNodes[node].output;
+        while (hit >= 0) {
+            for (int s = watchNodes[hit].firstMatch; s >= 0; s = watchMatchNext[s]) {
+                if (watchAlertStamp[s] == watchCheckStamp) {
+                    continue;
+                }
+                if (subscriptions[s].field != WATCH_ANY && subscriptions[s].field != field) {
+                    continue;
+                }
+                watchAlertStamp[s] = watchCheckStamp;
+                printf(ANSI_COLOR_YELLOW "ALERT" ANSI_COLOR_RESET " for " ANSI_COLOR_GREEN "%s" ANSI_COLOR_RESET
+                       ": incident %d (" ANSI_COLOR_GREEN "%s" ANSI_COLOR_RESET ", " ANSI_COLOR_RED "%s"
+                       ANSI_COLOR_RESET ") matches \"" ANSI_COLOR_MAGENTA "%s" ANSI_COLOR_RESET "\"\n",
+                       subscriptions[s].subscriber, incident->id, incident->area, incident->type,
+                       subscriptions[s].pattern);
+            }
+            hit = watchNodes[hit].output;
+        }
+    }
+}
+
+// Name of a watch field as shown to the user and stored in the file
+const char* watchFieldName(int field) {
+    switch (field) {
+        case WATCH_AREA: return "area";
+        case WATCH_TYPE: return "type";
+        default: return "any";
+    }
+}
+
+// Show the alert rules menu until the user goes back
+void manageAlertRules() {
+    while (1) {
+        clearScreen();
+        displayHeader("ALERT RULES");
+        printf("1. View rules " ANSI_COLOR_GREEN "(%d rule%s)" ANSI_COLOR_RESET "\n",
+               alertRuleCount, (alertRuleCount == 1) ? "" : "s");
+        printf("2. Reload rules from %s\n", RULES_FILE);
+        printf("3. Replay an incident trace through the rules\n");
+        printf("4. Back to main menu\n\n");
+
+        int choice = validateChoiceInput("Enter your choice (1-4)", 1, 4);
+        if (choice == 4) {
+            return;
+        }
+
+        clearScreen();
+        switch (choice) {
+            case 1:
+                displayHeader("ALERT RULES");
+                viewAlertRules();
+                break;
+            case 2:
+                displayHeader("RELOAD RULES");
+                alertRuleCount = readAlertRulesFromFile();
+                warmRuleWindows();
+                printf(ANSI_COLOR_GREEN "Loaded %d rule%s.\n" ANSI_COLOR_RESET,
+                       alertRuleCount, (alertRuleCount == 1) ? "" : "s");
+                break;
+            case 3:
+                displayHeader("REPLAY TRACE");
+                replayTrace();
+                break;
+        }
+        printf("\nPress Enter to return to the alert rules menu...");
+        getchar();
+    }
+}
+
+// List the configured alert rules
+void viewAlertRules() {
+    if (alertRuleCount == 0) {
+        printf("No rules configured. Add lines to %s in the format:\n", RULES_FILE);
+        printf("  name|area, type or area+type|type text or *|threshold|window minutes|sliding or tumbling\n");
+        printf("Example: Pothole cluster|area|pothole|10|60|sliding\n");
+        printf("Thresholds range from 0 to %d; rules outside it are skipped.\n", MAX_RULE_THRESHOLD);
+        printf("Rules over adjacent areas are not supported; areas have no map of their neighbours.\n");
+        return;
+    }
+
+    static const char* keyNames[] = { "area", "type", "area+type" };
+    printf("%-25s | %-10s | %-20s | %-9s | %-7s | %-8s\n", "Rule", "Per", "Type", "More than", "Window", "Mode");
+    printf("---------------------------------------------------------------------------------------\n");
+    for (int r = 0; r < alertRuleCount; r++) {
+        printf(ANSI_COLOR_GREEN "%-25s" ANSI_COLOR_RESET " | %-10s | " ANSI_COLOR_RED "%-20s" ANSI_COLOR_RESET
+               " | " ANSI_COLOR_YELLOW "%-9d" ANSI_COLOR_RESET " | " ANSI_COLOR_BLUE "%4d min" ANSI_COLOR_RESET
+               " | %-8s\n",
+               alertRules[r].name, keyNames[alertRules[r].key], alertRules[r].typePattern,
+               alertRules[r].threshold, alertRules[r].windowMinutes,
+               alertRules[r].tumbling ? "tumbling" : "sliding");
+    }
+}
+
+// Feed the incidents of a file through fresh rule windows, printing every alert
+void replayTrace() {
+    char path[MAX_STRING_LENGTH];
+    validateStringInput(path, MAX_STRING_LENGTH, "Enter the incidents file to replay (e.g., incidents.txt)");
+
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        printf(ANSI_COLOR_RED "Error: Could not open %s.\n" ANSI_COLOR_RESET, path);
         return;
     }
 
-    fprintf(file, "%d|%s|%s|%s\n", incident->id, incident->area, incident->type, incident->time);
+    resetRuleWindows();
+    char line[MAX_LINE_LENGTH];
+    struct Incident incident;
+    struct IncidentLayout layout = legacyIncidentLayout;
+    int replayed = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (line[0] == '#') {
+            parseSchemaLine(line, &layout);
+        } else if (parseIncidentLine(line, &layout, &incident) && isValidTimeFormat(incident.time)) {
+            evaluateAlertRules(&incident, 1);
+            replayed++;
+        }
+    }
     fclose(file);
+    printf(ANSI_COLOR_GREEN "\nReplayed %d incident%s.\n" ANSI_COLOR_RESET, replayed, (replayed == 1) ? "" : "s");
+
+    // Rebuild the live windows from the store so the replay does not leak into them
+    warmRuleWindows();
 }
 
-// Generate next incident ID
-int getNextIncidentId() {
-    int maxId = 0;
+// Read alert rules from file, skipping blank lines, comments (#) and malformed rules
+int readAlertRulesFromFile() {
+    free(alertRules);
+    alertRules = NULL;
+
+    FILE *file = fopen(RULES_FILE, "r");
+    if (file == NULL) {
+        return 0;
+    }
+
+    int count = 0;
+    int capacity = 0;
+    int lineNumber = 0;
+    char line[MAX_STRING_LENGTH * 3];
+    char key[MAX_STRING_LENGTH];
+    char mode[MAX_STRING_LENGTH];
+    struct AlertRule rule;
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        lineNumber++;
+        if (line[0] == '#') {
+            continue;
+        }
+        if (sscanf(line, "%49[^|]|%99[^|]|%49[^|]|%d|%d|%99[^\r\n]", rule.name, key, rule.typePattern,
+                   &rule.threshold, &rule.windowMinutes, mode) != 6) {
+            continue;
+        }
+        if (rule.threshold < 0 || rule.threshold > MAX_RULE_THRESHOLD
+            || rule.windowMinutes <= 0 || rule.windowMinutes > MINUTES_PER_DAY) {
+            continue;
+        }
+        if (strcmp(key, "area") == 0) {
+            rule.key = RULE_KEY_AREA;
+        } else if (strcmp(key, "type") == 0) {
+            rule.key = RULE_KEY_TYPE;
+        } else if (strcmp(key, "area+type") == 0) {
+            rule.key = RULE_KEY_AREA_TYPE;
+        } else {
+            // Areas are free text with no map of which ones border each other, so there is no "adjacent areas" key
+            printf(ANSI_COLOR_RED "Error: %s line %d: rule \"%s\" is per \"%s\"; rules can only be per area, type "
+                   "or area+type%s.\n" ANSI_COLOR_RESET, RULES_FILE, lineNumber, rule.name, key,
+                   strContainsLower(key, "adjacent") ? " (adjacent areas are not known)" : "");
+            continue;
+        }
+        rule.tumbling = strcmp(mode, "tumbling") == 0;
+
+        if (count == capacity) {
+            capacity = capacity == 0 ? 8 : capacity * 2;
+            struct AlertRule* grown = realloc(alertRules, (size_t)capacity * sizeof(struct AlertRule));
+            if (grown == NULL) {
+                break;
+            }
+            alertRules = grown;
+        }
+        alertRules[count++] = rule;
+    }
+
+    fclose(file);
+    return count;
+}
+
+// Forget all window state, e.g. after the rules change or before a replay
+void resetRuleWindows() {
+    for (int i = 0; i < windowStateCount; i++) {
+        free(windowStates[i].ring);
+    }
+    windowStateCount = 0;
+    for (int i = 0; i < windowTableSize; i++) {
+        windowTable[i] = -1;
+    }
+    streamDay = 0;
+    lastStreamMinute = 0;
+}
+
+// Rebuild the rule windows from the stored history without raising alerts
+void warmRuleWindows() {
+    resetRuleWindows();
     for (int i = 0; i < incidentCount; i++) {
-        if (incidents[i].id > maxId) {
-            maxId = incidents[i].id;
+        struct Incident incident;
+        loadIncident(i, &incident);
+        evaluateAlertRules(&incident, 0);
+    }
+}
+
+// Advance every rule's window with one incident in O(1) per rule, alerting when a threshold is crossed
+void evaluateAlertRules(const struct Incident* incident, int report) {
+    if (alertRuleCount == 0) {
+        return;
+    }
+
+    // Windows run on the commit time; rows from before it was recorded only have a time of day,
+    // so for them a jump back of more than half a day starts the next day
+    long timestamp;
+    if (incident->reported != 0) {
+        timestamp = incident->reported / 60;
+    } else {
+        int minute = timeToMinutes(incident->time);
+        if (minute < lastStreamMinute - MINUTES_PER_DAY / 2) {
+            streamDay++;
         }
+        lastStreamMinute = minute;
+        timestamp = streamDay * MINUTES_PER_DAY + minute;
+    }
+
+    for (int r = 0; r < alertRuleCount; r++) {
+        const struct AlertRule* rule = &alertRules[r];
+        if (strcmp(rule->typePattern, "*") != 0 && !strContains(incident->type, rule->typePattern)) {
+            continue;
+        }
+
+        char key[MAX_AREA_LENGTH + MAX_TYPE_LENGTH];
+        if (rule->key == RULE_KEY_AREA) {
+            toLowerCopy(key, incident->area, sizeof(key));
+        } else if (rule->key == RULE_KEY_TYPE) {
+            toLowerCopy(key, incident->type, sizeof(key));
+        } else {
+            char combined[MAX_AREA_LENGTH + MAX_TYPE_LENGTH];
+            snprintf(combined, sizeof(combined), "%s|%s", incident->area, incident->type);
+            toLowerCopy(key, combined, sizeof(key));
+        }
+
+        struct WindowState* state = findWindowState(r, key);
+        if (state == NULL) {
+            continue;
+        }
+
+        // Late reports within the same day are counted at the newest time seen for the key
+        long eventTime = timestamp < state->lastTimestamp ? state->lastTimestamp : timestamp;
+        state->lastTimestamp = eventTime;
+
+        int exceeded;
+        if (rule->tumbling) {
+            long bucket = eventTime / rule->windowMinutes;
+            if (bucket != state->bucket) {
+                state->bucket = bucket;
+                state->count = 0;
+                state->firing = 0;
+            }
+            state->count++;
+            exceeded = state->count > rule->threshold;
+        } else {
+            // The ring keeps the last threshold + 1 events; the threshold is exceeded
+            // exactly when the oldest of them is still inside the window
+            int size = rule->threshold + 1;
+            state->ring[state->ringNext] = eventTime;
+            state->ringNext = (state->ringNext + 1) % size;
+            if (state->ringCount < size) {
+                state->ringCount++;
+            }
+            long oldest = state->ring[state->ringCount < size ? 0 : state->ringNext];
+            exceeded = state->ringCount == size && eventTime - oldest < rule->windowMinutes;
+        }
+
+        if (exceeded && !state->firing && report) {
+            printf(ANSI_COLOR_YELLOW "RULE ALERT" ANSI_COLOR_RESET " " ANSI_COLOR_GREEN "%s" ANSI_COLOR_RESET
+                   ": more than " ANSI_COLOR_YELLOW "%d" ANSI_COLOR_RESET " incidents for \"" ANSI_COLOR_MAGENTA
+                   "%s" ANSI_COLOR_RESET "\" within " ANSI_COLOR_BLUE "%d" ANSI_COLOR_RESET
+                   " minutes (latest: incident %d at %s)\n",
+                   rule->name, rule->threshold, key, rule->windowMinutes, incident->id, incident->time);
+        }
+        state->firing = exceeded;
+    }
+}
+
+// Find the window state of a rule for a key, creating it on first use (NULL if out of memory)
+struct WindowState* findWindowState(int rule, const char* key) {
+    unsigned int hash = hashString(key) ^ (unsigned int)rule * 2654435761u;
+
+    // Keep the table at most half full so probes stay short
+    if ((windowStateCount + 1) * 2 > windowTableSize) {
+        int newSize = windowTableSize == 0 ? 64 : windowTableSize * 2;
+        int* table = malloc((size_t)newSize * sizeof(int));
+        if (table == NULL) {
+            return NULL;
+        }
+        for (int i = 0; i < newSize; i++) {
+            table[i] = -1;
+        }
+        for (int i = 0; i < windowStateCount; i++) {
+            int slot = (int)(windowStates[i].hash & (unsigned int)(newSize - 1));
+            while (table[slot] >= 0) {
+                slot = (slot + 1) & (newSize - 1);
+            }
+            table[slot] = i;
+        }
+        free(windowTable);
+        windowTable = table;
+        windowTableSize = newSize;
+    }
+
+    int slot = (int)(hash & (unsigned int)(windowTableSize - 1));
+    while (windowTable[slot] >= 0) {
+        struct WindowState* state = &windowStates[windowTable[slot]];
+        if (state->hash == hash && state->rule == rule && strcmp(state->key, key) == 0) {
+            return state;
+        }
+        slot = (slot + 1) & (windowTableSize - 1);
+    }
+
+    if (windowStateCount == windowStateCapacity) {
+        int newCapacity = windowStateCapacity == 0 ? 64 : windowStateCapacity * 2;
+        struct WindowState* grown = realloc(windowStates, (size_t)newCapacity * sizeof(struct WindowState));
+        if (grown == NULL) {
+            return NULL;
+        }
+        windowStates = grown;
+        windowStateCapacity = newCapacity;
+    }
+
+    struct WindowState* state = &windowStates[windowStateCount];
+    memset(state, 0, sizeof(*state));
+    strcpy(state->key, key);
+    state->hash = hash;
+    state->rule = rule;
+    state->bucket = -1;
+    state->lastTimestamp = -1;
+    if (!alertRules[rule].tumbling) {
+        state->ring = malloc((size_t)(alertRules[rule].threshold + 1) * sizeof(long));
+        if (state->ring == NULL) {
+            return NULL;
+        }
+    }
+    windowTable[slot] = windowStateCount++;
+    return state;
+}
+
+// FNV-1a hash of a string
+unsigned int hashString(const char* text) {
+    unsigned int hash = 2166136261u;
+    for (const unsigned char* c = (const unsigned char*)text; *c != '\0'; c++) {
+        hash ^= *c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Ask for a menu choice until a number in the given range is entered
+int validateChoiceInput(const char* prompt, int min, int max) {
+    char input[MAX_STRING_LENGTH];
+    int value;
+    char extra;
+
+    while (1) {
+        validateStringInput(input, sizeof(input), prompt);
+        if (sscanf(input, "%d%c", &value, &extra) == 1 && value >= min && value <= max) {
+            return value;
+        }
+        printf(ANSI_COLOR_RED "Please enter a number between %d and %d.\n" ANSI_COLOR_RESET, min, max);
     }
-    return maxId + 1;
 }
 
 // Validate string input with proper formatting and limits
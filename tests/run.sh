@@ -0,0 +1,77 @@
+#!/bin/sh
+# Build the program and run the tests/test_*.sh scripts against it, each driving its menus in scratch directories.
+# Usage: tests/run.sh [name...]   e.g. tests/run.sh query   (needs a C compiler; python3 with pyarrow for the
+# full export checks)
+
+set -u
+root=$(cd "$(dirname "$0")/.." && pwd)
+tests="$root/tests"
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT INT TERM
+failures=0
+
+# Each case runs in its own directory; checkpoints are off so every start reads the incidents file
+export INCIDENTS_CHECKPOINT=off
+unset INCIDENTS_SHARED_STORE INCIDENTS_SERVER_PORT INCIDENTS_BENCHMARK INCIDENTS_ARROW_SNAPSHOT
+
+pass() { echo "ok - $1"; }
+fail() { echo "not ok - $1"; failures=$((failures + 1)); }
+
+# Feed the menus the given input and print what the program wrote, without colors
+app() {
+    printf "$1" | timeout 20 "$work/app" 2>&1 | sed 's/\x1b\[[0-9;]*[A-Za-z]//g'
+}
+
+# Start a case directory holding the given incidents file lines
+scratch() {
+    dir="$work/$1"
+    mkdir -p "$dir"
+    cd "$dir" || exit 1
+    printf "$2" > incidents.txt
+}
+
+# Start a case directory holding the given number of generated incidents: five areas, five types, one a minute,
+# reported over the last day, every 97th with a burst water main in its description
+generated() {
+    scratch "$1" ""
+    awk -v count="$2" -v now="$now" 'BEGIN {
+        split("Main Street|Oak Road|Pine Lane|Elm Street|Market Square", areas, "|")
+        split("pothole|flood|fire|streetlight|graffiti", types, "|")
+        print "#schema 1|id|area|type|time|description|priority|reported"
+        for (i = 1; i <= count; i++) {
+            printf "%d|%s|%s|%02d:%02d|%s|%d|%d\n", i, areas[i % 5 + 1], types[int(i / 5) % 5 + 1], int(i / 60) % 24,
+                   i % 60, i % 97 == 0 ? "water main burst near the school" : "routine report", 1 + i % 5,
+                   now - 86400 + i
+        }
+    }' > incidents.txt
+}
+
+now=$(date +%s)
+hour=$((now - 3600))
+rows="#schema 1|id|area|type|time|description|priority|reported
+1|Main Street|flood|10:00|water over the road|2|$hour
+2|Oak Road|fire|11:30|smoke from a roof|4|$hour
+3|main street|pothole|08:15||3|0
+"
+
+echo "Building with ${CC:-cc} main.c -lm"
+if ! ${CC:-cc} -O2 "$root/main.c" -o "$work/app" -lm; then
+    echo "not ok - build"
+    exit 1
+fi
+pass "build"
+
+# Each test script is sourced, so it can use the helpers above and count its failures
+if [ "$#" -eq 0 ]; then
+    set -- $(cd "$tests" && ls test_*.sh | sed 's/^test_//; s/\.sh$//')
+fi
+for name in "$@"; do
+    echo "# $name"
+    . "$tests/test_$name.sh"
+done
+
+if [ "$failures" -ne 0 ]; then
+    echo "$failures test(s) failed"
+    exit 1
+fi
+echo "All tests passed"
@@ -0,0 +1,21 @@
+# Adaptive indexes (user-083): a selective filter used often gets an index, which is dropped once the workload
+# moves on
+
+generated adaptive_indexes 5000
+range="SELECT id WHERE time BETWEEN '10:00' AND '10:30'"
+app "2\n4\nEXPLAIN $range\n\n4\n$range\n\n4\n$range\n\n4\n$range\n\n4\nEXPLAIN $range\n\n4\n$range\n\n8\n7\n" > out.log
+if [ "$(grep -c "Scan incidents (full scan of 5000 rows" out.log)" -eq 1 ] \
+    && grep -q "Index scan using time index (about 124 candidate rows" out.log \
+    && [ "$(grep -c "^124 rows" out.log)" -eq 4 ]; then pass "a frequent selective filter gets an index"
+else fail "a frequent selective filter gets an index"; fi
+other=""
+i=0
+while [ $i -lt 51 ]; do
+    other="${other}4\nSELECT count(*) WHERE priority = $((i % 5 + 1))\n\n"
+    i=$((i + 1))
+done
+app "2\n4\n$range\n\n4\n$range\n\n4\n$range\n\n4\nEXPLAIN $range\n\n${other}4\nEXPLAIN $range\n\n8\n7\n" > out.log
+if [ "$(grep -c "Index scan using time index" out.log)" -eq 1 ] \
+    && grep -q "Scan incidents (full scan of 5000 rows" out.log; then
+    pass "an index the workload stops using is dropped"
+else fail "an index the workload stops using is dropped"; fi
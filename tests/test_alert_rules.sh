@@ -0,0 +1,30 @@
+# Alert rules (user-080): replayed traces fire rules on commit times, fall back to times of day for old rows, and
+# rules the engine cannot evaluate are reported
+
+scratch alert_rules "$rows"
+printf "Pothole cluster|area|pothole|2|60|sliding\nLights out|adjacent areas|streetlight|3|30|sliding\n" > rules.txt
+day=$((now - now % 86400 - 86400))
+printf "#schema 1|id|area|type|time|description|priority|reported
+1|Oak Road|pothole|10:00||2|$((day + 36000))
+2|Oak Road|pothole|10:20||2|$((day + 37200))
+3|Oak Road|pothole|10:10||2|$((day + 37800))
+4|Elm Street|pothole|10:00||2|$((day + 36000))
+5|Elm Street|pothole|06:00||2|$((day + 108000))
+6|Elm Street|pothole|06:10||2|$((day + 108600))
+7|Pine Lane|pothole|23:50||2|0
+8|Pine Lane|pothole|23:55||2|0
+9|Pine Lane|pothole|00:05||2|0
+" > trace.txt
+app "4\n1\n\n3\ntrace.txt\n\n4\n7\n" > out.log
+if grep -q "rules.txt line 2: rule \"Lights out\" is per \"adjacent areas\".*adjacent areas are not known" out.log \
+    && grep -q "^Pothole cluster " out.log && ! grep -q "^Lights out " out.log; then
+    pass "a rule over adjacent areas is refused"
+else fail "a rule over adjacent areas is refused"; fi
+if grep -q "RULE ALERT Pothole cluster: .*\"oak road\".*incident 3 at 10:10" out.log; then
+    pass "a late report inside the window fires"
+else fail "a late report inside the window fires"; fi
+if ! grep -q "\"elm street\"" out.log; then pass "commit times keep reports a day apart out of one window"
+else fail "commit times keep reports a day apart out of one window"; fi
+if grep -q "RULE ALERT Pothole cluster: .*\"pine lane\".*incident 9 at 00:05" out.log; then
+    pass "rows without a commit time roll over midnight"
+else fail "rows without a commit time roll over midnight"; fi
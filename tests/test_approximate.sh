@@ -0,0 +1,24 @@
+# Approximate queries (user-087): APPROX estimates from the reservoir sample land near the exact counts, EXACT
+# overrides INCIDENTS_QUERY_MODE=approx, and a store smaller than the sample is counted exactly
+
+generated approximate 300000
+app "2\n4\nAPPROX SELECT area, count(*) GROUP BY area ORDER BY 1\n\n8\n7\n" > out.log
+# Rows read "Oak Road | ~61295 ± 819"; the fixed sampling seed puts one of the five estimates just outside its 95%
+# interval, so each may be off by twice its margin
+near='NF >= 5 && $(NF - 2) - 2 * $NF <= 60000 && $(NF - 2) + 2 * $NF >= 60000'
+if grep -q "^Approximate result from a uniform sample of 65536 of 300000 incidents" out.log \
+    && [ "$(grep -A6 "^Area" out.log | tr -d '~' | awk "$near" | wc -l)" -eq 5 ]; then
+    pass "sampled group counts are near the exact ones"
+else fail "sampled group counts are near the exact ones"; fi
+export INCIDENTS_QUERY_MODE=approx
+app "2\n4\nSELECT count(*) WHERE priority = 3\n\n4\nEXACT SELECT count(*) WHERE priority = 3\n\n8\n7\n" > out.log
+unset INCIDENTS_QUERY_MODE
+if [ "$(grep -c "^Approximate result" out.log)" -eq 1 ] && grep -A2 "^Count" out.log | grep -q "^60000 *$"; then
+    pass "EXACT overrides the approximate default"
+else fail "EXACT overrides the approximate default"; fi
+
+scratch approximate_small "$rows"
+app "2\n4\nAPPROX SELECT count(*) WHERE area = 'main street'\n\n8\n7\n" > out.log
+if ! grep -q "Approximate" out.log && grep -A2 "^Count" out.log | grep -q "^2 *$"; then
+    pass "a store smaller than the sample is counted exactly"
+else fail "a store smaller than the sample is counted exactly"; fi
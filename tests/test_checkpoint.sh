@@ -0,0 +1,32 @@
+# Checkpoints (user-093): a restart restores the image and reads only the rows appended after it, and an image that
+# no longer matches the incidents file, or is damaged, is refused in favour of reading the whole file
+
+generated checkpoint 5000
+export INCIDENTS_CHECKPOINT=incidents.ckpt
+app "7\n" > out.log
+printf "5001|Harbor Road|flood|09:00|tail row under water|4|$now\n" >> incidents.txt
+check="2\n5\n\n4\nSELECT count(*) WHERE area = 'harbor road'\n\n4\nSELECT count(*)\n\n6\nwater\n\n8\n7\n"
+app "$check" > out.log
+if grep -q "^Opened from checkpoint incidents.ckpt: 5000 rows restored, 1 read from incidents.txt" out.log \
+    && grep -A2 "^Count" out.log | grep -q "^5001 *$" && grep -q "^52 matching incidents" out.log; then
+    pass "a restored image picks up the rows appended after it"
+else fail "a restored image picks up the rows appended after it"; fi
+
+# Same length, so only hashing the whole covered prefix notices the edit far from its end
+sed -i '11s/|Main Street|/|Main Stre3t|/' incidents.txt
+app "2\n5\n\n4\nSELECT count(*) WHERE area = 'main stre3t'\n\n8\n7\n" > out.log
+if ! grep -q "^Opened from checkpoint" out.log && grep -A2 "^Count" out.log | grep -q "^1 *$"; then
+    pass "an edit early in the incidents file invalidates the image"
+else fail "an edit early in the incidents file invalidates the image"; fi
+
+head -c 20000 incidents.ckpt > truncated.ckpt
+mv truncated.ckpt incidents.ckpt
+app "$check" > out.log
+if ! grep -q "^Opened from checkpoint" out.log && grep -A2 "^Count" out.log | grep -q "^5001 *$"; then
+    pass "a truncated image is refused"
+else fail "a truncated image is refused"; fi
+app "2\n5\n\n8\n7\n" > out.log
+if grep -q "^Opened from checkpoint incidents.ckpt: 5001 rows restored, 0 read" out.log; then
+    pass "the next exit writes a usable image again"
+else fail "the next exit writes a usable image again"; fi
+export INCIDENTS_CHECKPOINT=off
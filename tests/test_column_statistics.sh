@@ -0,0 +1,19 @@
+# Column statistics (user-084): counts are kept up to date as incidents are reported, rebuilt the same on load, and
+# the planner evaluates the most selective filter first
+
+scratch column_statistics "$rows"
+app "1\nOak Road\nfire\n12:00\n3\n\n\n1\nOak Road\nflood\n12:05\n3\n\n\n2\n5\n\n8\n7\n" > live.log
+app "2\n5\n\n8\n7\n" > loaded.log
+for log in live loaded; do
+    if grep -q "^Rows: 5$" $log.log && grep -q "^area *| 2 " $log.log && grep -q "^type *| 3 " $log.log \
+        && grep -A1 "^Most common areas:" $log.log | grep -q "^  oak road *3$" \
+        && grep -A2 "^Most common areas:" $log.log | grep -q "^  main street *2$"; then
+        pass "statistics after reports ($log)"
+    else fail "statistics after reports ($log)"; fi
+done
+
+generated column_statistics_order 5000
+app "2\n4\nEXPLAIN SELECT id WHERE priority >= 1 AND area = 'oak road'\n\n8\n7\n" > out.log
+if grep -A2 "^Filter (priority >= 1), est. 100.0%" out.log | grep -q "^  -> Filter (area = 'oak road'), est. 20.0%" \
+    && grep -q "^    -> Scan incidents" out.log; then pass "the more selective filter runs first"
+else fail "the more selective filter runs first"; fi
@@ -0,0 +1,24 @@
+# Compaction (user-094): a file in an older schema is rewritten in the current one on exit; a current file is left
+# alone, and rows before any schema line keep their original layout
+
+scratch compaction "#schema 0|id|type|area|time|description|priority|reported
+1|flood|Main Street|10:00|water|2|0
+2|fire|Oak Road|11:30|smoke|4|0
+"
+app "7\n" > out.log
+if [ "$(head -1 incidents.txt)" = "#schema 1|id|area|type|time|description|priority|reported" ] \
+    && grep -q "^1|Main Street|flood|10:00|water|2|0$" incidents.txt \
+    && grep -q "^2|Oak Road|fire|11:30|smoke|4|0$" incidents.txt && [ "$(wc -l < incidents.txt)" -eq 3 ]; then
+    pass "compaction migrates older rows"
+else fail "compaction migrates older rows"; fi
+cp incidents.txt before.txt
+app "7\n" > out.log
+if cmp -s before.txt incidents.txt; then pass "compaction skips a current file"
+else fail "compaction skips a current file"; fi
+
+scratch compaction_unversioned "1|Main Street|flood|10:00\n#schema 0|id|type|area|time\n2|fire|Oak Road|11:30\n"
+app "2\n4\nSELECT id, area, type WHERE id <= 2 ORDER BY 1\n\n8\n7\n" > out.log
+if grep -q "^1 *| Main Street *| flood" out.log && grep -q "^2 *| Oak Road *| fire" out.log \
+    && grep -q "^1|Main Street|flood|10:00||3|0$" incidents.txt && grep -q "^2|Oak Road|fire|11:30||3|0$" incidents.txt; then
+    pass "compaction migrates unversioned rows and mixed segments"
+else fail "compaction migrates unversioned rows and mixed segments"; fi
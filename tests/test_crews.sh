@@ -0,0 +1,18 @@
+# Crew assignments (user-090): crews only get incidents they have the skill for, within their capacity, and the most
+# urgent work is covered first
+
+scratch crews "#schema 1|id|area|type|time|description|priority|reported
+1|Main Street|pothole|10:00||5|0
+2|Main Street|pothole|10:05||5|0
+3|Main Street|pothole|10:10||1|0
+4|Oak Road|fire|10:15||4|0
+5|Oak Road|flood|10:20||2|0
+6|Pine Lane|graffiti|10:25||3|0
+"
+printf "Roads|pothole|2\nFire|fire,flood|1\nAnyone|*|1\n" > crews.txt
+app "5\n4\n\n5\n7\n" > out.log
+if [ "$(sort assignments.txt | tr '\n' ' ')" = "Anyone|6 Fire|4 Roads|1 Roads|2 " ]; then
+    pass "crews get the most urgent work they can do"
+else fail "crews get the most urgent work they can do: $(sort assignments.txt | tr '\n' ' ')"; fi
+if grep -q "^Unassigned: critical 0, high 0, normal 0, minor 1, low 1$" out.log; then pass "unassigned work is summarized"
+else fail "unassigned work is summarized"; fi
@@ -0,0 +1,19 @@
+# Description search (user-088): reports are searchable as soon as they are stored, terms rank by BM25 and quoted
+# phrases need their words in order
+
+scratch descriptions "#schema 1|id|area|type|time|description|priority|reported
+1|Main Street|gas leak|10:00|smell near the school, maybe gas|2|0
+2|Oak Road|gas leak|10:05|strong gas smell, gas everywhere, gas meter hissing|3|0
+3|Pine Lane|traffic|10:10|school bus stuck at the junction|2|0
+4|Elm Street|smoke|10:15|smell of smoke near school|2|0
+"
+search="2\n6\ngas\n\n6\n\"gas smell\"\n\n6\n\"school smell\"\n\n8\n7\n"
+app "1\nMarket Square\ngas leak\n11:00\n4\nGas smell by the school gates\n\n$search" > live.log
+app "$search" > loaded.log
+for log in live loaded; do
+    ranks=$(grep "^[0-9] *| [0-9.]* *| " $log.log | awk -F'|' '{ printf "%d ", $3 }')
+    if [ "$ranks" = "2 1 5 2 5 " ] && grep -q "^3 matching incidents" $log.log \
+        && grep -q "^2 matching incidents" $log.log && grep -q "^0 matching incidents" $log.log; then
+        pass "ranked and phrase search ($log)"
+    else fail "ranked and phrase search ($log): $ranks"; fi
+done
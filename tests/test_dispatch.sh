@@ -0,0 +1,20 @@
+# Dispatch queue (user-089): the most urgent open incident comes next, priority changes reorder the queue, and
+# dispatches and changes survive a restart
+
+scratch dispatch "$rows"
+# IDs in the queue as the given "next to dispatch" screen of out.log listed them
+queue() {
+    awk '/NEXT TO DISPATCH/ { n++; shown = n == '"$1"' } /DISPATCH QUEUE/ { shown = 0 }
+         shown && /^[0-9]+ *\|/ { printf "%d ", $1 }' out.log
+}
+app "5\n1\n\n2\n\n3\n1\n5\n\n1\n\n5\n7\n" > out.log
+if [ "$(queue 1)" = "2 3 1 " ]; then pass "the queue is ordered by priority"
+else fail "the queue is ordered by priority: $(queue 1)"; fi
+if grep -A4 "^Dispatching:" out.log | grep -q "^2 *| Oak Road" && grep -q "^2 open incidents left" out.log; then
+    pass "dispatch takes the most urgent incident"
+else fail "dispatch takes the most urgent incident"; fi
+if [ "$(queue 2)" = "1 3 " ]; then pass "raising a priority moves the incident up"
+else fail "raising a priority moves the incident up: $(queue 2)"; fi
+app "5\n1\n\n3\n1\n1\n\n1\n\n5\n7\n" > out.log
+if [ "$(queue 1)" = "1 3 " ] && [ "$(queue 2)" = "3 1 " ]; then pass "the queue is restored and lowering reorders it"
+else fail "the queue is restored and lowering reorders it: $(queue 1)/ $(queue 2)"; fi
@@ -0,0 +1,19 @@
+# Version history (user-091): AS OF reads earlier values, also after a restart, and refuses times it cannot answer
+
+scratch history "$rows"
+app "5\n3\n1\n5\n\n5\n7\n" > out.log
+app "2\n4\nSELECT id, priority WHERE id = 1\n\n4\nSELECT id, priority AS OF $((now - 1800)) WHERE id = 1\n\n8\n7\n" > out.log
+if grep -q "^1 *| critical" out.log && grep -q "^1 *| minor" out.log; then pass "AS OF reads the earlier priority"
+else fail "AS OF reads the earlier priority"; fi
+app "2\n4\nSELECT id AS OF 1000000000\n\n8\n7\n" > out.log
+if grep -q "AS OF can go back to" out.log; then pass "AS OF refuses times before the history"
+else fail "AS OF refuses times before the history"; fi
+for date in "'2024-05-01x'" "'2024-05-01 10:30junk'" "'2024-13-45'" "'2023-02-29'" "'2024-05-01 24:00'"; do
+    app "2\n4\nSELECT id AS OF $date\n\n8\n7\n" > out.log
+    if grep -q "Query error: expected AS OF 'YYYY-MM-DD \[HH:MM\[:SS\]\]'" out.log; then pass "AS OF refuses $date"
+    else fail "AS OF refuses $date"; fi
+done
+today=$(date +%Y-%m-%d)
+app "2\n4\nSELECT count(*) AS OF '$today'\n\n4\nSELECT count(*) AS OF '$(date "+%Y-%m-%d %H:%M")'\n\n8\n7\n" > out.log
+if ! grep -q "Query error" out.log && [ "$(grep -c "^Count" out.log)" -eq 2 ]; then pass "AS OF takes a date and a date and time"
+else fail "AS OF takes a date and a date and time"; fi
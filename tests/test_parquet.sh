@@ -0,0 +1,26 @@
+# Parquet export (user-099): the file holds the same rows as the incidents file
+
+scratch parquet "$rows"
+app "2\n7\n2\nout.parquet\n\n8\n7\n" > out.log
+if [ "$(head -c 4 out.parquet)" = "PAR1" ] && [ "$(tail -c 4 out.parquet)" = "PAR1" ]; then pass "Parquet file framing"
+else fail "Parquet file framing"; fi
+if python3 -c "import pyarrow" 2>/dev/null; then
+    if python3 - <<'EOF'
+import pyarrow.parquet
+expected = []
+for line in open("incidents.txt"):
+    if not line.startswith("#"):
+        id, area, type, time, description, priority, reported = line.rstrip("\n").split("|")
+        expected.append((int(id), area, type, int(priority), description))
+# An incident with no description has an empty string
+table = pyarrow.parquet.read_table("out.parquet")
+columns = table.to_pydict()
+got = list(zip(columns["id"], columns["area"], columns["type"], columns["priority"], columns["description"]))
+assert got == expected, got
+assert table.column("status").to_pylist() == ["open"] * len(expected)
+EOF
+    then pass "Parquet reads back with pyarrow"
+    else fail "Parquet reads back with pyarrow"; fi
+else
+    echo "ok - Parquet reads back with pyarrow # SKIP pyarrow not installed"
+fi
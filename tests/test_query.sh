@@ -0,0 +1,17 @@
+# Query language (user-081): reported incidents are found by queries; areas group case-insensitively and the
+# grammar is enforced
+
+scratch query "$rows"
+app "1\nElm Avenue\nflood\n09:45\n4\nbasement flooded\n\n7\n" > out.log
+if grep -q "^4|Elm Avenue|flood|09:45|basement flooded|4|" incidents.txt; then pass "report appends a row"
+else fail "report appends a row"; fi
+app "2\n4\nSELECT area, count(*) WHERE type = 'flood' GROUP BY area ORDER BY 1\n\n8\n7\n" > out.log
+if grep -q "^Elm Avenue *| 1" out.log && grep -q "^Main Street *| 1" out.log; then pass "query filters and groups"
+else fail "query filters and groups"; fi
+app "2\n4\nSELECT area, count(*) GROUP BY area ORDER BY 2 DESC\n\n8\n7\n" > out.log
+if grep -A2 "^Area" out.log | grep -q "^Main Street *| 2"; then pass "areas group case-insensitively"
+else fail "areas group case-insensitively"; fi
+app "2\n4\nSELECT area, count(x) GROUP BY area\n\n4\nSELECT id WHERE type = 'fire' LIMIT 5\n\n8\n7\n" > out.log
+if grep -q "Query error: expected a column or count(\*)" out.log && grep -A2 "^ID" out.log | grep -q "^2 *$"; then
+    pass "a malformed query is rejected and the next one runs"
+else fail "a malformed query is rejected and the next one runs"; fi
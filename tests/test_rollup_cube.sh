@@ -0,0 +1,12 @@
+# Rollup cube (user-085): count(*) over area, type and time ranges is read from the cube without scanning rows,
+# and agrees with a scan, also for incidents reported in the same session ('fi' matches fire and graffiti)
+
+generated rollup_cube 5000
+cube="SELECT count(*) WHERE area = 'oak road' AND type ~ 'fi' AND time BETWEEN '06:00' AND '11:59'"
+app "1\nOak Road\nfire\n07:30\n2\n\n\n1\nOak Road\nfire\n13:30\n2\n\n\n2\n4\nEXPLAIN ANALYZE $cube\n\n4\n$cube\n\n4\n$cube AND id > 0\n\n8\n7\n" > out.log
+expected=$(awk -F'|' '$2 == "Oak Road" && $3 ~ /fi/ && $4 >= "06:00" && $4 <= "11:59"' incidents.txt | wc -l)
+if grep -q "Rollup cube lookup (2 cells, no rows scanned)" out.log; then pass "a range count reads the cube"
+else fail "a range count reads the cube"; fi
+if [ "$(grep -A2 "^Count" out.log | grep -c "^$expected *$")" -eq 2 ] && [ "$expected" -gt 1 ]; then
+    pass "the cube count agrees with a scan"
+else fail "the cube count agrees with a scan"; fi
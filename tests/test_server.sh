@@ -0,0 +1,95 @@
+# Server mode (user-096): the line protocol over TCP, and startup failures that stop every worker instead of hanging
+
+if ! command -v python3 > /dev/null; then
+    echo "ok - server protocol # SKIP python3 not installed"
+else
+port=$((20000 + $$ % 20000))
+scratch server "$rows"
+INCIDENTS_SERVER_PORT=$port INCIDENTS_SERVER_WORKERS=2 "$work/app" > server.log 2>&1 &
+server=$!
+cat > client.py <<'EOF'
+import socket, sys, time
+# Connect once the workers listen, send the requests in one go, and read the replies in order
+for attempt in range(100):
+    try:
+        connection = socket.create_connection(("127.0.0.1", int(sys.argv[1])))
+        break
+    except OSError:
+        time.sleep(0.1)
+replies = connection.makefile("rb")
+connection.sendall(b"REPORT Pine Lane|fire|12:00|5|shed on fire\nCOUNT main street\nLIST Oak Road\nSTATS\nHELLO\n")
+assert replies.readline().split()[0] == b"OK"
+assert replies.readline() == b"OK 2\n"
+assert replies.readline() == b"OK 1\n"
+assert replies.readline() == b"2|Oak Road|fire|11:30|open|high\n"
+assert replies.readline() == b"OK 4 incidents, 4 open, 2 workers\n"
+assert replies.readline().startswith(b"ERR commands are")
+connection.sendall(b"EXPORT\nQUIT\n")
+header = replies.readline().split()
+assert header[0] == b"OK" and header[2] == b"bytes", header
+assert replies.read(int(header[1])) == open("incidents.txt", "rb").read()
+assert replies.read() == b""
+EOF
+if timeout 20 python3 client.py $port; then pass "server answers REPORT, COUNT, LIST, STATS, EXPORT and QUIT"
+else fail "server answers REPORT, COUNT, LIST, STATS, EXPORT and QUIT"; fi
+
+# Group commit (user-097): a REPORT is answered once its row is in the incidents file, with an id no other has
+cat > reports.py <<'EOF'
+import socket, sys, threading
+ids = []
+def report(client):
+    connection = socket.create_connection(("127.0.0.1", int(sys.argv[1])))
+    replies = connection.makefile("rb")
+    lines = ["REPORT Street %d|flood|10:%02d|3|report %d-%d" % (i % 7, i, client, i) for i in range(50)]
+    connection.sendall(("\n".join(lines) + "\n").encode())
+    for line in lines:
+        reply = replies.readline().split()
+        assert reply[0] == b"OK", reply
+        ids.append((int(reply[1]), line.split("|")[-1]))
+    connection.close()
+clients = [threading.Thread(target=report, args=(client,)) for client in range(8)]
+[client.start() for client in clients]
+[client.join() for client in clients]
+assert len(ids) == 400 and len(set(id for id, _ in ids)) == 400
+stored = {}
+for line in open("incidents.txt"):
+    fields = line.rstrip("\n").split("|")
+    if not line.startswith("#"):
+        stored[int(fields[0])] = (fields[4], int(fields[6]))
+for id, description in ids:
+    assert stored[id][0] == description and stored[id][1] > 0, (id, stored.get(id))
+EOF
+if timeout 20 python3 reports.py $port; then pass "reports are durable when answered, with unique ids"
+else fail "reports are durable when answered, with unique ids"; fi
+
+# A worker that dies takes the server down with an error rather than leaving its peers forwarding to it
+kill -9 $(pgrep -P $server | head -n 1)
+for attempt in 1 2 3 4 5 6 7 8 9 10; do
+    kill -0 $server 2> /dev/null && sleep 1
+done
+if kill -0 $server 2> /dev/null; then
+    fail "a worker that dies stops the server"
+    pkill -9 -P $server
+    kill -9 $server
+else
+    wait $server
+    status=$?
+    if [ $status -eq 1 ] && grep -q "Server worker . stopped" server.log; then pass "a worker that dies stops the server"
+    else fail "a worker that dies stops the server"; fi
+fi
+
+# Every worker fails to listen on a port already taken; the server exits with an error instead of waiting for them
+cat > taken.py <<'EOF'
+import socket, subprocess, sys
+taken = socket.socket()
+taken.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+taken.bind(("0.0.0.0", int(sys.argv[1])))
+taken.listen()
+sys.exit(subprocess.run([sys.argv[2]], timeout=15).returncode)
+EOF
+INCIDENTS_SERVER_PORT=$((port + 1)) INCIDENTS_SERVER_WORKERS=2 timeout 20 python3 taken.py $((port + 1)) "$work/app" > taken.log 2>&1
+status=$?
+if [ $status -eq 1 ] && grep -q "could not listen on port $((port + 1))" taken.log; then
+    pass "a port already in use stops the server with an error"
+else fail "a port already in use stops the server with an error"; fi
+fi
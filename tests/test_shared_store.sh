@@ -0,0 +1,29 @@
+# Shared store (user-092): instances attached to one segment see each other's reports without a restart
+
+scratch shared_store "$rows"
+export INCIDENTS_SHARED_STORE="$dir/segment"
+app "7\n" > first.log
+mkfifo input
+timeout 20 "$work/app" < input > holder.log 2>&1 &
+holder=$!
+exec 3> input
+printf "1\nPine Lane\nfire\n12:00\n5\nshed on fire\n\n" >&3
+sleep 1
+app "2\n4\nSELECT count(*) WHERE area = 'pine lane'\n\n8\n7\n" > second.log
+printf "7\n" >&3
+exec 3>&-
+wait $holder
+if grep -A2 "^Count" second.log | grep -q "^1 *$"; then pass "shared store sees another instance's report"
+else fail "shared store sees another instance's report"; fi
+app "2\n4\nSELECT count(*)\n\n8\n7\n" > third.log
+if grep -A2 "^Count" third.log | grep -q "^4 *$" \
+    && [ "$(grep -c "^4|Pine Lane|fire|12:00|shed on fire|5|" incidents.txt)" -eq 1 ]; then
+    pass "a later instance attaches with every row stored once"
+else fail "a later instance attaches with every row stored once"; fi
+
+# Export (user-098): an attached instance never read the incidents file, yet exports all of it
+app "2\n7\n1\nexport.txt\n\n8\n7\n" > export.log
+if grep -q "Exported 4 incidents" export.log && cmp -s export.txt incidents.txt; then
+    pass "an attached instance exports the whole incidents file"
+else fail "an attached instance exports the whole incidents file"; fi
+unset INCIDENTS_SHARED_STORE
@@ -0,0 +1,44 @@
+# Streaming queries (user-086): a deadline stops a scan with the rows found so far, or with no result for an
+# aggregate, and a keypress on a terminal cancels one and leaves the next prompt alone
+
+generated streaming 300000
+app "2\n4\nSELECT id WHERE area ~ 'o' TIMEOUT 0\n\n4\nSELECT area, count(*) WHERE type ~ 'o' GROUP BY area TIMEOUT 0\n\n4\nSELECT count(*) WHERE area ~ 'o'\n\n8\n7\n" > out.log
+if grep -q "^Query reached its deadline; showing the [0-9]* rows found so far" out.log; then
+    pass "a deadline keeps the streamed rows"
+else fail "a deadline keeps the streamed rows"; fi
+if grep -q "^Query reached its deadline before it finished; no result" out.log; then
+    pass "a deadline drops a partial aggregate"
+else fail "a deadline drops a partial aggregate"; fi
+if grep -A2 "^Count" out.log | grep -q "^60000 *$"; then pass "a query without a deadline finishes"
+else fail "a query without a deadline finishes"; fi
+
+if command -v python3 > /dev/null; then
+    if python3 - "$work/app" <<'EOF'
+import os, pty, re, select, sys, time
+pid, terminal = pty.fork()
+if pid == 0:
+    os.execv(sys.argv[1], [sys.argv[1]])
+output = b""
+def expect(text):
+    global output
+    end = time.time() + 20
+    while text not in output and time.time() < end:
+        if select.select([terminal], [], [], 0.1)[0]:
+            try:
+                output += os.read(terminal, 65536)
+            except OSError:
+                break
+    return text in output
+for answer, prompt in ((b"2\n", b"Enter your choice"), (b"4\n", b"Enter a query"),
+                       (b"SELECT id WHERE area ~ 'o'\n", b"press any key to cancel"), (b"x", b"rows found so far"),
+                       (b"\n8\n7\n", b"Thank you")):
+    os.write(terminal, answer)
+    assert expect(prompt), prompt
+os.waitpid(pid, 0)
+assert "Query cancelled; showing the" in re.sub(rb"\x1b\[[0-9;]*[A-Za-z]", b"", output).decode(errors="replace")
+EOF
+    then pass "a keypress cancels a streaming query"
+    else fail "a keypress cancels a streaming query"; fi
+else
+    echo "ok - a keypress cancels a streaming query # SKIP python3 not installed"
+fi
@@ -0,0 +1,30 @@
+# Municipalities (user-095): each one reads and writes only its own directory, and its memory and query quotas
+# bound what it can load, report and scan
+
+scratch tenants ""
+rm incidents.txt
+mkdir north south east
+printf "$rows" > north/incidents.txt
+generated tenants/south 50000
+generated tenants/east 300000
+cd "$work/tenants" || exit 1
+printf "North|north\nSouth|south|1\nEast|east|0|1\n" > tenants.txt
+count="2\n4\nSELECT count(*)\n\n8\n"
+app "1\nElm Avenue\nflood\n09:45\n4\n\n\n${count}6\n2\n\n2\n4\nSELECT count(*) WHERE area = 'elm avenue'\n\n8\n6\n1\n\n${count}7\n" \
+    > out.log
+if [ "$(grep -A2 "^Count" out.log | grep -c "^4 *$")" -eq 2 ] && grep -A2 "^Count" out.log | grep -q "^0 *$" \
+    && grep -q "^4|Elm Avenue|flood|" north/incidents.txt && [ ! -e incidents.txt ] \
+    && ! grep -q "Elm Avenue" south/incidents.txt east/incidents.txt; then
+    pass "municipalities keep their incidents apart"
+else fail "municipalities keep their incidents apart"; fi
+if grep -q "Error: South reached its memory quota after [0-9]* incidents" out.log; then
+    pass "loading stops at the memory quota"
+else fail "loading stops at the memory quota"; fi
+app "6\n2\n\n1\n\n7\n" > out.log
+if grep -q "Error: South has reached its memory quota" out.log \
+    && ! grep -q "Elm Avenue" south/incidents.txt; then pass "a report over the memory quota is refused"
+else fail "a report over the memory quota is refused"; fi
+app "6\n3\n\n2\n4\nSELECT id WHERE area ~ 'o'\n\n8\n7\n" > out.log
+if grep -q "^Query reached its deadline; showing the [0-9]* rows found so far" out.log; then
+    pass "the query quota stops a long scan"
+else fail "the query quota stops a long scan"; fi
@@ -0,0 +1,15 @@
+# Watch list (user-079): subscriptions alert on matching reports, keep their field, and survive a restart
+
+scratch watch_list "$rows"
+long="collapsed retaining wall next to the northern railway bridge"  # longer than an area name
+app "3\n1\nAna|Pop\ngas leak\n3\n\n1\nDan\n$long\n1\n\n1\nEva\noak road\n2\n\n4\n7\n" > out.log
+if grep -q "^Ana/Pop|type|gas leak$" subscriptions.txt && grep -q "^Dan|any|$long$" subscriptions.txt \
+    && [ "$(wc -l < subscriptions.txt)" -eq 3 ]; then pass "subscriptions are saved one per line"
+else fail "subscriptions are saved one per line"; fi
+app "1\nOak Road\nGas Leak\n13:00\n5\nsmell of gas\n\n1\nGas Leak Lane\nfire\n13:05\n3\nbin fire\n\n7\n" > out.log
+if grep -q "ALERT for Ana/Pop: incident 4 (Oak Road, Gas Leak)" out.log \
+    && grep -q "ALERT for Eva: incident 4" out.log; then pass "a report alerts the matching subscribers"
+else fail "a report alerts the matching subscribers"; fi
+if ! grep -q "ALERT for Ana/Pop: incident 5" out.log && ! grep -q "ALERT for Eva: incident 5" out.log; then
+    pass "an area match does not alert a type-only subscription"
+else fail "an area match does not alert a type-only subscription"; fi